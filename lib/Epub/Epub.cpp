@@ -1,5 +1,6 @@
 #include "Epub.h"
 
+#include <BmpSink.h>
 #include <FsHelpers.h>
 #include <HalStorage.h>
 #include <JpegToBmpConverter.h>
@@ -7,6 +8,7 @@
 #include <PngToBmpConverter.h>
 #include <ZipFile.h>
 
+#include "Epub/converters/ZipImageSource.h"
 #include "Epub/parsers/ContainerParser.h"
 #include "Epub/parsers/ContentOpfParser.h"
 #include "Epub/parsers/TocNavParser.h"
@@ -318,14 +320,34 @@ void Epub::parseCssFiles() const {
       Storage.remove(tmpCssPath.c_str());
     }
 
-    // Save to cache for next time
+    LOG_DBG("EBP", "Loaded %zu CSS style rules from %zu files", cssParser->ruleCount(), cssFiles.size());
+
+    // Save to cache for next time; sections read the rules back through the cached rule index
     if (!cssParser->saveToCache()) {
       LOG_ERR("EBP", "Failed to save CSS rules to cache");
     }
     cssParser->clear();
+  }
+}
 
-    LOG_DBG("EBP", "Loaded %zu CSS style rules from %zu files", cssParser->ruleCount(), cssFiles.size());
+bool Epub::rebuildCssCache() {
+  if (!cssParser || !bookMetadataCache || cssCacheRebuilt) {
+    return false;
+  }
+  cssCacheRebuilt = true;
+
+  LOG_ERR("EBP", "CSS rules cache is unusable, re-parsing CSS files");
+  cssParser->clear();
+  if (!cssParser->removeCache()) {
+    LOG_ERR("EBP", "Could not remove CSS rules cache");
+    return false;
   }
+  if (cssFiles.empty() && !parseContentOpf(bookMetadataCache->coreMetadata)) {
+    LOG_ERR("EBP", "Could not parse content.opf for CSS files");
+    return false;
+  }
+  parseCssFiles();
+  return cssParser->loadFromCache();
 }
 
 // load in the meta data for the epub file
@@ -512,192 +534,144 @@ std::string Epub::getCoverBmpPath(bool cropped) const {
   return cachePath + "/" + coverFileName + ".bmp";
 }
 
-bool Epub::generateCoverBmp(bool cropped) const {
-  // Already generated, return true
-  if (Storage.exists(getCoverBmpPath(cropped).c_str())) {
-    return true;
+bool Epub::generateCoverBmp(bool cropped) const { return generateCoverBmps(!cropped, cropped, {}).allWritten(); }
+
+Epub::CoverBmpResult Epub::generateCoverBmps(const bool fitCover, const bool croppedCover,
+                                             const std::vector<int>& thumbHeights,
+                                             const std::atomic<bool>* cancel) const {
+  CoverBmpResult result;
+  result.thumbs.assign(thumbHeights.size(), true);
+
+  // Only the variants that do not exist yet are generated
+  struct Output {
+    std::string path;
+    BmpTarget target;
+    int thumbIndex;  // Index into thumbHeights, -1 for the sleep covers
+  };
+  std::vector<Output> outputs;
+  for (const bool cropped : {false, true}) {
+    if ((cropped ? croppedCover : fitCover) && !Storage.exists(getCoverBmpPath(cropped).c_str())) {
+      outputs.push_back(Output{getCoverBmpPath(cropped),
+                               {nullptr, BmpTarget::COVER_MAX_WIDTH, BmpTarget::COVER_MAX_HEIGHT, false, cropped},
+                               -1});
+    }
   }
-
-  if (!bookMetadataCache || !bookMetadataCache->isLoaded()) {
-    LOG_ERR("EBP", "Cannot generate cover BMP, cache not loaded");
-    return false;
+  for (size_t i = 0; i < thumbHeights.size(); i++) {
+    const int height = thumbHeights[i];
+    if (!Storage.exists(getThumbBmpPath(height).c_str())) {
+      // 1-bit thumbnails render fast on the home screen (no gray passes needed)
+      outputs.push_back(Output{getThumbBmpPath(height), {nullptr, static_cast<int>(height * 0.6), height, true, true},
+                               static_cast<int>(i)});
+    }
   }
-
-  const auto coverImageHref = bookMetadataCache->coreMetadata.coverItemHref;
-  if (coverImageHref.empty()) {
-    LOG_ERR("EBP", "No known cover image");
-    return false;
+  if (outputs.empty()) {
+    return result;
   }
 
-  if (coverImageHref.substr(coverImageHref.length() - 4) == ".jpg" ||
-      coverImageHref.substr(coverImageHref.length() - 5) == ".jpeg") {
-    LOG_DBG("EBP", "Generating BMP from JPG cover image (%s mode)", cropped ? "cropped" : "fit");
-    const auto coverJpgTempPath = getCachePath() + "/.cover.jpg";
-
-    FsFile coverJpg;
-    if (!Storage.openFileForWrite("EBP", coverJpgTempPath, coverJpg)) {
-      return false;
+  const auto setWritten = [&result](const Output& output, const bool written) {
+    if (output.thumbIndex >= 0) {
+      result.thumbs[output.thumbIndex] = written;
+    } else if (output.target.crop) {
+      result.croppedCover = written;
+    } else {
+      result.fitCover = written;
     }
-    readItemContentsToStream(coverImageHref, coverJpg, 1024);
-    coverJpg.close();
+  };
+  for (const auto& output : outputs) {
+    setWritten(output, false);
+  }
 
-    if (!Storage.openFileForRead("EBP", coverJpgTempPath, coverJpg)) {
-      return false;
-    }
+  if (!bookMetadataCache || !bookMetadataCache->isLoaded()) {
+    LOG_ERR("EBP", "Cannot generate cover BMPs, cache not loaded");
+    return result;
+  }
 
-    FsFile coverBmp;
-    if (!Storage.openFileForWrite("EBP", getCoverBmpPath(cropped), coverBmp)) {
-      coverJpg.close();
-      return false;
+  const auto coverImageHref = bookMetadataCache->coreMetadata.coverItemHref;
+  const auto hasSuffix = [&coverImageHref](const std::string& suffix) {
+    return coverImageHref.length() >= suffix.length() &&
+           coverImageHref.compare(coverImageHref.length() - suffix.length(), suffix.length(), suffix) == 0;
+  };
+  const bool isJpg = hasSuffix(".jpg") || hasSuffix(".jpeg");
+  const bool isPng = hasSuffix(".png");
+  if (!isJpg && !isPng) {
+    if (coverImageHref.empty()) {
+      LOG_ERR("EBP", "No known cover image");
+    } else {
+      LOG_ERR("EBP", "Cover image is not a supported format, skipping");
     }
-    const bool success = JpegToBmpConverter::jpegFileToBmpStream(coverJpg, coverBmp, cropped);
-    coverJpg.close();
-    coverBmp.close();
-    Storage.remove(coverJpgTempPath.c_str());
-
-    if (!success) {
-      LOG_ERR("EBP", "Failed to generate BMP from cover image");
-      Storage.remove(getCoverBmpPath(cropped).c_str());
+    // Write empty thumbnail files to avoid generation attempts in the future
+    for (const auto& output : outputs) {
+      if (output.thumbIndex >= 0) {
+        FsFile thumbBmp;
+        Storage.openFileForWrite("EBP", output.path, thumbBmp);
+        thumbBmp.close();
+      }
     }
-    LOG_DBG("EBP", "Generated BMP from JPG cover image, success: %s", success ? "yes" : "no");
-    return success;
+    return result;
   }
 
-  if (coverImageHref.substr(coverImageHref.length() - 4) == ".png") {
-    LOG_DBG("EBP", "Generating BMP from PNG cover image (%s mode)", cropped ? "cropped" : "fit");
-    const auto coverPngTempPath = getCachePath() + "/.cover.png";
+  LOG_DBG("EBP", "Generating %d BMPs from %s cover image", static_cast<int>(outputs.size()), isJpg ? "JPG" : "PNG");
 
-    FsFile coverPng;
-    if (!Storage.openFileForWrite("EBP", coverPngTempPath, coverPng)) {
-      return false;
-    }
-    readItemContentsToStream(coverImageHref, coverPng, 1024);
-    coverPng.close();
+  // Decode straight out of the EPUB instead of extracting the image to the SD card first
+  ZipImageSource coverImage(filepath);
+  if (!coverImage.open(FsHelpers::normalisePath(coverImageHref))) {
+    return result;
+  }
+  coverImage.setCancelFlag(cancel);
 
-    if (!Storage.openFileForRead("EBP", coverPngTempPath, coverPng)) {
-      return false;
+  // An output whose file cannot be created is left out; the others are still decoded
+  std::vector<FsFile> bmpFiles(outputs.size());
+  std::vector<const Output*> opened;
+  std::vector<BmpTarget> targets;
+  opened.reserve(outputs.size());
+  targets.reserve(outputs.size());
+  for (size_t i = 0; i < outputs.size(); i++) {
+    if (!Storage.openFileForWrite("EBP", outputs[i].path, bmpFiles[i])) {
+      LOG_ERR("EBP", "Failed to create %s", outputs[i].path.c_str());
+      continue;
     }
+    opened.push_back(&outputs[i]);
+    targets.push_back(outputs[i].target);
+    targets.back().out = &bmpFiles[i];
+  }
+  if (targets.empty()) {
+    coverImage.close();
+    return result;
+  }
+
+  // One decode writes every variant; each one is kept or removed on its own
+  const int count = static_cast<int>(targets.size());
+  std::unique_ptr<bool[]> written(new (std::nothrow) bool[count]());
+  if (!written) {
+    LOG_ERR("EBP", "Failed to allocate cover BMP results");
+  } else if (isJpg) {
+    JpegToBmpConverter::jpegToBmpStreams(coverImage, targets.data(), count, written.get());
+  } else {
+    PngToBmpConverter::pngToBmpStreams(coverImage, targets.data(), count, written.get());
+  }
+  coverImage.close();
+  for (auto& bmpFile : bmpFiles) {
+    bmpFile.close();
+  }
 
-    FsFile coverBmp;
-    if (!Storage.openFileForWrite("EBP", getCoverBmpPath(cropped), coverBmp)) {
-      coverPng.close();
-      return false;
+  int writtenCount = 0;
+  for (int i = 0; i < count; i++) {
+    if (written && written[i]) {
+      setWritten(*opened[i], true);
+      writtenCount++;
+    } else {
+      LOG_ERR("EBP", "Failed to generate %s from cover image", opened[i]->path.c_str());
+      Storage.remove(opened[i]->path.c_str());
     }
-    const bool success = PngToBmpConverter::pngFileToBmpStream(coverPng, coverBmp, cropped);
-    coverPng.close();
-    coverBmp.close();
-    Storage.remove(coverPngTempPath.c_str());
-
-    if (!success) {
-      LOG_ERR("EBP", "Failed to generate BMP from PNG cover image");
-      Storage.remove(getCoverBmpPath(cropped).c_str());
-    }
-    LOG_DBG("EBP", "Generated BMP from PNG cover image, success: %s", success ? "yes" : "no");
-    return success;
   }
-
-  LOG_ERR("EBP", "Cover image is not a supported format, skipping");
-  return false;
+  LOG_DBG("EBP", "Generated %d of %d BMPs from cover image", writtenCount, static_cast<int>(outputs.size()));
+  return result;
 }
 
 std::string Epub::getThumbBmpPath() const { return cachePath + "/thumb_[HEIGHT].bmp"; }
 std::string Epub::getThumbBmpPath(int height) const { return cachePath + "/thumb_" + std::to_string(height) + ".bmp"; }
 
-bool Epub::generateThumbBmp(int height) const {
-  // Already generated, return true
-  if (Storage.exists(getThumbBmpPath(height).c_str())) {
-    return true;
-  }
-
-  if (!bookMetadataCache || !bookMetadataCache->isLoaded()) {
-    LOG_ERR("EBP", "Cannot generate thumb BMP, cache not loaded");
-    return false;
-  }
-
-  const auto coverImageHref = bookMetadataCache->coreMetadata.coverItemHref;
-  if (coverImageHref.empty()) {
-    LOG_DBG("EBP", "No known cover image for thumbnail");
-  } else if (coverImageHref.substr(coverImageHref.length() - 4) == ".jpg" ||
-             coverImageHref.substr(coverImageHref.length() - 5) == ".jpeg") {
-    LOG_DBG("EBP", "Generating thumb BMP from JPG cover image");
-    const auto coverJpgTempPath = getCachePath() + "/.cover.jpg";
-
-    FsFile coverJpg;
-    if (!Storage.openFileForWrite("EBP", coverJpgTempPath, coverJpg)) {
-      return false;
-    }
-    readItemContentsToStream(coverImageHref, coverJpg, 1024);
-    coverJpg.close();
-
-    if (!Storage.openFileForRead("EBP", coverJpgTempPath, coverJpg)) {
-      return false;
-    }
-
-    FsFile thumbBmp;
-    if (!Storage.openFileForWrite("EBP", getThumbBmpPath(height), thumbBmp)) {
-      coverJpg.close();
-      return false;
-    }
-    // Use smaller target size for Continue Reading card (half of screen: 240x400)
-    // Generate 1-bit BMP for fast home screen rendering (no gray passes needed)
-    int THUMB_TARGET_WIDTH = height * 0.6;
-    int THUMB_TARGET_HEIGHT = height;
-    const bool success = JpegToBmpConverter::jpegFileTo1BitBmpStreamWithSize(coverJpg, thumbBmp, THUMB_TARGET_WIDTH,
-                                                                             THUMB_TARGET_HEIGHT);
-    coverJpg.close();
-    thumbBmp.close();
-    Storage.remove(coverJpgTempPath.c_str());
-
-    if (!success) {
-      LOG_ERR("EBP", "Failed to generate thumb BMP from JPG cover image");
-      Storage.remove(getThumbBmpPath(height).c_str());
-    }
-    LOG_DBG("EBP", "Generated thumb BMP from JPG cover image, success: %s", success ? "yes" : "no");
-    return success;
-  } else if (coverImageHref.substr(coverImageHref.length() - 4) == ".png") {
-    LOG_DBG("EBP", "Generating thumb BMP from PNG cover image");
-    const auto coverPngTempPath = getCachePath() + "/.cover.png";
-
-    FsFile coverPng;
-    if (!Storage.openFileForWrite("EBP", coverPngTempPath, coverPng)) {
-      return false;
-    }
-    readItemContentsToStream(coverImageHref, coverPng, 1024);
-    coverPng.close();
-
-    if (!Storage.openFileForRead("EBP", coverPngTempPath, coverPng)) {
-      return false;
-    }
-
-    FsFile thumbBmp;
-    if (!Storage.openFileForWrite("EBP", getThumbBmpPath(height), thumbBmp)) {
-      coverPng.close();
-      return false;
-    }
-    int THUMB_TARGET_WIDTH = height * 0.6;
-    int THUMB_TARGET_HEIGHT = height;
-    const bool success =
-        PngToBmpConverter::pngFileTo1BitBmpStreamWithSize(coverPng, thumbBmp, THUMB_TARGET_WIDTH, THUMB_TARGET_HEIGHT);
-    coverPng.close();
-    thumbBmp.close();
-    Storage.remove(coverPngTempPath.c_str());
-
-    if (!success) {
-      LOG_ERR("EBP", "Failed to generate thumb BMP from PNG cover image");
-      Storage.remove(getThumbBmpPath(height).c_str());
-    }
-    LOG_DBG("EBP", "Generated thumb BMP from PNG cover image, success: %s", success ? "yes" : "no");
-    return success;
-  } else {
-    LOG_ERR("EBP", "Cover image is not a supported format, skipping thumbnail");
-  }
-
-  // Write an empty bmp file to avoid generation attempts in the future
-  FsFile thumbBmp;
-  Storage.openFileForWrite("EBP", getThumbBmpPath(height), thumbBmp);
-  thumbBmp.close();
-  return false;
-}
+bool Epub::generateThumbBmp(int height) const { return generateCoverBmps(false, false, {height}).allWritten(); }
 
 uint8_t* Epub::readItemContentsToBytes(const std::string& itemHref, size_t* size, const bool trailingNullByte) const {
   if (itemHref.empty()) {
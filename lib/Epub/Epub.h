@@ -2,6 +2,8 @@
 
 #include <Print.h>
 
+#include <algorithm>
+#include <atomic>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -29,6 +31,8 @@ class Epub {
   std::unique_ptr<CssParser> cssParser;
   // CSS files
   std::vector<std::string> cssFiles;
+  // Set once the CSS rules cache has been rebuilt, so an unusable cache is only re-parsed once per load
+  bool cssCacheRebuilt = false;
 
   bool findContentOpfFile(std::string* contentOpfFile) const;
   bool parseContentOpf(BookMetadataCache::BookMetadata& bookMetadata);
@@ -53,6 +57,22 @@ class Epub {
   const std::string& getLanguage() const;
   std::string getCoverBmpPath(bool cropped = false) const;
   bool generateCoverBmp(bool cropped = false) const;
+  // Re-parse the stylesheets into a fresh CSS rules cache after the cached one failed to load
+  bool rebuildCssCache();
+  // Result of generateCoverBmps for each requested file; files that already existed count as written
+  struct CoverBmpResult {
+    bool fitCover = true;
+    bool croppedCover = true;
+    std::vector<bool> thumbs;  // One per thumbHeights entry
+
+    bool allWritten() const {
+      return fitCover && croppedCover && std::find(thumbs.begin(), thumbs.end(), false) == thumbs.end();
+    }
+  };
+  // Writes the missing sleep covers (fit and/or cropped) and 1-bit thumbnails from a single decode of the cover image.
+  // Files that could be written are kept when others fail. Setting cancel stops the decode, leaving nothing written.
+  CoverBmpResult generateCoverBmps(bool fitCover, bool croppedCover, const std::vector<int>& thumbHeights,
+                                   const std::atomic<bool>* cancel = nullptr) const;
   std::string getThumbBmpPath() const;
   std::string getThumbBmpPath(int height) const;
   bool generateThumbBmp(int height) const;
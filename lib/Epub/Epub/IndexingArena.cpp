@@ -0,0 +1,232 @@
+#include "IndexingArena.h"
+
+#include <Logging.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+IndexingArena* activeArena = nullptr;
+TaskHandle_t activeOwner = nullptr;
+// Chunks of arenas whose Scope ended while blocks were still handed out; freed once those blocks come back
+IndexingArena retiredArena;
+
+size_t roundUp(const size_t bytes, const size_t granule) { return (bytes + granule - 1) / granule * granule; }
+}  // namespace
+
+bool IndexingArena::addChunk() {
+  if (growthFailed || chunkCount == MAX_CHUNKS) {
+    return false;
+  }
+
+  // A fragmented heap gets a smaller chunk rather than none
+  Chunk chunk = {nullptr, 0};
+  for (size_t size = CHUNK_SIZE; size >= MIN_CHUNK_SIZE && !chunk.begin; size /= 2) {
+    chunk = {static_cast<uint8_t*>(malloc(size)), size};
+  }
+  if (!chunk.begin) {
+    // Not retried for the rest of the run so every later request does not pay for failing mallocs
+    growthFailed = true;
+    if (chunkCount == 0) {
+      LOG_ERR("ARN", "Failed to reserve indexing arena, using the heap");
+    }
+    return false;
+  }
+
+  // The unused tail of the previous chunk is smaller than the request that did not fit, so it is a pooled size
+  if (bumpLeft >= GRANULE) {
+    pushFree(bumpPtr, bumpLeft);
+  }
+  bumpPtr = chunk.begin;
+  bumpLeft = chunk.size;
+
+  size_t index = chunkCount++;
+  for (; index > 0 && chunks[index - 1].begin > chunk.begin; --index) {
+    chunks[index] = chunks[index - 1];
+  }
+  chunks[index] = chunk;
+  spanBegin = reinterpret_cast<uintptr_t>(chunks[0].begin);
+  spanEnd = reinterpret_cast<uintptr_t>(chunks[chunkCount - 1].begin) + chunks[chunkCount - 1].size;
+  stats.reservedBytes += chunk.size;
+  stats.chunks++;
+  return true;
+}
+
+bool IndexingArena::owns(const void* ptr) const {
+  const auto address = reinterpret_cast<uintptr_t>(ptr);
+  if (address - spanBegin >= spanEnd - spanBegin) {
+    return false;
+  }
+  // Last chunk starting at or below the address
+  size_t lo = 0;
+  size_t hi = chunkCount;
+  while (hi - lo > 1) {
+    const size_t mid = lo + (hi - lo) / 2;
+    if (reinterpret_cast<uintptr_t>(chunks[mid].begin) <= address) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  return address - reinterpret_cast<uintptr_t>(chunks[lo].begin) < chunks[lo].size;
+}
+
+void IndexingArena::pushFree(void* ptr, const size_t size) {
+  auto* block = static_cast<FreeBlock*>(ptr);
+  FreeBlock*& freeList = freeLists[size / GRANULE - 1];
+  block->next = freeList;
+  freeList = block;
+}
+
+void* IndexingArena::allocate(const size_t bytes) {
+  const size_t size = roundUp(bytes == 0 ? 1 : bytes, GRANULE);
+  if (size > MAX_POOLED_SIZE) {
+    stats.heapFallbacks++;
+    return ::operator new(bytes, std::nothrow);
+  }
+
+  void* ptr = nullptr;
+  FreeBlock*& freeList = freeLists[size / GRANULE - 1];
+  if (freeList) {
+    ptr = freeList;
+    freeList = freeList->next;
+    stats.recycled++;
+  } else {
+    if (bumpLeft < size && !addChunk()) {
+      stats.heapFallbacks++;
+      return ::operator new(bytes, std::nothrow);
+    }
+    ptr = bumpPtr;
+    bumpPtr += size;
+    bumpLeft -= size;
+  }
+
+  stats.allocations++;
+  stats.inUse += size;
+  if (stats.inUse > stats.peakInUse) {
+    stats.peakInUse = stats.inUse;
+  }
+  return ptr;
+}
+
+void IndexingArena::deallocate(void* ptr, const size_t bytes) {
+  if (!ptr) {
+    return;
+  }
+  if (!owns(ptr)) {
+    ::operator delete(ptr);
+    return;
+  }
+
+  const size_t size = roundUp(bytes == 0 ? 1 : bytes, GRANULE);
+  pushFree(ptr, size);
+  stats.inUse -= size;
+}
+
+void IndexingArena::release() {
+  for (size_t i = 0; i < chunkCount; ++i) {
+    free(chunks[i].begin);
+  }
+  chunkCount = 0;
+  spanBegin = 0;
+  spanEnd = 0;
+  bumpPtr = nullptr;
+  bumpLeft = 0;
+  growthFailed = false;
+  for (auto& freeList : freeLists) {
+    freeList = nullptr;
+  }
+  stats.reservedBytes = 0;
+  stats.chunks = 0;
+  stats.inUse = 0;
+}
+
+void IndexingArena::adopt(IndexingArena& other) {
+  for (size_t i = 0; i < other.chunkCount; ++i) {
+    if (chunkCount == MAX_CHUNKS) {
+      // Leaked rather than freed: a block in it may still be freed later
+      LOG_ERR("ARN", "Too many retired arena chunks, leaking %u bytes", static_cast<uint32_t>(other.chunks[i].size));
+      continue;
+    }
+    size_t index = chunkCount++;
+    for (; index > 0 && chunks[index - 1].begin > other.chunks[i].begin; --index) {
+      chunks[index] = chunks[index - 1];
+    }
+    chunks[index] = other.chunks[i];
+    stats.reservedBytes += other.chunks[i].size;
+    stats.chunks++;
+  }
+  if (chunkCount > 0) {
+    spanBegin = reinterpret_cast<uintptr_t>(chunks[0].begin);
+    spanEnd = reinterpret_cast<uintptr_t>(chunks[chunkCount - 1].begin) + chunks[chunkCount - 1].size;
+  }
+  stats.inUse += other.stats.inUse;
+
+  other.chunkCount = 0;
+  other.release();
+}
+
+IndexingArena* IndexingArena::active() {
+  if (!activeArena || activeOwner != xTaskGetCurrentTaskHandle()) {
+    return nullptr;
+  }
+  return activeArena;
+}
+
+IndexingArena::Scope::Scope(IndexingArena& arena) : arena(arena) {
+  activeArena = &arena;
+  activeOwner = xTaskGetCurrentTaskHandle();
+}
+
+IndexingArena::Scope::~Scope() {
+  activeArena = nullptr;
+  activeOwner = nullptr;
+
+  const Stats& stats = arena.getStats();
+  if (stats.inUse > 0) {
+    LOG_ERR("ARN", "%u bytes still allocated when indexing arena was released, keeping its chunks until freed",
+            static_cast<uint32_t>(stats.inUse));
+  }
+  LOG_DBG("ARN", "Arena: peak %u of %u bytes in %u chunks, %u allocs (%u recycled), %u heap fallbacks",
+          static_cast<uint32_t>(stats.peakInUse), static_cast<uint32_t>(stats.reservedBytes), stats.chunks,
+          stats.allocations, stats.recycled, stats.heapFallbacks);
+  if (stats.inUse > 0) {
+    // Freeing the chunks now would let those blocks' eventual frees hand arena memory to ::operator delete
+    retiredArena.adopt(arena);
+  } else {
+    arena.release();
+  }
+}
+
+void* arena::tryAllocate(const size_t bytes) {
+  IndexingArena* current = IndexingArena::active();
+  return current ? current->allocate(bytes) : ::operator new(bytes, std::nothrow);
+}
+
+void* arena::allocate(const size_t bytes) {
+  void* ptr = tryAllocate(bytes);
+  return ptr ? ptr : ::operator new(bytes);
+}
+
+void arena::deallocate(void* ptr, const size_t bytes) {
+  IndexingArena* current = IndexingArena::active();
+  if (current) {
+    current->deallocate(ptr, bytes);
+    return;
+  }
+  if (retiredArena.owns(ptr)) {
+    retiredArena.deallocate(ptr, bytes);
+    if (retiredArena.getStats().inUse == 0) {
+      retiredArena.release();
+    }
+    return;
+  }
+  if (activeArena && activeArena->owns(ptr)) {
+    // Another task's arena; its free lists are not ours to touch, and the chunk goes back to the heap with it
+    LOG_ERR("ARN", "Arena block freed from outside its indexing task, ignoring");
+    return;
+  }
+  ::operator delete(ptr);
+}
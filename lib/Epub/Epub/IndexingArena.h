@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+
+// Pool allocator that owns the short-lived allocations made while a section file is being built (words, text
+// blocks, page elements, expat state). Memory is carved out of chunks reserved from the heap as the run needs them,
+// freed blocks are recycled through per-size free lists, and everything is handed back to the heap in one shot when
+// the indexing run ends. Requests that no longer fit in the arena go to the heap.
+// This keeps thousands of small transient allocations from being interleaved with long-lived heap objects, which
+// otherwise fragments the heap and can make the next image decode fail.
+//
+// Only the task that opened the Scope allocates from the arena; other tasks (and code running outside a Scope)
+// transparently fall back to the regular heap.
+class IndexingArena {
+ public:
+  struct Stats {
+    size_t reservedBytes = 0;    // Bytes currently reserved from the heap for chunks
+    uint32_t chunks = 0;         // Chunks currently reserved
+    size_t inUse = 0;            // Bytes currently handed out from the chunks
+    size_t peakInUse = 0;        // High-water mark of inUse
+    uint32_t allocations = 0;    // Allocations served from the chunks
+    uint32_t recycled = 0;       // Of which served from a free list
+    uint32_t heapFallbacks = 0;  // Requests too large for the pool, or made once no further chunk could be reserved
+  };
+
+  IndexingArena() = default;
+  ~IndexingArena() { release(); }
+  IndexingArena(const IndexingArena&) = delete;
+  IndexingArena& operator=(const IndexingArena&) = delete;
+
+  // Returns nullptr only if both the pool and the heap fallback are exhausted.
+  void* allocate(size_t bytes);
+  void deallocate(void* ptr, size_t bytes);
+  // A bounds check against the span of all chunks, then a binary search over their sorted address ranges
+  bool owns(const void* ptr) const;
+  // Returns the chunks to the heap. Any pointer still handed out becomes invalid.
+  void release();
+  const Stats& getStats() const { return stats; }
+
+  // The arena bound to the calling task, or nullptr when no indexing run is active on it.
+  static IndexingArena* active();
+
+  // Binds an arena to the calling task for its lifetime and releases it on exit. Blocks still handed out at that
+  // point keep their chunks reserved until they are freed, so a late free never reaches ::operator delete.
+  class Scope {
+    IndexingArena& arena;
+
+   public:
+    explicit Scope(IndexingArena& arena);
+    ~Scope();
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+  };
+
+ private:
+  // A chunk is halved until a reservation succeeds, down to MIN_CHUNK_SIZE
+  static constexpr size_t CHUNK_SIZE = 16 * 1024;
+  static constexpr size_t MIN_CHUNK_SIZE = 4 * 1024;
+  static constexpr size_t MAX_CHUNKS = 8;
+  static constexpr size_t GRANULE = 8;
+  static constexpr size_t MAX_POOLED_SIZE = 512;
+  static constexpr size_t NUM_SIZE_CLASSES = MAX_POOLED_SIZE / GRANULE;
+
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+
+  struct Chunk {
+    uint8_t* begin;
+    size_t size;
+  };
+
+  // Sorted by address; [spanBegin, spanEnd) covers all of them so most foreign pointers fail one range check
+  Chunk chunks[MAX_CHUNKS] = {};
+  size_t chunkCount = 0;
+  uintptr_t spanBegin = 0;
+  uintptr_t spanEnd = 0;
+  // Unused tail of the newest chunk
+  uint8_t* bumpPtr = nullptr;
+  size_t bumpLeft = 0;
+  bool growthFailed = false;
+  FreeBlock* freeLists[NUM_SIZE_CLASSES] = {};
+  Stats stats;
+
+  bool addChunk();
+  void pushFree(void* ptr, size_t size);
+  void adopt(IndexingArena& other);
+};
+
+// Heap-or-arena allocation entry points used by the adapters below.
+namespace arena {
+// Returns nullptr when out of memory (for C libraries such as expat that handle allocation failure).
+void* tryAllocate(size_t bytes);
+// Behaves like ::operator new when out of memory.
+void* allocate(size_t bytes);
+void deallocate(void* ptr, size_t bytes);
+}  // namespace arena
+
+// STL-compatible allocator that routes through the active IndexingArena (or the heap when there is none).
+template <typename T>
+struct ArenaAllocator {
+  using value_type = T;
+  static_assert(alignof(T) <= 8, "IndexingArena only guarantees 8-byte alignment");
+
+  ArenaAllocator() = default;
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>&) {}  // NOLINT(google-explicit-constructor)
+
+  T* allocate(const size_t n) { return static_cast<T*>(arena::allocate(n * sizeof(T))); }
+  void deallocate(T* ptr, const size_t n) { arena::deallocate(ptr, n * sizeof(T)); }
+
+  template <typename U>
+  bool operator==(const ArenaAllocator<U>&) const {
+    return true;
+  }
+  template <typename U>
+  bool operator!=(const ArenaAllocator<U>&) const {
+    return false;
+  }
+};
+
+// Base class for transient indexing objects created with plain `new`.
+struct ArenaAllocated {
+  static void* operator new(const size_t size) { return arena::allocate(size); }
+  static void operator delete(void* ptr, const size_t size) { arena::deallocate(ptr, size); }
+};
+
+using ArenaString = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+template <typename T>
+using ArenaList = std::list<T, ArenaAllocator<T>>;
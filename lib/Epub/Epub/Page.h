@@ -5,6 +5,7 @@
 #include <utility>
 #include <vector>
 
+#include "IndexingArena.h"
 #include "blocks/ImageBlock.h"
 #include "blocks/TextBlock.h"
 
@@ -51,7 +52,7 @@ class PageImage final : public PageElement {
   static std::unique_ptr<PageImage> deserialize(FsFile& file);
 };
 
-class Page {
+class Page : public ArenaAllocated {
  public:
   // the list of block index and line numbers on this page
   std::vector<std::shared_ptr<PageElement>> elements;
@@ -4,15 +4,58 @@
 #include <Logging.h>
 #include <Serialization.h>
 
+#include <cstring>
+#include <new>
+
+#include "IndexingArena.h"
 #include "Page.h"
+#include "hyphenation/HyphenationCache.h"
 #include "hyphenation/Hyphenator.h"
 #include "parsers/ChapterHtmlSlimParser.h"
 
 namespace {
-constexpr uint8_t SECTION_FILE_VERSION = 13;
+constexpr uint8_t SECTION_FILE_VERSION = 15;
 constexpr uint32_t HEADER_SIZE = sizeof(uint8_t) + sizeof(int) + sizeof(float) + sizeof(bool) + sizeof(uint8_t) +
                                  sizeof(uint16_t) + sizeof(uint16_t) + sizeof(uint16_t) + sizeof(bool) + sizeof(bool) +
                                  sizeof(uint32_t);
+// hyphenation.bin: version byte + HyphenationCache::identity() + the raw table
+constexpr uint8_t HYPHENATION_CACHE_VERSION = 2;
+
+// Share of the free heap that is not reachable as one contiguous block (0% = unfragmented)
+uint32_t heapFragmentationPercent() {
+  const uint32_t freeHeap = ESP.getFreeHeap();
+  return freeHeap == 0 ? 0 : 100 - static_cast<uint32_t>(static_cast<uint64_t>(ESP.getMaxAllocHeap()) * 100 / freeHeap);
+}
+
+// The hyphenation break cache is carried over between section builds of a book, so common words are hyphenated once
+void loadHyphenationCache(const std::string& path, HyphenationCache& cache) {
+  FsFile cacheFile;
+  if (!Storage.exists(path.c_str()) || !Storage.openFileForRead("SCT", path, cacheFile)) {
+    return;
+  }
+  uint8_t version = 0;
+  uint32_t identity = 0;
+  if (cacheFile.size() == sizeof(version) + sizeof(identity) + HyphenationCache::sizeBytes() &&
+      cacheFile.read(&version, 1) == 1 && version == HYPHENATION_CACHE_VERSION &&
+      cacheFile.read(&identity, sizeof(identity)) == sizeof(identity) && identity == HyphenationCache::identity()) {
+    if (cacheFile.read(cache.entries(), HyphenationCache::sizeBytes()) !=
+        static_cast<int>(HyphenationCache::sizeBytes())) {
+      memset(cache.entries(), 0, HyphenationCache::sizeBytes());
+    }
+  }
+  cacheFile.close();
+}
+
+void saveHyphenationCache(const std::string& path, const HyphenationCache& cache) {
+  FsFile cacheFile;
+  if (!Storage.openFileForWrite("SCT", path, cacheFile)) {
+    return;
+  }
+  serialization::writePod(cacheFile, HYPHENATION_CACHE_VERSION);
+  serialization::writePod(cacheFile, HyphenationCache::identity());
+  cacheFile.write(reinterpret_cast<const uint8_t*>(cache.entries()), HyphenationCache::sizeBytes());
+  cacheFile.close();
+}
 }  // namespace
 
 uint32_t Section::onPageComplete(std::unique_ptr<Page> page) {
@@ -128,7 +171,7 @@ bool Section::clearCache() const {
 bool Section::createSectionFile(const int fontId, const float lineCompression, const bool extraParagraphSpacing,
                                 const uint8_t paragraphAlignment, const uint16_t viewportWidth,
                                 const uint16_t viewportHeight, const bool hyphenationEnabled, const bool embeddedStyle,
-                                const std::function<void()>& popupFn) {
+                                const std::function<void()>& popupFn, const bool preDecodeImages) {
   const auto localPath = epub->getSpineItem(spineIndex).href;
   const auto tmpHtmlPath = epub->getCachePath() + "/.tmp_" + std::to_string(spineIndex) + ".html";
 
@@ -190,19 +233,51 @@ bool Section::createSectionFile(const int fontId, const float lineCompression, c
   if (embeddedStyle) {
     cssParser = epub->getCssParser();
     if (cssParser) {
-      if (!cssParser->loadFromCache()) {
-        LOG_ERR("SCT", "Failed to load CSS from cache");
+      if (!cssParser->loadFromCache() && !epub->rebuildCssCache()) {
+        LOG_ERR("SCT", "Failed to load CSS from cache, stylesheet rules are ignored");
       }
     }
   }
 
-  ChapterHtmlSlimParser visitor(
-      epub, tmpHtmlPath, renderer, fontId, lineCompression, extraParagraphSpacing, paragraphAlignment, viewportWidth,
-      viewportHeight, hyphenationEnabled,
-      [this, &lut](std::unique_ptr<Page> page) { lut.emplace_back(this->onPageComplete(std::move(page))); },
-      embeddedStyle, contentBase, imageBasePath, popupFn, cssParser);
-  Hyphenator::setPreferredLanguage(epub->getLanguage());
-  success = visitor.parseAndBuildPages();
+  std::unique_ptr<HyphenationCache> hyphenationCache;
+  const std::string hyphenationCachePath = epub->getCachePath() + "/hyphenation.bin";
+  if (hyphenationEnabled) {
+    hyphenationCache.reset(new (std::nothrow) HyphenationCache());
+    if (hyphenationCache) {
+      loadHyphenationCache(hyphenationCachePath, *hyphenationCache);
+    }
+  }
+
+  // Decoded once the parser and its arena are gone, so the decoders get the memory back
+  std::vector<std::shared_ptr<ImageBlock>> imagesToDecode;
+
+  LOG_DBG("SCT", "Heap before indexing: %u free, %u largest block, %u%% fragmented", ESP.getFreeHeap(),
+          ESP.getMaxAllocHeap(), heapFragmentationPercent());
+  {
+    // Everything the parser allocates lives in this arena and is returned to the heap in one go below
+    IndexingArena arena;
+    IndexingArena::Scope arenaScope(arena);
+    ChapterHtmlSlimParser visitor(
+        epub, tmpHtmlPath, renderer, fontId, lineCompression, extraParagraphSpacing, paragraphAlignment, viewportWidth,
+        viewportHeight, hyphenationEnabled,
+        [this, &lut](std::unique_ptr<Page> page) { lut.emplace_back(this->onPageComplete(std::move(page))); },
+        embeddedStyle, contentBase, imageBasePath, popupFn, cssParser, preDecodeImages ? &imagesToDecode : nullptr);
+    Hyphenator::setPreferredLanguage(epub->getLanguage());
+    Hyphenator::setBreakCache(hyphenationCache.get());
+    success = visitor.parseAndBuildPages();
+    Hyphenator::setBreakCache(nullptr);
+  }
+  if (hyphenationCache) {
+    LOG_DBG("SCT", "Hyphenation cache: %u of %u lookups hit", hyphenationCache->hits(), hyphenationCache->lookups());
+    if (success) {
+      saveHyphenationCache(hyphenationCachePath, *hyphenationCache);
+    }
+  }
+  if (cssParser && cssParser->styleMemoLookups() > 0) {
+    LOG_DBG("SCT", "CSS style memo: %u of %u lookups hit", cssParser->styleMemoHits(), cssParser->styleMemoLookups());
+  }
+  LOG_DBG("SCT", "Heap after indexing: %u free, %u largest block, %u%% fragmented", ESP.getFreeHeap(),
+          ESP.getMaxAllocHeap(), heapFragmentationPercent());
 
   Storage.remove(tmpHtmlPath.c_str());
   if (!success) {
@@ -210,7 +285,7 @@ bool Section::createSectionFile(const int fontId, const float lineCompression, c
     file.close();
     Storage.remove(filePath.c_str());
     if (cssParser) {
-      cssParser->clear();
+      cssParser->endSection();
     }
     return false;
   }
@@ -239,7 +314,12 @@ bool Section::createSectionFile(const int fontId, const float lineCompression, c
   serialization::writePod(file, lutOffset);
   file.close();
   if (cssParser) {
-    cssParser->clear();
+    cssParser->endSection();
+  }
+
+  // An image that fails here is decoded and cached on first render instead
+  for (const auto& imageBlock : imagesToDecode) {
+    imageBlock->buildCache(renderer);
   }
   return true;
 }
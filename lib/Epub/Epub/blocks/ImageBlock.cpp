@@ -2,33 +2,23 @@
 
 #include <GfxRenderer.h>
 #include <Logging.h>
+#include <PackBits.h>
 #include <SDCardManager.h>
 #include <Serialization.h>
 
-#include "../converters/DitherUtils.h"
 #include "../converters/ImageDecoderFactory.h"
+#include "../converters/PixelCache.h"
+#include "../converters/ZipImageSource.h"
 
-// Cache file format:
-// - uint16_t width
-// - uint16_t height
-// - uint8_t pixels[...] - 2 bits per pixel, packed (4 pixels per byte), row-major order
+// Cache file format: see PixelCacheHeader. Files from other orientations or older versions are treated as missing and
+// rewritten on the next decode.
 
-ImageBlock::ImageBlock(const std::string& imagePath, int16_t width, int16_t height)
-    : imagePath(imagePath), width(width), height(height) {}
-
-bool ImageBlock::imageExists() const { return Storage.exists(imagePath.c_str()); }
+ImageBlock::ImageBlock(const std::string& epubPath, const std::string& imagePath, const std::string& cachePath,
+                       int16_t width, int16_t height)
+    : epubPath(epubPath), imagePath(imagePath), cachePath(cachePath), width(width), height(height) {}
 
 namespace {
 
-std::string getCachePath(const std::string& imagePath) {
-  // Replace extension with .pxc (pixel cache)
-  size_t dotPos = imagePath.rfind('.');
-  if (dotPos != std::string::npos) {
-    return imagePath.substr(0, dotPos) + ".pxc";
-  }
-  return imagePath + ".pxc";
-}
-
 bool renderFromCache(GfxRenderer& renderer, const std::string& cachePath, int x, int y, int expectedWidth,
                      int expectedHeight) {
   FsFile cacheFile;
@@ -36,63 +26,144 @@ bool renderFromCache(GfxRenderer& renderer, const std::string& cachePath, int x,
     return false;
   }
 
-  uint16_t cachedWidth, cachedHeight;
-  if (cacheFile.read(&cachedWidth, 2) != 2 || cacheFile.read(&cachedHeight, 2) != 2) {
+  PixelCacheHeader header;
+  if (cacheFile.read(&header, sizeof(header)) != sizeof(header) || header.magic != PixelCacheHeader::MAGIC ||
+      header.orientation != renderer.getOrientation()) {
+    LOG_DBG("IMG", "Cache stale or from another orientation: %s", cachePath.c_str());
     cacheFile.close();
     return false;
   }
 
   // Verify dimensions are close (allow 1 pixel tolerance for rounding differences)
-  int widthDiff = abs(cachedWidth - expectedWidth);
-  int heightDiff = abs(cachedHeight - expectedHeight);
+  int widthDiff = abs(header.width - expectedWidth);
+  int heightDiff = abs(header.height - expectedHeight);
   if (widthDiff > 1 || heightDiff > 1) {
-    LOG_ERR("IMG", "Cache dimension mismatch: %dx%d vs %dx%d", cachedWidth, cachedHeight, expectedWidth,
+    LOG_ERR("IMG", "Cache dimension mismatch: %dx%d vs %dx%d", header.width, header.height, expectedWidth,
             expectedHeight);
     cacheFile.close();
     return false;
   }
 
   // Use cached dimensions for rendering (they're the actual decoded size)
-  expectedWidth = cachedWidth;
-  expectedHeight = cachedHeight;
+  const GfxRenderer::PanelRect panel = renderer.toPanelRect(x, y, header.width, header.height);
+  if (panel.width != header.panelWidth || panel.height != header.panelHeight) {
+    cacheFile.close();
+    return false;
+  }
+
+  const size_t plane = renderer.getRenderMode();
+  if (plane >= PixelCacheHeader::PLANE_COUNT || !cacheFile.seek(header.planeOffset[plane])) {
+    cacheFile.close();
+    return false;
+  }
 
-  LOG_DBG("IMG", "Loading from cache: %s (%dx%d)", cachePath.c_str(), cachedWidth, cachedHeight);
+  LOG_DBG("IMG", "Loading from cache: %s (%dx%d, plane %u)", cachePath.c_str(), header.width, header.height, plane);
 
-  // Read and render row by row to minimize memory usage
-  const int bytesPerRow = (cachedWidth + 3) / 4;  // 2 bits per pixel, 4 pixels per byte
-  uint8_t* rowBuffer = (uint8_t*)malloc(bytesPerRow);
-  if (!rowBuffer) {
+  // Decode and copy one panel row at a time to minimize memory usage
+  constexpr size_t INPUT_SIZE = 256;
+  const size_t rowBytes = (panel.width + 7) / 8;
+  uint8_t* buffers = static_cast<uint8_t*>(malloc(rowBytes + INPUT_SIZE));
+  if (!buffers) {
     LOG_ERR("IMG", "Failed to allocate row buffer");
     cacheFile.close();
     return false;
   }
-
-  for (int row = 0; row < cachedHeight; row++) {
-    if (cacheFile.read(rowBuffer, bytesPerRow) != bytesPerRow) {
-      LOG_ERR("IMG", "Cache read error at row %d", row);
-      free(rowBuffer);
-      cacheFile.close();
-      return false;
+  uint8_t* row = buffers;
+  uint8_t* input = buffers + rowBytes;
+
+  PackBitsDecoder decoder;
+  size_t inputPos = 0;
+  size_t inputLen = 0;
+  bool ok = true;
+  for (int r = 0; r < panel.height && ok; r++) {
+    size_t filled = 0;
+    while (filled < rowBytes) {
+      size_t consumed = 0;
+      const size_t written = decoder.decode(input + inputPos, inputLen - inputPos, consumed, row + filled,
+                                            rowBytes - filled);
+      inputPos += consumed;
+      filled += written;
+      if (written > 0 || inputPos < inputLen) {
+        continue;
+      }
+      const int bytesRead = cacheFile.read(input, INPUT_SIZE);
+      if (bytesRead <= 0) {
+        LOG_ERR("IMG", "Cache read error at row %d", r);
+        ok = false;
+        break;
+      }
+      inputLen = bytesRead;
+      inputPos = 0;
     }
-
-    int destY = y + row;
-    for (int col = 0; col < cachedWidth; col++) {
-      int byteIdx = col / 4;
-      int bitShift = 6 - (col % 4) * 2;  // MSB first within byte
-      uint8_t pixelValue = (rowBuffer[byteIdx] >> bitShift) & 0x03;
-
-      drawPixelWithRenderMode(renderer, x + col, destY, pixelValue);
+    if (ok) {
+      renderer.writePanelRow(panel.x, panel.y + r, row, panel.width);
     }
   }
 
-  free(rowBuffer);
+  free(buffers);
   cacheFile.close();
-  LOG_DBG("IMG", "Cache render complete");
-  return true;
+  if (ok) {
+    LOG_DBG("IMG", "Cache render complete");
+  }
+  return ok;
+}
+
+// A cache written for this orientation at this size needs no new decode
+bool hasUsableCache(const GfxRenderer& renderer, const std::string& cachePath, const int expectedWidth,
+                    const int expectedHeight) {
+  FsFile cacheFile;
+  if (!Storage.openFileForRead("IMG", cachePath, cacheFile)) {
+    return false;
+  }
+  PixelCacheHeader header;
+  const bool headerRead = cacheFile.read(&header, sizeof(header)) == sizeof(header);
+  cacheFile.close();
+  if (!headerRead || header.magic != PixelCacheHeader::MAGIC || header.orientation != renderer.getOrientation() ||
+      abs(header.width - expectedWidth) > 1 || abs(header.height - expectedHeight) > 1) {
+    return false;
+  }
+  const GfxRenderer::PanelRect panel = renderer.toPanelRect(0, 0, header.width, header.height);
+  return panel.width == header.panelWidth && panel.height == header.panelHeight;
+}
+
+RenderConfig makeDecodeConfig(const int x, const int y, const int width, const int height,
+                              const std::string& cachePath) {
+  RenderConfig config;
+  config.x = x;
+  config.y = y;
+  config.maxWidth = width;
+  config.maxHeight = height;
+  config.useGrayscale = true;
+  config.useDithering = true;
+  config.performanceMode = false;
+  config.useExactDimensions = true;  // Use pre-calculated dimensions to avoid rounding mismatches
+  config.cachePath = cachePath;      // Enable caching during decode
+  return config;
 }
 
 }  // namespace
 
+bool ImageBlock::decode(GfxRenderer& renderer, const int x, const int y, const bool cacheOnly) const {
+  ImageToFramebufferDecoder* decoder = ImageDecoderFactory::getDecoder(imagePath);
+  if (!decoder) {
+    LOG_ERR("IMG", "No decoder found for image: %s", imagePath.c_str());
+    return false;
+  }
+
+  ZipImageSource source(epubPath);
+  if (!source.open(imagePath)) {
+    LOG_ERR("IMG", "Image not found in EPUB: %s", imagePath.c_str());
+    return false;
+  }
+
+  RenderConfig config = makeDecodeConfig(x, y, width, height, cachePath);
+  config.cacheOnly = cacheOnly;
+  LOG_DBG("IMG", "Using %s decoder", decoder->getFormatName());
+  const bool success = decoder->decodeToFramebuffer(source, renderer, config);
+  source.close();
+  return success;
+}
+
 void ImageBlock::render(GfxRenderer& renderer, const int x, const int y) {
   LOG_DBG("IMG", "Rendering image at %d,%d: %s (%dx%d)", x, y, imagePath.c_str(), width, height);
 
@@ -107,68 +178,53 @@ void ImageBlock::render(GfxRenderer& renderer, const int x, const int y) {
   }
 
   // Try to render from cache first
-  std::string cachePath = getCachePath(imagePath);
   if (renderFromCache(renderer, cachePath, x, y, width, height)) {
     return;  // Successfully rendered from cache
   }
 
-  // No cache - need to decode the image
-  // Check if image file exists
-  FsFile file;
-  if (!Storage.openFileForRead("IMG", imagePath, file)) {
-    LOG_ERR("IMG", "Image file not found: %s", imagePath.c_str());
-    return;
-  }
-  size_t fileSize = file.size();
-  file.close();
-
-  if (fileSize == 0) {
-    LOG_ERR("IMG", "Image file is empty: %s", imagePath.c_str());
-    return;
-  }
-
+  // No cache - decode the image out of the EPUB, drawing it and writing its cache
   LOG_DBG("IMG", "Decoding and caching: %s", imagePath.c_str());
-
-  RenderConfig config;
-  config.x = x;
-  config.y = y;
-  config.maxWidth = width;
-  config.maxHeight = height;
-  config.useGrayscale = true;
-  config.useDithering = true;
-  config.performanceMode = false;
-  config.useExactDimensions = true;  // Use pre-calculated dimensions to avoid rounding mismatches
-  config.cachePath = cachePath;      // Enable caching during decode
-
-  ImageToFramebufferDecoder* decoder = ImageDecoderFactory::getDecoder(imagePath);
-  if (!decoder) {
-    LOG_ERR("IMG", "No decoder found for image: %s", imagePath.c_str());
+  if (!decode(renderer, x, y, false)) {
+    LOG_ERR("IMG", "Failed to decode image: %s", imagePath.c_str());
     return;
   }
 
-  LOG_DBG("IMG", "Using %s decoder", decoder->getFormatName());
+  LOG_DBG("IMG", "Decode successful");
+}
 
-  bool success = decoder->decodeToFramebuffer(imagePath, renderer, config);
-  if (!success) {
-    LOG_ERR("IMG", "Failed to decode image: %s", imagePath.c_str());
-    return;
+bool ImageBlock::buildCache(GfxRenderer& renderer) const {
+  // Re-indexing a section (e.g. after a font change) places the same images again; keep caches still valid
+  if (hasUsableCache(renderer, cachePath, width, height)) {
+    LOG_DBG("IMG", "Cache already built: %s", cachePath.c_str());
+    return true;
   }
 
-  LOG_DBG("IMG", "Decode successful");
+  // Cached pixels are placed relative to the image, so the position only sets the dither phase
+  const unsigned long start = millis();
+  if (!decode(renderer, 0, 0, true)) {
+    LOG_ERR("IMG", "Failed to pre-decode image: %s", imagePath.c_str());
+    return false;
+  }
+  LOG_DBG("IMG", "Pre-decoded %s (%dx%d) in %lu ms", imagePath.c_str(), width, height, millis() - start);
+  return true;
 }
 
 bool ImageBlock::serialize(FsFile& file) {
+  serialization::writeString(file, epubPath);
   serialization::writeString(file, imagePath);
+  serialization::writeString(file, cachePath);
   serialization::writePod(file, width);
   serialization::writePod(file, height);
   return true;
 }
 
 std::unique_ptr<ImageBlock> ImageBlock::deserialize(FsFile& file) {
-  std::string path;
+  std::string epubPath, path, cachePath;
+  serialization::readString(file, epubPath);
   serialization::readString(file, path);
+  serialization::readString(file, cachePath);
   int16_t w, h;
   serialization::readPod(file, w);
   serialization::readPod(file, h);
-  return std::unique_ptr<ImageBlock>(new ImageBlock(path, w, h));
+  return std::unique_ptr<ImageBlock>(new ImageBlock(epubPath, path, cachePath, w, h));
 }
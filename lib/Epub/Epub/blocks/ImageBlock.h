@@ -6,26 +6,32 @@
 
 #include "Block.h"
 
+// An image decoded straight out of the EPUB into its pixel cache, which later renders read instead
 class ImageBlock final : public Block {
  public:
-  ImageBlock(const std::string& imagePath, int16_t width, int16_t height);
+  ImageBlock(const std::string& epubPath, const std::string& imagePath, const std::string& cachePath, int16_t width,
+             int16_t height);
   ~ImageBlock() override = default;
 
   const std::string& getImagePath() const { return imagePath; }
   int16_t getWidth() const { return width; }
   int16_t getHeight() const { return height; }
 
-  bool imageExists() const;
-
   BlockType getType() override { return IMAGE_BLOCK; }
   bool isEmpty() override { return false; }
 
   void render(GfxRenderer& renderer, const int x, const int y);
+  // Decode, scale and dither the image into its pixel cache without drawing, so render() only reads the cache
+  bool buildCache(GfxRenderer& renderer) const;
   bool serialize(FsFile& file);
   static std::unique_ptr<ImageBlock> deserialize(FsFile& file);
 
  private:
-  std::string imagePath;
+  bool decode(GfxRenderer& renderer, int x, int y, bool cacheOnly) const;
+
+  std::string epubPath;
+  std::string imagePath;  // Entry inside the EPUB
+  std::string cachePath;
   int16_t width;
   int16_t height;
 };
@@ -21,7 +21,7 @@ void TextBlock::render(const GfxRenderer& renderer, const int fontId, const int
     renderer.drawText(fontId, wordX, y, wordIt->c_str(), true, currentStyle);
 
     if ((currentStyle & EpdFontFamily::UNDERLINE) != 0) {
-      const std::string& w = *wordIt;
+      const ArenaString& w = *wordIt;
       const int fullWordWidth = renderer.getTextWidth(fontId, w.c_str(), currentStyle);
       // y is the top of the text line; add ascender to reach baseline, then offset 2px below
       const int underlineY = y + renderer.getFontAscenderSize(fontId) + 2;
@@ -80,9 +80,9 @@ bool TextBlock::serialize(FsFile& file) const {
 
 std::unique_ptr<TextBlock> TextBlock::deserialize(FsFile& file) {
   uint16_t wc;
-  std::list<std::string> words;
-  std::list<uint16_t> wordXpos;
-  std::list<EpdFontFamily::Style> wordStyles;
+  ArenaList<ArenaString> words;
+  ArenaList<uint16_t> wordXpos;
+  ArenaList<EpdFontFamily::Style> wordStyles;
   BlockStyle blockStyle;
 
   // Word count
@@ -6,20 +6,21 @@
 #include <memory>
 #include <string>
 
+#include "../IndexingArena.h"
 #include "Block.h"
 #include "BlockStyle.h"
 
 // Represents a line of text on a page
 class TextBlock final : public Block {
  private:
-  std::list<std::string> words;
-  std::list<uint16_t> wordXpos;
-  std::list<EpdFontFamily::Style> wordStyles;
+  ArenaList<ArenaString> words;
+  ArenaList<uint16_t> wordXpos;
+  ArenaList<EpdFontFamily::Style> wordStyles;
   BlockStyle blockStyle;
 
  public:
-  explicit TextBlock(std::list<std::string> words, std::list<uint16_t> word_xpos,
-                     std::list<EpdFontFamily::Style> word_styles, const BlockStyle& blockStyle = BlockStyle())
+  explicit TextBlock(ArenaList<ArenaString> words, ArenaList<uint16_t> word_xpos,
+                     ArenaList<EpdFontFamily::Style> word_styles, const BlockStyle& blockStyle = BlockStyle())
       : words(std::move(words)),
         wordXpos(std::move(word_xpos)),
         wordStyles(std::move(word_styles)),
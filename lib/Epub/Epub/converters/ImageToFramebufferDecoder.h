@@ -5,6 +5,7 @@
 #include <string>
 
 class GfxRenderer;
+class ImageSource;
 
 struct ImageDimensions {
   int16_t width;
@@ -19,6 +20,7 @@ struct RenderConfig {
   bool performanceMode = false;
   bool useExactDimensions = false;  // If true, use maxWidth/maxHeight as exact output size (no recalculation)
   std::string cachePath;            // If non-empty, decoder will write pixel cache to this path
+  bool cacheOnly = false;           // If true, only write the pixel cache (cachePath required); nothing is drawn
 };
 
 class ImageToFramebufferDecoder {
@@ -26,8 +28,12 @@ class ImageToFramebufferDecoder {
   virtual ~ImageToFramebufferDecoder() = default;
 
   virtual bool decodeToFramebuffer(const std::string& imagePath, GfxRenderer& renderer, const RenderConfig& config) = 0;
+  // Decodes from the source's current position, e.g. an image still inside the EPUB
+  virtual bool decodeToFramebuffer(ImageSource& source, GfxRenderer& renderer, const RenderConfig& config) = 0;
 
   virtual bool getDimensions(const std::string& imagePath, ImageDimensions& dims) const = 0;
+  // Reads the dimensions from the header at the source's current position, e.g. an image still inside the EPUB
+  virtual bool getDimensions(ImageSource& source, ImageDimensions& dims) const = 0;
 
   virtual const char* getFormatName() const = 0;
 
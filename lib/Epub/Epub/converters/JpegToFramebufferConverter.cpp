@@ -1,23 +1,30 @@
 #include "JpegToFramebufferConverter.h"
 
 #include <GfxRenderer.h>
+#include <HeapWatermark.h>
+#include <ImageSource.h>
 #include <Logging.h>
+#include <ProgressiveJpegDecoder.h>
 #include <SDCardManager.h>
 #include <SdFat.h>
 #include <picojpeg.h>
 
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
+#include <memory>
+#include <new>
 
+#include "AreaScaler.h"
 #include "DitherUtils.h"
 #include "PixelCache.h"
 
 struct JpegContext {
-  FsFile& file;
+  ImageSource& source;
   uint8_t buffer[512];
   size_t bufferPos;
   size_t bufferFilled;
-  JpegContext(FsFile& f) : file(f), bufferPos(0), bufferFilled(0) {}
+  JpegContext(ImageSource& s) : source(s), bufferPos(0), bufferFilled(0) {}
 };
 
 bool JpegToFramebufferConverter::getDimensionsStatic(const std::string& imagePath, ImageDimensions& out) {
@@ -27,11 +34,30 @@ bool JpegToFramebufferConverter::getDimensionsStatic(const std::string& imagePat
     return false;
   }
 
-  JpegContext context(file);
+  FileImageSource source(file);
+  const bool success = getDimensionsStatic(source, out);
+  file.close();
+  return success;
+}
+
+bool JpegToFramebufferConverter::getDimensionsStatic(ImageSource& source, ImageDimensions& out) {
+  const size_t start = source.position();
+  JpegContext context(source);
   pjpeg_image_info_t imageInfo;
 
   int status = pjpeg_decode_init(&imageInfo, jpegReadCallback, &context, 0);
-  file.close();
+  if (status == PJPG_UNSUPPORTED_MODE) {
+    // Progressive: picojpeg stops at the frame header, which the progressive decoder reads again
+    std::unique_ptr<ProgressiveJpegDecoder> progressive(new (std::nothrow) ProgressiveJpegDecoder(source));
+    if (!progressive || !source.seek(start) || !progressive->begin()) {
+      LOG_ERR("JPG", "Failed to init progressive JPEG for dimensions");
+      return false;
+    }
+    out.width = progressive->getWidth();
+    out.height = progressive->getHeight();
+    LOG_DBG("JPG", "Image dimensions: %dx%d (progressive)", out.width, out.height);
+    return true;
+  }
 
   if (status != 0) {
     LOG_ERR("JPG", "Failed to init JPEG for dimensions: %d", status);
@@ -54,18 +80,36 @@ bool JpegToFramebufferConverter::decodeToFramebuffer(const std::string& imagePat
     return false;
   }
 
-  JpegContext context(file);
+  FileImageSource source(file);
+  const bool success = decodeToFramebuffer(source, renderer, config);
+  file.close();
+  return success;
+}
+
+bool JpegToFramebufferConverter::decodeToFramebuffer(ImageSource& source, GfxRenderer& renderer,
+                                                     const RenderConfig& config) {
+  HeapWatermark heap;
+  JpegContext context(source);
   pjpeg_image_info_t imageInfo;
 
+  // picojpeg cannot read progressive files: it stops at their frame header, and the progressive decoder reads the
+  // file again from the start
+  std::unique_ptr<ProgressiveJpegDecoder> progressive;
   int status = pjpeg_decode_init(&imageInfo, jpegReadCallback, &context, 0);
-  if (status != 0) {
+  if (status == PJPG_UNSUPPORTED_MODE) {
+    progressive.reset(new (std::nothrow) ProgressiveJpegDecoder(source));
+    if (!progressive || !source.seek(0) || !progressive->begin()) {
+      LOG_ERR("JPG", "Progressive JPEG init failed");
+      return false;
+    }
+  } else if (status != 0) {
     LOG_ERR("JPG", "picojpeg init failed: %d", status);
-    file.close();
     return false;
   }
 
-  if (!validateImageDimensions(imageInfo.m_width, imageInfo.m_height, "JPEG")) {
-    file.close();
+  const int imageWidth = progressive ? progressive->getWidth() : imageInfo.m_width;
+  const int imageHeight = progressive ? progressive->getHeight() : imageInfo.m_height;
+  if (!validateImageDimensions(imageWidth, imageHeight, "JPEG")) {
     return false;
   }
 
@@ -77,29 +121,46 @@ bool JpegToFramebufferConverter::decodeToFramebuffer(const std::string& imagePat
     // Use exact dimensions as specified (avoids rounding mismatches with pre-calculated sizes)
     destWidth = config.maxWidth;
     destHeight = config.maxHeight;
-    scale = (float)destWidth / imageInfo.m_width;
+    scale = (float)destWidth / imageWidth;
   } else {
     // Calculate scale factor to fit within maxWidth/maxHeight
-    float scaleX = (config.maxWidth > 0 && imageInfo.m_width > config.maxWidth)
-                       ? (float)config.maxWidth / imageInfo.m_width
-                       : 1.0f;
-    float scaleY = (config.maxHeight > 0 && imageInfo.m_height > config.maxHeight)
-                       ? (float)config.maxHeight / imageInfo.m_height
-                       : 1.0f;
+    float scaleX = (config.maxWidth > 0 && imageWidth > config.maxWidth) ? (float)config.maxWidth / imageWidth : 1.0f;
+    float scaleY =
+        (config.maxHeight > 0 && imageHeight > config.maxHeight) ? (float)config.maxHeight / imageHeight : 1.0f;
     scale = (scaleX < scaleY) ? scaleX : scaleY;
     if (scale > 1.0f) scale = 1.0f;
 
-    destWidth = (int)(imageInfo.m_width * scale);
-    destHeight = (int)(imageInfo.m_height * scale);
+    destWidth = (int)(imageWidth * scale);
+    destHeight = (int)(imageHeight * scale);
   }
 
-  LOG_DBG("JPG", "JPEG %dx%d -> %dx%d (scale %.2f), scan type: %d, MCU: %dx%d", imageInfo.m_width, imageInfo.m_height,
-          destWidth, destHeight, scale, imageInfo.m_scanType, imageInfo.m_MCUWidth, imageInfo.m_MCUHeight);
+  // Decode straight to the smallest 1/2, 1/4 or 1/8 size that still covers the output, then area-average that down
+  const unsigned char decodeScale = pjpeg_choose_scale(imageWidth, imageHeight, destWidth, destHeight);
+  const int round = (1 << decodeScale) - 1;
+  const int srcWidth = (imageWidth + round) >> decodeScale;
+  const int srcHeight = (imageHeight + round) >> decodeScale;
+  const int blockSize = 8 >> decodeScale;
+  const int mcuWidth = progressive ? 0 : imageInfo.m_MCUWidth >> decodeScale;
+  const int mcuHeight = progressive ? 0 : imageInfo.m_MCUHeight >> decodeScale;
+
+  if (progressive) {
+    LOG_DBG("JPG", "JPEG %dx%d -> %dx%d (scale %.2f, decoded at 1/%d), progressive", imageWidth, imageHeight,
+            destWidth, destHeight, scale, 1 << decodeScale);
+    // Every scan has to be read before the first row is final
+    if (!progressive->decodeScans(decodeScale)) {
+      return false;
+    }
+    heap.sample();
+  } else {
+    LOG_DBG("JPG", "JPEG %dx%d -> %dx%d (scale %.2f, decoded at 1/%d), scan type: %d, MCU: %dx%d", imageWidth,
+            imageHeight, destWidth, destHeight, scale, 1 << decodeScale, imageInfo.m_scanType, imageInfo.m_MCUWidth,
+            imageInfo.m_MCUHeight);
+    pjpeg_set_scale(decodeScale);
 
-  if (!imageInfo.m_pMCUBufR || !imageInfo.m_pMCUBufG || !imageInfo.m_pMCUBufB) {
-    LOG_ERR("JPG", "Null buffer pointers in imageInfo");
-    file.close();
-    return false;
+    if (!imageInfo.m_pMCUBufR || !imageInfo.m_pMCUBufG || !imageInfo.m_pMCUBufB) {
+      LOG_ERR("JPG", "Null buffer pointers in imageInfo");
+      return false;
+    }
   }
 
   const int screenWidth = renderer.getScreenWidth();
@@ -108,157 +169,120 @@ bool JpegToFramebufferConverter::decodeToFramebuffer(const std::string& imagePat
   // Allocate pixel cache if cachePath is provided
   PixelCache cache;
   bool caching = !config.cachePath.empty();
+  const bool drawing = !config.cacheOnly;
   if (caching) {
     if (!cache.allocate(destWidth, destHeight, config.x, config.y)) {
+      if (!drawing) {
+        LOG_ERR("JPG", "Failed to allocate cache buffer");
+        return false;
+      }
       LOG_ERR("JPG", "Failed to allocate cache buffer, continuing without caching");
       caching = false;
     }
   }
 
-  int mcuX = 0;
-  int mcuY = 0;
+  // One row of MCUs in grayscale, handed to the scaler a source row at a time once the row is complete (the
+  // progressive decoder hands out its own rows), and one output row of packed 2-bit levels
+  auto* mcuRowBuffer = progressive ? nullptr : static_cast<uint8_t*>(malloc(srcWidth * mcuHeight));
+  auto* levelRow = static_cast<uint8_t*>(malloc((destWidth + 3) / 4));
+  if ((!progressive && !mcuRowBuffer) || !levelRow) {
+    LOG_ERR("JPG", "Failed to allocate row buffers (%d bytes)", srcWidth * mcuHeight + (destWidth + 3) / 4);
+    free(mcuRowBuffer);
+    free(levelRow);
+    return false;
+  }
+
+  AreaScaler scaler;
+  if (!scaler.begin(srcWidth, srcHeight, destWidth, destHeight)) {
+    free(mcuRowBuffer);
+    free(levelRow);
+    return false;
+  }
 
-  while (mcuY < imageInfo.m_MCUSPerCol) {
-    status = pjpeg_decode_mcu();
-    if (status == PJPG_NO_MORE_BLOCKS) {
-      break;
+  // Each output pixel is dithered and drawn once, however large the source
+  const int visibleWidth = std::min(destWidth, screenWidth - config.x);
+  auto drawRow = [&](const int dstY, const uint8_t* row) {
+    const int outY = config.y + dstY;
+    if (outY >= screenHeight || visibleWidth <= 0) return;
+    if (config.useDithering) ditherRowBayer(row, levelRow, visibleWidth, config.x, outY);
+    for (int x = 0; x < visibleWidth; x++) {
+      const int outX = config.x + x;
+      uint8_t dithered = config.useDithering ? (levelRow[x >> 2] >> (6 - 2 * (x & 3))) & 0x03 : row[x] / 85;
+      if (dithered > 3) dithered = 3;
+      if (drawing) drawPixelWithRenderMode(renderer, outX, outY, dithered);
+      if (caching) cache.setPixel(outX, outY, dithered);
     }
-    if (status != 0) {
-      LOG_ERR("JPG", "MCU decode failed: %d", status);
-      file.close();
-      return false;
+  };
+
+  bool success = true;
+  if (progressive) {
+    int rowsDone = 0;
+    int rowCount = 0;
+    while (const uint8_t* rows = progressive->nextRows(rowCount)) {
+      for (int row = 0; row < rowCount; row++) {
+        scaler.pushRow(rows + row * srcWidth, drawRow);
+      }
+      rowsDone += rowCount;
+      heap.sample();
     }
-
-    // Source position in image coordinates
-    int srcStartX = mcuX * imageInfo.m_MCUWidth;
-    int srcStartY = mcuY * imageInfo.m_MCUHeight;
-
-    switch (imageInfo.m_scanType) {
-      case PJPG_GRAYSCALE:
-        for (int row = 0; row < 8; row++) {
-          int srcY = srcStartY + row;
-          int destY = config.y + (int)(srcY * scale);
-          if (destY >= screenHeight || destY >= config.y + destHeight) continue;
-          for (int col = 0; col < 8; col++) {
-            int srcX = srcStartX + col;
-            int destX = config.x + (int)(srcX * scale);
-            if (destX >= screenWidth || destX >= config.x + destWidth) continue;
-            uint8_t gray = imageInfo.m_pMCUBufR[row * 8 + col];
-            uint8_t dithered = config.useDithering ? applyBayerDither4Level(gray, destX, destY) : gray / 85;
-            if (dithered > 3) dithered = 3;
-            drawPixelWithRenderMode(renderer, destX, destY, dithered);
-            if (caching) cache.setPixel(destX, destY, dithered);
-          }
-        }
-        break;
-
-      case PJPG_YH1V1:
-        for (int row = 0; row < 8; row++) {
-          int srcY = srcStartY + row;
-          int destY = config.y + (int)(srcY * scale);
-          if (destY >= screenHeight || destY >= config.y + destHeight) continue;
-          for (int col = 0; col < 8; col++) {
-            int srcX = srcStartX + col;
-            int destX = config.x + (int)(srcX * scale);
-            if (destX >= screenWidth || destX >= config.x + destWidth) continue;
-            uint8_t r = imageInfo.m_pMCUBufR[row * 8 + col];
-            uint8_t g = imageInfo.m_pMCUBufG[row * 8 + col];
-            uint8_t b = imageInfo.m_pMCUBufB[row * 8 + col];
-            uint8_t gray = (uint8_t)((r * 77 + g * 150 + b * 29) >> 8);
-            uint8_t dithered = config.useDithering ? applyBayerDither4Level(gray, destX, destY) : gray / 85;
-            if (dithered > 3) dithered = 3;
-            drawPixelWithRenderMode(renderer, destX, destY, dithered);
-            if (caching) cache.setPixel(destX, destY, dithered);
-          }
-        }
-        break;
-
-      case PJPG_YH2V1:
-        for (int row = 0; row < 8; row++) {
-          int srcY = srcStartY + row;
-          int destY = config.y + (int)(srcY * scale);
-          if (destY >= screenHeight || destY >= config.y + destHeight) continue;
-          for (int col = 0; col < 16; col++) {
-            int srcX = srcStartX + col;
-            int destX = config.x + (int)(srcX * scale);
-            if (destX >= screenWidth || destX >= config.x + destWidth) continue;
-            int blockIndex = (col < 8) ? 0 : 1;
-            int pixelIndex = row * 8 + (col % 8);
-            uint8_t r = imageInfo.m_pMCUBufR[blockIndex * 64 + pixelIndex];
-            uint8_t g = imageInfo.m_pMCUBufG[blockIndex * 64 + pixelIndex];
-            uint8_t b = imageInfo.m_pMCUBufB[blockIndex * 64 + pixelIndex];
-            uint8_t gray = (uint8_t)((r * 77 + g * 150 + b * 29) >> 8);
-            uint8_t dithered = config.useDithering ? applyBayerDither4Level(gray, destX, destY) : gray / 85;
-            if (dithered > 3) dithered = 3;
-            drawPixelWithRenderMode(renderer, destX, destY, dithered);
-            if (caching) cache.setPixel(destX, destY, dithered);
-          }
+    if (rowsDone < srcHeight) {
+      LOG_ERR("JPG", "Progressive decode stopped at row %d of %d", rowsDone, srcHeight);
+      success = false;
+    }
+  } else {
+    bool done = false;
+    for (int mcuY = 0; mcuY < imageInfo.m_MCUSPerCol && !done; mcuY++) {
+      for (int mcuX = 0; mcuX < imageInfo.m_MCUSPerRow; mcuX++) {
+        status = pjpeg_decode_mcu();
+        if (status == PJPG_NO_MORE_BLOCKS) {
+          done = true;
+          break;
         }
-        break;
-
-      case PJPG_YH1V2:
-        for (int row = 0; row < 16; row++) {
-          int srcY = srcStartY + row;
-          int destY = config.y + (int)(srcY * scale);
-          if (destY >= screenHeight || destY >= config.y + destHeight) continue;
-          for (int col = 0; col < 8; col++) {
-            int srcX = srcStartX + col;
-            int destX = config.x + (int)(srcX * scale);
-            if (destX >= screenWidth || destX >= config.x + destWidth) continue;
-            int blockIndex = (row < 8) ? 0 : 1;
-            int pixelIndex = (row % 8) * 8 + col;
-            uint8_t r = imageInfo.m_pMCUBufR[blockIndex * 128 + pixelIndex];
-            uint8_t g = imageInfo.m_pMCUBufG[blockIndex * 128 + pixelIndex];
-            uint8_t b = imageInfo.m_pMCUBufB[blockIndex * 128 + pixelIndex];
-            uint8_t gray = (uint8_t)((r * 77 + g * 150 + b * 29) >> 8);
-            uint8_t dithered = config.useDithering ? applyBayerDither4Level(gray, destX, destY) : gray / 85;
-            if (dithered > 3) dithered = 3;
-            drawPixelWithRenderMode(renderer, destX, destY, dithered);
-            if (caching) cache.setPixel(destX, destY, dithered);
-          }
+        if (status != 0) {
+          LOG_ERR("JPG", "MCU decode failed: %d", status);
+          success = false;
+          done = true;
+          break;
         }
-        break;
-
-      case PJPG_YH2V2:
-        for (int row = 0; row < 16; row++) {
-          int srcY = srcStartY + row;
-          int destY = config.y + (int)(srcY * scale);
-          if (destY >= screenHeight || destY >= config.y + destHeight) continue;
-          for (int col = 0; col < 16; col++) {
-            int srcX = srcStartX + col;
-            int destX = config.x + (int)(srcX * scale);
-            if (destX >= screenWidth || destX >= config.x + destWidth) continue;
-            int blockX = (col < 8) ? 0 : 1;
-            int blockY = (row < 8) ? 0 : 1;
-            int blockIndex = blockY * 2 + blockX;
-            int pixelIndex = (row % 8) * 8 + (col % 8);
-            int blockOffset = blockIndex * 64;
-            uint8_t r = imageInfo.m_pMCUBufR[blockOffset + pixelIndex];
-            uint8_t g = imageInfo.m_pMCUBufG[blockOffset + pixelIndex];
-            uint8_t b = imageInfo.m_pMCUBufB[blockOffset + pixelIndex];
-            uint8_t gray = (uint8_t)((r * 77 + g * 150 + b * 29) >> 8);
-            uint8_t dithered = config.useDithering ? applyBayerDither4Level(gray, destX, destY) : gray / 85;
-            if (dithered > 3) dithered = 3;
-            drawPixelWithRenderMode(renderer, destX, destY, dithered);
-            if (caching) cache.setPixel(destX, destY, dithered);
+
+        // picojpeg stores each block's pixels with a row stride of 8
+        // Block layout: H2V2(16x16)=0,64,128,192 H2V1(16x8)=0,64 H1V2(8x16)=0,128
+        const int srcStartX = mcuX * mcuWidth;
+        for (int row = 0; row < mcuHeight; row++) {
+          uint8_t* dst = mcuRowBuffer + row * srcWidth;
+          for (int col = 0; col < mcuWidth && srcStartX + col < srcWidth; col++) {
+            const int pixelOffset =
+                (row / blockSize) * 128 + (col / blockSize) * 64 + (row % blockSize) * 8 + (col % blockSize);
+            if (imageInfo.m_scanType == PJPG_GRAYSCALE) {
+              dst[srcStartX + col] = imageInfo.m_pMCUBufR[pixelOffset];
+            } else {
+              const uint8_t r = imageInfo.m_pMCUBufR[pixelOffset];
+              const uint8_t g = imageInfo.m_pMCUBufG[pixelOffset];
+              const uint8_t b = imageInfo.m_pMCUBufB[pixelOffset];
+              dst[srcStartX + col] = (uint8_t)((r * 77 + g * 150 + b * 29) >> 8);
+            }
           }
         }
-        break;
-    }
+      }
+      if (done) break;
 
-    mcuX++;
-    if (mcuX >= imageInfo.m_MCUSPerRow) {
-      mcuX = 0;
-      mcuY++;
+      for (int row = 0; row < mcuHeight && mcuY * mcuHeight + row < srcHeight; row++) {
+        scaler.pushRow(mcuRowBuffer + row * srcWidth, drawRow);
+      }
+      heap.sample();
     }
   }
 
-  LOG_DBG("JPG", "Decoding complete");
-  file.close();
+  free(mcuRowBuffer);
+  free(levelRow);
+  if (!success) {
+    return false;
+  }
+  LOG_DBG("JPG", "Decoding complete, peak heap %u bytes", heap.peakBytes());
 
   // Write cache file if caching was enabled
-  if (caching) {
-    cache.writeToFile(config.cachePath);
+  if (caching && !cache.writeToFile(renderer, config.cachePath) && !drawing) {
+    return false;
   }
 
   return true;
@@ -269,7 +293,7 @@ unsigned char JpegToFramebufferConverter::jpegReadCallback(unsigned char* pBuf,
   JpegContext* context = reinterpret_cast<JpegContext*>(pCallback_data);
 
   if (context->bufferPos >= context->bufferFilled) {
-    int readCount = context->file.read(context->buffer, sizeof(context->buffer));
+    int readCount = context->source.read(context->buffer, sizeof(context->buffer));
     if (readCount <= 0) {
       *pBytes_actually_read = 0;
       return 0;
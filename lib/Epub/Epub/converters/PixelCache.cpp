@@ -0,0 +1,84 @@
+#include "PixelCache.h"
+
+#include <GfxRenderer.h>
+#include <PackBits.h>
+
+namespace {
+
+// Whether a 2-bit pixel (0 = black ... 3 = white) leaves its panel bit set in each render mode's pass; matches
+// drawPixelWithRenderMode() on the cleared buffers of each pass
+bool planeBit(const size_t plane, const uint8_t value) {
+  switch (plane) {
+    case GfxRenderer::BW:
+      return value == 3;
+    case GfxRenderer::GRAYSCALE_LSB:
+      return value == 1;
+    default:
+      return value == 1 || value == 2;
+  }
+}
+
+}  // namespace
+
+bool PixelCache::writeToFile(const GfxRenderer& renderer, const std::string& cachePath) const {
+  if (!buffer) return false;
+
+  const GfxRenderer::PanelRect panel = renderer.toPanelRect(0, 0, width, height);
+  const size_t rowBytes = (panel.width + 7) / 8;
+  uint8_t* row = static_cast<uint8_t*>(malloc(rowBytes + packBitsMaxSize(rowBytes)));
+  if (!row) {
+    LOG_ERR("IMG", "Failed to allocate cache row buffer");
+    return false;
+  }
+  uint8_t* encoded = row + rowBytes;
+
+  FsFile cacheFile;
+  if (!Storage.openFileForWrite("IMG", cachePath, cacheFile)) {
+    LOG_ERR("IMG", "Failed to open cache file for writing: %s", cachePath.c_str());
+    free(row);
+    return false;
+  }
+
+  PixelCacheHeader header = {};
+  header.magic = PixelCacheHeader::MAGIC;
+  header.width = width;
+  header.height = height;
+  header.orientation = renderer.getOrientation();
+  header.panelWidth = panel.width;
+  header.panelHeight = panel.height;
+  // A short write anywhere leaves no file behind, so a valid header always means complete planes
+  bool ok = cacheFile.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header)) == sizeof(header);
+
+  size_t fileSize = sizeof(header);
+  for (size_t plane = 0; plane < PixelCacheHeader::PLANE_COUNT && ok; plane++) {
+    header.planeOffset[plane] = fileSize;
+    for (int r = 0; r < panel.height && ok; r++) {
+      memset(row, 0, rowBytes);
+      int lx = panel.originX + r * panel.rowDx;
+      int ly = panel.originY + r * panel.rowDy;
+      for (int c = 0; c < panel.width; c++, lx += panel.columnDx, ly += panel.columnDy) {
+        if (planeBit(plane, getPixel(lx, ly))) {
+          row[c / 8] |= 0x80 >> (c % 8);
+        }
+      }
+      const size_t encodedSize = packBitsEncode(row, rowBytes, encoded);
+      ok = cacheFile.write(encoded, encodedSize) == encodedSize;
+      fileSize += encodedSize;
+    }
+  }
+
+  // Patch the plane offsets now that they are known
+  ok = ok && cacheFile.seek(0) &&
+       cacheFile.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header)) == sizeof(header);
+  cacheFile.close();
+  free(row);
+  if (!ok) {
+    LOG_ERR("IMG", "Failed to write cache file: %s", cachePath.c_str());
+    Storage.remove(cachePath.c_str());
+    return false;
+  }
+
+  LOG_DBG("IMG", "Cache written: %s (%dx%d, %u bytes, raw %u)", cachePath.c_str(), width, height, fileSize,
+          4 + bytesPerRow * height);
+  return true;
+}
@@ -7,6 +7,27 @@
 #include <cstring>
 #include <string>
 
+class GfxRenderer;
+
+// Pixel cache file (.pxc), version 2: the decoded image as three 1-bit planes in panel orientation, one per render
+// mode, so each pass reads only its own plane and copies whole rows into the frame buffer. Each panel row of each
+// plane is PackBits-encoded on its own; set bits are white (panel convention).
+#pragma pack(push, 1)
+struct PixelCacheHeader {
+  static constexpr uint32_t MAGIC = 0x32435850;  // "PXC2"
+  static constexpr size_t PLANE_COUNT = 3;       // Indexed by GfxRenderer::RenderMode
+
+  uint32_t magic;
+  uint16_t width;        // Image size in logical pixels
+  uint16_t height;
+  uint8_t orientation;   // GfxRenderer::Orientation the planes were laid out for
+  uint8_t reserved;
+  uint16_t panelWidth;   // Plane size in panel pixels
+  uint16_t panelHeight;
+  uint32_t planeOffset[PLANE_COUNT];  // File offset of each plane's first row
+};
+#pragma pack(pop)
+
 // Cache buffer for storing 2-bit pixels (4 levels) during decode.
 // Packs 4 pixels per byte, MSB first.
 struct PixelCache {
@@ -53,26 +74,13 @@ struct PixelCache {
     buffer[byteIdx] = (buffer[byteIdx] & ~(0x03 << bitShift)) | ((value & 0x03) << bitShift);
   }
 
-  bool writeToFile(const std::string& cachePath) {
-    if (!buffer) return false;
-
-    FsFile cacheFile;
-    if (!Storage.openFileForWrite("IMG", cachePath, cacheFile)) {
-      LOG_ERR("IMG", "Failed to open cache file for writing: %s", cachePath.c_str());
-      return false;
-    }
-
-    uint16_t w = width;
-    uint16_t h = height;
-    cacheFile.write(&w, 2);
-    cacheFile.write(&h, 2);
-    cacheFile.write(buffer, bytesPerRow * height);
-    cacheFile.close();
-
-    LOG_DBG("IMG", "Cache written: %s (%dx%d, %d bytes)", cachePath.c_str(), width, height, 4 + bytesPerRow * height);
-    return true;
+  uint8_t getPixel(const int localX, const int localY) const {
+    return (buffer[localY * bytesPerRow + localX / 4] >> (6 - (localX % 4) * 2)) & 0x03;
   }
 
+  // Writes the .pxc file laid out for the renderer's current orientation
+  bool writeToFile(const GfxRenderer& renderer, const std::string& cachePath) const;
+
   ~PixelCache() {
     if (buffer) {
       free(buffer);
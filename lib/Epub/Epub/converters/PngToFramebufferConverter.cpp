@@ -1,22 +1,24 @@
 #include "PngToFramebufferConverter.h"
 
 #include <GfxRenderer.h>
+#include <HeapWatermark.h>
+#include <ImageSource.h>
 #include <Logging.h>
-#include <PNGdec.h>
+#include <PngRowDecoder.h>
 #include <SDCardManager.h>
 #include <SdFat.h>
 
+#include <algorithm>
 #include <cstdlib>
-#include <new>
+#include <cstring>
 
+#include "AreaScaler.h"
 #include "DitherUtils.h"
 #include "PixelCache.h"
 
 namespace {
 
-// Context struct passed through PNGdec callbacks to avoid global mutable state.
-// The draw callback receives this via pDraw->pUser (set by png.decode()).
-// The file I/O callbacks receive the FsFile* via pFile->fHandle (set by pngOpen()).
+// Everything drawScaledRow needs, handed to the scaler's row callback
 struct PngContext {
   GfxRenderer* renderer;
   const RenderConfig* config;
@@ -29,12 +31,13 @@ struct PngContext {
   int srcHeight;
   int dstWidth;
   int dstHeight;
-  int lastDstY;  // Track last rendered destination Y to avoid duplicates
+  AreaScaler scaler;
 
   PixelCache cache;
   bool caching;
 
   uint8_t* grayLineBuffer;
+  uint8_t* levelRow;  // One destination row of packed 2-bit levels
 
   PngContext()
       : renderer(nullptr),
@@ -46,200 +49,77 @@ struct PngContext {
         srcHeight(0),
         dstWidth(0),
         dstHeight(0),
-        lastDstY(-1),
         caching(false),
-        grayLineBuffer(nullptr) {}
+        grayLineBuffer(nullptr),
+        levelRow(nullptr) {}
 };
 
-// File I/O callbacks use pFile->fHandle to access the FsFile*,
-// avoiding the need for global file state.
-void* pngOpenWithHandle(const char* filename, int32_t* size) {
-  FsFile* f = new FsFile();
-  if (!Storage.openFileForRead("PNG", std::string(filename), *f)) {
-    delete f;
-    return nullptr;
-  }
-  *size = f->size();
-  return f;
-}
-
-void pngCloseWithHandle(void* handle) {
-  FsFile* f = reinterpret_cast<FsFile*>(handle);
-  if (f) {
-    f->close();
-    delete f;
-  }
-}
-
-int32_t pngReadWithHandle(PNGFILE* pFile, uint8_t* pBuf, int32_t len) {
-  FsFile* f = reinterpret_cast<FsFile*>(pFile->fHandle);
-  if (!f) return 0;
-  return f->read(pBuf, len);
-}
-
-int32_t pngSeekWithHandle(PNGFILE* pFile, int32_t pos) {
-  FsFile* f = reinterpret_cast<FsFile*>(pFile->fHandle);
-  if (!f) return -1;
-  return f->seek(pos);
-}
-
-// The PNG decoder (PNGdec) is ~42 KB due to internal zlib decompression buffers.
-// We heap-allocate it on demand rather than using a static instance, so this memory
-// is only consumed while actually decoding/querying PNG images. This is critical on
-// the ESP32-C3 where total RAM is ~320 KB.
-constexpr size_t PNG_DECODER_APPROX_SIZE = 44 * 1024;                          // ~42 KB + overhead
-constexpr size_t MIN_FREE_HEAP_FOR_PNG = PNG_DECODER_APPROX_SIZE + 16 * 1024;  // decoder + 16 KB headroom
-
-// Convert entire source line to grayscale with alpha blending to white background.
-// For indexed PNGs with tRNS chunk, alpha values are stored at palette[768] onwards.
-// Processing the whole line at once improves cache locality and reduces per-pixel overhead.
-void convertLineToGray(uint8_t* pPixels, uint8_t* grayLine, int width, int pixelType, uint8_t* palette, int hasAlpha) {
-  switch (pixelType) {
-    case PNG_PIXEL_GRAYSCALE:
-      memcpy(grayLine, pPixels, width);
-      break;
-
-    case PNG_PIXEL_TRUECOLOR:
-      for (int x = 0; x < width; x++) {
-        uint8_t* p = &pPixels[x * 3];
-        grayLine[x] = (uint8_t)((p[0] * 77 + p[1] * 150 + p[2] * 29) >> 8);
-      }
-      break;
-
-    case PNG_PIXEL_INDEXED:
-      if (palette) {
-        if (hasAlpha) {
-          for (int x = 0; x < width; x++) {
-            uint8_t idx = pPixels[x];
-            uint8_t* p = &palette[idx * 3];
-            uint8_t gray = (uint8_t)((p[0] * 77 + p[1] * 150 + p[2] * 29) >> 8);
-            uint8_t alpha = palette[768 + idx];
-            grayLine[x] = (uint8_t)((gray * alpha + 255 * (255 - alpha)) / 255);
-          }
-        } else {
-          for (int x = 0; x < width; x++) {
-            uint8_t* p = &palette[pPixels[x] * 3];
-            grayLine[x] = (uint8_t)((p[0] * 77 + p[1] * 150 + p[2] * 29) >> 8);
-          }
-        }
-      } else {
-        memcpy(grayLine, pPixels, width);
-      }
-      break;
-
-    case PNG_PIXEL_GRAY_ALPHA:
-      for (int x = 0; x < width; x++) {
-        uint8_t gray = pPixels[x * 2];
-        uint8_t alpha = pPixels[x * 2 + 1];
-        grayLine[x] = (uint8_t)((gray * alpha + 255 * (255 - alpha)) / 255);
-      }
-      break;
-
-    case PNG_PIXEL_TRUECOLOR_ALPHA:
-      for (int x = 0; x < width; x++) {
-        uint8_t* p = &pPixels[x * 4];
-        uint8_t gray = (uint8_t)((p[0] * 77 + p[1] * 150 + p[2] * 29) >> 8);
-        uint8_t alpha = p[3];
-        grayLine[x] = (uint8_t)((gray * alpha + 255 * (255 - alpha)) / 255);
-      }
-      break;
-
-    default:
-      memset(grayLine, 128, width);
-      break;
-  }
-}
-
-int pngDrawCallback(PNGDRAW* pDraw) {
-  PngContext* ctx = reinterpret_cast<PngContext*>(pDraw->pUser);
-  if (!ctx || !ctx->config || !ctx->renderer || !ctx->grayLineBuffer) return 0;
-
-  int srcY = pDraw->y;
-  int srcWidth = ctx->srcWidth;
-
-  // Calculate destination Y with scaling
-  int dstY = (int)(srcY * ctx->scale);
-
-  // Skip if we already rendered this destination row (multiple source rows map to same dest)
-  if (dstY == ctx->lastDstY) return 1;
-  ctx->lastDstY = dstY;
-
-  // Check bounds
-  if (dstY >= ctx->dstHeight) return 1;
-
-  int outY = ctx->config->y + dstY;
-  if (outY >= ctx->screenHeight) return 1;
-
-  // Convert entire source line to grayscale (improves cache locality)
-  convertLineToGray(pDraw->pPixels, ctx->grayLineBuffer, srcWidth, pDraw->iPixelType, pDraw->pPalette,
-                    pDraw->iHasAlpha);
-
-  // Render scaled row using Bresenham-style integer stepping (no floating-point division)
-  int dstWidth = ctx->dstWidth;
-  int outXBase = ctx->config->x;
-  int screenWidth = ctx->screenWidth;
-  bool useDithering = ctx->config->useDithering;
-  bool caching = ctx->caching;
-
-  int srcX = 0;
-  int error = 0;
-
-  for (int dstX = 0; dstX < dstWidth; dstX++) {
-    int outX = outXBase + dstX;
-    if (outX < screenWidth) {
-      uint8_t gray = ctx->grayLineBuffer[srcX];
-
-      uint8_t ditheredGray;
-      if (useDithering) {
-        ditheredGray = applyBayerDither4Level(gray, outX, outY);
-      } else {
-        ditheredGray = gray / 85;
-        if (ditheredGray > 3) ditheredGray = 3;
-      }
-      drawPixelWithRenderMode(*ctx->renderer, outX, outY, ditheredGray);
-      if (caching) ctx->cache.setPixel(outX, outY, ditheredGray);
-    }
-
-    // Bresenham-style stepping: advance srcX based on ratio srcWidth/dstWidth
-    error += srcWidth;
-    while (error >= dstWidth) {
-      error -= dstWidth;
-      srcX++;
+// Dither and draw one finished destination row
+void drawScaledRow(PngContext& ctx, const int dstY, const uint8_t* row) {
+  const int outY = ctx.config->y + dstY;
+  if (outY >= ctx.screenHeight) return;
+
+  const int outXBase = ctx.config->x;
+  const int visibleWidth = std::min(ctx.dstWidth, ctx.screenWidth - outXBase);
+  const bool useDithering = ctx.config->useDithering;
+  const bool caching = ctx.caching;
+  const bool drawing = !ctx.config->cacheOnly;
+  if (visibleWidth <= 0) return;
+  if (useDithering) ditherRowBayer(row, ctx.levelRow, visibleWidth, outXBase, outY);
+
+  for (int dstX = 0; dstX < visibleWidth; dstX++) {
+    const int outX = outXBase + dstX;
+
+    uint8_t ditheredGray;
+    if (useDithering) {
+      ditheredGray = (ctx.levelRow[dstX >> 2] >> (6 - 2 * (dstX & 3))) & 0x03;
+    } else {
+      ditheredGray = row[dstX] / 85;
+      if (ditheredGray > 3) ditheredGray = 3;
     }
+    if (drawing) drawPixelWithRenderMode(*ctx.renderer, outX, outY, ditheredGray);
+    if (caching) ctx.cache.setPixel(outX, outY, ditheredGray);
   }
-
-  return 1;
 }
 
 }  // namespace
 
 bool PngToFramebufferConverter::getDimensionsStatic(const std::string& imagePath, ImageDimensions& out) {
-  size_t freeHeap = ESP.getFreeHeap();
-  if (freeHeap < MIN_FREE_HEAP_FOR_PNG) {
-    LOG_ERR("PNG", "Not enough heap for PNG decoder (%u free, need %u)", freeHeap, MIN_FREE_HEAP_FOR_PNG);
+  FsFile file;
+  if (!Storage.openFileForRead("PNG", imagePath, file)) {
+    LOG_ERR("PNG", "Failed to open file for dimensions: %s", imagePath.c_str());
     return false;
   }
 
-  PNG* png = new (std::nothrow) PNG();
-  if (!png) {
-    LOG_ERR("PNG", "Failed to allocate PNG decoder for dimensions");
+  FileImageSource source(file);
+  const bool success = getDimensionsStatic(source, out);
+  file.close();
+  return success;
+}
+
+bool PngToFramebufferConverter::getDimensionsStatic(ImageSource& source, ImageDimensions& out) {
+  // Signature, then the IHDR chunk, which must come first: the header alone gives the size, no decoder needed
+  static constexpr uint8_t PNG_SIGNATURE[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+  uint8_t header[24];
+  if (source.read(header, sizeof(header)) != sizeof(header) || memcmp(header, PNG_SIGNATURE, 8) != 0 ||
+      memcmp(header + 12, "IHDR", 4) != 0) {
+    LOG_ERR("PNG", "Invalid PNG header for dimensions");
     return false;
   }
 
-  int rc = png->open(imagePath.c_str(), pngOpenWithHandle, pngCloseWithHandle, pngReadWithHandle, pngSeekWithHandle,
-                     nullptr);
-
-  if (rc != 0) {
-    LOG_ERR("PNG", "Failed to open PNG for dimensions: %d", rc);
-    delete png;
+  const auto readBE32 = [&header](const int offset) {
+    return (static_cast<uint32_t>(header[offset]) << 24) | (static_cast<uint32_t>(header[offset + 1]) << 16) |
+           (static_cast<uint32_t>(header[offset + 2]) << 8) | header[offset + 3];
+  };
+  const uint32_t width = readBE32(16);
+  const uint32_t height = readBE32(20);
+  if (width == 0 || height == 0 || width > INT16_MAX || height > INT16_MAX) {
+    LOG_ERR("PNG", "Unsupported PNG dimensions: %ux%u", width, height);
     return false;
   }
 
-  out.width = png->getWidth();
-  out.height = png->getHeight();
-
-  png->close();
-  delete png;
+  out.width = width;
+  out.height = height;
   return true;
 }
 
@@ -247,16 +127,25 @@ bool PngToFramebufferConverter::decodeToFramebuffer(const std::string& imagePath
                                                     const RenderConfig& config) {
   LOG_DBG("PNG", "Decoding PNG: %s", imagePath.c_str());
 
-  size_t freeHeap = ESP.getFreeHeap();
-  if (freeHeap < MIN_FREE_HEAP_FOR_PNG) {
-    LOG_ERR("PNG", "Not enough heap for PNG decoder (%u free, need %u)", freeHeap, MIN_FREE_HEAP_FOR_PNG);
+  FsFile file;
+  if (!Storage.openFileForRead("PNG", imagePath, file)) {
+    LOG_ERR("PNG", "Failed to open file: %s", imagePath.c_str());
     return false;
   }
 
-  // Heap-allocate PNG decoder (~42 KB) - freed at end of function
-  PNG* png = new (std::nothrow) PNG();
-  if (!png) {
-    LOG_ERR("PNG", "Failed to allocate PNG decoder");
+  FileImageSource source(file);
+  const bool success = decodeToFramebuffer(source, renderer, config);
+  file.close();
+  return success;
+}
+
+bool PngToFramebufferConverter::decodeToFramebuffer(ImageSource& source, GfxRenderer& renderer,
+                                                    const RenderConfig& config) {
+  HeapWatermark heap;
+
+  // Rows are inflated and defiltered one at a time, so neither the width nor the height is bounded by a line buffer
+  PngRowDecoder decoder(source);
+  if (!decoder.begin()) {
     return false;
   }
 
@@ -266,23 +155,9 @@ bool PngToFramebufferConverter::decodeToFramebuffer(const std::string& imagePath
   ctx.screenWidth = renderer.getScreenWidth();
   ctx.screenHeight = renderer.getScreenHeight();
 
-  int rc = png->open(imagePath.c_str(), pngOpenWithHandle, pngCloseWithHandle, pngReadWithHandle, pngSeekWithHandle,
-                     pngDrawCallback);
-  if (rc != PNG_SUCCESS) {
-    LOG_ERR("PNG", "Failed to open PNG: %d", rc);
-    delete png;
-    return false;
-  }
-
-  if (!validateImageDimensions(png->getWidth(), png->getHeight(), "PNG")) {
-    png->close();
-    delete png;
-    return false;
-  }
-
   // Calculate output dimensions
-  ctx.srcWidth = png->getWidth();
-  ctx.srcHeight = png->getHeight();
+  ctx.srcWidth = decoder.getWidth();
+  ctx.srcHeight = decoder.getHeight();
 
   if (config.useExactDimensions && config.maxWidth > 0 && config.maxHeight > 0) {
     // Use exact dimensions as specified (avoids rounding mismatches with pre-calculated sizes)
@@ -299,22 +174,21 @@ bool PngToFramebufferConverter::decodeToFramebuffer(const std::string& imagePath
     ctx.dstWidth = (int)(ctx.srcWidth * ctx.scale);
     ctx.dstHeight = (int)(ctx.srcHeight * ctx.scale);
   }
-  ctx.lastDstY = -1;  // Reset row tracking
 
-  LOG_DBG("PNG", "PNG %dx%d -> %dx%d (scale %.2f), bpp: %d", ctx.srcWidth, ctx.srcHeight, ctx.dstWidth, ctx.dstHeight,
-          ctx.scale, png->getBpp());
+  LOG_DBG("PNG", "PNG %dx%d -> %dx%d (scale %.2f), bit depth: %d, color type: %d", ctx.srcWidth, ctx.srcHeight,
+          ctx.dstWidth, ctx.dstHeight, ctx.scale, decoder.getBitDepth(), decoder.getColorType());
 
-  if (png->getBpp() != 8) {
-    warnUnsupportedFeature("bit depth (" + std::to_string(png->getBpp()) + "bpp)", imagePath);
+  if (!ctx.scaler.begin(ctx.srcWidth, ctx.srcHeight, ctx.dstWidth, ctx.dstHeight)) {
+    return false;
   }
 
-  // Allocate grayscale line buffer on demand (~3.2 KB) - freed after decode
-  const size_t grayBufSize = PNG_MAX_BUFFERED_PIXELS / 2;
-  ctx.grayLineBuffer = static_cast<uint8_t*>(malloc(grayBufSize));
-  if (!ctx.grayLineBuffer) {
+  // One source row of gray and one destination row of packed 2-bit levels, freed after decode
+  ctx.grayLineBuffer = static_cast<uint8_t*>(malloc(ctx.srcWidth));
+  ctx.levelRow = static_cast<uint8_t*>(malloc((ctx.dstWidth + 3) / 4));
+  if (!ctx.grayLineBuffer || !ctx.levelRow) {
     LOG_ERR("PNG", "Failed to allocate gray line buffer");
-    png->close();
-    delete png;
+    free(ctx.grayLineBuffer);
+    free(ctx.levelRow);
     return false;
   }
 
@@ -322,32 +196,45 @@ bool PngToFramebufferConverter::decodeToFramebuffer(const std::string& imagePath
   ctx.caching = !config.cachePath.empty();
   if (ctx.caching) {
     if (!ctx.cache.allocate(ctx.dstWidth, ctx.dstHeight, config.x, config.y)) {
+      if (config.cacheOnly) {
+        LOG_ERR("PNG", "Failed to allocate cache buffer");
+        free(ctx.grayLineBuffer);
+        free(ctx.levelRow);
+        return false;
+      }
       LOG_ERR("PNG", "Failed to allocate cache buffer, continuing without caching");
       ctx.caching = false;
     }
   }
 
   unsigned long decodeStart = millis();
-  rc = png->decode(&ctx, 0);
+  bool success = true;
+  for (int y = 0; y < ctx.srcHeight; y++) {
+    if (!decoder.nextRow(ctx.grayLineBuffer)) {
+      LOG_ERR("PNG", "Decode failed at row %d", y);
+      success = false;
+      break;
+    }
+    // Every source line contributes to the area average; rows are drawn as they complete
+    ctx.scaler.pushRow(ctx.grayLineBuffer,
+                       [&ctx](const int dstY, const uint8_t* row) { drawScaledRow(ctx, dstY, row); });
+    heap.sample();
+  }
   unsigned long decodeTime = millis() - decodeStart;
 
   free(ctx.grayLineBuffer);
   ctx.grayLineBuffer = nullptr;
+  free(ctx.levelRow);
+  ctx.levelRow = nullptr;
 
-  if (rc != PNG_SUCCESS) {
-    LOG_ERR("PNG", "Decode failed: %d", rc);
-    png->close();
-    delete png;
+  if (!success) {
     return false;
   }
-
-  png->close();
-  delete png;
-  LOG_DBG("PNG", "PNG decoding complete - render time: %lu ms", decodeTime);
+  LOG_DBG("PNG", "PNG decoding complete - render time: %lu ms, peak heap %u bytes", decodeTime, heap.peakBytes());
 
   // Write cache file if caching was enabled and buffer was allocated
-  if (ctx.caching) {
-    ctx.cache.writeToFile(config.cachePath);
+  if (ctx.caching && !ctx.cache.writeToFile(renderer, config.cachePath) && config.cacheOnly) {
+    return false;
   }
 
   return true;
@@ -0,0 +1,33 @@
+#pragma once
+#include <ImageSource.h>
+#include <ZipEntryStream.h>
+
+#include <atomic>
+#include <string>
+
+// Image source reading an entry straight out of the EPUB, so images are decoded without extracting them first
+class ZipImageSource final : public ImageSource {
+ public:
+  // zipPath must outlive the source
+  explicit ZipImageSource(const std::string& zipPath) : stream(zipPath) {}
+
+  bool open(const std::string& entryPath) { return stream.open(entryPath.c_str()); }
+  void close() { stream.close(); }
+
+  // Once the flag is set every read fails, so a decode in progress gives up at its next read
+  void setCancelFlag(const std::atomic<bool>* flag) { cancel = flag; }
+
+  int read(void* buffer, const size_t len) override {
+    if (cancel && cancel->load()) {
+      return -1;
+    }
+    return stream.read(buffer, len);
+  }
+  bool skip(const size_t len) override { return stream.skip(len); }
+  bool seek(const size_t position) override { return stream.seek(position); }
+  size_t position() const override { return stream.position(); }
+
+ private:
+  ZipEntryStream stream;
+  const std::atomic<bool>* cancel = nullptr;
+};
@@ -2,10 +2,13 @@
 
 #include <Arduino.h>
 #include <Logging.h>
+#include <Serialization.h>
 
 #include <algorithm>
 #include <array>
 #include <cctype>
+#include <cstring>
+#include <new>
 #include <string_view>
 
 namespace {
@@ -49,8 +52,25 @@ constexpr size_t MIN_FREE_HEAP_FOR_CSS = 48 * 1024;
 // Prevents parsing of extremely long or malformed selectors
 constexpr size_t MAX_SELECTOR_LENGTH = 256;
 
-// Check if character is CSS whitespace
-bool isCssWhitespace(const char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f'; }
+// Maximum number of contextual (descendant/child/attribute) rules; they stay in memory while a book is open
+constexpr size_t MAX_CONTEXTUAL_RULES = 128;
+
+// Maximum number of contextual rules applied to a single element
+constexpr size_t MAX_MATCHED_RULES = 16;
+
+// Second hash of a memoized (tag, class attribute) pair, independent of the FNV-1a keys that pick its slot and
+// case-sensitive like the source text, so a memo hit needs two unrelated hashes and both lengths to agree
+uint32_t memoCheckHash(const char* tagName, const size_t tagLength, const char* classAttr, const size_t classLength) {
+  uint32_t hash = 5381;
+  for (size_t i = 0; i < tagLength; ++i) {
+    hash = hash * 33 + static_cast<uint8_t>(tagName[i]);
+  }
+  hash = hash * 33 + ' ';
+  for (size_t i = 0; i < classLength; ++i) {
+    hash = hash * 33 + static_cast<uint8_t>(classAttr[i]);
+  }
+  return hash;
+}
 
 }  // anonymous namespace
 
@@ -340,8 +360,28 @@ void CssParser::processRuleBlockWithStyle(const std::string& selectorGroup, cons
     }
 
     // Normalize the selector
-    std::string key = normalized(sel);
-    if (key.empty()) continue;
+    const std::string normalizedSel = normalized(sel);
+    if (normalizedSel.empty()) continue;
+
+    CssComplexSelector compiled;
+    const CssSelectorKind kind = compileCssSelector(normalizedSel, compiled);
+    if (kind == CssSelectorKind::Unsupported) {
+      continue;
+    }
+    if (kind == CssSelectorKind::Contextual) {
+      if (contextualRules_.size() >= MAX_CONTEXTUAL_RULES) {
+        LOG_DBG("CSS", "Reached max contextual rules limit (%zu), skipping: %s", MAX_CONTEXTUAL_RULES,
+                normalizedSel.c_str());
+        continue;
+      }
+      ContextualRule rule;
+      rule.selector = compiled;
+      rule.order = static_cast<uint16_t>(contextualRules_.size());
+      rule.style = packRule(compiled.bucketKey, style);
+      contextualRules_.push_back(rule);
+      continue;
+    }
+    const uint32_t key = cssKey(normalizedSel.data(), normalizedSel.size());
 
     // Skip if this would exceed the rule limit
     if (rulesBySelector_.size() >= MAX_RULES) {
@@ -349,12 +389,16 @@ void CssParser::processRuleBlockWithStyle(const std::string& selectorGroup, cons
       return;
     }
 
-    // Store or merge with existing
-    auto it = rulesBySelector_.find(key);
-    if (it != rulesBySelector_.end()) {
-      it->second.applyOver(style);
+    // Store or merge with an existing rule for the same selector; a different selector with the same key is kept
+    // as a rule of its own
+    const auto range = rulesBySelector_.equal_range(key);
+    const auto it = std::find_if(range.first, range.second, [&normalizedSel](const auto& entry) {
+      return entry.second.selector == normalizedSel;
+    });
+    if (it != range.second) {
+      it->second.style.applyOver(style);
     } else {
-      rulesBySelector_[key] = style;
+      rulesBySelector_.emplace(key, SelectorRule{normalizedSel, style});
     }
   }
 }
@@ -366,6 +410,8 @@ bool CssParser::loadFromStream(FsFile& source) {
     LOG_ERR("CSS", "Cannot read from invalid file");
     return false;
   }
+  // New rules can change any previously resolved style
+  resetStyleMemo();
 
   size_t totalRead = 0;
 
@@ -509,7 +555,80 @@ bool CssParser::loadFromStream(FsFile& source) {
 
 // Style resolution
 
-CssStyle CssParser::resolveStyle(const std::string& tagName, const std::string& classAttr) const {
+bool CssParser::SelectorQuery::matches(const char* selector, const size_t length) const {
+  // Selectors are stored normalized (lower case); element and class names are matched case-insensitively
+  const auto equalsLower = [](const char* stored, const char* name, const size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+      if (stored[i] != std::tolower(static_cast<unsigned char>(name[i]))) {
+        return false;
+      }
+    }
+    return true;
+  };
+  if (length != tagLength + (className ? 1 + classLength : 0) || !equalsLower(selector, tag, tagLength)) {
+    return false;
+  }
+  return !className || (selector[tagLength] == '.' && equalsLower(selector + tagLength + 1, className, classLength));
+}
+
+void CssParser::applyRule(const uint32_t selectorKey, const SelectorQuery& query, CssStyle& style) const {
+  PackedRule rule;
+  if (findRule(selectorKey, query, rule)) {
+    style.applyOver(unpackRule(rule));
+  }
+}
+
+size_t CssParser::collectContextualMatches(const CssAncestry& ancestry, uint16_t* matched) const {
+  if (contextualRules_.empty() || ancestry.size() == 0) {
+    return 0;
+  }
+
+  // Only rules whose rightmost compound could match this element are tried: its tag, classes, attributes, or none
+  size_t count = 0;
+  const auto collectBucket = [&](const uint32_t bucketKey) {
+    auto it = std::lower_bound(contextualRules_.begin(), contextualRules_.end(), bucketKey,
+                               [](const ContextualRule& r, const uint32_t key) { return r.selector.bucketKey < key; });
+    for (; it != contextualRules_.end() && it->selector.bucketKey == bucketKey && count < MAX_MATCHED_RULES; ++it) {
+      if (it->selector.matches(ancestry)) {
+        matched[count++] = static_cast<uint16_t>(it - contextualRules_.begin());
+      }
+    }
+  };
+  const CssElementKeys& element = ancestry.back();
+  collectBucket(CSS_KEY_ANY);
+  collectBucket(element.tag);
+  for (size_t i = 0; i < element.classCount; ++i) {
+    collectBucket(element.classes[i]);
+  }
+  for (size_t i = 0; i < element.attrCount; ++i) {
+    collectBucket(element.attrs[i]);
+  }
+
+  // Cascade order: specificity, then source order
+  const auto before = [this](const uint16_t a, const uint16_t b) {
+    const ContextualRule& ra = contextualRules_[a];
+    const ContextualRule& rb = contextualRules_[b];
+    return ra.selector.specificity != rb.selector.specificity ? ra.selector.specificity < rb.selector.specificity
+                                                              : ra.order < rb.order;
+  };
+  std::sort(matched, matched + count, before);
+  return count;
+}
+
+CssStyle CssParser::resolveStyle(const char* tagName, const char* classAttr, const CssAncestry* ancestry) const {
+  if (!indexLoaded_) {
+    // Rules are only resolved through the cached index; without it stylesheets would be dropped silently
+    static bool missingIndexLogged = false;
+    if (!missingIndexLogged) {
+      missingIndexLogged = true;
+      LOG_ERR("CSS", "Rule index not loaded (call loadFromCache() first), returning empty style");
+    }
+    return CssStyle{};
+  }
+  if (indexRuleCount_ == 0 && contextualRules_.empty()) {
+    return CssStyle{};
+  }
+
   static bool lowHeapWarningLogged = false;
   if (ESP.getFreeHeap() < MIN_FREE_HEAP_FOR_CSS) {
     if (!lowHeapWarningLogged) {
@@ -519,39 +638,86 @@ CssStyle CssParser::resolveStyle(const std::string& tagName, const std::string&
     }
     return CssStyle{};
   }
-  CssStyle result;
-  const std::string tag = normalized(tagName);
-
-  // 1. Apply element-level style (lowest priority)
-  const auto tagIt = rulesBySelector_.find(tag);
-  if (tagIt != rulesBySelector_.end()) {
-    result.applyOver(tagIt->second);
-  }
 
-  // 2. Apply class styles (medium priority)
-  if (!classAttr.empty()) {
-    const auto classes = splitWhitespace(classAttr);
+  const size_t tagLength = strlen(tagName);
+  const uint32_t tagKey = cssKey(tagName, tagLength);
 
-    for (const auto& cls : classes) {
-      std::string classKey = "." + normalized(cls);
+  // 1. Element-level style (lowest priority)
+  const auto applyTagRules = [&](CssStyle& style) {
+    applyRule(tagKey, SelectorQuery{tagName, tagLength, nullptr, 0}, style);
+  };
+  // 2. Class styles (medium priority)
+  const auto applyClassRules = [&](CssStyle& style) {
+    const uint32_t dotKey = cssKey(".", 1);
+    forEachCssClassName(classAttr, [&](const char* cls, const size_t len) {
+      applyRule(extendCssKey(dotKey, cls, len), SelectorQuery{tagName, 0, cls, len}, style);
+    });
+  };
+  // 3. element.class styles (higher priority)
+  const auto applyTagClassRules = [&](CssStyle& style) {
+    const uint32_t tagDotKey = extendCssKey(tagKey, ".", 1);
+    forEachCssClassName(classAttr, [&](const char* cls, const size_t len) {
+      applyRule(extendCssKey(tagDotKey, cls, len), SelectorQuery{tagName, tagLength, cls, len}, style);
+    });
+  };
 
-      auto classIt = rulesBySelector_.find(classKey);
-      if (classIt != rulesBySelector_.end()) {
-        result.applyOver(classIt->second);
+  uint16_t matched[MAX_MATCHED_RULES];
+  const size_t matchCount = ancestry ? collectContextualMatches(*ancestry, matched) : 0;
+  if (matchCount > 0) {
+    // Interleave contextual rules with the simple ones by specificity; on a tie the contextual rule wins
+    CssStyle result;
+    size_t next = 0;
+    const auto applyContextualUpTo = [&](const uint16_t specificity) {
+      for (; next < matchCount && contextualRules_[matched[next]].selector.specificity <= specificity; ++next) {
+        result.applyOver(unpackRule(contextualRules_[matched[next]].style));
       }
-    }
-
-    // 3. Apply element.class styles (higher priority)
-    for (const auto& cls : classes) {
-      std::string combinedKey = tag + "." + normalized(cls);
+    };
+    applyContextualUpTo(0);
+    applyTagRules(result);
+    applyContextualUpTo(CSS_SPECIFICITY_CLASS - 1);
+    applyClassRules(result);
+    applyContextualUpTo(CSS_SPECIFICITY_CLASS);
+    applyTagClassRules(result);
+    applyContextualUpTo(UINT16_MAX);
+    return result;
+  }
 
-      auto combinedIt = rulesBySelector_.find(combinedKey);
-      if (combinedIt != rulesBySelector_.end()) {
-        result.applyOver(combinedIt->second);
-      }
+  // Without contextual matches the style only depends on (tag, class attribute), so it can be memoized
+  const size_t classLength = strlen(classAttr);
+  const uint32_t classKey = cssKey(classAttr, classLength);
+  // Attributes too long for the entry's length fields are resolved every time
+  const bool memoizable = tagLength <= UINT16_MAX && classLength <= UINT16_MAX;
+  const uint32_t check = memoizable ? memoCheckHash(tagName, tagLength, classAttr, classLength) : 0;
+  memoLookups_++;
+  if (!styleMemo_ && memoizable) {
+    styleMemo_.reset(new (std::nothrow) StyleMemoEntry[STYLE_MEMO_SLOTS]);
+  }
+  StyleMemoEntry* slot = nullptr;
+  if (styleMemo_ && memoizable) {
+    slot = &styleMemo_[(tagKey * 31 + classKey) & (STYLE_MEMO_SLOTS - 1)];
+    if (slot->used && slot->tagKey == tagKey && slot->classKey == classKey && slot->check == check &&
+        slot->tagLength == tagLength && slot->classLength == classLength) {
+      memoHits_++;
+      return slot->style;
     }
   }
 
+  CssStyle result;
+  applyTagRules(result);
+  if (*classAttr) {
+    applyClassRules(result);
+    applyTagClassRules(result);
+  }
+
+  if (slot) {
+    slot->tagKey = tagKey;
+    slot->classKey = classKey;
+    slot->check = check;
+    slot->tagLength = static_cast<uint16_t>(tagLength);
+    slot->classLength = static_cast<uint16_t>(classLength);
+    slot->used = true;
+    slot->style = result;
+  }
   return result;
 }
 
@@ -562,16 +728,181 @@ CssStyle CssParser::parseInlineStyle(const std::string& styleValue) { return par
 // Cache serialization
 
 // Cache format version - increment when format changes
-constexpr uint8_t CSS_CACHE_VERSION = 2;
+constexpr uint8_t CSS_CACHE_VERSION = 7;
 constexpr char rulesCache[] = "/css_rules.cache";
+// Version byte + uint16_t rule count + uint16_t contextual rule count, followed by PackedRule records sorted by
+// key, ContextualRule records sorted by bucket key and the selector table (the rules' selectors, concatenated)
+constexpr size_t CSS_CACHE_HEADER_SIZE = sizeof(uint8_t) + 2 * sizeof(uint16_t);
+// ContextualRule records are written field by field (no struct padding): selector, order, then the packed style
+constexpr size_t CSS_COMPOUND_RECORD_SIZE = 3 * sizeof(uint8_t) + (1 + CssCompoundSelector::MAX_CLASSES +
+                                                                   CssCompoundSelector::MAX_ATTRIBUTES) *
+                                                                      sizeof(uint32_t);
+constexpr size_t CSS_PACKED_STYLE_RECORD_SIZE =
+    2 * sizeof(uint32_t) + 2 * sizeof(uint16_t) + 4 * sizeof(uint8_t) + 9 * (sizeof(uint8_t) + sizeof(float));
+constexpr size_t CSS_CONTEXTUAL_RECORD_SIZE = sizeof(uint32_t) + sizeof(uint16_t) + sizeof(uint8_t) +
+                                              CssComplexSelector::MAX_COMPOUNDS * CSS_COMPOUND_RECORD_SIZE +
+                                              sizeof(uint16_t) + CSS_PACKED_STYLE_RECORD_SIZE;
+// Rule indexes up to this many records (~16KB plus selectors) stay in memory for the book's lifetime
+constexpr size_t MAX_RESIDENT_RULES = 256;
+
+// Length properties in PackedRule order
+constexpr CssLength CssStyle::*LENGTH_FIELDS[] = {
+    &CssStyle::textIndent,    &CssStyle::marginTop,   &CssStyle::marginBottom,
+    &CssStyle::marginLeft,    &CssStyle::marginRight, &CssStyle::paddingTop,
+    &CssStyle::paddingBottom, &CssStyle::paddingLeft, &CssStyle::paddingRight};
+
+CssParser::PackedRule CssParser::packRule(const uint32_t key, const CssStyle& style) {
+  static_assert(sizeof(LENGTH_FIELDS) / sizeof(LENGTH_FIELDS[0]) == NUM_LENGTH_FIELDS,
+                "PackedRule length fields out of sync with CssStyle");
+  PackedRule rule = {};
+  rule.key = key;
+  rule.textAlign = static_cast<uint8_t>(style.textAlign);
+  rule.fontStyle = static_cast<uint8_t>(style.fontStyle);
+  rule.fontWeight = static_cast<uint8_t>(style.fontWeight);
+  rule.textDecoration = static_cast<uint8_t>(style.textDecoration);
+
+  for (size_t i = 0; i < NUM_LENGTH_FIELDS; ++i) {
+    const CssLength& length = style.*LENGTH_FIELDS[i];
+    rule.lengthValues[i] = length.value;
+    rule.lengthUnits[i] = static_cast<uint8_t>(length.unit);
+  }
+
+  uint16_t definedBits = 0;
+  if (style.defined.textAlign) definedBits |= 1 << 0;
+  if (style.defined.fontStyle) definedBits |= 1 << 1;
+  if (style.defined.fontWeight) definedBits |= 1 << 2;
+  if (style.defined.textDecoration) definedBits |= 1 << 3;
+  if (style.defined.textIndent) definedBits |= 1 << 4;
+  if (style.defined.marginTop) definedBits |= 1 << 5;
+  if (style.defined.marginBottom) definedBits |= 1 << 6;
+  if (style.defined.marginLeft) definedBits |= 1 << 7;
+  if (style.defined.marginRight) definedBits |= 1 << 8;
+  if (style.defined.paddingTop) definedBits |= 1 << 9;
+  if (style.defined.paddingBottom) definedBits |= 1 << 10;
+  if (style.defined.paddingLeft) definedBits |= 1 << 11;
+  if (style.defined.paddingRight) definedBits |= 1 << 12;
+  rule.definedBits = definedBits;
+  return rule;
+}
+
+CssStyle CssParser::unpackRule(const PackedRule& rule) {
+  CssStyle style;
+  style.textAlign = static_cast<CssTextAlign>(rule.textAlign);
+  style.fontStyle = static_cast<CssFontStyle>(rule.fontStyle);
+  style.fontWeight = static_cast<CssFontWeight>(rule.fontWeight);
+  style.textDecoration = static_cast<CssTextDecoration>(rule.textDecoration);
+
+  for (size_t i = 0; i < NUM_LENGTH_FIELDS; ++i) {
+    CssLength& length = style.*LENGTH_FIELDS[i];
+    length.value = rule.lengthValues[i];
+    length.unit = static_cast<CssUnit>(rule.lengthUnits[i]);
+  }
+
+  const uint16_t definedBits = rule.definedBits;
+  style.defined.textAlign = (definedBits & 1 << 0) != 0;
+  style.defined.fontStyle = (definedBits & 1 << 1) != 0;
+  style.defined.fontWeight = (definedBits & 1 << 2) != 0;
+  style.defined.textDecoration = (definedBits & 1 << 3) != 0;
+  style.defined.textIndent = (definedBits & 1 << 4) != 0;
+  style.defined.marginTop = (definedBits & 1 << 5) != 0;
+  style.defined.marginBottom = (definedBits & 1 << 6) != 0;
+  style.defined.marginLeft = (definedBits & 1 << 7) != 0;
+  style.defined.marginRight = (definedBits & 1 << 8) != 0;
+  style.defined.paddingTop = (definedBits & 1 << 9) != 0;
+  style.defined.paddingBottom = (definedBits & 1 << 10) != 0;
+  style.defined.paddingLeft = (definedBits & 1 << 11) != 0;
+  style.defined.paddingRight = (definedBits & 1 << 12) != 0;
+  return style;
+}
+
+void CssParser::writeContextualRule(FsFile& file, const ContextualRule& rule) {
+  static_assert(NUM_LENGTH_FIELDS == 9, "CSS_PACKED_STYLE_RECORD_SIZE out of sync with PackedRule");
+  using serialization::writePod;
+  writePod(file, rule.selector.bucketKey);
+  writePod(file, rule.selector.specificity);
+  writePod(file, rule.selector.compoundCount);
+  for (const CssCompoundSelector& compound : rule.selector.compounds) {
+    writePod(file, compound.tag);
+    for (const uint32_t cls : compound.classes) writePod(file, cls);
+    for (const uint32_t attr : compound.attrs) writePod(file, attr);
+    writePod(file, compound.classCount);
+    writePod(file, compound.attrCount);
+    writePod(file, static_cast<uint8_t>(compound.combinator));
+  }
+  writePod(file, rule.order);
+
+  const PackedRule& style = rule.style;
+  writePod(file, style.key);
+  writePod(file, style.selectorOffset);
+  writePod(file, style.selectorLength);
+  writePod(file, style.definedBits);
+  writePod(file, style.textAlign);
+  writePod(file, style.fontStyle);
+  writePod(file, style.fontWeight);
+  writePod(file, style.textDecoration);
+  for (const uint8_t unit : style.lengthUnits) writePod(file, unit);
+  for (const float value : style.lengthValues) writePod(file, value);
+}
+
+void CssParser::readContextualRule(FsFile& file, ContextualRule& rule) {
+  using serialization::readPod;
+  readPod(file, rule.selector.bucketKey);
+  readPod(file, rule.selector.specificity);
+  readPod(file, rule.selector.compoundCount);
+  for (CssCompoundSelector& compound : rule.selector.compounds) {
+    readPod(file, compound.tag);
+    for (uint32_t& cls : compound.classes) readPod(file, cls);
+    for (uint32_t& attr : compound.attrs) readPod(file, attr);
+    readPod(file, compound.classCount);
+    readPod(file, compound.attrCount);
+    uint8_t combinator = 0;
+    readPod(file, combinator);
+    compound.combinator = static_cast<CssCombinator>(combinator);
+  }
+  readPod(file, rule.order);
+
+  PackedRule& style = rule.style;
+  readPod(file, style.key);
+  readPod(file, style.selectorOffset);
+  readPod(file, style.selectorLength);
+  readPod(file, style.definedBits);
+  readPod(file, style.textAlign);
+  readPod(file, style.fontStyle);
+  readPod(file, style.fontWeight);
+  readPod(file, style.textDecoration);
+  for (uint8_t& unit : style.lengthUnits) readPod(file, unit);
+  for (float& value : style.lengthValues) readPod(file, value);
+}
 
 bool CssParser::hasCache() const { return Storage.exists((cachePath + rulesCache).c_str()); }
 
+bool CssParser::removeCache() const { return !hasCache() || Storage.remove((cachePath + rulesCache).c_str()); }
+
 bool CssParser::saveToCache() const {
   if (cachePath.empty()) {
     return false;
   }
 
+  // Sort only pointers so the rules are not duplicated in memory while writing
+  using RuleEntry = std::pair<const uint32_t, SelectorRule>;
+  std::vector<const RuleEntry*> rules;
+  rules.reserve(rulesBySelector_.size());
+  for (const auto& entry : rulesBySelector_) {
+    rules.push_back(&entry);
+  }
+  std::sort(rules.begin(), rules.end(), [](const RuleEntry* a, const RuleEntry* b) {
+    return a->first != b->first ? a->first < b->first : a->second.selector < b->second.selector;
+  });
+
+  // Contextual rules are grouped by bucket so resolveStyle() can find an element's candidates by binary search
+  std::vector<uint16_t> contextualOrder(contextualRules_.size());
+  for (size_t i = 0; i < contextualOrder.size(); ++i) {
+    contextualOrder[i] = static_cast<uint16_t>(i);
+  }
+  std::stable_sort(contextualOrder.begin(), contextualOrder.end(), [this](const uint16_t a, const uint16_t b) {
+    return contextualRules_[a].selector.bucketKey < contextualRules_[b].selector.bucketKey;
+  });
+
   FsFile file;
   if (!Storage.openFileForWrite("CSS", cachePath + rulesCache, file)) {
     return false;
@@ -580,76 +911,46 @@ bool CssParser::saveToCache() const {
   // Write version
   file.write(CSS_CACHE_VERSION);
 
-  // Write rule count
-  const auto ruleCount = static_cast<uint16_t>(rulesBySelector_.size());
+  // Write rule counts
+  const auto ruleCount = static_cast<uint16_t>(rules.size());
+  const auto contextualCount = static_cast<uint16_t>(contextualOrder.size());
   file.write(reinterpret_cast<const uint8_t*>(&ruleCount), sizeof(ruleCount));
+  file.write(reinterpret_cast<const uint8_t*>(&contextualCount), sizeof(contextualCount));
+
+  // Write one fixed-size record per rule, in key order, pointing at its selector in the selector table
+  uint32_t selectorOffset = 0;
+  for (const RuleEntry* entry : rules) {
+    PackedRule rule = packRule(entry->first, entry->second.style);
+    rule.selectorOffset = selectorOffset;
+    rule.selectorLength = static_cast<uint16_t>(entry->second.selector.size());
+    selectorOffset += rule.selectorLength;
+    file.write(reinterpret_cast<const uint8_t*>(&rule), sizeof(rule));
+  }
+  for (const uint16_t index : contextualOrder) {
+    writeContextualRule(file, contextualRules_[index]);
+  }
+  for (const RuleEntry* entry : rules) {
+    file.write(reinterpret_cast<const uint8_t*>(entry->second.selector.data()), entry->second.selector.size());
+  }
 
-  // Write each rule: selector string + CssStyle fields
-  for (const auto& pair : rulesBySelector_) {
-    // Write selector string (length-prefixed)
-    const auto selectorLen = static_cast<uint16_t>(pair.first.size());
-    file.write(reinterpret_cast<const uint8_t*>(&selectorLen), sizeof(selectorLen));
-    file.write(reinterpret_cast<const uint8_t*>(pair.first.data()), selectorLen);
-
-    // Write CssStyle fields (all are POD types)
-    const CssStyle& style = pair.second;
-    file.write(static_cast<uint8_t>(style.textAlign));
-    file.write(static_cast<uint8_t>(style.fontStyle));
-    file.write(static_cast<uint8_t>(style.fontWeight));
-    file.write(static_cast<uint8_t>(style.textDecoration));
-
-    // Write CssLength fields (value + unit)
-    auto writeLength = [&file](const CssLength& len) {
-      file.write(reinterpret_cast<const uint8_t*>(&len.value), sizeof(len.value));
-      file.write(static_cast<uint8_t>(len.unit));
-    };
-
-    writeLength(style.textIndent);
-    writeLength(style.marginTop);
-    writeLength(style.marginBottom);
-    writeLength(style.marginLeft);
-    writeLength(style.marginRight);
-    writeLength(style.paddingTop);
-    writeLength(style.paddingBottom);
-    writeLength(style.paddingLeft);
-    writeLength(style.paddingRight);
-
-    // Write defined flags as uint16_t
-    uint16_t definedBits = 0;
-    if (style.defined.textAlign) definedBits |= 1 << 0;
-    if (style.defined.fontStyle) definedBits |= 1 << 1;
-    if (style.defined.fontWeight) definedBits |= 1 << 2;
-    if (style.defined.textDecoration) definedBits |= 1 << 3;
-    if (style.defined.textIndent) definedBits |= 1 << 4;
-    if (style.defined.marginTop) definedBits |= 1 << 5;
-    if (style.defined.marginBottom) definedBits |= 1 << 6;
-    if (style.defined.marginLeft) definedBits |= 1 << 7;
-    if (style.defined.marginRight) definedBits |= 1 << 8;
-    if (style.defined.paddingTop) definedBits |= 1 << 9;
-    if (style.defined.paddingBottom) definedBits |= 1 << 10;
-    if (style.defined.paddingLeft) definedBits |= 1 << 11;
-    if (style.defined.paddingRight) definedBits |= 1 << 12;
-    file.write(reinterpret_cast<const uint8_t*>(&definedBits), sizeof(definedBits));
-  }
-
-  LOG_DBG("CSS", "Saved %u rules to cache", ruleCount);
+  LOG_DBG("CSS", "Saved %u rules and %u contextual rules to cache", ruleCount, contextualCount);
   file.close();
   return true;
 }
 
 bool CssParser::loadFromCache() {
+  if (indexLoaded_) {
+    return true;
+  }
   if (cachePath.empty()) {
     return false;
   }
 
-  FsFile file;
+  FsFile& file = indexFile_;
   if (!Storage.openFileForRead("CSS", cachePath + rulesCache, file)) {
     return false;
   }
 
-  // Clear existing rules
-  clear();
-
   // Read and verify version
   uint8_t version = 0;
   if (file.read(&version, 1) != 1 || version != CSS_CACHE_VERSION) {
@@ -658,109 +959,143 @@ bool CssParser::loadFromCache() {
     return false;
   }
 
-  // Read rule count
+  // Read rule counts and check them against the file size before trusting any record offsets
   uint16_t ruleCount = 0;
-  if (file.read(&ruleCount, sizeof(ruleCount)) != sizeof(ruleCount)) {
+  uint16_t contextualCount = 0;
+  if (file.read(&ruleCount, sizeof(ruleCount)) != sizeof(ruleCount) ||
+      file.read(&contextualCount, sizeof(contextualCount)) != sizeof(contextualCount) ||
+      file.size() <
+          CSS_CACHE_HEADER_SIZE + ruleCount * sizeof(PackedRule) + contextualCount * CSS_CONTEXTUAL_RECORD_SIZE) {
+    LOG_ERR("CSS", "Corrupt rule cache");
     file.close();
     return false;
   }
-
-  // Read each rule
-  for (uint16_t i = 0; i < ruleCount; ++i) {
-    // Read selector string
-    uint16_t selectorLen = 0;
-    if (file.read(&selectorLen, sizeof(selectorLen)) != sizeof(selectorLen)) {
-      rulesBySelector_.clear();
+  selectorTableOffset_ =
+      CSS_CACHE_HEADER_SIZE + ruleCount * sizeof(PackedRule) + contextualCount * CSS_CONTEXTUAL_RECORD_SIZE;
+  selectorTableSize_ = file.size() - selectorTableOffset_;
+
+  // Contextual rules are few and always kept in memory
+  contextualRules_.resize(contextualCount);
+  if (contextualCount > 0) {
+    const size_t contextualStart = CSS_CACHE_HEADER_SIZE + ruleCount * sizeof(PackedRule);
+    if (file.seek(contextualStart)) {
+      for (ContextualRule& rule : contextualRules_) {
+        readContextualRule(file, rule);
+      }
+    }
+    if (file.position() != selectorTableOffset_) {
+      LOG_ERR("CSS", "Could not read contextual rules from cache");
+      contextualRules_.clear();
       file.close();
       return false;
     }
+  }
 
-    std::string selector;
-    selector.resize(selectorLen);
-    if (file.read(&selector[0], selectorLen) != selectorLen) {
-      rulesBySelector_.clear();
+  if (ruleCount <= MAX_RESIDENT_RULES) {
+    residentRules_.resize(ruleCount);
+    residentSelectors_.resize(selectorTableSize_);
+    const size_t bytes = ruleCount * sizeof(PackedRule);
+    if ((bytes > 0 && (!file.seek(CSS_CACHE_HEADER_SIZE) ||
+                       file.read(residentRules_.data(), bytes) != static_cast<int>(bytes))) ||
+        (selectorTableSize_ > 0 &&
+         (!file.seek(selectorTableOffset_) ||
+          file.read(&residentSelectors_[0], selectorTableSize_) != static_cast<int>(selectorTableSize_)))) {
+      residentRules_.clear();
+      residentSelectors_.clear();
+      contextualRules_.clear();
       file.close();
       return false;
     }
+    file.close();
+    LOG_DBG("CSS", "Loaded %u rules and %u contextual rules from cache", ruleCount, contextualCount);
+  } else {
+    // Too large to keep around; resolveStyle() binary-searches the file, which stays open until endSection()
+    LOG_DBG("CSS", "Searching %u cached rules on disk, %u contextual rules loaded", ruleCount, contextualCount);
+  }
 
-    // Read CssStyle fields
-    CssStyle style;
-    uint8_t enumVal;
+  indexRuleCount_ = ruleCount;
+  indexLoaded_ = true;
+  return true;
+}
 
-    if (file.read(&enumVal, 1) != 1) {
-      rulesBySelector_.clear();
-      file.close();
-      return false;
-    }
-    style.textAlign = static_cast<CssTextAlign>(enumVal);
+bool CssParser::ruleMatches(const PackedRule& rule, const SelectorQuery& query) const {
+  if (rule.selectorOffset + rule.selectorLength > selectorTableSize_) {
+    return false;
+  }
+  if (!residentRules_.empty()) {
+    return query.matches(residentSelectors_.data() + rule.selectorOffset, rule.selectorLength);
+  }
+  char selector[MAX_SELECTOR_LENGTH];
+  return rule.selectorLength <= MAX_SELECTOR_LENGTH && indexFile_.seek(selectorTableOffset_ + rule.selectorOffset) &&
+         indexFile_.read(selector, rule.selectorLength) == static_cast<int>(rule.selectorLength) &&
+         query.matches(selector, rule.selectorLength);
+}
 
-    if (file.read(&enumVal, 1) != 1) {
-      rulesBySelector_.clear();
-      file.close();
-      return false;
+bool CssParser::findRule(const uint32_t selectorKey, const SelectorQuery& query, PackedRule& rule) const {
+  // Records with the same key are adjacent; the one whose selector matches the query is the rule
+  if (!residentRules_.empty()) {
+    auto it = std::lower_bound(residentRules_.begin(), residentRules_.end(), selectorKey,
+                               [](const PackedRule& r, const uint32_t key) { return r.key < key; });
+    for (; it != residentRules_.end() && it->key == selectorKey; ++it) {
+      if (ruleMatches(*it, query)) {
+        rule = *it;
+        return true;
+      }
     }
-    style.fontStyle = static_cast<CssFontStyle>(enumVal);
+    return false;
+  }
 
-    if (file.read(&enumVal, 1) != 1) {
-      rulesBySelector_.clear();
-      file.close();
+  if (!indexFile_) {
+    return false;
+  }
+  size_t lo = 0;
+  size_t hi = indexRuleCount_;
+  while (lo < hi) {
+    const size_t mid = lo + (hi - lo) / 2;
+    uint32_t key = 0;
+    if (!indexFile_.seek(CSS_CACHE_HEADER_SIZE + mid * sizeof(PackedRule)) ||
+        indexFile_.read(&key, sizeof(key)) != sizeof(key)) {
       return false;
     }
-    style.fontWeight = static_cast<CssFontWeight>(enumVal);
-
-    if (file.read(&enumVal, 1) != 1) {
-      rulesBySelector_.clear();
-      file.close();
-      return false;
+    if (key < selectorKey) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
     }
-    style.textDecoration = static_cast<CssTextDecoration>(enumVal);
-
-    // Read CssLength fields
-    auto readLength = [&file](CssLength& len) -> bool {
-      if (file.read(&len.value, sizeof(len.value)) != sizeof(len.value)) {
-        return false;
-      }
-      uint8_t unitVal;
-      if (file.read(&unitVal, 1) != 1) {
-        return false;
-      }
-      len.unit = static_cast<CssUnit>(unitVal);
-      return true;
-    };
-
-    if (!readLength(style.textIndent) || !readLength(style.marginTop) || !readLength(style.marginBottom) ||
-        !readLength(style.marginLeft) || !readLength(style.marginRight) || !readLength(style.paddingTop) ||
-        !readLength(style.paddingBottom) || !readLength(style.paddingLeft) || !readLength(style.paddingRight)) {
-      rulesBySelector_.clear();
-      file.close();
+  }
+  for (; lo < indexRuleCount_; ++lo) {
+    if (!indexFile_.seek(CSS_CACHE_HEADER_SIZE + lo * sizeof(PackedRule)) ||
+        indexFile_.read(&rule, sizeof(rule)) != sizeof(rule) || rule.key != selectorKey) {
       return false;
     }
-
-    // Read defined flags
-    uint16_t definedBits = 0;
-    if (file.read(&definedBits, sizeof(definedBits)) != sizeof(definedBits)) {
-      rulesBySelector_.clear();
-      file.close();
-      return false;
+    if (ruleMatches(rule, query)) {
+      return true;
     }
-    style.defined.textAlign = (definedBits & 1 << 0) != 0;
-    style.defined.fontStyle = (definedBits & 1 << 1) != 0;
-    style.defined.fontWeight = (definedBits & 1 << 2) != 0;
-    style.defined.textDecoration = (definedBits & 1 << 3) != 0;
-    style.defined.textIndent = (definedBits & 1 << 4) != 0;
-    style.defined.marginTop = (definedBits & 1 << 5) != 0;
-    style.defined.marginBottom = (definedBits & 1 << 6) != 0;
-    style.defined.marginLeft = (definedBits & 1 << 7) != 0;
-    style.defined.marginRight = (definedBits & 1 << 8) != 0;
-    style.defined.paddingTop = (definedBits & 1 << 9) != 0;
-    style.defined.paddingBottom = (definedBits & 1 << 10) != 0;
-    style.defined.paddingLeft = (definedBits & 1 << 11) != 0;
-    style.defined.paddingRight = (definedBits & 1 << 12) != 0;
+  }
+  return false;
+}
 
-    rulesBySelector_[selector] = style;
+void CssParser::endSection() {
+  resetStyleMemo();
+  if (indexFile_) {
+    indexFile_.close();
+    indexLoaded_ = false;
+    indexRuleCount_ = 0;
   }
+}
 
-  LOG_DBG("CSS", "Loaded %u rules from cache", ruleCount);
-  file.close();
-  return true;
+void CssParser::clear() {
+  rulesBySelector_.clear();
+  residentRules_.clear();
+  residentRules_.shrink_to_fit();
+  residentSelectors_.clear();
+  residentSelectors_.shrink_to_fit();
+  contextualRules_.clear();
+  contextualRules_.shrink_to_fit();
+  if (indexFile_) {
+    indexFile_.close();
+  }
+  indexRuleCount_ = 0;
+  indexLoaded_ = false;
+  resetStyleMemo();
 }
@@ -2,11 +2,14 @@
 
 #include <HalStorage.h>
 
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "CssSelector.h"
 #include "CssStyle.h"
 
 /**
@@ -19,11 +22,16 @@
  * Supported selectors:
  *   - Element selectors: p, div, h1, etc.
  *   - Class selectors: .classname
- *   - Combined: element.classname
+ *   - Combined: element.classname, element.class1.class2
+ *   - Attribute presence: [epub|type], p[lang]
+ *   - Descendant and child combinators: div p, ol > li
  *   - Grouped: selector1, selector2 { }
  *
+ * Descendant/child/attribute selectors are compiled into CssComplexSelector and matched right-to-left
+ * against the element path supplied by the HTML parser.
+ *
  * Not supported (silently ignored):
- *   - Descendant/child selectors
+ *   - Sibling combinators, id selectors and attribute value matches
  *   - Pseudo-classes and pseudo-elements
  *   - Media queries (content is skipped)
  *   - @import, @font-face, etc.
@@ -49,11 +57,22 @@ class CssParser {
    * Look up the style for an HTML element, considering tag name and class attributes.
    * Applies CSS cascade: element style < class style < element.class style
    *
+   * Contextual rules matching the element path are merged into the cascade by specificity.
+   * Results without contextual matches are memoized per (tag, class attribute) until endSection() or
+   * clear(), so the same pair repeated throughout a chapter is resolved once.
+   *
    * @param tagName The HTML element name (e.g., "p", "div")
    * @param classAttr The class attribute value (may contain multiple space-separated classes)
+   * @param ancestry Open elements ending with this one, or nullptr to skip contextual rules
    * @return Combined style with all applicable rules merged
    */
-  [[nodiscard]] CssStyle resolveStyle(const std::string& tagName, const std::string& classAttr) const;
+  [[nodiscard]] CssStyle resolveStyle(const char* tagName, const char* classAttr,
+                                      const CssAncestry* ancestry = nullptr) const;
+
+  /**
+   * Check if any descendant/child/attribute rules are loaded (callers only need to track ancestry then)
+   */
+  [[nodiscard]] bool hasContextualRules() const { return !contextualRules_.empty(); }
 
   /**
    * Parse an inline style attribute string.
@@ -65,17 +84,31 @@ class CssParser {
   /**
    * Check if any rules have been loaded
    */
-  [[nodiscard]] bool empty() const { return rulesBySelector_.empty(); }
+  [[nodiscard]] bool empty() const { return ruleCount() == 0; }
+
+  /**
+   * Get count of loaded rule sets (parsed rules while loading stylesheets, otherwise the cached rule index)
+   */
+  [[nodiscard]] size_t ruleCount() const {
+    return (rulesBySelector_.empty() ? indexRuleCount_ : rulesBySelector_.size()) + contextualRules_.size();
+  }
 
   /**
-   * Get count of loaded rule sets
+   * Clear all loaded rules, the rule index and the resolved style memo
    */
-  [[nodiscard]] size_t ruleCount() const { return rulesBySelector_.size(); }
+  void clear();
 
   /**
-   * Clear all loaded rules
+   * Release per-section state once a section has been built: drops the style memo and closes the
+   * rule index file if it is being searched on disk. A resident rule index is kept for the next section.
    */
-  void clear() { rulesBySelector_.clear(); }
+  void endSection();
+
+  /**
+   * Style memo statistics since the last endSection() or clear()
+   */
+  [[nodiscard]] uint32_t styleMemoLookups() const { return memoLookups_; }
+  [[nodiscard]] uint32_t styleMemoHits() const { return memoHits_; }
 
   /**
    * Check if CSS rules cache file exists
@@ -83,24 +116,111 @@ class CssParser {
   bool hasCache() const;
 
   /**
-   * Save parsed CSS rules to a cache file.
+   * Delete the CSS rules cache file so the stylesheets are parsed again
+   * @return true if no cache file is left
+   */
+  bool removeCache() const;
+
+  /**
+   * Save parsed CSS rules to a cache file as a rule index: fixed-size records sorted by selector key.
    * @return true if cache was written successfully
    */
   bool saveToCache() const;
 
   /**
-   * Load CSS rules from a cache file.
-   * Clears any existing rules before loading.
-   * @return true if cache was loaded successfully
+   * Open the rule index from the cache file for style resolution.
+   * Small indexes are read into memory once and kept for the book's lifetime, so later calls are free;
+   * larger ones are binary-searched directly in the file until endSection().
+   * @return true if the rule index is available
    */
   bool loadFromCache();
 
  private:
-  // Storage: maps normalized selector -> style properties
-  std::unordered_map<std::string, CssStyle> rulesBySelector_;
+  // Parsed rules while loading stylesheets: maps interned selector key (hash of the normalized selector) -> rules.
+  // The selector is kept next to its style so two selectors whose keys collide stay separate rules.
+  struct SelectorRule {
+    std::string selector;
+    CssStyle style;
+  };
+  std::unordered_multimap<uint32_t, SelectorRule> rulesBySelector_;
+
+  // Simple selector looked up by resolveStyle(): "tag", ".class" or "tag.class"
+  struct SelectorQuery {
+    const char* tag;
+    size_t tagLength;
+    const char* className;  // nullptr for a tag-only selector
+    size_t classLength;
+
+    bool matches(const char* selector, size_t length) const;
+  };
+
+  static constexpr size_t NUM_LENGTH_FIELDS = 9;
+
+  // On-disk / resident rule index record. Fixed size so the file can be binary-searched by record number; the
+  // selector text it was keyed from lives in the selector table at the end of the file.
+  struct PackedRule {
+    uint32_t key;
+    uint32_t selectorOffset;
+    uint16_t selectorLength;
+    uint16_t definedBits;
+    uint8_t textAlign;
+    uint8_t fontStyle;
+    uint8_t fontWeight;
+    uint8_t textDecoration;
+    uint8_t lengthUnits[NUM_LENGTH_FIELDS];
+    float lengthValues[NUM_LENGTH_FIELDS];
+  };
+  static PackedRule packRule(uint32_t key, const CssStyle& style);
+  static CssStyle unpackRule(const PackedRule& rule);
+
+  // Rule index used by resolveStyle(): either resident with its selector table, or searched in indexFile_
+  std::vector<PackedRule> residentRules_;
+  std::string residentSelectors_;
+  mutable FsFile indexFile_;
+  size_t indexRuleCount_ = 0;
+  size_t selectorTableOffset_ = 0;
+  size_t selectorTableSize_ = 0;
+  bool indexLoaded_ = false;
+
+  // Descendant/child/attribute rules, sorted by bucket key (source order within a bucket) once loaded from cache
+  struct ContextualRule {
+    CssComplexSelector selector;
+    uint16_t order;
+    PackedRule style;
+  };
+  std::vector<ContextualRule> contextualRules_;
+  static void writeContextualRule(FsFile& file, const ContextualRule& rule);
+  static void readContextualRule(FsFile& file, ContextualRule& rule);
+  size_t collectContextualMatches(const CssAncestry& ancestry, uint16_t* matched) const;
+
+  // Direct-mapped memo of resolved styles, indexed by interned tag key + class attribute hash. An entry records the
+  // keys and lengths it was resolved for plus an independent check hash of the source text, so a hit is confirmed
+  // without copying the attribute. Allocated on first use and dropped by endSection() or clear().
+  struct StyleMemoEntry {
+    uint32_t tagKey = 0;
+    uint32_t classKey = 0;
+    uint32_t check = 0;
+    uint16_t tagLength = 0;
+    uint16_t classLength = 0;
+    bool used = false;
+    CssStyle style;
+  };
+  static constexpr size_t STYLE_MEMO_SLOTS = 32;
+  mutable std::unique_ptr<StyleMemoEntry[]> styleMemo_;
+  mutable uint32_t memoLookups_ = 0;
+  mutable uint32_t memoHits_ = 0;
 
   std::string cachePath;
 
+  void resetStyleMemo() {
+    styleMemo_.reset();
+    memoLookups_ = 0;
+    memoHits_ = 0;
+  }
+  bool findRule(uint32_t selectorKey, const SelectorQuery& query, PackedRule& rule) const;
+  bool ruleMatches(const PackedRule& rule, const SelectorQuery& query) const;
+  void applyRule(uint32_t selectorKey, const SelectorQuery& query, CssStyle& style) const;
+
   // Internal parsing helpers
   void processRuleBlockWithStyle(const std::string& selectorGroup, const CssStyle& style);
   static CssStyle parseDeclarations(const std::string& declBlock);
@@ -0,0 +1,208 @@
+#include "CssSelector.h"
+
+#include <cstring>
+
+namespace {
+
+bool isNameChar(const char c) {
+  return std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' || static_cast<uint8_t>(c) >= 0x80;
+}
+
+// Key of "[name]"; CSS namespace syntax (epub|type) is folded onto the prefixed attribute name expat reports
+uint32_t attributeKey(const char* name, const size_t len) {
+  uint32_t key = cssKey("[", 1);
+  for (size_t i = 0; i < len; ++i) {
+    const char c = name[i] == '|' ? ':' : name[i];
+    key = extendCssKey(key, &c, 1);
+  }
+  return extendCssKey(key, "]", 1);
+}
+
+bool containsKey(const uint32_t* keys, const size_t count, const uint32_t key) {
+  for (size_t i = 0; i < count; ++i) {
+    if (keys[i] == key) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Parses one compound selector starting at s[pos]. Returns false for anything the matcher cannot express.
+bool parseCompound(const std::string& s, size_t& pos, CssCompoundSelector& compound, bool& isUniversal) {
+  const size_t start = pos;
+  if (pos < s.size() && s[pos] == '*') {
+    isUniversal = true;
+    ++pos;
+  } else {
+    while (pos < s.size() && isNameChar(s[pos])) ++pos;
+    if (pos > start) {
+      compound.tag = cssKey(s.data() + start, pos - start);
+    }
+  }
+
+  while (pos < s.size()) {
+    const char c = s[pos];
+    if (c == '.') {
+      const size_t nameStart = ++pos;
+      while (pos < s.size() && isNameChar(s[pos])) ++pos;
+      if (pos == nameStart || compound.classCount >= CssCompoundSelector::MAX_CLASSES) {
+        return false;
+      }
+      compound.classes[compound.classCount++] = cssKey(s.data() + nameStart - 1, pos - nameStart + 1);
+    } else if (c == '[') {
+      const size_t nameStart = ++pos;
+      while (pos < s.size() && (isNameChar(s[pos]) || s[pos] == '|')) ++pos;
+      // Only presence tests ([name]) are supported, not value matches ([name=value])
+      if (pos == nameStart || pos >= s.size() || s[pos] != ']' ||
+          compound.attrCount >= CssCompoundSelector::MAX_ATTRIBUTES) {
+        return false;
+      }
+      compound.attrs[compound.attrCount++] = attributeKey(s.data() + nameStart, pos - nameStart);
+      ++pos;
+    } else if (c == ' ' || c == '>') {
+      break;
+    } else {
+      // Pseudo-classes, ids, sibling combinators, escapes...
+      return false;
+    }
+  }
+  return pos > start;
+}
+
+// compounds[index] is known to match ancestry[element]; check the rest of the selector to its left
+bool matchRemaining(const CssComplexSelector& selector, const size_t index, const CssAncestry& ancestry,
+                    const size_t element) {
+  if (index + 1 >= selector.compoundCount) {
+    return true;
+  }
+  const CssCompoundSelector& next = selector.compounds[index + 1];
+  if (selector.compounds[index].combinator == CssCombinator::Child) {
+    return element > 0 && next.matches(ancestry[element - 1]) &&
+           matchRemaining(selector, index + 1, ancestry, element - 1);
+  }
+  for (size_t e = element; e-- > 0;) {
+    if (next.matches(ancestry[e]) && matchRemaining(selector, index + 1, ancestry, e)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // anonymous namespace
+
+bool CssAncestry::push(const int depth, const char* tagName, const char* classAttr, const char* const* atts) {
+  while (!path.empty() && path.back().depth >= depth) {
+    path.pop_back();
+  }
+  if (path.size() >= MAX_DEPTH) {
+    return false;
+  }
+
+  CssElementKeys keys;
+  keys.depth = depth;
+  keys.tag = cssKey(tagName, strlen(tagName));
+  if (classAttr) {
+    const uint32_t dotKey = cssKey(".", 1);
+    forEachCssClassName(classAttr, [&](const char* cls, const size_t len) {
+      if (keys.classCount < CssElementKeys::MAX_CLASSES) {
+        keys.classes[keys.classCount++] = extendCssKey(dotKey, cls, len);
+      }
+    });
+  }
+  for (size_t i = 0; atts && atts[i] && keys.attrCount < CssElementKeys::MAX_ATTRIBUTES; i += 2) {
+    keys.attrs[keys.attrCount++] = attributeKey(atts[i], strlen(atts[i]));
+  }
+
+  path.push_back(keys);
+  return true;
+}
+
+bool CssCompoundSelector::matches(const CssElementKeys& element) const {
+  if (tag != CSS_KEY_ANY && tag != element.tag) {
+    return false;
+  }
+  for (size_t i = 0; i < classCount; ++i) {
+    if (!containsKey(element.classes, element.classCount, classes[i])) {
+      return false;
+    }
+  }
+  for (size_t i = 0; i < attrCount; ++i) {
+    if (!containsKey(element.attrs, element.attrCount, attrs[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool CssComplexSelector::matches(const CssAncestry& ancestry) const {
+  if (compoundCount == 0 || ancestry.size() == 0) {
+    return false;
+  }
+  const size_t top = ancestry.size() - 1;
+  return compounds[0].matches(ancestry[top]) && matchRemaining(*this, 0, ancestry, top);
+}
+
+CssSelectorKind compileCssSelector(const std::string& normalizedSelector, CssComplexSelector& out) {
+  const std::string& s = normalizedSelector;
+  CssCompoundSelector parsed[CssComplexSelector::MAX_COMPOUNDS];
+  size_t count = 0;
+  bool isUniversal = false;
+  size_t pos = 0;
+
+  while (pos < s.size()) {
+    if (count >= CssComplexSelector::MAX_COMPOUNDS) {
+      return CssSelectorKind::Unsupported;
+    }
+    CssCompoundSelector& compound = parsed[count];
+    if (!parseCompound(s, pos, compound, isUniversal)) {
+      return CssSelectorKind::Unsupported;
+    }
+    ++count;
+
+    // Combinator to the next compound: whitespace, '>', or both
+    if (pos >= s.size()) {
+      break;
+    }
+    CssCombinator combinator = CssCombinator::Descendant;
+    while (pos < s.size() && (s[pos] == ' ' || s[pos] == '>')) {
+      if (s[pos] == '>') {
+        combinator = CssCombinator::Child;
+      }
+      ++pos;
+    }
+    if (pos >= s.size()) {
+      return CssSelectorKind::Unsupported;
+    }
+    // Recorded on the compound to the right of the combinator
+    parsed[count].combinator = combinator;
+  }
+  if (count == 0) {
+    return CssSelectorKind::Unsupported;
+  }
+
+  const CssCompoundSelector& rightmost = parsed[count - 1];
+  if (count == 1 && rightmost.attrCount == 0 && rightmost.classCount <= 1 && !isUniversal) {
+    return CssSelectorKind::Simple;
+  }
+
+  out = CssComplexSelector();
+  out.compoundCount = static_cast<uint8_t>(count);
+  uint16_t tags = 0;
+  uint16_t classesAndAttrs = 0;
+  // Reverse for right-to-left matching; each compound keeps the combinator linking it to its left neighbour
+  for (size_t i = 0; i < count; ++i) {
+    out.compounds[i] = parsed[count - 1 - i];
+    if (out.compounds[i].tag != CSS_KEY_ANY) tags++;
+    classesAndAttrs += out.compounds[i].classCount + out.compounds[i].attrCount;
+  }
+  out.specificity = static_cast<uint16_t>(classesAndAttrs * CSS_SPECIFICITY_CLASS + tags * CSS_SPECIFICITY_TAG);
+
+  if (rightmost.tag != CSS_KEY_ANY) {
+    out.bucketKey = rightmost.tag;
+  } else if (rightmost.classCount > 0) {
+    out.bucketKey = rightmost.classes[0];
+  } else if (rightmost.attrCount > 0) {
+    out.bucketKey = rightmost.attrs[0];
+  }
+  return CssSelectorKind::Contextual;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Check if character is CSS whitespace
+inline bool isCssWhitespace(const char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f'; }
+
+// Selector parts are interned as an FNV-1a hash of their lower-cased text: "p", ".note", "p.note", "[epub:type]".
+// The hash is incremental, so keys can be built piecewise from element names and attributes without allocating.
+constexpr uint32_t CSS_KEY_SEED = 2166136261u;
+constexpr uint32_t CSS_KEY_PRIME = 16777619u;
+// Marks "no constraint" (universal selector / universal rule bucket)
+constexpr uint32_t CSS_KEY_ANY = 0;
+
+inline uint32_t extendCssKey(uint32_t key, const char* s, const size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    key ^= static_cast<uint8_t>(std::tolower(static_cast<unsigned char>(s[i])));
+    key *= CSS_KEY_PRIME;
+  }
+  return key;
+}
+
+inline uint32_t cssKey(const char* s, const size_t len) { return extendCssKey(CSS_KEY_SEED, s, len); }
+
+// Calls fn(start, len) for every whitespace-separated class name in a class attribute
+template <typename Fn>
+void forEachCssClassName(const char* classAttr, Fn&& fn) {
+  const char* p = classAttr;
+  while (*p) {
+    while (*p && isCssWhitespace(*p)) ++p;
+    const char* start = p;
+    while (*p && !isCssWhitespace(*p)) ++p;
+    if (p > start) {
+      fn(start, static_cast<size_t>(p - start));
+    }
+  }
+}
+
+// Specificity is (classes + attributes) * CSS_SPECIFICITY_CLASS + tags, which puts the simple selectors at
+// p = 1, .c = 16 and p.c = 17 so contextual rules can be merged into the same cascade.
+constexpr uint16_t CSS_SPECIFICITY_TAG = 1;
+constexpr uint16_t CSS_SPECIFICITY_CLASS = 16;
+
+// Interned keys of one open element
+struct CssElementKeys {
+  static constexpr size_t MAX_CLASSES = 4;
+  static constexpr size_t MAX_ATTRIBUTES = 4;
+
+  int depth = 0;
+  uint32_t tag = 0;
+  uint8_t classCount = 0;
+  uint8_t attrCount = 0;
+  uint32_t classes[MAX_CLASSES] = {};   // Keys of ".name"
+  uint32_t attrs[MAX_ATTRIBUTES] = {};  // Keys of "[name]"
+};
+
+// Path of open elements from the document root to the element currently being styled
+class CssAncestry {
+  std::vector<CssElementKeys> path;
+
+ public:
+  static constexpr size_t MAX_DEPTH = 32;
+
+  /**
+   * Drop elements that were closed (depth >= the new element's) and append the new element.
+   * @param atts Expat-style null-terminated name/value array (may be nullptr)
+   * @return false if the path is too deep to track; contextual rules are then skipped for this element
+   */
+  bool push(int depth, const char* tagName, const char* classAttr, const char* const* atts);
+  void clear() { path.clear(); }
+  [[nodiscard]] size_t size() const { return path.size(); }
+  [[nodiscard]] const CssElementKeys& operator[](const size_t i) const { return path[i]; }
+  [[nodiscard]] const CssElementKeys& back() const { return path.back(); }
+};
+
+enum class CssCombinator : uint8_t { None = 0, Descendant = 1, Child = 2 };
+
+// One compound selector, e.g. "p.note[lang]". Unset parts match anything.
+struct CssCompoundSelector {
+  static constexpr size_t MAX_CLASSES = 2;
+  static constexpr size_t MAX_ATTRIBUTES = 2;
+
+  uint32_t tag = CSS_KEY_ANY;
+  uint32_t classes[MAX_CLASSES] = {};
+  uint32_t attrs[MAX_ATTRIBUTES] = {};
+  uint8_t classCount = 0;
+  uint8_t attrCount = 0;
+  CssCombinator combinator = CssCombinator::None;  // Relation to the compound on its left
+
+  [[nodiscard]] bool matches(const CssElementKeys& element) const;
+};
+
+// Selector compiled for right-to-left matching against a CssAncestry. Plain data so it can be cached as-is.
+struct CssComplexSelector {
+  static constexpr size_t MAX_COMPOUNDS = 4;
+
+  uint32_t bucketKey = CSS_KEY_ANY;  // Most selective key of the rightmost compound; used to find candidate rules
+  uint16_t specificity = 0;
+  uint8_t compoundCount = 0;
+  CssCompoundSelector compounds[MAX_COMPOUNDS];  // Rightmost first
+
+  [[nodiscard]] bool matches(const CssAncestry& ancestry) const;
+};
+
+enum class CssSelectorKind : uint8_t { Simple, Contextual, Unsupported };
+
+/**
+ * Classify a normalized selector (lower-case, single spaces).
+ * Simple selectors ("p", ".c", "p.c") are stored by key; contextual ones (descendant, child, attribute
+ * presence, multiple classes) are compiled into `out`. Sibling combinators, pseudo-classes, ids and attribute
+ * value matches are unsupported.
+ */
+CssSelectorKind compileCssSelector(const std::string& normalizedSelector, CssComplexSelector& out);
@@ -0,0 +1,92 @@
+#include "HyphenationCache.h"
+
+#include <cstring>
+
+#include "LanguageRegistry.h"
+
+namespace {
+uint32_t fnv1a(uint32_t hash, const void* data, const size_t length) {
+  const auto* bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < length; ++i) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash;
+}
+}  // namespace
+
+HyphenationCache::Key HyphenationCache::keyFor(const char* word, const size_t length, const uint8_t languageId,
+                                               const bool includeFallback) {
+  const uint8_t params[] = {languageId, static_cast<uint8_t>(includeFallback ? 1 : 0)};
+  // FNV-1a over the word bytes, seeded with the parameters that change the result
+  const uint32_t hash = fnv1a(fnv1a(2166136261u, params, sizeof(params)), word, length);
+  // djb2 (xor variant) over the same input for the check
+  uint32_t check = 5381;
+  for (const uint8_t param : params) {
+    check = (check * 33) ^ param;
+  }
+  for (size_t i = 0; i < length; ++i) {
+    check = (check * 33) ^ static_cast<uint8_t>(word[i]);
+  }
+  return {hash, check};
+}
+
+uint32_t HyphenationCache::identity() {
+  static uint32_t cached = 0;
+  if (cached != 0) {
+    return cached;
+  }
+  uint32_t hash = 2166136261u;
+#ifdef CROSSPOINT_VERSION
+  hash = fnv1a(hash, CROSSPOINT_VERSION, strlen(CROSSPOINT_VERSION));
+#endif
+  // Regenerated patterns change their trie sizes; hashing the tries themselves would read ~350KB of flash
+  for (const LanguageEntry& entry : getLanguageEntries()) {
+    hash = fnv1a(hash, entry.primaryTag, strlen(entry.primaryTag));
+    if (entry.hyphenator) {
+      const SerializedHyphenationPatterns& patterns = entry.hyphenator->patterns();
+      const uint32_t shape[] = {static_cast<uint32_t>(patterns.size), static_cast<uint32_t>(patterns.rootOffset),
+                                static_cast<uint32_t>(entry.hyphenator->minPrefix()),
+                                static_cast<uint32_t>(entry.hyphenator->minSuffix())};
+      hash = fnv1a(hash, shape, sizeof(shape));
+    }
+  }
+  cached = hash != 0 ? hash : 1;
+  return cached;
+}
+
+bool HyphenationCache::lookup(const Key& key, const size_t wordLength, std::vector<Hyphenator::BreakInfo>& out) {
+  lookups_++;
+  const Entry& entry = entries_[key.hash & (NUM_ENTRIES - 1)];
+  if (entry.wordLength == 0 || entry.key != key.hash || entry.check != key.check || entry.wordLength != wordLength) {
+    return false;
+  }
+
+  hits_++;
+  out.clear();
+  out.reserve(entry.breakCount);
+  for (size_t i = 0; i < entry.breakCount; ++i) {
+    out.push_back({entry.offsets[i], (entry.hyphenMask & (1u << i)) != 0});
+  }
+  return true;
+}
+
+void HyphenationCache::store(const Key& key, const size_t wordLength,
+                             const std::vector<Hyphenator::BreakInfo>& breaks) {
+  if (wordLength == 0 || wordLength > MAX_WORD_LENGTH || breaks.size() > MAX_BREAKS) {
+    return;
+  }
+
+  Entry entry = {};
+  entry.key = key.hash;
+  entry.check = key.check;
+  entry.wordLength = static_cast<uint8_t>(wordLength);
+  entry.breakCount = static_cast<uint8_t>(breaks.size());
+  for (size_t i = 0; i < breaks.size(); ++i) {
+    // Offsets are within the word, so they always fit next to a length that does
+    entry.offsets[i] = static_cast<uint8_t>(breaks[i].byteOffset);
+    if (breaks[i].requiresInsertedHyphen) {
+      entry.hyphenMask |= static_cast<uint16_t>(1u << i);
+    }
+  }
+  entries_[key.hash & (NUM_ENTRIES - 1)] = entry;
+}
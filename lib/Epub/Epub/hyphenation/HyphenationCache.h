@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Hyphenator.h"
+
+// Bounded memo of Hyphenator::breakOffsets() results. Common words recur thousands of times per book and
+// ParsedText may ask for the same word several times while fitting a line, so most lookups can skip codepoint
+// decoding and the Liang walk entirely. Slots are direct-mapped by a hash of the word, its language and the
+// fallback flag; a second, independent hash and the word length confirm a hit. Entries are plain data so the
+// table can be persisted per book between section builds.
+class HyphenationCache {
+ public:
+  static constexpr size_t NUM_ENTRIES = 256;  // Power of two
+  static constexpr size_t MAX_BREAKS = 12;    // Words with more break points are not cached
+  static constexpr size_t MAX_WORD_LENGTH = 255;
+
+  // Slot hash plus check hash; both are computed from the same inputs with unrelated functions
+  struct Key {
+    uint32_t hash;
+    uint32_t check;
+  };
+
+  struct Entry {
+    uint32_t key;
+    uint32_t check;
+    uint8_t wordLength;  // 0 marks an empty slot
+    uint8_t breakCount;
+    uint16_t hyphenMask;  // Bit i set: break i requires an inserted hyphen
+    uint8_t offsets[MAX_BREAKS];
+  };
+
+  static Key keyFor(const char* word, size_t length, uint8_t languageId, bool includeFallback);
+
+  // Fingerprint of everything a persisted table depends on: the firmware build and the compiled-in patterns
+  static uint32_t identity();
+
+  bool lookup(const Key& key, size_t wordLength, std::vector<Hyphenator::BreakInfo>& out);
+  void store(const Key& key, size_t wordLength, const std::vector<Hyphenator::BreakInfo>& breaks);
+
+  // Raw table, for persisting the cache between section builds
+  Entry* entries() { return entries_; }
+  const Entry* entries() const { return entries_; }
+  static constexpr size_t sizeBytes() { return sizeof(Entry) * NUM_ENTRIES; }
+
+  uint32_t lookups() const { return lookups_; }
+  uint32_t hits() const { return hits_; }
+
+ private:
+  Entry entries_[NUM_ENTRIES] = {};
+  uint32_t lookups_ = 0;
+  uint32_t hits_ = 0;
+};
@@ -2,6 +2,9 @@
 
 #include <Utf8.h>
 
+#include <array>
+#include <cstring>
+
 namespace {
 
 // Convert Latin uppercase letters (ASCII plus Latin-1 supplement) to lowercase
@@ -38,6 +41,21 @@ uint32_t toLowerCyrillicImpl(const uint32_t cp) {
   return cp;
 }
 
+// Script by UTF-8 lead byte. Continuation bytes, digits, punctuation and the U+0080-U+00BF block (NBSP, quotes,
+// inverted marks) are Unknown so leading punctuation is skipped.
+constexpr std::array<HyphenationScript, 256> buildLeadByteScripts() {
+  std::array<HyphenationScript, 256> table{};
+  for (int b = 'A'; b <= 'Z'; ++b) table[b] = HyphenationScript::Latin;
+  for (int b = 'a'; b <= 'z'; ++b) table[b] = HyphenationScript::Latin;
+  // U+00C0-U+027F: Latin-1 letters, Latin Extended-A and -B
+  for (int b = 0xC3; b <= 0xC9; ++b) table[b] = HyphenationScript::Latin;
+  // U+0400-U+052F: Cyrillic and Cyrillic Supplement, matching isCyrillicLetter()
+  for (int b = 0xD0; b <= 0xD4; ++b) table[b] = HyphenationScript::Cyrillic;
+  return table;
+}
+
+constexpr std::array<HyphenationScript, 256> kLeadByteScripts = buildLeadByteScripts();
+
 }  // namespace
 
 uint32_t toLowerLatin(const uint32_t cp) { return toLowerLatinImpl(cp); }
@@ -135,6 +153,16 @@ bool isExplicitHyphen(const uint32_t cp) {
 
 bool isSoftHyphen(const uint32_t cp) { return cp == 0x00AD; }
 
+HyphenationScript scriptOfWord(const char* word) {
+  for (const char* p = word; *p; ++p) {
+    const HyphenationScript script = kLeadByteScripts[static_cast<uint8_t>(*p)];
+    if (script != HyphenationScript::Unknown) {
+      return script;
+    }
+  }
+  return HyphenationScript::Unknown;
+}
+
 void trimSurroundingPunctuationAndFootnote(std::vector<CodepointInfo>& cps) {
   if (cps.empty()) {
     return;
@@ -165,11 +193,11 @@ void trimSurroundingPunctuationAndFootnote(std::vector<CodepointInfo>& cps) {
   }
 }
 
-std::vector<CodepointInfo> collectCodepoints(const std::string& word) {
+std::vector<CodepointInfo> collectCodepoints(const char* word) {
   std::vector<CodepointInfo> cps;
-  cps.reserve(word.size());
+  cps.reserve(strlen(word));
 
-  const unsigned char* base = reinterpret_cast<const unsigned char*>(word.c_str());
+  const unsigned char* base = reinterpret_cast<const unsigned char*>(word);
   const unsigned char* ptr = base;
   while (*ptr != 0) {
     const unsigned char* current = ptr;
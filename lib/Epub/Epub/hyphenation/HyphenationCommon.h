@@ -10,6 +10,10 @@ struct CodepointInfo {
   size_t byteOffset;
 };
 
+// Writing systems the hyphenation patterns are grouped by. A word is matched against patterns of its own script.
+enum class HyphenationScript : uint8_t { Unknown = 0, Latin, Cyrillic };
+constexpr size_t HYPHENATION_SCRIPT_COUNT = 3;
+
 uint32_t toLowerLatin(uint32_t cp);
 uint32_t toLowerCyrillic(uint32_t cp);
 
@@ -21,5 +25,9 @@ bool isPunctuation(uint32_t cp);
 bool isAsciiDigit(uint32_t cp);
 bool isExplicitHyphen(uint32_t cp);
 bool isSoftHyphen(uint32_t cp);
+// Script of the first letter in a UTF-8 word, classified from its lead byte alone (one table lookup per byte
+// skipped, normally just the first one).
+HyphenationScript scriptOfWord(const char* word);
 void trimSurroundingPunctuationAndFootnote(std::vector<CodepointInfo>& cps);
-std::vector<CodepointInfo> collectCodepoints(const std::string& word);
+std::vector<CodepointInfo> collectCodepoints(const char* word);
+inline std::vector<CodepointInfo> collectCodepoints(const std::string& word) { return collectCodepoints(word.c_str()); }
@@ -1,11 +1,14 @@
 #include "Hyphenator.h"
 
+#include <cstring>
 #include <vector>
 
+#include "HyphenationCache.h"
 #include "HyphenationCommon.h"
 #include "LanguageRegistry.h"
 
-const LanguageHyphenator* Hyphenator::cachedHyphenator_ = nullptr;
+uint8_t Hyphenator::resolvedLanguage_[Hyphenator::MAX_LANGUAGE_IDS][HYPHENATION_SCRIPT_COUNT] = {};
+HyphenationCache* Hyphenator::breakCache_ = nullptr;
 
 namespace {
 
@@ -26,6 +29,40 @@ const LanguageHyphenator* hyphenatorForLanguage(const std::string& langTag) {
   return getLanguageHyphenatorForPrimaryTag(primary);
 }
 
+// Stable small id for a hyphenator: its 1-based position in the language registry (0 = none).
+uint8_t languageIdFor(const LanguageHyphenator* hyphenator) {
+  if (!hyphenator) return 0;
+  uint8_t id = 1;
+  for (const auto& entry : getLanguageEntries()) {
+    if (entry.hyphenator == hyphenator) return id;
+    ++id;
+  }
+  return 0;
+}
+
+const LanguageEntry* entryForId(const uint8_t id) {
+  const auto entries = getLanguageEntries();
+  return (id > 0 && id <= entries.size) ? &entries.data[id - 1] : nullptr;
+}
+
+// Picks the patterns for words of `script` in a block of language `requested`, in a book of language `book`.
+uint8_t resolveLanguageForScript(const uint8_t requested, const uint8_t book, const HyphenationScript script) {
+  const LanguageEntry* entry = entryForId(requested);
+  if (!entry || script == HyphenationScript::Unknown || entry->script == script) {
+    return entry ? requested : 0;
+  }
+  const LanguageEntry* bookEntry = entryForId(book);
+  if (bookEntry && bookEntry->script == script) {
+    return book;
+  }
+  uint8_t id = 1;
+  for (const auto& candidate : getLanguageEntries()) {
+    if (candidate.script == script) return id;
+    ++id;
+  }
+  return 0;
+}
+
 // Maps a codepoint index back to its byte offset inside the source word.
 size_t byteOffsetForIndex(const std::vector<CodepointInfo>& cps, const size_t index) {
   return (index < cps.size()) ? cps[index].byteOffset : (cps.empty() ? 0 : cps.back().byteOffset);
@@ -50,15 +87,38 @@ std::vector<Hyphenator::BreakInfo> buildExplicitBreakInfos(const std::vector<Cod
 
 }  // namespace
 
-std::vector<Hyphenator::BreakInfo> Hyphenator::breakOffsets(const std::string& word, const bool includeFallback) {
-  if (word.empty()) {
+std::vector<Hyphenator::BreakInfo> Hyphenator::breakOffsets(const char* word, const bool includeFallback,
+                                                             const uint8_t blockLanguage) {
+  if (*word == '\0') {
     return {};
   }
 
+  const uint8_t languageId = blockLanguage < MAX_LANGUAGE_IDS
+                                 ? resolvedLanguage_[blockLanguage][static_cast<size_t>(scriptOfWord(word))]
+                                 : 0;
+  const LanguageEntry* entry = entryForId(languageId);
+  const LanguageHyphenator* hyphenator = entry ? entry->hyphenator : nullptr;
+
+  HyphenationCache* cache = breakCache_;
+  if (!cache) {
+    return computeBreakOffsets(word, includeFallback, hyphenator);
+  }
+
+  const size_t wordLength = strlen(word);
+  const HyphenationCache::Key key = HyphenationCache::keyFor(word, wordLength, languageId, includeFallback);
+  std::vector<BreakInfo> breaks;
+  if (!cache->lookup(key, wordLength, breaks)) {
+    breaks = computeBreakOffsets(word, includeFallback, hyphenator);
+    cache->store(key, wordLength, breaks);
+  }
+  return breaks;
+}
+
+std::vector<Hyphenator::BreakInfo> Hyphenator::computeBreakOffsets(const char* word, const bool includeFallback,
+                                                                    const LanguageHyphenator* hyphenator) {
   // Convert to codepoints and normalize word boundaries.
   auto cps = collectCodepoints(word);
   trimSurroundingPunctuationAndFootnote(cps);
-  const auto* hyphenator = cachedHyphenator_;
 
   // Explicit hyphen markers (soft or hard) take precedence over language breaks.
   auto explicitBreakInfos = buildExplicitBreakInfos(cps);
@@ -94,4 +154,18 @@ std::vector<Hyphenator::BreakInfo> Hyphenator::breakOffsets(const std::string& w
   return breaks;
 }
 
-void Hyphenator::setPreferredLanguage(const std::string& lang) { cachedHyphenator_ = hyphenatorForLanguage(lang); }
+void Hyphenator::setPreferredLanguage(const std::string& lang) {
+  const uint8_t bookLanguage = languageIdFor(hyphenatorForLanguage(lang));
+  for (size_t row = 0; row < MAX_LANGUAGE_IDS; ++row) {
+    const uint8_t requested = row == LANGUAGE_BOOK ? bookLanguage : static_cast<uint8_t>(row);
+    for (size_t script = 0; script < HYPHENATION_SCRIPT_COUNT; ++script) {
+      resolvedLanguage_[row][script] =
+          resolveLanguageForScript(requested, bookLanguage, static_cast<HyphenationScript>(script));
+    }
+  }
+}
+
+uint8_t Hyphenator::languageIdForTag(const char* langTag) {
+  const uint8_t id = languageIdFor(hyphenatorForLanguage(langTag));
+  return (id > 0 && id < MAX_LANGUAGE_IDS) ? id : LANGUAGE_NONE;
+}
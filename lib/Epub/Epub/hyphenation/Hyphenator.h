@@ -1,9 +1,13 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 
+#include "HyphenationCommon.h"
+
+class HyphenationCache;
 class LanguageHyphenator;
 
 class Hyphenator {
@@ -12,13 +16,38 @@ class Hyphenator {
     size_t byteOffset;
     bool requiresInsertedHyphen;
   };
+  // Language of a text block, as returned by languageIdForTag(). LANGUAGE_BOOK follows the publication language,
+  // LANGUAGE_NONE marks a language without patterns.
+  static constexpr uint8_t LANGUAGE_BOOK = 0;
+  static constexpr uint8_t LANGUAGE_NONE = 0xFF;
+
   // Returns byte offsets where the word may be hyphenated. When includeFallback is true, all positions obeying the
   // minimum prefix/suffix constraints are returned even if no language-specific rule matches.
-  static std::vector<BreakInfo> breakOffsets(const std::string& word, bool includeFallback);
+  // Patterns come from blockLanguage, unless the word is written in another script (e.g. a Latin word in a
+  // Russian paragraph), in which case the book language or the registry default for that script is used.
+  static std::vector<BreakInfo> breakOffsets(const char* word, bool includeFallback,
+                                             uint8_t blockLanguage = LANGUAGE_BOOK);
+  static std::vector<BreakInfo> breakOffsets(const std::string& word, const bool includeFallback,
+                                             const uint8_t blockLanguage = LANGUAGE_BOOK) {
+    return breakOffsets(word.c_str(), includeFallback, blockLanguage);
+  }
 
   // Provide a publication-level language hint (e.g. "en", "en-US", "ru") used to select hyphenation rules.
   static void setPreferredLanguage(const std::string& lang);
 
+  // Maps an xml:lang/lang attribute value to a block language id
+  static uint8_t languageIdForTag(const char* langTag);
+
+  // Memoize breakOffsets() results in `cache` until reset with nullptr. The caller owns the cache.
+  static void setBreakCache(HyphenationCache* cache) { breakCache_ = cache; }
+
  private:
-  static const LanguageHyphenator* cachedHyphenator_;
+  static constexpr size_t MAX_LANGUAGE_IDS = 16;  // LANGUAGE_BOOK plus registry languages
+
+  static std::vector<BreakInfo> computeBreakOffsets(const char* word, bool includeFallback,
+                                                    const LanguageHyphenator* hyphenator);
+
+  // Registry language used for [block language][word script]; 0 = none. Rebuilt by setPreferredLanguage().
+  static uint8_t resolvedLanguage_[MAX_LANGUAGE_IDS][HYPHENATION_SCRIPT_COUNT];
+  static HyphenationCache* breakCache_;
 };
\ No newline at end of file
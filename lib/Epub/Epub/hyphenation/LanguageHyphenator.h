@@ -1,5 +1,8 @@
 #pragma once
 
+#include <memory>
+#include <new>
+
 #include "LiangHyphenation.h"
 
 // Generic Liang-backed hyphenator that stores pattern metadata plus language-specific helpers.
@@ -11,13 +14,30 @@ class LanguageHyphenator {
       : patterns_(patterns), config_(isLetterFn, toLowerFn, minPrefix, minSuffix) {}
 
   std::vector<size_t> breakIndexes(const std::vector<CodepointInfo>& cps) const {
-    return liangBreakIndexes(cps, patterns_, config_);
+    return liangBreakIndexes(cps, patterns_, config_, rootTable());
   }
 
   size_t minPrefix() const { return config_.minPrefix; }
   size_t minSuffix() const { return config_.minSuffix; }
+  const SerializedHyphenationPatterns& patterns() const { return patterns_; }
 
  protected:
   const SerializedHyphenationPatterns& patterns_;
   LiangWordConfig config_;
+
+ private:
+  // Built on first use so only languages that are actually hyphenated pay for the table
+  const LiangRootTable* rootTable() const {
+    if (!rootTableBuilt_) {
+      rootTableBuilt_ = true;
+      rootTable_.reset(new (std::nothrow) LiangRootTable);
+      if (rootTable_ && !buildLiangRootTable(patterns_, *rootTable_)) {
+        rootTable_.reset();
+      }
+    }
+    return rootTable_.get();
+  }
+
+  mutable std::unique_ptr<LiangRootTable> rootTable_;
+  mutable bool rootTableBuilt_ = false;
 };
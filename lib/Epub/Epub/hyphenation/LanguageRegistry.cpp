@@ -26,13 +26,14 @@ LanguageHyphenator ukrainianHyphenator(uk_patterns, isCyrillicLetter, toLowerCyr
 using EntryArray = std::array<LanguageEntry, 7>;
 
 const EntryArray& entries() {
-  static const EntryArray kEntries = {{{"english", "en", &englishHyphenator},
-                                       {"french", "fr", &frenchHyphenator},
-                                       {"german", "de", &germanHyphenator},
-                                       {"russian", "ru", &russianHyphenator},
-                                       {"spanish", "es", &spanishHyphenator},
-                                       {"italian", "it", &italianHyphenator},
-                                       {"ukrainian", "uk", &ukrainianHyphenator}}};
+  // Within a script, the first entry is the default for words of that script in books of another script
+  static const EntryArray kEntries = {{{"english", "en", &englishHyphenator, HyphenationScript::Latin},
+                                       {"french", "fr", &frenchHyphenator, HyphenationScript::Latin},
+                                       {"german", "de", &germanHyphenator, HyphenationScript::Latin},
+                                       {"russian", "ru", &russianHyphenator, HyphenationScript::Cyrillic},
+                                       {"spanish", "es", &spanishHyphenator, HyphenationScript::Latin},
+                                       {"italian", "it", &italianHyphenator, HyphenationScript::Latin},
+                                       {"ukrainian", "uk", &ukrainianHyphenator, HyphenationScript::Cyrillic}}};
   return kEntries;
 }
 
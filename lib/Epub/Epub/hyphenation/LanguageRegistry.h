@@ -3,12 +3,14 @@
 #include <cstddef>
 #include <string>
 
+#include "HyphenationCommon.h"
 #include "LanguageHyphenator.h"
 
 struct LanguageEntry {
   const char* cliName;
   const char* primaryTag;
   const LanguageHyphenator* hyphenator;
+  HyphenationScript script;
 };
 
 struct LanguageEntryView {
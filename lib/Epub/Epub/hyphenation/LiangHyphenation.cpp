@@ -1,7 +1,6 @@
 #include "LiangHyphenation.h"
 
 #include <algorithm>
-#include <vector>
 
 /*
  * Liang hyphenation pipeline overview (Typst-style binary trie variant)
@@ -24,8 +23,9 @@
  *       nodes, and an optional pointer into a shared "levels" list. We parse
  *       that layout lazily via decodeState/transition, keeping everything in
  *       flash memory; no heap allocations besides the stack-local AutomatonState
- *       structs. getAutomaton caches parseAutomaton results per blob pointer so
- *       multiple words hitting the same language only pay the cost once.
+ *       structs. Every walk starts at the root, which is also the widest node,
+ *       so callers may pass a LiangRootTable that maps each first byte straight
+ *       to its child slot instead of scanning the root's transition list.
  *
  * 3.  Pattern application
  *     - We walk the augmented bytes left-to-right. For each starting byte we
@@ -45,84 +45,88 @@
  *       etc.
  *
  * Keeping the entire algorithm small and deterministic is critical on the
- * ESP32-C3: we avoid recursion, dynamic allocations per node, or copying the
- * trie. All lookups stay within the generated blob, which lives in flash, and
- * the working buffers (augmented bytes/scores) scale with the word length rather
- * than the pattern corpus.
+ * ESP32-C3: we avoid recursion, heap allocations, or copying the trie. All
+ * lookups stay within the generated blob, which lives in flash, and the working
+ * buffers (augmented bytes/scores) are fixed-size stack arrays bounded by
+ * LIANG_MAX_WORD_CODEPOINTS. Longer words are simply not hyphenated.
  */
 
 namespace {
 
 using EmbeddedAutomaton = SerializedHyphenationPatterns;
 
-struct AugmentedWord {
-  std::vector<uint8_t> bytes;
-  std::vector<size_t> charByteOffsets;
-  std::vector<int32_t> byteToCharIndex;
+// Leading and trailing '.' sentinels around the word.
+constexpr size_t kMaxAugmentedChars = LIANG_MAX_WORD_CODEPOINTS + 2;
+// isLetter only admits Latin and Cyrillic letters, which lowercase to at most two UTF-8 bytes each.
+// Anything wider is caught by appendUtf8's bounds check and the word is left unhyphenated.
+constexpr size_t kMaxAugmentedBytes = LIANG_MAX_WORD_CODEPOINTS * 2 + 2;
+constexpr uint8_t kNoCharIndex = 0xFF;
+static_assert(kMaxAugmentedChars < kNoCharIndex, "char indexes must fit in a byte");
 
-  bool empty() const { return bytes.empty(); }
-  size_t charCount() const { return charByteOffsets.size(); }
+struct AugmentedWord {
+  uint8_t bytes[kMaxAugmentedBytes];
+  // Codepoint index starting at each byte, kNoCharIndex for UTF-8 continuation bytes.
+  uint8_t byteToCharIndex[kMaxAugmentedBytes];
+  uint16_t charByteOffsets[kMaxAugmentedChars];
+  size_t byteCount = 0;
+  size_t charCount = 0;
 };
 
-// Encode a single Unicode codepoint into UTF-8 and append to the provided buffer.
-size_t encodeUtf8(uint32_t cp, std::vector<uint8_t>& out) {
-  if (cp <= 0x7Fu) {
-    out.push_back(static_cast<uint8_t>(cp));
-    return 1;
-  }
-  if (cp <= 0x7FFu) {
-    out.push_back(static_cast<uint8_t>(0xC0u | ((cp >> 6) & 0x1Fu)));
-    out.push_back(static_cast<uint8_t>(0x80u | (cp & 0x3Fu)));
-    return 2;
+// Encode a single Unicode codepoint into UTF-8 and append it, keeping room for the trailing '.'.
+bool appendUtf8(uint32_t cp, AugmentedWord& word) {
+  const size_t len = cp <= 0x7Fu ? 1 : cp <= 0x7FFu ? 2 : cp <= 0xFFFFu ? 3 : 4;
+  if (word.byteCount + len + 1 > kMaxAugmentedBytes) {
+    return false;
   }
-  if (cp <= 0xFFFFu) {
-    out.push_back(static_cast<uint8_t>(0xE0u | ((cp >> 12) & 0x0Fu)));
-    out.push_back(static_cast<uint8_t>(0x80u | ((cp >> 6) & 0x3Fu)));
-    out.push_back(static_cast<uint8_t>(0x80u | (cp & 0x3Fu)));
-    return 3;
+
+  uint8_t* out = word.bytes + word.byteCount;
+  if (len == 1) {
+    out[0] = static_cast<uint8_t>(cp);
+  } else if (len == 2) {
+    out[0] = static_cast<uint8_t>(0xC0u | ((cp >> 6) & 0x1Fu));
+    out[1] = static_cast<uint8_t>(0x80u | (cp & 0x3Fu));
+  } else if (len == 3) {
+    out[0] = static_cast<uint8_t>(0xE0u | ((cp >> 12) & 0x0Fu));
+    out[1] = static_cast<uint8_t>(0x80u | ((cp >> 6) & 0x3Fu));
+    out[2] = static_cast<uint8_t>(0x80u | (cp & 0x3Fu));
+  } else {
+    out[0] = static_cast<uint8_t>(0xF0u | ((cp >> 18) & 0x07u));
+    out[1] = static_cast<uint8_t>(0x80u | ((cp >> 12) & 0x3Fu));
+    out[2] = static_cast<uint8_t>(0x80u | ((cp >> 6) & 0x3Fu));
+    out[3] = static_cast<uint8_t>(0x80u | (cp & 0x3Fu));
   }
-  out.push_back(static_cast<uint8_t>(0xF0u | ((cp >> 18) & 0x07u)));
-  out.push_back(static_cast<uint8_t>(0x80u | ((cp >> 12) & 0x3Fu)));
-  out.push_back(static_cast<uint8_t>(0x80u | ((cp >> 6) & 0x3Fu)));
-  out.push_back(static_cast<uint8_t>(0x80u | (cp & 0x3Fu)));
-  return 4;
+  word.byteCount += len;
+  return true;
 }
 
 // Build the dotted, lowercase UTF-8 representation plus lookup tables.
-AugmentedWord buildAugmentedWord(const std::vector<CodepointInfo>& cps, const LiangWordConfig& config) {
-  AugmentedWord word;
-  if (cps.empty()) {
-    return word;
+// Returns false for empty, overlong, or non-alphabetic words.
+bool buildAugmentedWord(const std::vector<CodepointInfo>& cps, const LiangWordConfig& config, AugmentedWord& word) {
+  if (cps.empty() || cps.size() > LIANG_MAX_WORD_CODEPOINTS) {
+    return false;
   }
 
-  word.bytes.reserve(cps.size() * 2 + 2);
-  word.charByteOffsets.reserve(cps.size() + 2);
-
-  word.charByteOffsets.push_back(0);
-  word.bytes.push_back('.');
+  word.charByteOffsets[word.charCount++] = 0;
+  word.bytes[word.byteCount++] = '.';
 
   for (const auto& info : cps) {
     if (!config.isLetter(info.value)) {
-      word.bytes.clear();
-      word.charByteOffsets.clear();
-      word.byteToCharIndex.clear();
-      return word;
+      return false;
+    }
+    word.charByteOffsets[word.charCount++] = static_cast<uint16_t>(word.byteCount);
+    if (!appendUtf8(config.toLower(info.value), word)) {
+      return false;
     }
-    word.charByteOffsets.push_back(word.bytes.size());
-    encodeUtf8(config.toLower(info.value), word.bytes);
   }
 
-  word.charByteOffsets.push_back(word.bytes.size());
-  word.bytes.push_back('.');
+  word.charByteOffsets[word.charCount++] = static_cast<uint16_t>(word.byteCount);
+  word.bytes[word.byteCount++] = '.';
 
-  word.byteToCharIndex.assign(word.bytes.size(), -1);
-  for (size_t i = 0; i < word.charByteOffsets.size(); ++i) {
-    const size_t offset = word.charByteOffsets[i];
-    if (offset < word.byteToCharIndex.size()) {
-      word.byteToCharIndex[offset] = static_cast<int32_t>(i);
-    }
+  std::fill_n(word.byteToCharIndex, word.byteCount, kNoCharIndex);
+  for (size_t i = 0; i < word.charCount; ++i) {
+    word.byteToCharIndex[word.charByteOffsets[i]] = static_cast<uint8_t>(i);
   }
-  return word;
+  return true;
 }
 
 // Decoded view of a single trie node pulled straight out of the serialized blob.
@@ -227,6 +231,20 @@ int32_t decodeDelta(const uint8_t* buf, uint8_t stride) {
   return unsignedVal - (1 << 23);
 }
 
+// Decode the node behind the `idx`-th child slot of `state`.
+bool followChild(const EmbeddedAutomaton& automaton, const AutomatonState& state, size_t idx, AutomatonState& out) {
+  const uint8_t* deltaPtr = state.targets + idx * state.stride;
+  const int32_t delta = decodeDelta(deltaPtr, state.stride);
+  // Deltas are relative to the current node's address, allowing us to keep all
+  // targets within 24 bits while still referencing further nodes in the blob.
+  const int64_t nextAddr = static_cast<int64_t>(state.addr) + delta;
+  if (nextAddr < 0 || static_cast<size_t>(nextAddr) >= automaton.size) {
+    return false;
+  }
+  out = decodeState(automaton, static_cast<size_t>(nextAddr));
+  return out.valid();
+}
+
 // Follow a single byte transition from `state`, decoding the child node on success.
 bool transition(const EmbeddedAutomaton& automaton, const AutomatonState& state, uint8_t letter, AutomatonState& out) {
   if (!state.valid()) {
@@ -236,30 +254,18 @@ bool transition(const EmbeddedAutomaton& automaton, const AutomatonState& state,
   // Children remain sorted by letter in the serialized blob, but the lists are
   // short enough that a linear scan keeps code size down compared to binary search.
   for (size_t idx = 0; idx < state.childCount; ++idx) {
-    if (state.transitions[idx] != letter) {
-      continue;
+    if (state.transitions[idx] == letter) {
+      return followChild(automaton, state, idx, out);
     }
-    const uint8_t* deltaPtr = state.targets + idx * state.stride;
-    const int32_t delta = decodeDelta(deltaPtr, state.stride);
-    // Deltas are relative to the current node's address, allowing us to keep all
-    // targets within 24 bits while still referencing further nodes in the blob.
-    const int64_t nextAddr = static_cast<int64_t>(state.addr) + delta;
-    if (nextAddr < 0 || static_cast<size_t>(nextAddr) >= automaton.size) {
-      return false;
-    }
-    out = decodeState(automaton, static_cast<size_t>(nextAddr));
-    return out.valid();
   }
   return false;
 }
 
-// Converts odd score positions back into codepoint indexes, honoring min prefix/suffix constraints.
-// Each break corresponds to scores[breakIndex + 1] because of the leading '.' sentinel.
 // Convert odd score entries into hyphen positions while honoring prefix/suffix limits.
-std::vector<size_t> collectBreakIndexes(const std::vector<CodepointInfo>& cps, const std::vector<uint8_t>& scores,
+// Each break corresponds to scores[breakIndex + 1] because of the leading '.' sentinel.
+std::vector<size_t> collectBreakIndexes(const size_t cpCount, const uint8_t* scores, const size_t scoreCount,
                                         const size_t minPrefix, const size_t minSuffix) {
   std::vector<size_t> indexes;
-  const size_t cpCount = cps.size();
   if (cpCount < 2) {
     return indexes;
   }
@@ -275,7 +281,7 @@ std::vector<size_t> collectBreakIndexes(const std::vector<CodepointInfo>& cps, c
     }
 
     const size_t scoreIdx = breakIndex + 1;
-    if (scoreIdx >= scores.size()) {
+    if (scoreIdx >= scoreCount) {
       break;
     }
     if ((scores[scoreIdx] & 1u) == 0) {
@@ -289,11 +295,25 @@ std::vector<size_t> collectBreakIndexes(const std::vector<CodepointInfo>& cps, c
 
 }  // namespace
 
+bool buildLiangRootTable(const SerializedHyphenationPatterns& patterns, LiangRootTable& table) {
+  std::fill_n(table.childIndex, LiangRootTable::kByteValues, LiangRootTable::kNoChild);
+  const AutomatonState root = decodeState(patterns, patterns.rootOffset);
+  if (!root.valid() || root.childCount >= LiangRootTable::kNoChild) {
+    return false;
+  }
+  // First match wins, exactly like the linear scan in transition()
+  for (size_t idx = root.childCount; idx-- > 0;) {
+    table.childIndex[root.transitions[idx]] = static_cast<uint8_t>(idx);
+  }
+  return true;
+}
+
 // Entry point that runs the full Liang pipeline for a single word.
 std::vector<size_t> liangBreakIndexes(const std::vector<CodepointInfo>& cps,
-                                      const SerializedHyphenationPatterns& patterns, const LiangWordConfig& config) {
-  const auto augmented = buildAugmentedWord(cps, config);
-  if (augmented.empty()) {
+                                      const SerializedHyphenationPatterns& patterns, const LiangWordConfig& config,
+                                      const LiangRootTable* rootTable) {
+  AugmentedWord augmented;
+  if (!buildAugmentedWord(cps, config, augmented)) {
     return {};
   }
 
@@ -305,20 +325,27 @@ std::vector<size_t> liangBreakIndexes(const std::vector<CodepointInfo>& cps,
   }
 
   // Liang scores: one entry per augmented char (leading/trailing dots included).
-  std::vector<uint8_t> scores(augmented.charCount(), 0);
+  // Bounds are copied into locals: stores through uint8_t may alias anything, which would otherwise force the
+  // compiler to reload them on every score update.
+  const size_t byteCount = augmented.byteCount;
+  const size_t charCount = augmented.charCount;
+  uint8_t scores[kMaxAugmentedChars];
+  std::fill_n(scores, charCount, 0);
 
   // Walk every starting character position and stream bytes through the trie.
-  for (size_t charStart = 0; charStart < augmented.charByteOffsets.size(); ++charStart) {
+  for (size_t charStart = 0; charStart < charCount; ++charStart) {
     const size_t byteStart = augmented.charByteOffsets[charStart];
-    AutomatonState state = root;
-
-    for (size_t cursor = byteStart; cursor < augmented.bytes.size(); ++cursor) {
-      AutomatonState next;
-      if (!transition(automaton, state, augmented.bytes[cursor], next)) {
-        break;  // No more matches for this prefix.
+    AutomatonState state;
+    if (rootTable) {
+      const uint8_t idx = rootTable->childIndex[augmented.bytes[byteStart]];
+      if (idx == LiangRootTable::kNoChild || !followChild(automaton, root, idx, state)) {
+        continue;
       }
-      state = next;
+    } else if (!transition(automaton, root, augmented.bytes[byteStart], state)) {
+      continue;
+    }
 
+    for (size_t cursor = byteStart;;) {
       if (state.levels && state.levelsLen > 0) {
         size_t offset = 0;
         // Each packed byte stores the byte-distance delta and the Liang level digit.
@@ -329,27 +356,32 @@ std::vector<size_t> liangBreakIndexes(const std::vector<CodepointInfo>& cps,
 
           offset += dist;
           const size_t splitByte = byteStart + offset;
-          if (splitByte >= augmented.byteToCharIndex.size()) {
+          if (splitByte >= byteCount) {
             continue;
           }
 
-          const int32_t boundary = augmented.byteToCharIndex[splitByte];
-          if (boundary < 0) {
+          const uint8_t boundary = augmented.byteToCharIndex[splitByte];
+          if (boundary == kNoCharIndex) {
             continue;  // Mid-codepoint byte, wait for the next one.
           }
-          if (boundary < 2 || boundary + 2 > static_cast<int32_t>(augmented.charCount())) {
+          if (boundary < 2 || boundary + 2u > charCount) {
             continue;  // Skip splits that land in the leading/trailing sentinels.
           }
 
-          const size_t idx = static_cast<size_t>(boundary);
-          if (idx >= scores.size()) {
-            continue;
-          }
-          scores[idx] = std::max(scores[idx], level);
+          scores[boundary] = std::max(scores[boundary], level);
         }
       }
+
+      if (++cursor >= byteCount) {
+        break;
+      }
+      AutomatonState next;
+      if (!transition(automaton, state, augmented.bytes[cursor], next)) {
+        break;  // No more matches for this prefix.
+      }
+      state = next;
     }
   }
 
-  return collectBreakIndexes(cps, scores, config.minPrefix, config.minSuffix);
+  return collectBreakIndexes(cps.size(), scores, charCount, config.minPrefix, config.minSuffix);
 }
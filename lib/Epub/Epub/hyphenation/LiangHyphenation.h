@@ -33,6 +33,23 @@ struct LiangWordConfig {
       : isLetter(letterFn), toLower(lowerFn), minPrefix(prefix), minSuffix(suffix) {}
 };
 
-// Shared Liang pattern evaluator used by every language-specific hyphenator.
+// Longest word the evaluator will hyphenate. Matches MAX_WORD_SIZE in ChapterHtmlSlimParser, which counts bytes,
+// so parsed words never exceed it; the working buffers are sized from this and live on the stack.
+constexpr size_t LIANG_MAX_WORD_CODEPOINTS = 200;
+
+// First-byte lookup for a pattern trie. Every walk starts at the root, which is by far the widest node, so mapping
+// each byte directly to its child slot replaces the longest transition scan of every walk with a single load.
+struct LiangRootTable {
+  static constexpr size_t kByteValues = 256;
+  static constexpr uint8_t kNoChild = 0xFF;
+  uint8_t childIndex[kByteValues];
+};
+
+// Fill `table` from the root node of `patterns`. Returns false if the trie cannot be indexed this way.
+bool buildLiangRootTable(const SerializedHyphenationPatterns& patterns, LiangRootTable& table);
+
+// Shared Liang pattern evaluator used by every language-specific hyphenator. `rootTable` is optional; results are
+// identical with or without it.
 std::vector<size_t> liangBreakIndexes(const std::vector<CodepointInfo>& cps,
-                                      const SerializedHyphenationPatterns& patterns, const LiangWordConfig& config);
+                                      const SerializedHyphenationPatterns& patterns, const LiangWordConfig& config,
+                                      const LiangRootTable* rootTable = nullptr);
@@ -10,52 +10,110 @@
 #include "../Page.h"
 #include "../converters/ImageDecoderFactory.h"
 #include "../converters/ImageToFramebufferDecoder.h"
+#include "../converters/ZipImageSource.h"
 #include "../htmlEntities.h"
-
-const char* HEADER_TAGS[] = {"h1", "h2", "h3", "h4", "h5", "h6"};
-constexpr int NUM_HEADER_TAGS = sizeof(HEADER_TAGS) / sizeof(HEADER_TAGS[0]);
+#include "../hyphenation/Hyphenator.h"
+#include "HtmlTagClassifier.h"
 
 // Minimum file size (in bytes) to show indexing popup - smaller chapters don't benefit from it
 constexpr size_t MIN_SIZE_FOR_POPUP = 10 * 1024;  // 10KB
 constexpr size_t PARSE_BUFFER_SIZE = 1024;
 
-const char* BLOCK_TAGS[] = {"p", "li", "div", "br", "blockquote"};
-constexpr int NUM_BLOCK_TAGS = sizeof(BLOCK_TAGS) / sizeof(BLOCK_TAGS[0]);
-
-const char* BOLD_TAGS[] = {"b", "strong"};
-constexpr int NUM_BOLD_TAGS = sizeof(BOLD_TAGS) / sizeof(BOLD_TAGS[0]);
-
-const char* ITALIC_TAGS[] = {"i", "em"};
-constexpr int NUM_ITALIC_TAGS = sizeof(ITALIC_TAGS) / sizeof(ITALIC_TAGS[0]);
-
-const char* UNDERLINE_TAGS[] = {"u", "ins"};
-constexpr int NUM_UNDERLINE_TAGS = sizeof(UNDERLINE_TAGS) / sizeof(UNDERLINE_TAGS[0]);
-
-const char* IMAGE_TAGS[] = {"img"};
-constexpr int NUM_IMAGE_TAGS = sizeof(IMAGE_TAGS) / sizeof(IMAGE_TAGS[0]);
-
-const char* SKIP_TAGS[] = {"head"};
-constexpr int NUM_SKIP_TAGS = sizeof(SKIP_TAGS) / sizeof(SKIP_TAGS[0]);
+namespace {
+// Expat only knows malloc/realloc/free, so each block records its payload size in front of it for the arena.
+constexpr size_t EXPAT_BLOCK_HEADER_SIZE = 8;
+static_assert(EXPAT_BLOCK_HEADER_SIZE >= sizeof(size_t), "Expat block header too small");
 
-bool isWhitespace(const char c) { return c == ' ' || c == '\r' || c == '\n' || c == '\t'; }
+void* expatMalloc(const size_t size) {
+  auto* block = static_cast<uint8_t*>(arena::tryAllocate(size + EXPAT_BLOCK_HEADER_SIZE));
+  if (!block) {
+    return nullptr;
+  }
+  *reinterpret_cast<size_t*>(block) = size;
+  return block + EXPAT_BLOCK_HEADER_SIZE;
+}
 
-// given the start and end of a tag, check to see if it matches a known tag
-bool matches(const char* tag_name, const char* possible_tags[], const int possible_tag_count) {
-  for (int i = 0; i < possible_tag_count; i++) {
-    if (strcmp(tag_name, possible_tags[i]) == 0) {
-      return true;
-    }
+void expatFree(void* ptr) {
+  if (!ptr) {
+    return;
   }
-  return false;
+  auto* block = static_cast<uint8_t*>(ptr) - EXPAT_BLOCK_HEADER_SIZE;
+  arena::deallocate(block, *reinterpret_cast<size_t*>(block) + EXPAT_BLOCK_HEADER_SIZE);
 }
 
-bool isHeaderOrBlock(const char* name) {
-  return matches(name, HEADER_TAGS, NUM_HEADER_TAGS) || matches(name, BLOCK_TAGS, NUM_BLOCK_TAGS);
+void* expatRealloc(void* ptr, const size_t size) {
+  if (!ptr) {
+    return expatMalloc(size);
+  }
+  const size_t oldSize = *reinterpret_cast<size_t*>(static_cast<uint8_t*>(ptr) - EXPAT_BLOCK_HEADER_SIZE);
+  void* resized = expatMalloc(size);
+  if (!resized) {
+    return nullptr;
+  }
+  memcpy(resized, ptr, std::min(oldSize, size));
+  expatFree(ptr);
+  return resized;
 }
 
-bool isTableStructuralTag(const char* name) {
-  return strcmp(name, "table") == 0 || strcmp(name, "tr") == 0 || strcmp(name, "td") == 0 || strcmp(name, "th") == 0;
+const XML_Memory_Handling_Suite EXPAT_ARENA_MEMORY_SUITE = {expatMalloc, expatRealloc, expatFree};
+
+// Attributes the parser cares about, gathered in a single pass over expat's attribute array.
+// Pointers reference expat's buffers and are only valid for the duration of the callback.
+struct ElementAttributes {
+  const char* classAttr = nullptr;
+  const char* style = nullptr;
+  const char* src = nullptr;
+  const char* alt = nullptr;
+  const char* lang = nullptr;
+  const char* xmlLang = nullptr;  // Takes precedence over lang
+  bool isPageBreak = false;
+};
+
+ElementAttributes scanAttributes(const XML_Char** atts) {
+  ElementAttributes attrs;
+  if (atts == nullptr) {
+    return attrs;
+  }
+  for (int i = 0; atts[i]; i += 2) {
+    const char* attrName = atts[i];
+    const char* value = atts[i + 1];
+    switch (attrName[0]) {
+      case 'a':
+        if (strcmp(attrName, "alt") == 0) attrs.alt = value;
+        break;
+      case 'c':
+        if (strcmp(attrName, "class") == 0) attrs.classAttr = value;
+        break;
+      case 's':
+        if (strcmp(attrName, "style") == 0) {
+          attrs.style = value;
+        } else if (strcmp(attrName, "src") == 0) {
+          attrs.src = value;
+        }
+        break;
+      case 'l':
+        if (strcmp(attrName, "lang") == 0) attrs.lang = value;
+        break;
+      case 'x':
+        if (strcmp(attrName, "xml:lang") == 0) attrs.xmlLang = value;
+        break;
+      case 'r':
+        // Skip blocks with role="doc-pagebreak"
+        if (strcmp(attrName, "role") == 0 && strcmp(value, "doc-pagebreak") == 0) attrs.isPageBreak = true;
+        break;
+      case 'e':
+        // Skip blocks with epub:type="pagebreak"
+        if (strcmp(attrName, "epub:type") == 0 && strcmp(value, "pagebreak") == 0) attrs.isPageBreak = true;
+        break;
+      default:
+        break;
+    }
+  }
+  return attrs;
 }
+}  // namespace
+
+bool isWhitespace(const char c) { return c == ' ' || c == '\r' || c == '\n' || c == '\t'; }
 
 // Update effective bold/italic/underline based on block style and inline style stack
 void ChapterHtmlSlimParser::updateEffectiveInlineStyle() {
@@ -115,12 +173,14 @@ void ChapterHtmlSlimParser::startNewTextBlock(const BlockStyle& blockStyle) {
       // This handles cases like <div style="margin-bottom:2em"><h1>text</h1></div> where the
       // div's margin should be preserved, even though it has no direct text content.
       currentTextBlock->setBlockStyle(currentTextBlock->getBlockStyle().getCombinedBlockStyle(blockStyle));
+      currentTextBlock->setHyphenationLanguage(currentLanguage());
       return;
     }
 
     makePages();
   }
   currentTextBlock.reset(new ParsedText(extraParagraphSpacing, hyphenationEnabled, blockStyle));
+  currentTextBlock->setHyphenationLanguage(currentLanguage());
 }
 
 void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char* name, const XML_Char** atts) {
@@ -132,17 +192,18 @@ void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char*
     return;
   }
 
-  // Extract class and style attributes for CSS processing
-  std::string classAttr;
-  std::string styleAttr;
-  if (atts != nullptr) {
-    for (int i = 0; atts[i]; i += 2) {
-      if (strcmp(atts[i], "class") == 0) {
-        classAttr = atts[i + 1];
-      } else if (strcmp(atts[i], "style") == 0) {
-        styleAttr = atts[i + 1];
-      }
-    }
+  // Classify the tag and extract the attributes we care about exactly once per element
+  const uint16_t tagCategories = classifyHtmlTag(name);
+  const ElementAttributes attrs = scanAttributes(atts);
+
+  // Record the element path for descendant/child/attribute selectors
+  const bool hasAncestry = self->cssParser && self->cssParser->hasContextualRules() &&
+                           self->cssAncestry.push(self->depth, name, attrs.classAttr, atts);
+
+  // Text blocks started inside this element hyphenate with its declared language
+  const char* lang = attrs.xmlLang ? attrs.xmlLang : attrs.lang;
+  if (lang && self->hyphenationEnabled) {
+    self->languageStack.push_back({self->depth, Hyphenator::languageIdForTag(lang)});
   }
 
   auto centeredBlockStyle = BlockStyle();
@@ -150,7 +211,7 @@ void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char*
   centeredBlockStyle.alignment = CssTextAlign::Center;
 
   // Special handling for tables/cells: flatten into per-cell paragraphs with a prefixed header.
-  if (strcmp(name, "table") == 0) {
+  if (tagCategories & HTML_TAG_TABLE) {
     // skip nested tables
     if (self->tableDepth > 0) {
       self->tableDepth += 1;
@@ -167,14 +228,14 @@ void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char*
     return;
   }
 
-  if (self->tableDepth == 1 && strcmp(name, "tr") == 0) {
+  if (self->tableDepth == 1 && (tagCategories & HTML_TAG_TABLE_ROW)) {
     self->tableRowIndex += 1;
     self->tableColIndex = 0;
     self->depth += 1;
     return;
   }
 
-  if (self->tableDepth == 1 && (strcmp(name, "td") == 0 || strcmp(name, "th") == 0)) {
+  if (self->tableDepth == 1 && (tagCategories & HTML_TAG_TABLE_CELL)) {
     if (self->partWordBufferIndex > 0) {
       self->flushPartWordBuffer();
     }
@@ -212,18 +273,10 @@ void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char*
     return;
   }
 
-  if (matches(name, IMAGE_TAGS, NUM_IMAGE_TAGS)) {
-    std::string src;
-    std::string alt;
+  if (tagCategories & HTML_TAG_IMAGE) {
+    std::string src = attrs.src ? attrs.src : "";
+    std::string alt = attrs.alt ? attrs.alt : "";
     if (atts != nullptr) {
-      for (int i = 0; atts[i]; i += 2) {
-        if (strcmp(atts[i], "src") == 0) {
-          src = atts[i + 1];
-        } else if (strcmp(atts[i], "alt") == 0) {
-          alt = atts[i + 1];
-        }
-      }
-
       if (!src.empty()) {
         LOG_DBG("EHP", "Found image: src=%s", src.c_str());
 
@@ -232,86 +285,76 @@ void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char*
           std::string resolvedPath = FsHelpers::normalisePath(self->contentBase + src);
 
           if (ImageDecoderFactory::isFormatSupported(resolvedPath)) {
-            // Create a unique filename for the cached image
-            std::string ext;
-            size_t extPos = resolvedPath.rfind('.');
-            if (extPos != std::string::npos) {
-              ext = resolvedPath.substr(extPos);
-            }
-            std::string cachedImagePath = self->imageBasePath + std::to_string(self->imageCounter++) + ext;
-
-            // Extract image to cache file
-            FsFile cachedImageFile;
-            bool extractSuccess = false;
-            if (Storage.openFileForWrite("EHP", cachedImagePath, cachedImageFile)) {
-              extractSuccess = self->epub->readItemContentsToStream(resolvedPath, cachedImageFile, 4096);
-              cachedImageFile.flush();
-              cachedImageFile.close();
-              delay(50);  // Give SD card time to sync
-            }
-
-            if (extractSuccess) {
-              // Get image dimensions
-              ImageDimensions dims = {0, 0};
-              ImageToFramebufferDecoder* decoder = ImageDecoderFactory::getDecoder(cachedImagePath);
-              if (decoder && decoder->getDimensions(cachedImagePath, dims)) {
-                LOG_DBG("EHP", "Image dimensions: %dx%d", dims.width, dims.height);
-
-                // Scale to fit viewport while maintaining aspect ratio
-                int maxWidth = self->viewportWidth;
-                int maxHeight = self->viewportHeight;
-                float scaleX = (dims.width > maxWidth) ? (float)maxWidth / dims.width : 1.0f;
-                float scaleY = (dims.height > maxHeight) ? (float)maxHeight / dims.height : 1.0f;
-                float scale = (scaleX < scaleY) ? scaleX : scaleY;
-                if (scale > 1.0f) scale = 1.0f;
-
-                int displayWidth = (int)(dims.width * scale);
-                int displayHeight = (int)(dims.height * scale);
-
-                LOG_DBG("EHP", "Display size: %dx%d (scale %.2f)", displayWidth, displayHeight, scale);
-
-                // Create page for image - only break if image won't fit remaining space
-                if (self->currentPage && !self->currentPage->elements.empty() &&
-                    (self->currentPageNextY + displayHeight > self->viewportHeight)) {
-                  self->completePageFn(std::move(self->currentPage));
-                  self->currentPage.reset(new Page());
-                  if (!self->currentPage) {
-                    LOG_ERR("EHP", "Failed to create new page");
-                    return;
-                  }
-                  self->currentPageNextY = 0;
-                } else if (!self->currentPage) {
-                  self->currentPage.reset(new Page());
-                  if (!self->currentPage) {
-                    LOG_ERR("EHP", "Failed to create initial page");
-                    return;
-                  }
-                  self->currentPageNextY = 0;
-                }
-
-                // Create ImageBlock and add to page
-                auto imageBlock = std::make_shared<ImageBlock>(cachedImagePath, displayWidth, displayHeight);
-                if (!imageBlock) {
-                  LOG_ERR("EHP", "Failed to create ImageBlock");
+            // Each image gets a unique pixel cache file; the image itself stays in the EPUB and is decoded from there
+            const std::string cachePath = self->imageBasePath + std::to_string(self->imageCounter++) + ".pxc";
+
+            // Only the header is read here, straight from the EPUB
+            ImageDimensions dims = {0, 0};
+            bool dimsSuccess = false;
+            {
+              ZipImageSource imageSource(self->epub->getPath());
+              ImageToFramebufferDecoder* decoder = ImageDecoderFactory::getDecoder(resolvedPath);
+              dimsSuccess = decoder && imageSource.open(resolvedPath) && decoder->getDimensions(imageSource, dims);
+            }  // Frees the inflate buffers before parsing goes on
+
+            if (dimsSuccess) {
+              LOG_DBG("EHP", "Image dimensions: %dx%d", dims.width, dims.height);
+
+              // Scale to fit viewport while maintaining aspect ratio
+              int maxWidth = self->viewportWidth;
+              int maxHeight = self->viewportHeight;
+              float scaleX = (dims.width > maxWidth) ? (float)maxWidth / dims.width : 1.0f;
+              float scaleY = (dims.height > maxHeight) ? (float)maxHeight / dims.height : 1.0f;
+              float scale = (scaleX < scaleY) ? scaleX : scaleY;
+              if (scale > 1.0f) scale = 1.0f;
+
+              int displayWidth = (int)(dims.width * scale);
+              int displayHeight = (int)(dims.height * scale);
+
+              LOG_DBG("EHP", "Display size: %dx%d (scale %.2f)", displayWidth, displayHeight, scale);
+
+              // Create page for image - only break if image won't fit remaining space
+              if (self->currentPage && !self->currentPage->elements.empty() &&
+                  (self->currentPageNextY + displayHeight > self->viewportHeight)) {
+                self->completePageFn(std::move(self->currentPage));
+                self->currentPage.reset(new Page());
+                if (!self->currentPage) {
+                  LOG_ERR("EHP", "Failed to create new page");
                   return;
                 }
-                int xPos = (self->viewportWidth - displayWidth) / 2;
-                auto pageImage = std::make_shared<PageImage>(imageBlock, xPos, self->currentPageNextY);
-                if (!pageImage) {
-                  LOG_ERR("EHP", "Failed to create PageImage");
+                self->currentPageNextY = 0;
+              } else if (!self->currentPage) {
+                self->currentPage.reset(new Page());
+                if (!self->currentPage) {
+                  LOG_ERR("EHP", "Failed to create initial page");
                   return;
                 }
-                self->currentPage->elements.push_back(pageImage);
-                self->currentPageNextY += displayHeight;
+                self->currentPageNextY = 0;
+              }
 
-                self->depth += 1;
+              // Create ImageBlock and add to page
+              auto imageBlock = std::make_shared<ImageBlock>(self->epub->getPath(), resolvedPath, cachePath,
+                                                             displayWidth, displayHeight);
+              if (!imageBlock) {
+                LOG_ERR("EHP", "Failed to create ImageBlock");
                 return;
-              } else {
-                LOG_ERR("EHP", "Failed to get image dimensions");
-                Storage.remove(cachedImagePath.c_str());
               }
+              if (self->imagesToDecode) {
+                self->imagesToDecode->push_back(imageBlock);
+              }
+              int xPos = (self->viewportWidth - displayWidth) / 2;
+              auto pageImage = std::make_shared<PageImage>(imageBlock, xPos, self->currentPageNextY);
+              if (!pageImage) {
+                LOG_ERR("EHP", "Failed to create PageImage");
+                return;
+              }
+              self->currentPage->elements.push_back(pageImage);
+              self->currentPageNextY += displayHeight;
+
+              self->depth += 1;
+              return;
             } else {
-              LOG_ERR("EHP", "Failed to extract image");
+              LOG_ERR("EHP", "Failed to get image dimensions");
             }
           }  // isFormatSupported
         }
@@ -336,7 +379,7 @@ void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char*
     }
   }
 
-  if (matches(name, SKIP_TAGS, NUM_SKIP_TAGS)) {
+  if (tagCategories & HTML_TAG_SKIP) {
     // start skip
     self->skipUntilDepth = self->depth;
     self->depth += 1;
@@ -344,25 +387,21 @@ void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char*
   }
 
   // Skip blocks with role="doc-pagebreak" and epub:type="pagebreak"
-  if (atts != nullptr) {
-    for (int i = 0; atts[i]; i += 2) {
-      if (strcmp(atts[i], "role") == 0 && strcmp(atts[i + 1], "doc-pagebreak") == 0 ||
-          strcmp(atts[i], "epub:type") == 0 && strcmp(atts[i + 1], "pagebreak") == 0) {
-        self->skipUntilDepth = self->depth;
-        self->depth += 1;
-        return;
-      }
-    }
+  if (attrs.isPageBreak) {
+    self->skipUntilDepth = self->depth;
+    self->depth += 1;
+    return;
   }
 
   // Compute CSS style for this element
   CssStyle cssStyle;
   if (self->cssParser) {
     // Get combined tag + class styles
-    cssStyle = self->cssParser->resolveStyle(name, classAttr);
+    cssStyle = self->cssParser->resolveStyle(name, attrs.classAttr ? attrs.classAttr : "",
+                                             hasAncestry ? &self->cssAncestry : nullptr);
     // Merge inline style (highest priority)
-    if (!styleAttr.empty()) {
-      CssStyle inlineStyle = CssParser::parseInlineStyle(styleAttr);
+    if (attrs.style && attrs.style[0] != '\0') {
+      CssStyle inlineStyle = CssParser::parseInlineStyle(attrs.style);
       cssStyle.applyOver(inlineStyle);
     }
   }
@@ -371,7 +410,7 @@ void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char*
   const auto userAlignmentBlockStyle = BlockStyle::fromCssStyle(
       cssStyle, emSize, static_cast<CssTextAlign>(self->paragraphAlignment), self->viewportWidth);
 
-  if (matches(name, HEADER_TAGS, NUM_HEADER_TAGS)) {
+  if (tagCategories & HTML_TAG_HEADER) {
     self->currentCssStyle = cssStyle;
     auto headerBlockStyle = BlockStyle::fromCssStyle(cssStyle, emSize, CssTextAlign::Center, self->viewportWidth);
     headerBlockStyle.textAlignDefined = true;
@@ -381,8 +420,8 @@ void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char*
     self->startNewTextBlock(headerBlockStyle);
     self->boldUntilDepth = std::min(self->boldUntilDepth, self->depth);
     self->updateEffectiveInlineStyle();
-  } else if (matches(name, BLOCK_TAGS, NUM_BLOCK_TAGS)) {
-    if (strcmp(name, "br") == 0) {
+  } else if (tagCategories & HTML_TAG_BLOCK) {
+    if (tagCategories & HTML_TAG_LINE_BREAK) {
       if (self->partWordBufferIndex > 0) {
         // flush word preceding <br/> to currentTextBlock before calling startNewTextBlock
         self->flushPartWordBuffer();
@@ -393,11 +432,11 @@ void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char*
       self->startNewTextBlock(userAlignmentBlockStyle);
       self->updateEffectiveInlineStyle();
 
-      if (strcmp(name, "li") == 0) {
+      if (tagCategories & HTML_TAG_LIST_ITEM) {
         self->currentTextBlock->addWord("\xe2\x80\xa2", EpdFontFamily::REGULAR);
       }
     }
-  } else if (matches(name, UNDERLINE_TAGS, NUM_UNDERLINE_TAGS)) {
+  } else if (tagCategories & HTML_TAG_UNDERLINE) {
     // Flush buffer before style change so preceding text gets current style
     if (self->partWordBufferIndex > 0) {
       self->flushPartWordBuffer();
@@ -419,7 +458,7 @@ void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char*
     }
     self->inlineStyleStack.push_back(entry);
     self->updateEffectiveInlineStyle();
-  } else if (matches(name, BOLD_TAGS, NUM_BOLD_TAGS)) {
+  } else if (tagCategories & HTML_TAG_BOLD) {
     // Flush buffer before style change so preceding text gets current style
     if (self->partWordBufferIndex > 0) {
       self->flushPartWordBuffer();
@@ -441,7 +480,7 @@ void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char*
     }
     self->inlineStyleStack.push_back(entry);
     self->updateEffectiveInlineStyle();
-  } else if (matches(name, ITALIC_TAGS, NUM_ITALIC_TAGS)) {
+  } else if (tagCategories & HTML_TAG_ITALIC) {
     // Flush buffer before style change so preceding text gets current style
     if (self->partWordBufferIndex > 0) {
       self->flushPartWordBuffer();
@@ -463,7 +502,7 @@ void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char*
     }
     self->inlineStyleStack.push_back(entry);
     self->updateEffectiveInlineStyle();
-  } else if (strcmp(name, "span") == 0 || !isHeaderOrBlock(name)) {
+  } else {
     // Handle span and other inline elements for CSS styling
     if (cssStyle.hasFontWeight() || cssStyle.hasFontStyle() || cssStyle.hasTextDecoration()) {
       // Flush buffer before style change so preceding text gets current style
@@ -604,10 +643,12 @@ void XMLCALL ChapterHtmlSlimParser::endElement(void* userData, const XML_Char* n
   const bool willClearUnderline = self->underlineUntilDepth == self->depth - 1;
 
   const bool styleWillChange = willPopStyleStack || willClearBold || willClearItalic || willClearUnderline;
-  const bool headerOrBlockTag = isHeaderOrBlock(name);
-  const bool tableStructuralTag = isTableStructuralTag(name);
+  const uint16_t tagCategories = classifyHtmlTag(name);
+  const bool headerOrBlockTag = tagCategories & (HTML_TAG_HEADER | HTML_TAG_BLOCK);
+  const bool tableStructuralTag = tagCategories & (HTML_TAG_TABLE | HTML_TAG_TABLE_ROW | HTML_TAG_TABLE_CELL);
+  const bool imageTag = tagCategories & HTML_TAG_IMAGE;
 
-  if (self->tableDepth > 1 && strcmp(name, "table") == 0) {
+  if (self->tableDepth > 1 && (tagCategories & HTML_TAG_TABLE)) {
     // get rid of all text inside the nested table
     self->partWordBufferIndex = 0;
     self->tableDepth -= 1;
@@ -618,12 +659,10 @@ void XMLCALL ChapterHtmlSlimParser::endElement(void* userData, const XML_Char* n
   // Flush buffer with current style BEFORE any style changes
   if (self->partWordBufferIndex > 0) {
     // Flush if style will change OR if we're closing a block/structural element
-    const bool isInlineTag =
-        !headerOrBlockTag && !tableStructuralTag && !matches(name, IMAGE_TAGS, NUM_IMAGE_TAGS) && self->depth != 1;
-    const bool shouldFlush = styleWillChange || headerOrBlockTag || matches(name, BOLD_TAGS, NUM_BOLD_TAGS) ||
-                             matches(name, ITALIC_TAGS, NUM_ITALIC_TAGS) ||
-                             matches(name, UNDERLINE_TAGS, NUM_UNDERLINE_TAGS) || tableStructuralTag ||
-                             matches(name, IMAGE_TAGS, NUM_IMAGE_TAGS) || self->depth == 1;
+    const bool isInlineTag = !headerOrBlockTag && !tableStructuralTag && !imageTag && self->depth != 1;
+    const bool shouldFlush = styleWillChange || headerOrBlockTag ||
+                             (tagCategories & (HTML_TAG_BOLD | HTML_TAG_ITALIC | HTML_TAG_UNDERLINE)) ||
+                             tableStructuralTag || imageTag || self->depth == 1;
 
     if (shouldFlush) {
       self->flushPartWordBuffer();
@@ -636,20 +675,22 @@ void XMLCALL ChapterHtmlSlimParser::endElement(void* userData, const XML_Char* n
 
   self->depth -= 1;
 
+  // Leaving elements that declared a language. Nested tables never close at their own depth, so drop every entry
+  // at or below the current depth rather than just an exact match.
+  while (!self->languageStack.empty() && self->languageStack.back().depth >= self->depth) {
+    self->languageStack.pop_back();
+  }
+
   // Leaving skip
   if (self->skipUntilDepth == self->depth) {
     self->skipUntilDepth = INT_MAX;
   }
 
-  if (self->tableDepth == 1 && (strcmp(name, "td") == 0 || strcmp(name, "th") == 0)) {
-    self->nextWordContinues = false;
-  }
-
-  if (self->tableDepth == 1 && (strcmp(name, "tr") == 0)) {
+  if (self->tableDepth == 1 && (tagCategories & (HTML_TAG_TABLE_CELL | HTML_TAG_TABLE_ROW))) {
     self->nextWordContinues = false;
   }
 
-  if (self->tableDepth == 1 && strcmp(name, "table") == 0) {
+  if (self->tableDepth == 1 && (tagCategories & HTML_TAG_TABLE)) {
     self->tableDepth -= 1;
     self->tableRowIndex = 0;
     self->tableColIndex = 0;
@@ -695,7 +736,8 @@ bool ChapterHtmlSlimParser::parseAndBuildPages() {
   paragraphAlignmentBlockStyle.alignment = align;
   startNewTextBlock(paragraphAlignmentBlockStyle);
 
-  const XML_Parser parser = XML_ParserCreate(nullptr);
+  // Route expat's own allocations through the indexing arena when the caller set one up
+  const XML_Parser parser = XML_ParserCreate_MM(nullptr, &EXPAT_ARENA_MEMORY_SUITE, nullptr);
   int done;
 
   if (!parser) {
@@ -791,7 +833,8 @@ void ChapterHtmlSlimParser::addLineToPage(std::shared_ptr<TextBlock> line) {
 
   // Apply horizontal left inset (margin + padding) as x position offset
   const int16_t xOffset = line->getBlockStyle().leftInset();
-  currentPage->elements.push_back(std::make_shared<PageLine>(line, xOffset, currentPageNextY));
+  currentPage->elements.push_back(
+      std::allocate_shared<PageLine>(ArenaAllocator<PageLine>(), line, xOffset, currentPageNextY));
   currentPageNextY += lineHeight;
 }
 
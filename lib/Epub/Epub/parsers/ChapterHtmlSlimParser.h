@@ -45,10 +45,13 @@ class ChapterHtmlSlimParser {
   uint16_t viewportHeight;
   bool hyphenationEnabled;
   const CssParser* cssParser;
+  CssAncestry cssAncestry;  // Open elements, tracked only when the stylesheet has contextual selectors
   bool embeddedStyle;
   std::string contentBase;
   std::string imageBasePath;
   int imageCounter = 0;
+  // Images placed on pages are collected here, when set, to be decoded into their pixel caches after parsing
+  std::vector<std::shared_ptr<ImageBlock>>* imagesToDecode;
 
   // Style tracking (replaces depth-based approach)
   struct StyleStackEntry {
@@ -58,6 +61,12 @@ class ChapterHtmlSlimParser {
     bool hasUnderline = false, underline = false;
   };
   std::vector<StyleStackEntry> inlineStyleStack;
+  // Hyphenation language declared by xml:lang/lang on open elements
+  struct LanguageStackEntry {
+    int depth = 0;
+    uint8_t languageId = 0;
+  };
+  std::vector<LanguageStackEntry> languageStack;
   CssStyle currentCssStyle;
   bool effectiveBold = false;
   bool effectiveItalic = false;
@@ -67,6 +76,7 @@ class ChapterHtmlSlimParser {
   int tableColIndex = 0;
 
   void updateEffectiveInlineStyle();
+  uint8_t currentLanguage() const { return languageStack.empty() ? 0 : languageStack.back().languageId; }
   void startNewTextBlock(const BlockStyle& blockStyle);
   void flushPartWordBuffer();
   void makePages();
@@ -84,7 +94,8 @@ class ChapterHtmlSlimParser {
                                  const std::function<void(std::unique_ptr<Page>)>& completePageFn,
                                  const bool embeddedStyle, const std::string& contentBase,
                                  const std::string& imageBasePath, const std::function<void()>& popupFn = nullptr,
-                                 const CssParser* cssParser = nullptr)
+                                 const CssParser* cssParser = nullptr,
+                                 std::vector<std::shared_ptr<ImageBlock>>* imagesToDecode = nullptr)
 
       : epub(epub),
         filepath(filepath),
@@ -101,7 +112,8 @@ class ChapterHtmlSlimParser {
         cssParser(cssParser),
         embeddedStyle(embeddedStyle),
         contentBase(contentBase),
-        imageBasePath(imageBasePath) {}
+        imageBasePath(imageBasePath),
+        imagesToDecode(imagesToDecode) {}
 
   ~ChapterHtmlSlimParser() = default;
   bool parseAndBuildPages();
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Categories an element can belong to. A tag may carry several bits (e.g. <br> is both a block and a line break),
+// so one lookup answers every "is this a ... tag" question the chapter parser asks.
+enum HtmlTagCategory : uint16_t {
+  HTML_TAG_NONE = 0,
+  HTML_TAG_HEADER = 1 << 0,
+  HTML_TAG_BLOCK = 1 << 1,
+  HTML_TAG_BOLD = 1 << 2,
+  HTML_TAG_ITALIC = 1 << 3,
+  HTML_TAG_UNDERLINE = 1 << 4,
+  HTML_TAG_IMAGE = 1 << 5,
+  HTML_TAG_SKIP = 1 << 6,
+  HTML_TAG_TABLE = 1 << 7,
+  HTML_TAG_TABLE_ROW = 1 << 8,
+  HTML_TAG_TABLE_CELL = 1 << 9,
+  HTML_TAG_LINE_BREAK = 1 << 10,
+  HTML_TAG_LIST_ITEM = 1 << 11,
+};
+
+namespace html_tags {
+
+struct TagEntry {
+  const char* name;
+  uint16_t categories;
+};
+
+constexpr TagEntry KNOWN_TAGS[] = {
+    {"h1", HTML_TAG_HEADER},
+    {"h2", HTML_TAG_HEADER},
+    {"h3", HTML_TAG_HEADER},
+    {"h4", HTML_TAG_HEADER},
+    {"h5", HTML_TAG_HEADER},
+    {"h6", HTML_TAG_HEADER},
+    {"p", HTML_TAG_BLOCK},
+    {"li", HTML_TAG_BLOCK | HTML_TAG_LIST_ITEM},
+    {"div", HTML_TAG_BLOCK},
+    {"br", HTML_TAG_BLOCK | HTML_TAG_LINE_BREAK},
+    {"blockquote", HTML_TAG_BLOCK},
+    {"b", HTML_TAG_BOLD},
+    {"strong", HTML_TAG_BOLD},
+    {"i", HTML_TAG_ITALIC},
+    {"em", HTML_TAG_ITALIC},
+    {"u", HTML_TAG_UNDERLINE},
+    {"ins", HTML_TAG_UNDERLINE},
+    {"img", HTML_TAG_IMAGE},
+    {"head", HTML_TAG_SKIP},
+    {"table", HTML_TAG_TABLE},
+    {"tr", HTML_TAG_TABLE_ROW},
+    {"td", HTML_TAG_TABLE_CELL},
+    {"th", HTML_TAG_TABLE_CELL},
+};
+constexpr size_t NUM_KNOWN_TAGS = sizeof(KNOWN_TAGS) / sizeof(KNOWN_TAGS[0]);
+constexpr size_t MAX_TAG_LENGTH = 10;  // "blockquote"
+
+// Perfect hash over (length, first char, last char). The multipliers were picked so every known tag lands in its
+// own slot; buildSlotTable() below verifies that at compile time, so adding a colliding tag fails the build.
+constexpr size_t SLOT_COUNT = 64;
+constexpr uint8_t EMPTY_SLOT = 0xFF;
+
+constexpr size_t constLength(const char* s) {
+  size_t len = 0;
+  while (s[len] != '\0') {
+    ++len;
+  }
+  return len;
+}
+
+constexpr size_t slotFor(const char* name, const size_t len) {
+  return (len * 3 + static_cast<uint8_t>(name[0]) * 46 + static_cast<uint8_t>(name[len - 1])) & (SLOT_COUNT - 1);
+}
+
+constexpr std::array<uint8_t, SLOT_COUNT> buildSlotTable() {
+  std::array<uint8_t, SLOT_COUNT> slots{};
+  for (auto& slot : slots) {
+    slot = EMPTY_SLOT;
+  }
+  for (size_t i = 0; i < NUM_KNOWN_TAGS; ++i) {
+    slots[slotFor(KNOWN_TAGS[i].name, constLength(KNOWN_TAGS[i].name))] = static_cast<uint8_t>(i);
+  }
+  return slots;
+}
+
+constexpr bool slotTableIsPerfect(const std::array<uint8_t, SLOT_COUNT>& slots) {
+  size_t used = 0;
+  for (const auto slot : slots) {
+    if (slot != EMPTY_SLOT) {
+      ++used;
+    }
+  }
+  return used == NUM_KNOWN_TAGS;
+}
+
+constexpr auto SLOT_TABLE = buildSlotTable();
+static_assert(slotTableIsPerfect(SLOT_TABLE), "HTML tag hash collision - adjust slotFor() multipliers");
+
+}  // namespace html_tags
+
+// Classifies an element name with one hash and at most one string compare.
+inline uint16_t classifyHtmlTag(const char* name) {
+  size_t len = 0;
+  while (name[len] != '\0') {
+    if (++len > html_tags::MAX_TAG_LENGTH) {
+      return HTML_TAG_NONE;
+    }
+  }
+  if (len == 0) {
+    return HTML_TAG_NONE;
+  }
+
+  const uint8_t index = html_tags::SLOT_TABLE[html_tags::slotFor(name, len)];
+  if (index == html_tags::EMPTY_SLOT || strcmp(name, html_tags::KNOWN_TAGS[index].name) != 0) {
+    return HTML_TAG_NONE;
+  }
+  return html_tags::KNOWN_TAGS[index].categories;
+}
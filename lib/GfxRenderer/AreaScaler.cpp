@@ -0,0 +1,97 @@
+#include "AreaScaler.h"
+
+#include <Logging.h>
+
+#include <cstdlib>
+#include <cstring>
+
+AreaScaler::~AreaScaler() {
+  free(rowSum);
+  free(accum);
+  free(outRow);
+}
+
+bool AreaScaler::begin(const int srcWidth, const int srcHeight, const int dstWidth, const int dstHeight) {
+  this->srcWidth = srcWidth;
+  this->srcHeight = srcHeight;
+  this->dstWidth = dstWidth;
+  this->dstHeight = dstHeight;
+  srcY = 0;
+  dstY = 0;
+  pointSample = false;
+  passthrough = srcWidth == dstWidth && srcHeight == dstHeight;
+  if (passthrough) {
+    return true;
+  }
+
+  if (srcWidth <= 0 || srcHeight <= 0 || dstWidth <= 0 || dstHeight <= 0) {
+    LOG_ERR("SCL", "Unsupported scale %dx%d -> %dx%d", srcWidth, srcHeight, dstWidth, dstHeight);
+    return false;
+  }
+
+  // An output pixel accumulates up to 255 * srcWidth * srcHeight; beyond 32 bits only point sampling is left
+  pointSample = static_cast<uint64_t>(srcWidth) * srcHeight * 255 > UINT32_MAX;
+  if (pointSample) {
+    LOG_DBG("SCL", "Source %dx%d too large to average, point sampling", srcWidth, srcHeight);
+    outRow = static_cast<uint8_t*>(malloc(dstWidth));
+    if (!outRow) {
+      LOG_ERR("SCL", "Failed to allocate scaler row (%d bytes)", dstWidth);
+      return false;
+    }
+    return true;
+  }
+
+  rowSum = static_cast<uint32_t*>(malloc(dstWidth * sizeof(uint32_t)));
+  accum = static_cast<uint32_t*>(calloc(dstWidth, sizeof(uint32_t)));
+  outRow = static_cast<uint8_t*>(malloc(dstWidth));
+  if (!rowSum || !accum || !outRow) {
+    LOG_ERR("SCL", "Failed to allocate scaler rows (%d bytes)", dstWidth * 9);
+    return false;
+  }
+  return true;
+}
+
+void AreaScaler::scaleRow(const uint8_t* src) {
+  memset(rowSum, 0, dstWidth * sizeof(uint32_t));
+
+  // Source pixel x spans [x * dstWidth, (x + 1) * dstWidth), output pixel o spans [o * srcWidth, (o + 1) * srcWidth)
+  int o = 0;
+  uint32_t outEnd = srcWidth;
+  uint32_t start = 0;
+  for (int x = 0; x < srcWidth; x++) {
+    const uint32_t value = src[x];
+    const uint32_t end = start + dstWidth;
+    while (end > outEnd) {
+      rowSum[o] += value * (outEnd - start);
+      start = outEnd;
+      o++;
+      outEnd += srcWidth;
+    }
+    rowSum[o] += value * (end - start);
+    start = end;
+    if (end == outEnd && o + 1 < dstWidth) {
+      o++;
+      outEnd += srcWidth;
+    }
+  }
+}
+
+void AreaScaler::sampleRow(const uint8_t* src) {
+  for (int o = 0; o < dstWidth; o++) {
+    outRow[o] = src[(2 * static_cast<uint64_t>(o) + 1) * srcWidth / (2 * static_cast<uint64_t>(dstWidth))];
+  }
+}
+
+void AreaScaler::accumulate(const uint32_t weight) {
+  for (int o = 0; o < dstWidth; o++) {
+    accum[o] += rowSum[o] * weight;
+  }
+}
+
+void AreaScaler::finishRow() {
+  const uint32_t area = static_cast<uint32_t>(srcWidth) * srcHeight;
+  for (int o = 0; o < dstWidth; o++) {
+    outRow[o] = static_cast<uint8_t>((accum[o] + area / 2) / area);
+  }
+  memset(accum, 0, dstWidth * sizeof(uint32_t));
+}
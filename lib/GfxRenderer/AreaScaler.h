@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Streaming box-filter (area-averaging) resampler for 8-bit grayscale rows.
+ *
+ * Source rows are pushed top to bottom and each output row is handed out as soon as the last source row it covers
+ * has arrived, so only one accumulator row is kept. Every output pixel is the exact area-weighted mean of the source
+ * pixels under it: a source pixel spans dstWidth units and an output pixel srcWidth units (likewise vertically), so
+ * the overlaps are integers and no weight is rounded. Works for downscaling and upscaling; equal sizes pass rows
+ * straight through. Sources too large for the 32-bit accumulators (above ~16.8M pixels) are point-sampled instead,
+ * taking the source pixel under the center of each output pixel.
+ */
+class AreaScaler {
+ public:
+  AreaScaler() = default;
+  ~AreaScaler();
+
+  AreaScaler(const AreaScaler&) = delete;
+  AreaScaler& operator=(const AreaScaler&) = delete;
+
+  // Allocates the accumulators (9 bytes per output column, 1 when point sampling). Fails on invalid sizes or
+  // allocation failure.
+  bool begin(int srcWidth, int srcHeight, int dstWidth, int dstHeight);
+
+  /**
+   * Adds the next source row of srcWidth gray values.
+   * @param emit void(int dstY, const uint8_t* row): receives each completed output row of dstWidth values. The row is
+   *             only valid during the call.
+   */
+  template <typename EmitFn>
+  void pushRow(const uint8_t* src, EmitFn&& emit) {
+    if (passthrough) {
+      if (srcY < dstHeight) emit(srcY, src);
+      srcY++;
+      return;
+    }
+    if (pointSample) {
+      while (dstY < dstHeight && sourceRowOf(dstY) == srcY) {
+        sampleRow(src);
+        emit(dstY, outRow);
+        dstY++;
+      }
+      srcY++;
+      return;
+    }
+
+    scaleRow(src);
+    uint32_t start = static_cast<uint32_t>(srcY) * dstHeight;
+    const uint32_t end = start + dstHeight;
+    srcY++;
+    while (start < end && dstY < dstHeight) {
+      const uint32_t rowEnd = static_cast<uint32_t>(dstY + 1) * srcHeight;
+      const uint32_t weight = (end < rowEnd ? end : rowEnd) - start;
+      accumulate(weight);
+      start += weight;
+      if (start == rowEnd) {
+        finishRow();
+        emit(dstY, outRow);
+        dstY++;
+      }
+    }
+  }
+
+ private:
+  void scaleRow(const uint8_t* src);
+  void accumulate(uint32_t weight);
+  void finishRow();
+  // Point sampling: the source row under the center of output row dstRow, and one output row picked from src
+  int sourceRowOf(int dstRow) const {
+    return static_cast<int>((2 * static_cast<uint64_t>(dstRow) + 1) * srcHeight /
+                            (2 * static_cast<uint64_t>(dstHeight)));
+  }
+  void sampleRow(const uint8_t* src);
+
+  int srcWidth = 0;
+  int srcHeight = 0;
+  int dstWidth = 0;
+  int dstHeight = 0;
+  int srcY = 0;
+  int dstY = 0;
+  bool passthrough = false;
+  bool pointSample = false;
+
+  uint32_t* rowSum = nullptr;  // Current source row, horizontally weighted per output column
+  uint32_t* accum = nullptr;   // Current output row, weighted by source row overlap
+  uint8_t* outRow = nullptr;
+};
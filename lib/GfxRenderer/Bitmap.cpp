@@ -2,6 +2,7 @@
 
 #include <cstdlib>
 #include <cstring>
+#include <new>
 
 // ============================================================================
 // IMAGE PROCESSING OPTIONS
@@ -14,8 +15,7 @@ constexpr bool USE_ATKINSON = true;  // Use Atkinson dithering instead of Floyd-
 // ============================================================================
 
 Bitmap::~Bitmap() {
-  delete[] errorCurRow;
-  delete[] errorNextRow;
+  free(grayRow);
 
   delete atkinsonDitherer;
   delete fsDitherer;
@@ -168,12 +168,25 @@ BmpReaderError Bitmap::parseHeaders() {
   const bool highColor = !nativePalette;
   if (highColor && dithering) {
     if (USE_ATKINSON) {
-      atkinsonDitherer = new AtkinsonDitherer(width);
+      atkinsonDitherer = new (std::nothrow) AtkinsonDitherer(width);
+      if (atkinsonDitherer && !atkinsonDitherer->ok()) {
+        delete atkinsonDitherer;
+        atkinsonDitherer = nullptr;
+      }
     } else {
-      fsDitherer = new FloydSteinbergDitherer(width);
+      fsDitherer = new (std::nothrow) FloydSteinbergDitherer(width);
+      if (fsDitherer && !fsDitherer->ok()) {
+        delete fsDitherer;
+        fsDitherer = nullptr;
+      }
     }
+    // Without a ditherer the rows are quantized without error diffusion
   }
 
+  free(grayRow);
+  grayRow = static_cast<uint8_t*>(malloc(width));
+  if (!grayRow) return BmpReaderError::OomRowBuffer;
+
   return BmpReaderError::Ok;
 }
 
@@ -184,46 +197,12 @@ BmpReaderError Bitmap::readNextRow(uint8_t* data, uint8_t* rowBuffer) const {
 
   prevRowY += 1;
 
-  uint8_t* outPtr = data;
-  uint8_t currentOutByte = 0;
-  int bitShift = 6;
-  int currentX = 0;
-
-  // Helper lambda to pack 2bpp color into the output stream
-  auto packPixel = [&](const uint8_t lum) {
-    uint8_t color;
-    if (atkinsonDitherer) {
-      color = atkinsonDitherer->processPixel(adjustPixel(lum), currentX);
-    } else if (fsDitherer) {
-      color = fsDitherer->processPixel(adjustPixel(lum), currentX);
-    } else {
-      if (nativePalette) {
-        // Palette matches native gray levels: direct mapping (still apply brightness/contrast/gamma)
-        color = static_cast<uint8_t>(adjustPixel(lum) >> 6);
-      } else {
-        // Non-native palette with dithering disabled: simple quantization
-        color = quantize(adjustPixel(lum), currentX, prevRowY);
-      }
-    }
-    currentOutByte |= (color << bitShift);
-    if (bitShift == 0) {
-      *outPtr++ = currentOutByte;
-      currentOutByte = 0;
-      bitShift = 6;
-    } else {
-      bitShift -= 2;
-    }
-    currentX++;
-  };
-
-  uint8_t lum;
-
+  // Luminance of the whole row first, then one row kernel quantizes or dithers it straight into packed 2bpp
   switch (bpp) {
     case 32: {
       const uint8_t* p = rowBuffer;
       for (int x = 0; x < width; x++) {
-        lum = (77u * p[2] + 150u * p[1] + 29u * p[0]) >> 8;
-        packPixel(lum);
+        grayRow[x] = (77u * p[2] + 150u * p[1] + 29u * p[0]) >> 8;
         p += 4;
       }
       break;
@@ -231,29 +210,27 @@ BmpReaderError Bitmap::readNextRow(uint8_t* data, uint8_t* rowBuffer) const {
     case 24: {
       const uint8_t* p = rowBuffer;
       for (int x = 0; x < width; x++) {
-        lum = (77u * p[2] + 150u * p[1] + 29u * p[0]) >> 8;
-        packPixel(lum);
+        grayRow[x] = (77u * p[2] + 150u * p[1] + 29u * p[0]) >> 8;
         p += 3;
       }
       break;
     }
     case 8: {
       for (int x = 0; x < width; x++) {
-        packPixel(paletteLum[rowBuffer[x]]);
+        grayRow[x] = paletteLum[rowBuffer[x]];
       }
       break;
     }
     case 4: {
       for (int x = 0; x < width; x++) {
         const uint8_t nibble = (x & 1) ? (rowBuffer[x >> 1] & 0x0F) : (rowBuffer[x >> 1] >> 4);
-        packPixel(paletteLum[nibble]);
+        grayRow[x] = paletteLum[nibble];
       }
       break;
     }
     case 2: {
       for (int x = 0; x < width; x++) {
-        lum = paletteLum[(rowBuffer[x >> 2] >> (6 - ((x & 3) * 2))) & 0x03];
-        packPixel(lum);
+        grayRow[x] = paletteLum[(rowBuffer[x >> 2] >> (6 - ((x & 3) * 2))) & 0x03];
       }
       break;
     }
@@ -262,8 +239,7 @@ BmpReaderError Bitmap::readNextRow(uint8_t* data, uint8_t* rowBuffer) const {
         // Get palette index (0 or 1) from bit at position x
         const uint8_t palIndex = (rowBuffer[x >> 3] & (0x80 >> (x & 7))) ? 1 : 0;
         // Use palette lookup for proper black/white mapping
-        lum = paletteLum[palIndex];
-        packPixel(lum);
+        grayRow[x] = paletteLum[palIndex];
       }
       break;
     }
@@ -271,13 +247,17 @@ BmpReaderError Bitmap::readNextRow(uint8_t* data, uint8_t* rowBuffer) const {
       return BmpReaderError::UnsupportedBpp;
   }
 
-  if (atkinsonDitherer)
-    atkinsonDitherer->nextRow();
-  else if (fsDitherer)
-    fsDitherer->nextRow();
-
-  // Flush remaining bits if width is not a multiple of 4
-  if (bitShift != 6) *outPtr = currentOutByte;
+  if (atkinsonDitherer) {
+    atkinsonDitherer->ditherRow(grayRow, data);
+  } else if (fsDitherer) {
+    fsDitherer->ditherRow(grayRow, data);
+  } else if (nativePalette) {
+    // Palette matches native gray levels: direct mapping (still apply brightness/contrast/gamma)
+    quantizeRowNative(grayRow, data, width);
+  } else {
+    // Non-native palette with dithering disabled: simple quantization
+    quantizeRow(grayRow, data, width, prevRowY);
+  }
 
   return BmpReaderError::Ok;
 }
@@ -61,9 +61,9 @@ class Bitmap {
   int rowBytes = 0;
   uint8_t paletteLum[256] = {};
 
+  uint8_t* grayRow = nullptr;  // Luminance of the row being read, quantized as a whole
+
   // Dithering state (mutable for const methods)
-  mutable int16_t* errorCurRow = nullptr;
-  mutable int16_t* errorNextRow = nullptr;
   mutable int prevRowY = -1;  // Track row progression for error propagation
 
   mutable AtkinsonDitherer* atkinsonDitherer = nullptr;
@@ -51,12 +51,14 @@ int adjustPixel(int gray) {
 }
 // Simple quantization without dithering - divide into 4 levels
 // The thresholds are fine-tuned to the X4 display
+constexpr int SIMPLE_THRESHOLDS[3] = {45, 70, 140};
+
 uint8_t quantizeSimple(int gray) {
-  if (gray < 45) {
+  if (gray < SIMPLE_THRESHOLDS[0]) {
     return 0;
-  } else if (gray < 70) {
+  } else if (gray < SIMPLE_THRESHOLDS[1]) {
     return 1;
-  } else if (gray < 140) {
+  } else if (gray < SIMPLE_THRESHOLDS[2]) {
     return 2;
   } else {
     return 3;
@@ -104,3 +106,239 @@ uint8_t quantize1bit(int gray, int x, int y) {
   const int adjustedThreshold = 128 + ((threshold - 128) / 2);  // Range: 64-192
   return (gray >= adjustedThreshold) ? 1 : 0;
 }
+
+// ============================================================================
+// Row kernels
+// ============================================================================
+// Four 8-bit pixels are loaded into one 32-bit word, first pixel in the lowest byte lane, and compared, clamped and
+// shifted lane-wise without carries crossing lanes. A single multiply then gathers the four 2-bit levels into one
+// output byte.
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "row kernels expect the first pixel in the lowest lane");
+
+namespace {
+
+constexpr uint32_t LANES_HIGH = 0x80808080u;
+constexpr uint32_t LANES_LOW7 = 0x7F7F7F7Fu;
+constexpr uint32_t LANES_ONE = 0x01010101u;
+constexpr uint32_t LANES_LEVEL = 0x03030303u;
+
+// 0x80 in every lane where a >= b (unsigned)
+inline uint32_t lanesAtLeast(const uint32_t a, const uint32_t b) {
+  const uint32_t diff = ((a | LANES_HIGH) - (b & LANES_LOW7)) ^ ((a ^ ~b) & LANES_HIGH);
+  const uint32_t borrow = (~a & b) | (~(a ^ b) & diff);
+  return ~borrow & LANES_HIGH;
+}
+
+// min(a + b, 255) in every lane
+inline uint32_t lanesAddSaturate(const uint32_t a, const uint32_t b) {
+  const uint32_t sum = ((a & LANES_LOW7) + (b & LANES_LOW7)) ^ ((a ^ b) & LANES_HIGH);
+  const uint32_t carry = ((a & b) | ((a | b) & ~sum)) & LANES_HIGH;
+  return sum | ((carry >> 7) * 0xFF);
+}
+
+// max(a - b, 0) in every lane
+inline uint32_t lanesSubSaturate(const uint32_t a, const uint32_t b) {
+  const uint32_t diff = ((a | LANES_HIGH) - (b & LANES_LOW7)) ^ ((a ^ ~b) & LANES_HIGH);
+  const uint32_t borrow = ((~a & b) | (~(a ^ b) & diff)) & LANES_HIGH;
+  return diff & ~((borrow >> 7) * 0xFF);
+}
+
+// Lane i (a 2-bit level) moves to bits 30 - 2i; nothing below bit 24 carries into the top byte
+inline uint8_t packLevels(const uint32_t levels) { return static_cast<uint8_t>((levels * 0x40100401u) >> 24); }
+
+// Applies levelsOf to the row a word at a time and packs the results
+template <typename LevelsFn>
+void packRowWords(const uint8_t* gray, uint8_t* out, const int width, LevelsFn&& levelsOf) {
+  const int whole = width & ~3;
+  for (int x = 0; x < whole; x += 4) {
+    uint32_t lanes;
+    memcpy(&lanes, gray + x, sizeof(lanes));
+    *out++ = packLevels(levelsOf(lanes));
+  }
+  const int rest = width - whole;
+  if (rest > 0) {
+    uint32_t lanes = 0;
+    memcpy(&lanes, gray + whole, rest);
+    *out = packLevels(levelsOf(lanes)) & static_cast<uint8_t>(0xFF << (8 - 2 * rest));
+  }
+}
+
+// Per-pixel fallback for the optional brightness and noise settings
+template <typename LevelFn>
+void packRowPixels(uint8_t* out, const int width, LevelFn&& levelOf) {
+  for (int x = 0; x < width; x += 4) {
+    uint8_t packed = 0;
+    for (int i = 0; i < 4; i++) {
+      packed = (packed << 2) | (x + i < width ? levelOf(x + i) : 0);
+    }
+    *out++ = packed;
+  }
+}
+
+// 4-level quantizer of AtkinsonDitherer and FloydSteinbergDitherer ("fine-tuned to X4 eink display"): thresholds
+// 30/50/140, levels 15/30/80/210. The three comparisons are independent, so the level and its value come out of them
+// without branches or a table lookup on the pixel-to-pixel dependency chain.
+inline int diffusionLevel(const int adjusted, int* value) {
+  const int above30 = adjusted >= 30;
+  const int above50 = adjusted >= 50;
+  const int above140 = adjusted >= 140;
+  *value = 15 + 15 * above30 + 50 * above50 + 130 * above140;
+  return above30 + above50 + above140;
+}
+
+}  // namespace
+
+void quantizeRow(const uint8_t* gray, uint8_t* out, const int width, const int y) {
+  if (USE_BRIGHTNESS || USE_NOISE_DITHERING) {
+    packRowPixels(out, width, [&](const int x) { return quantize(adjustPixel(gray[x]), x, y); });
+    return;
+  }
+  packRowWords(gray, out, width, [](const uint32_t lanes) {
+    return (lanesAtLeast(lanes, SIMPLE_THRESHOLDS[0] * LANES_ONE) >> 7) +
+           (lanesAtLeast(lanes, SIMPLE_THRESHOLDS[1] * LANES_ONE) >> 7) +
+           (lanesAtLeast(lanes, SIMPLE_THRESHOLDS[2] * LANES_ONE) >> 7);
+  });
+}
+
+void quantizeRowNative(const uint8_t* gray, uint8_t* out, const int width) {
+  if (USE_BRIGHTNESS) {
+    packRowPixels(out, width, [&](const int x) { return adjustPixel(gray[x]) >> 6; });
+    return;
+  }
+  packRowWords(gray, out, width, [](const uint32_t lanes) { return (lanes >> 6) & LANES_LEVEL; });
+}
+
+void ditherRowBayer(const uint8_t* gray, uint8_t* out, const int width, const int x, const int y) {
+  // The Bayer offset of each lane, split into what is added and what is subtracted
+  uint32_t add = 0;
+  uint32_t sub = 0;
+  for (int lane = 0; lane < 4; lane++) {
+    const int dither = (bayer4x4[y & 3][(x + lane) & 3] - 8) * 5;
+    if (dither > 0) {
+      add |= static_cast<uint32_t>(dither) << (8 * lane);
+    } else {
+      sub |= static_cast<uint32_t>(-dither) << (8 * lane);
+    }
+  }
+  // Clamped to 0-255 like applyBayerDither4Level, whose thresholds 64/128/192 are the top two bits
+  packRowWords(gray, out, width, [add, sub](const uint32_t lanes) {
+    return (lanesSubSaturate(lanesAddSaturate(lanes, add), sub) >> 6) & LANES_LEVEL;
+  });
+}
+
+// Error diffusion rows are scalar on purpose: each pixel's level depends on the error carried from the pixel before
+// it, so lanes cannot be quantized side by side as in the kernels above. What is serial stays in registers instead.
+
+void Atkinson1BitDitherer::ditherRow(const uint8_t* gray, uint8_t* out) {
+  // Locals, as the byte stores to out could otherwise alias the members
+  const int width = this->width;
+  const int16_t* row0 = errorRow0;
+  int16_t* row1 = errorRow1;
+  int16_t* row2 = errorRow2;
+  int prev1 = 0;  // Error of pixel x - 1
+  int prev2 = 0;  // Error of pixel x - 2
+  uint8_t packed = 0;
+  for (int x = 0; x < width; x++) {
+    // Right and Right+1 of the two previous pixels arrive through prev1 and prev2
+    int adjusted = adjustPixel(gray[x]) + row0[x + 2] + prev1 + prev2;
+    if (adjusted < 0) adjusted = 0;
+    if (adjusted > 255) adjusted = 255;
+
+    const int bit = adjusted >= 128;
+    const int error = (adjusted - (bit ? 255 : 0)) >> 3;
+
+    // This entry is complete: bottom-left of x, bottom of x - 1, bottom-right of x - 2
+    row1[x + 1] += error + prev1 + prev2;
+    row2[x + 2] = error;  // Two rows down, nothing else lands here
+    prev2 = prev1;
+    prev1 = error;
+
+    packed = (packed << 1) | bit;
+    if ((x & 7) == 7) {
+      *out++ = packed;
+      packed = 0;
+    }
+  }
+  if (width & 7) *out = packed << (8 - (width & 7));
+  row1[width + 1] += prev1 + prev2;
+
+  nextRow();
+}
+
+void AtkinsonDitherer::ditherRow(const uint8_t* gray, uint8_t* out) {
+  // Locals, as the byte stores to out could otherwise alias the members
+  const int width = this->width;
+  const int16_t* row0 = errorRow0;
+  int16_t* row1 = errorRow1;
+  int16_t* row2 = errorRow2;
+  int prev1 = 0;  // Error of pixel x - 1
+  int prev2 = 0;  // Error of pixel x - 2
+  uint8_t packed = 0;
+  for (int x = 0; x < width; x++) {
+    // Right and Right+1 of the two previous pixels arrive through prev1 and prev2
+    int adjusted = adjustPixel(gray[x]) + row0[x + 2] + prev1 + prev2;
+    if (adjusted < 0) adjusted = 0;
+    if (adjusted > 255) adjusted = 255;
+
+    int value;
+    const int level = diffusionLevel(adjusted, &value);
+    const int error = (adjusted - value) >> 3;
+
+    // This entry is complete: bottom-left of x, bottom of x - 1, bottom-right of x - 2
+    row1[x + 1] += error + prev1 + prev2;
+    row2[x + 2] = error;  // Two rows down, nothing else lands here
+    prev2 = prev1;
+    prev1 = error;
+
+    packed = (packed << 2) | level;
+    if ((x & 3) == 3) {
+      *out++ = packed;
+      packed = 0;
+    }
+  }
+  if (width & 3) *out = packed << (2 * (4 - (width & 3)));
+  row1[width + 1] += prev1 + prev2;
+
+  nextRow();
+}
+
+void FloydSteinbergDitherer::ditherRow(const uint8_t* gray, uint8_t* out) {
+  // Pixels are visited left to right either way; on reverse rows processPixel() mirrors the weights and sends 7/16
+  // to the already visited left neighbour, where it is dropped
+  const bool reverse = isReverseRow();
+  const int width = this->width;
+  const int16_t* curRow = errorCurRow;
+  int16_t* below = errorNextRow;
+  const int weightCur = reverse ? 1 : 3;    // 16ths of pixel x's error landing below-left of it
+  const int weightPrev2 = reverse ? 3 : 1;  // 16ths of pixel x - 2's error landing on that same entry
+  int carry = 0;  // 7/16 of the previous pixel's error on forward rows
+  int prev1 = 0;  // Error of pixel x - 1
+  int prev2 = 0;  // Error of pixel x - 2
+  uint8_t packed = 0;
+  for (int x = 0; x < width; x++) {
+    int adjusted = adjustPixel(gray[x]) + curRow[x + 1] + carry;
+    if (adjusted < 0) adjusted = 0;
+    if (adjusted > 255) adjusted = 255;
+
+    int value;
+    const int level = diffusionLevel(adjusted, &value);
+    const int error = adjusted - value;
+    if (!reverse) carry = (error * 7) >> 4;
+
+    // This entry is complete: it only collects from pixels x, x - 1 and x - 2
+    below[x] += ((error * weightCur) >> 4) + ((prev1 * 5) >> 4) + ((prev2 * weightPrev2) >> 4);
+    prev2 = prev1;
+    prev1 = error;
+
+    packed = (packed << 2) | level;
+    if ((x & 3) == 3) {
+      *out++ = packed;
+      packed = 0;
+    }
+  }
+  if (width & 3) *out = packed << (2 * (4 - (width & 3)));
+  below[width] += ((prev1 * 5) >> 4) + ((prev2 * weightPrev2) >> 4);
+
+  nextRow();
+}
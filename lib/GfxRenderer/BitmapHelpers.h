@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstdint>
 #include <cstring>
+#include <new>
 
 // Helper functions
 uint8_t quantize(int gray, int x, int y);
@@ -8,6 +10,41 @@ uint8_t quantizeSimple(int gray);
 uint8_t quantize1bit(int gray, int x, int y);
 int adjustPixel(int gray);
 
+// 4x4 Bayer matrix for ordered dithering
+inline const uint8_t bayer4x4[4][4] = {
+    {0, 8, 2, 10},
+    {12, 4, 14, 6},
+    {3, 11, 1, 9},
+    {15, 7, 13, 5},
+};
+
+// Apply Bayer dithering and quantize to 4 levels (0-3)
+// Stateless - works correctly with any pixel processing order
+inline uint8_t applyBayerDither4Level(uint8_t gray, int x, int y) {
+  int bayer = bayer4x4[y & 3][x & 3];
+  int dither = (bayer - 8) * 5;  // Scale to +/-40 (half of quantization step 85)
+
+  int adjusted = gray + dither;
+  if (adjusted < 0) adjusted = 0;
+  if (adjusted > 255) adjusted = 255;
+
+  if (adjusted < 64) return 0;
+  if (adjusted < 128) return 1;
+  if (adjusted < 192) return 2;
+  return 3;
+}
+
+// Row kernels: quantize a row of 8-bit gray values four pixels per 32-bit word and write it packed 2 bits per pixel,
+// first pixel in the top bits (0 = black, 3 = white) as in 2-bit BMP rows and Bitmap::readNextRow output. Unused
+// bits of the last byte are cleared. Each matches its per-pixel counterpart exactly.
+
+// quantize(adjustPixel(gray[i]), i, y) for each pixel
+void quantizeRow(const uint8_t* gray, uint8_t* out, int width, int y);
+// adjustPixel(gray[i]) >> 6 for each pixel (palettes that already sit on the four display levels)
+void quantizeRowNative(const uint8_t* gray, uint8_t* out, int width);
+// applyBayerDither4Level(gray[i], x + i, y) for each pixel
+void ditherRowBayer(const uint8_t* gray, uint8_t* out, int width, int x, int y);
+
 // 1-bit Atkinson dithering - better quality than noise dithering for thumbnails
 // Error distribution pattern (same as 2-bit but quantizes to 2 levels):
 //     X  1/8 1/8
@@ -16,16 +53,16 @@ int adjustPixel(int gray);
 class Atkinson1BitDitherer {
  public:
   explicit Atkinson1BitDitherer(int width) : width(width) {
-    errorRow0 = new int16_t[width + 4]();  // Current row
-    errorRow1 = new int16_t[width + 4]();  // Next row
-    errorRow2 = new int16_t[width + 4]();  // Row after next
+    // All three error rows share one allocation that is reused row after row
+    errorRows = new (std::nothrow) int16_t[3 * (width + 4)]();
+    errorRow0 = errorRows;                    // Current row
+    errorRow1 = errorRows + (width + 4);      // Next row
+    errorRow2 = errorRows + 2 * (width + 4);  // Row after next
   }
 
-  ~Atkinson1BitDitherer() {
-    delete[] errorRow0;
-    delete[] errorRow1;
-    delete[] errorRow2;
-  }
+  ~Atkinson1BitDitherer() { delete[] errorRows; }
+  // False if the error rows could not be allocated
+  bool ok() const { return errorRows != nullptr; }
 
   // EXPLICITLY DELETE THE COPY CONSTRUCTOR
   Atkinson1BitDitherer(const Atkinson1BitDitherer& other) = delete;
@@ -67,6 +104,10 @@ class Atkinson1BitDitherer {
     return quantized;
   }
 
+  // processPixel() over a whole row of width pixels, packed 8 per byte MSB first, then nextRow(). Errors headed for
+  // the rest of this row and for the next row are carried in registers.
+  void ditherRow(const uint8_t* gray, uint8_t* out);
+
   void nextRow() {
     int16_t* temp = errorRow0;
     errorRow0 = errorRow1;
@@ -75,14 +116,11 @@ class Atkinson1BitDitherer {
     memset(errorRow2, 0, (width + 4) * sizeof(int16_t));
   }
 
-  void reset() {
-    memset(errorRow0, 0, (width + 4) * sizeof(int16_t));
-    memset(errorRow1, 0, (width + 4) * sizeof(int16_t));
-    memset(errorRow2, 0, (width + 4) * sizeof(int16_t));
-  }
+  void reset() { memset(errorRows, 0, 3 * (width + 4) * sizeof(int16_t)); }
 
  private:
   int width;
+  int16_t* errorRows;
   int16_t* errorRow0;
   int16_t* errorRow1;
   int16_t* errorRow2;
@@ -97,16 +135,16 @@ class Atkinson1BitDitherer {
 class AtkinsonDitherer {
  public:
   explicit AtkinsonDitherer(int width) : width(width) {
-    errorRow0 = new int16_t[width + 4]();  // Current row
-    errorRow1 = new int16_t[width + 4]();  // Next row
-    errorRow2 = new int16_t[width + 4]();  // Row after next
+    // All three error rows share one allocation that is reused row after row
+    errorRows = new (std::nothrow) int16_t[3 * (width + 4)]();
+    errorRow0 = errorRows;                    // Current row
+    errorRow1 = errorRows + (width + 4);      // Next row
+    errorRow2 = errorRows + 2 * (width + 4);  // Row after next
   }
 
-  ~AtkinsonDitherer() {
-    delete[] errorRow0;
-    delete[] errorRow1;
-    delete[] errorRow2;
-  }
+  ~AtkinsonDitherer() { delete[] errorRows; }
+  // False if the error rows could not be allocated
+  bool ok() const { return errorRows != nullptr; }
   // **1. EXPLICITLY DELETE THE COPY CONSTRUCTOR**
   AtkinsonDitherer(const AtkinsonDitherer& other) = delete;
 
@@ -166,6 +204,10 @@ class AtkinsonDitherer {
     return quantized;
   }
 
+  // processPixel(adjustPixel(gray[x]), x) over a whole row of width pixels, packed 2 bits per pixel, then nextRow().
+  // Errors headed for the rest of this row and for the next row are carried in registers.
+  void ditherRow(const uint8_t* gray, uint8_t* out);
+
   void nextRow() {
     int16_t* temp = errorRow0;
     errorRow0 = errorRow1;
@@ -174,14 +216,11 @@ class AtkinsonDitherer {
     memset(errorRow2, 0, (width + 4) * sizeof(int16_t));
   }
 
-  void reset() {
-    memset(errorRow0, 0, (width + 4) * sizeof(int16_t));
-    memset(errorRow1, 0, (width + 4) * sizeof(int16_t));
-    memset(errorRow2, 0, (width + 4) * sizeof(int16_t));
-  }
+  void reset() { memset(errorRows, 0, 3 * (width + 4) * sizeof(int16_t)); }
 
  private:
   int width;
+  int16_t* errorRows;
   int16_t* errorRow0;
   int16_t* errorRow1;
   int16_t* errorRow2;
@@ -198,14 +237,15 @@ class AtkinsonDitherer {
 class FloydSteinbergDitherer {
  public:
   explicit FloydSteinbergDitherer(int width) : width(width), rowCount(0) {
-    errorCurRow = new int16_t[width + 2]();  // +2 for boundary handling
-    errorNextRow = new int16_t[width + 2]();
+    // Both error rows share one allocation that is reused row after row
+    errorRows = new (std::nothrow) int16_t[2 * (width + 2)]();  // +2 for boundary handling
+    errorCurRow = errorRows;
+    errorNextRow = errorRows + (width + 2);
   }
 
-  ~FloydSteinbergDitherer() {
-    delete[] errorCurRow;
-    delete[] errorNextRow;
-  }
+  ~FloydSteinbergDitherer() { delete[] errorRows; }
+  // False if the error rows could not be allocated
+  bool ok() const { return errorRows != nullptr; }
 
   // **1. EXPLICITLY DELETE THE COPY CONSTRUCTOR**
   FloydSteinbergDitherer(const FloydSteinbergDitherer& other) = delete;
@@ -285,6 +325,10 @@ class FloydSteinbergDitherer {
     return quantized;
   }
 
+  // processPixel(adjustPixel(gray[x]), x) over a whole row of width pixels, packed 2 bits per pixel, then nextRow().
+  // The next-row errors are carried in registers and each next-row entry is written once.
+  void ditherRow(const uint8_t* gray, uint8_t* out);
+
   // Call at the end of each row to swap buffers
   void nextRow() {
     // Swap buffers
@@ -301,14 +345,14 @@ class FloydSteinbergDitherer {
 
   // Reset for a new image or MCU block
   void reset() {
-    memset(errorCurRow, 0, (width + 2) * sizeof(int16_t));
-    memset(errorNextRow, 0, (width + 2) * sizeof(int16_t));
+    memset(errorRows, 0, 2 * (width + 2) * sizeof(int16_t));
     rowCount = 0;
   }
 
  private:
   int width;
   int rowCount;
+  int16_t* errorRows;
   int16_t* errorCurRow;
   int16_t* errorNextRow;
 };
@@ -0,0 +1,290 @@
+#include "BmpSink.h"
+
+#include <Logging.h>
+#include <Print.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// ============================================================================
+// IMAGE PROCESSING OPTIONS - Toggle these to test different configurations
+// ============================================================================
+constexpr bool USE_8BIT_OUTPUT = false;  // true: 8-bit grayscale (no quantization), false: 2-bit (4 levels)
+// Dithering method selection (only one should be true, or all false for simple quantization):
+constexpr bool USE_ATKINSON = true;          // Atkinson dithering (cleaner than F-S, less error diffusion)
+constexpr bool USE_FLOYD_STEINBERG = false;  // Floyd-Steinberg error diffusion (can cause "worm" artifacts)
+// ============================================================================
+
+namespace {
+
+inline void write16(Print& out, const uint16_t value) {
+  out.write(value & 0xFF);
+  out.write((value >> 8) & 0xFF);
+}
+
+inline void write32(Print& out, const uint32_t value) {
+  out.write(value & 0xFF);
+  out.write((value >> 8) & 0xFF);
+  out.write((value >> 16) & 0xFF);
+  out.write((value >> 24) & 0xFF);
+}
+
+inline void write32Signed(Print& out, const int32_t value) {
+  out.write(value & 0xFF);
+  out.write((value >> 8) & 0xFF);
+  out.write((value >> 16) & 0xFF);
+  out.write((value >> 24) & 0xFF);
+}
+
+// Helper function: Write BMP header with 8-bit grayscale (256 levels)
+void writeBmpHeader8bit(Print& bmpOut, const int width, const int height) {
+  // Calculate row padding (each row must be multiple of 4 bytes)
+  const int bytesPerRow = (width + 3) / 4 * 4;  // 8 bits per pixel, padded
+  const int imageSize = bytesPerRow * height;
+  const uint32_t paletteSize = 256 * 4;  // 256 colors * 4 bytes (BGRA)
+  const uint32_t fileSize = 14 + 40 + paletteSize + imageSize;
+
+  // BMP File Header (14 bytes)
+  bmpOut.write('B');
+  bmpOut.write('M');
+  write32(bmpOut, fileSize);
+  write32(bmpOut, 0);                      // Reserved
+  write32(bmpOut, 14 + 40 + paletteSize);  // Offset to pixel data
+
+  // DIB Header (BITMAPINFOHEADER - 40 bytes)
+  write32(bmpOut, 40);
+  write32Signed(bmpOut, width);
+  write32Signed(bmpOut, -height);  // Negative height = top-down bitmap
+  write16(bmpOut, 1);              // Color planes
+  write16(bmpOut, 8);              // Bits per pixel (8 bits)
+  write32(bmpOut, 0);              // BI_RGB (no compression)
+  write32(bmpOut, imageSize);
+  write32(bmpOut, 2835);  // xPixelsPerMeter (72 DPI)
+  write32(bmpOut, 2835);  // yPixelsPerMeter (72 DPI)
+  write32(bmpOut, 256);   // colorsUsed
+  write32(bmpOut, 256);   // colorsImportant
+
+  // Color Palette (256 grayscale entries x 4 bytes = 1024 bytes)
+  for (int i = 0; i < 256; i++) {
+    bmpOut.write(static_cast<uint8_t>(i));  // Blue
+    bmpOut.write(static_cast<uint8_t>(i));  // Green
+    bmpOut.write(static_cast<uint8_t>(i));  // Red
+    bmpOut.write(static_cast<uint8_t>(0));  // Reserved
+  }
+}
+
+// Helper function: Write BMP header with 1-bit color depth (black and white)
+void writeBmpHeader1bit(Print& bmpOut, const int width, const int height) {
+  // Calculate row padding (each row must be multiple of 4 bytes)
+  const int bytesPerRow = (width + 31) / 32 * 4;  // 1 bit per pixel, round up to 4-byte boundary
+  const int imageSize = bytesPerRow * height;
+  const uint32_t fileSize = 62 + imageSize;  // 14 (file header) + 40 (DIB header) + 8 (palette) + image
+
+  // BMP File Header (14 bytes)
+  bmpOut.write('B');
+  bmpOut.write('M');
+  write32(bmpOut, fileSize);  // File size
+  write32(bmpOut, 0);         // Reserved
+  write32(bmpOut, 62);        // Offset to pixel data (14 + 40 + 8)
+
+  // DIB Header (BITMAPINFOHEADER - 40 bytes)
+  write32(bmpOut, 40);
+  write32Signed(bmpOut, width);
+  write32Signed(bmpOut, -height);  // Negative height = top-down bitmap
+  write16(bmpOut, 1);              // Color planes
+  write16(bmpOut, 1);              // Bits per pixel (1 bit)
+  write32(bmpOut, 0);              // BI_RGB (no compression)
+  write32(bmpOut, imageSize);
+  write32(bmpOut, 2835);  // xPixelsPerMeter (72 DPI)
+  write32(bmpOut, 2835);  // yPixelsPerMeter (72 DPI)
+  write32(bmpOut, 2);     // colorsUsed
+  write32(bmpOut, 2);     // colorsImportant
+
+  // Color Palette (2 colors x 4 bytes = 8 bytes)
+  // Format: Blue, Green, Red, Reserved (BGRA)
+  // Note: In 1-bit BMP, palette index 0 = black, 1 = white
+  uint8_t palette[8] = {
+      0x00, 0x00, 0x00, 0x00,  // Color 0: Black
+      0xFF, 0xFF, 0xFF, 0x00   // Color 1: White
+  };
+  for (const uint8_t i : palette) {
+    bmpOut.write(i);
+  }
+}
+
+// Helper function: Write BMP header with 2-bit color depth
+void writeBmpHeader2bit(Print& bmpOut, const int width, const int height) {
+  // Calculate row padding (each row must be multiple of 4 bytes)
+  const int bytesPerRow = (width * 2 + 31) / 32 * 4;  // 2 bits per pixel, round up
+  const int imageSize = bytesPerRow * height;
+  const uint32_t fileSize = 70 + imageSize;  // 14 (file header) + 40 (DIB header) + 16 (palette) + image
+
+  // BMP File Header (14 bytes)
+  bmpOut.write('B');
+  bmpOut.write('M');
+  write32(bmpOut, fileSize);  // File size
+  write32(bmpOut, 0);         // Reserved
+  write32(bmpOut, 70);        // Offset to pixel data
+
+  // DIB Header (BITMAPINFOHEADER - 40 bytes)
+  write32(bmpOut, 40);
+  write32Signed(bmpOut, width);
+  write32Signed(bmpOut, -height);  // Negative height = top-down bitmap
+  write16(bmpOut, 1);              // Color planes
+  write16(bmpOut, 2);              // Bits per pixel (2 bits)
+  write32(bmpOut, 0);              // BI_RGB (no compression)
+  write32(bmpOut, imageSize);
+  write32(bmpOut, 2835);  // xPixelsPerMeter (72 DPI)
+  write32(bmpOut, 2835);  // yPixelsPerMeter (72 DPI)
+  write32(bmpOut, 4);     // colorsUsed
+  write32(bmpOut, 4);     // colorsImportant
+
+  // Color Palette (4 colors x 4 bytes = 16 bytes)
+  // Format: Blue, Green, Red, Reserved (BGRA)
+  uint8_t palette[16] = {
+      0x00, 0x00, 0x00, 0x00,  // Color 0: Black
+      0x55, 0x55, 0x55, 0x00,  // Color 1: Dark gray (85)
+      0xAA, 0xAA, 0xAA, 0x00,  // Color 2: Light gray (170)
+      0xFF, 0xFF, 0xFF, 0x00   // Color 3: White
+  };
+  for (const uint8_t i : palette) {
+    bmpOut.write(i);
+  }
+}
+
+}  // namespace
+
+BmpSink::~BmpSink() {
+  delete atkinsonDitherer;
+  delete fsDitherer;
+  delete atkinson1BitDitherer;
+  free(rowBuffer);
+}
+
+void BmpSink::outputSize(const BmpTarget& target, const int imageWidth, const int imageHeight, int& outWidth,
+                         int& outHeight) {
+  outWidth = imageWidth;
+  outHeight = imageHeight;
+  if (target.maxWidth <= 0 || target.maxHeight <= 0 ||
+      (imageWidth == target.maxWidth && imageHeight == target.maxHeight)) {
+    return;
+  }
+
+  // Calculate scale to fit/fill target dimensions while maintaining aspect ratio
+  const float scaleToFitWidth = static_cast<float>(target.maxWidth) / imageWidth;
+  const float scaleToFitHeight = static_cast<float>(target.maxHeight) / imageHeight;
+  float scale = 1.0;
+  if (target.crop) {  // if we will crop, scale to the smaller dimension
+    scale = (scaleToFitWidth > scaleToFitHeight) ? scaleToFitWidth : scaleToFitHeight;
+  } else {  // else, scale to the larger dimension to fit
+    scale = (scaleToFitWidth < scaleToFitHeight) ? scaleToFitWidth : scaleToFitHeight;
+  }
+
+  outWidth = static_cast<int>(imageWidth * scale);
+  outHeight = static_cast<int>(imageHeight * scale);
+
+  // Ensure at least 1 pixel
+  if (outWidth < 1) outWidth = 1;
+  if (outHeight < 1) outHeight = 1;
+}
+
+bool BmpSink::collectResults(const BmpSink* sinks, const int count, bool* written) {
+  bool all = true;
+  for (int i = 0; i < count; i++) {
+    if (written) written[i] = sinks[i].ok();
+    all = all && sinks[i].ok();
+  }
+  return all;
+}
+
+bool BmpSink::begin(const BmpTarget& target, const int imageWidth, const int imageHeight, const int srcWidth,
+                    const int srcHeight) {
+  failed = true;
+  out = target.out;
+  oneBit = target.oneBit;
+  outputSize(target, imageWidth, imageHeight, outWidth, outHeight);
+
+  // Area-average the decoded rows down (or up) to the output size
+  if (!scaler.begin(srcWidth, srcHeight, outWidth, outHeight)) {
+    return false;
+  }
+
+  if (USE_8BIT_OUTPUT && !oneBit) {
+    bytesPerRow = (outWidth + 3) / 4 * 4;
+  } else if (oneBit) {
+    bytesPerRow = (outWidth + 31) / 32 * 4;  // 1 bit per pixel
+  } else {
+    bytesPerRow = (outWidth * 2 + 31) / 32 * 4;
+  }
+
+  rowBuffer = static_cast<uint8_t*>(malloc(bytesPerRow));
+  if (!rowBuffer) {
+    LOG_ERR("BMS", "Failed to allocate row buffer (%d bytes)", bytesPerRow);
+    return false;
+  }
+
+  // Dither at the output size, after scaling
+  bool dithererReady = true;
+  if (oneBit) {
+    // For 1-bit output, use Atkinson dithering for better quality
+    atkinson1BitDitherer = new (std::nothrow) Atkinson1BitDitherer(outWidth);
+    dithererReady = atkinson1BitDitherer && atkinson1BitDitherer->ok();
+  } else if (!USE_8BIT_OUTPUT) {
+    if (USE_ATKINSON) {
+      atkinsonDitherer = new (std::nothrow) AtkinsonDitherer(outWidth);
+      dithererReady = atkinsonDitherer && atkinsonDitherer->ok();
+    } else if (USE_FLOYD_STEINBERG) {
+      fsDitherer = new (std::nothrow) FloydSteinbergDitherer(outWidth);
+      dithererReady = fsDitherer && fsDitherer->ok();
+    }
+  }
+  if (!dithererReady) {
+    LOG_ERR("BMS", "Failed to allocate ditherer (%d pixels wide)", outWidth);
+    return false;
+  }
+
+  if (USE_8BIT_OUTPUT && !oneBit) {
+    writeBmpHeader8bit(*out, outWidth, outHeight);
+  } else if (oneBit) {
+    writeBmpHeader1bit(*out, outWidth, outHeight);
+  } else {
+    writeBmpHeader2bit(*out, outWidth, outHeight);
+  }
+  failed = false;
+  return true;
+}
+
+void BmpSink::writeRow(const int outY, const uint8_t* gray) {
+  if (failed) {
+    return;
+  }
+  memset(rowBuffer, 0, bytesPerRow);
+
+  if (USE_8BIT_OUTPUT && !oneBit) {
+    for (int x = 0; x < outWidth; x++) {
+      rowBuffer[x] = adjustPixel(gray[x]);
+    }
+  } else if (oneBit) {
+    // 1-bit output with Atkinson dithering for better quality
+    if (atkinson1BitDitherer) {
+      atkinson1BitDitherer->ditherRow(gray, rowBuffer);
+    } else {
+      for (int x = 0; x < outWidth; x++) {
+        // Pack 1-bit value: MSB first, 8 pixels per byte
+        rowBuffer[x / 8] |= quantize1bit(gray[x], x, outY) << (7 - (x % 8));
+      }
+    }
+  } else if (atkinsonDitherer) {
+    // 2-bit output, packed straight by the row kernels
+    atkinsonDitherer->ditherRow(gray, rowBuffer);
+  } else if (fsDitherer) {
+    fsDitherer->ditherRow(gray, rowBuffer);
+  } else {
+    quantizeRow(gray, rowBuffer, outWidth, outY);
+  }
+  if (out->write(rowBuffer, bytesPerRow) != static_cast<size_t>(bytesPerRow)) {
+    LOG_ERR("BMS", "Failed to write BMP row %d", outY);
+    failed = true;
+  }
+}
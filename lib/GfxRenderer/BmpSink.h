@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+
+#include "AreaScaler.h"
+#include "BitmapHelpers.h"
+
+class Print;
+
+// One BMP file to produce from a decoded image
+struct BmpTarget {
+  // Full-screen cover size (portrait display)
+  static constexpr int COVER_MAX_WIDTH = 480;
+  static constexpr int COVER_MAX_HEIGHT = 800;
+
+  Print* out;
+  int maxWidth;   // Box the image is scaled into; 0 keeps the image size
+  int maxHeight;
+  bool oneBit;    // 1-bit black and white instead of 2-bit gray
+  bool crop;      // Fill the box (the reader crops the overflow) instead of fitting inside it
+};
+
+/**
+ * Turns decoded 8-bit gray rows into a top-down BMP: area-averages them to the target size, dithers or quantizes
+ * each output row and writes it as soon as it is complete. Each sink has its own scaler and ditherer, so a decoder can
+ * feed every row to several sinks and produce several sizes of the same image from a single decode.
+ */
+class BmpSink {
+ public:
+  BmpSink() = default;
+  ~BmpSink();
+
+  BmpSink(const BmpSink&) = delete;
+  BmpSink& operator=(const BmpSink&) = delete;
+
+  // Output size of target for an imageWidth x imageHeight image, aspect ratio kept
+  static void outputSize(const BmpTarget& target, int imageWidth, int imageHeight, int& outWidth, int& outHeight);
+
+  // Writes the BMP header and allocates the working rows. srcWidth x srcHeight is the size of the rows that will be
+  // pushed, which may be smaller than the image when the decoder reduces it.
+  bool begin(const BmpTarget& target, int imageWidth, int imageHeight, int srcWidth, int srcHeight);
+
+  // Adds the next decoded row of srcWidth gray values; ignored once the sink has failed
+  void pushRow(const uint8_t* src) {
+    if (failed) return;
+    scaler.pushRow(src, [this](const int outY, const uint8_t* row) { writeRow(outY, row); });
+  }
+
+  // False once begin() or a row write failed, so the other sinks of a decode can still complete
+  bool ok() const { return !failed; }
+
+  // Reports ok() of each sink in written (may be nullptr); true if every sink is ok
+  static bool collectResults(const BmpSink* sinks, int count, bool* written);
+
+  int getOutputWidth() const { return outWidth; }
+  int getOutputHeight() const { return outHeight; }
+
+ private:
+  void writeRow(int outY, const uint8_t* gray);
+
+  Print* out = nullptr;
+  bool failed = true;
+  int outWidth = 0;
+  int outHeight = 0;
+  bool oneBit = false;
+  int bytesPerRow = 0;
+  uint8_t* rowBuffer = nullptr;
+  AreaScaler scaler;
+  AtkinsonDitherer* atkinsonDitherer = nullptr;
+  FloydSteinbergDitherer* fsDitherer = nullptr;
+  Atkinson1BitDitherer* atkinson1BitDitherer = nullptr;
+};
@@ -59,6 +59,34 @@ static inline void rotateCoordinates(const GfxRenderer::Orientation orientation,
   }
 }
 
+// Mirror a byte of packed pixels
+static inline uint8_t reverseBits(uint8_t b) {
+  b = static_cast<uint8_t>((b & 0xF0) >> 4 | (b & 0x0F) << 4);
+  b = static_cast<uint8_t>((b & 0xCC) >> 2 | (b & 0x33) << 2);
+  return static_cast<uint8_t>((b & 0xAA) >> 1 | (b & 0x55) << 1);
+}
+
+// Transpose an 8x8 bit block, MSB first: bit 7-j of in[i] becomes bit 7-i of out[j] (Hacker's Delight, 7-3)
+static void transpose8x8(const uint8_t in[8], uint8_t out[8]) {
+  uint32_t hi = static_cast<uint32_t>(in[0]) << 24 | in[1] << 16 | in[2] << 8 | in[3];
+  uint32_t lo = static_cast<uint32_t>(in[4]) << 24 | in[5] << 16 | in[6] << 8 | in[7];
+  uint32_t t = (hi ^ (hi >> 7)) & 0x00AA00AA;
+  hi = hi ^ t ^ (t << 7);
+  t = (lo ^ (lo >> 7)) & 0x00AA00AA;
+  lo = lo ^ t ^ (t << 7);
+  t = (hi ^ (hi >> 14)) & 0x0000CCCC;
+  hi = hi ^ t ^ (t << 14);
+  t = (lo ^ (lo >> 14)) & 0x0000CCCC;
+  lo = lo ^ t ^ (t << 14);
+  t = (hi & 0xF0F0F0F0) | ((lo >> 4) & 0x0F0F0F0F);
+  lo = ((hi << 4) & 0xF0F0F0F0) | (lo & 0x0F0F0F0F);
+  hi = t;
+  for (int i = 0; i < 4; i++) {
+    out[i] = static_cast<uint8_t>(hi >> (24 - 8 * i));
+    out[i + 4] = static_cast<uint8_t>(lo >> (24 - 8 * i));
+  }
+}
+
 // IMPORTANT: This function is in critical rendering path and is called for every pixel. Please keep it as simple and
 // efficient as possible.
 void GfxRenderer::drawPixel(const int x, const int y, const bool state) const {
@@ -601,6 +629,148 @@ void GfxRenderer::drawBitmap1Bit(const Bitmap& bitmap, const int x, const int y,
   free(rowBytes);
 }
 
+// fetch(line, k) returns source byte k of a line (a logical row if linesAreRows, else a column): 8 pixels along the
+// line, MSB first, set bit = white
+template <typename FetchByte>
+void GfxRenderer::blitPacked(const int x, const int y, const int width, const int height, const bool linesAreRows,
+                             FetchByte&& fetch) const {
+  const int lineCount = linesAreRows ? height : width;
+  const int lineBytes = (linesAreRows ? width : height) / 8;
+  auto toPhysical = [&](const int line, const int along, int* phyX, int* phyY) {
+    rotateCoordinates(orientation, linesAreRows ? x + along : x + line, linesAreRows ? y + line : y + along, phyX,
+                      phyY);
+  };
+  // Stores 8 pixels running from first to last along a panel row
+  auto storeByte = [&](const int firstX, const int lastX, const int phyY, const uint8_t value) {
+    frameBuffer[phyY * HalDisplay::DISPLAY_WIDTH_BYTES + std::min(firstX, lastX) / 8] =
+        firstX < lastX ? value : reverseBits(value);
+  };
+
+  const bool aligned = x >= 0 && y >= 0 && x % 8 == 0 && y % 8 == 0 && width % 8 == 0 && height % 8 == 0 &&
+                       x + width <= getScreenWidth() && y + height <= getScreenHeight();
+  if (!aligned) {
+    const int lineLength = linesAreRows ? width : height;
+    const int screenWidth = getScreenWidth();
+    const int screenHeight = getScreenHeight();
+    for (int line = 0; line < lineCount; line++) {
+      for (int along = 0; along < lineLength; along++) {
+        const int screenX = linesAreRows ? x + along : x + line;
+        const int screenY = linesAreRows ? y + line : y + along;
+        if (screenX < 0 || screenX >= screenWidth || screenY < 0 || screenY >= screenHeight) {
+          continue;
+        }
+        const bool white = (fetch(line, along / 8) >> (7 - along % 8)) & 1;
+        drawPixel(screenX, screenY, !white);
+      }
+    }
+    return;
+  }
+
+  int firstX, firstY, nextX, nextY;
+  toPhysical(0, 0, &firstX, &firstY);
+  toPhysical(0, 1, &nextX, &nextY);
+  if (firstY == nextY) {
+    // Source lines run along panel rows: copy bytes, mirrored if the orientation reverses them
+    for (int line = 0; line < lineCount; line++) {
+      for (int k = 0; k < lineBytes; k++) {
+        int lastX, lastY;
+        toPhysical(line, k * 8, &firstX, &firstY);
+        toPhysical(line, k * 8 + 7, &lastX, &lastY);
+        storeByte(firstX, lastX, firstY, fetch(line, k));
+      }
+    }
+    return;
+  }
+
+  // Source lines run across panel rows: transpose 8 lines at a time
+  uint8_t block[8];
+  uint8_t rows[8];
+  for (int line = 0; line < lineCount; line += 8) {
+    for (int k = 0; k < lineBytes; k++) {
+      for (int i = 0; i < 8; i++) {
+        block[i] = fetch(line + i, k);
+      }
+      transpose8x8(block, rows);
+      for (int j = 0; j < 8; j++) {
+        int lastX, lastY;
+        toPhysical(line, k * 8 + j, &firstX, &firstY);
+        toPhysical(line + 7, k * 8 + j, &lastX, &lastY);
+        storeByte(firstX, lastX, firstY, rows[j]);
+      }
+    }
+  }
+}
+
+GfxRenderer::PanelRect GfxRenderer::toPanelRect(const int x, const int y, const int width, const int height) const {
+  int firstX, firstY, lastX, lastY, rightX, rightY, downX, downY;
+  rotateCoordinates(orientation, x, y, &firstX, &firstY);
+  rotateCoordinates(orientation, x + width - 1, y + height - 1, &lastX, &lastY);
+  rotateCoordinates(orientation, x + 1, y, &rightX, &rightY);
+  rotateCoordinates(orientation, x, y + 1, &downX, &downY);
+
+  // Panel steps of one logical column (dX) and row (dY); the inverse of this rotation is its transpose
+  const int dXx = rightX - firstX, dXy = rightY - firstY;
+  const int dYx = downX - firstX, dYy = downY - firstY;
+
+  PanelRect rect;
+  rect.x = std::min(firstX, lastX);
+  rect.y = std::min(firstY, lastY);
+  rect.width = std::abs(lastX - firstX) + 1;
+  rect.height = std::abs(lastY - firstY) + 1;
+  const int ax = rect.x - firstX;
+  const int ay = rect.y - firstY;
+  rect.originX = dXx * ax + dXy * ay;
+  rect.originY = dYx * ax + dYy * ay;
+  rect.columnDx = dXx;
+  rect.columnDy = dYx;
+  rect.rowDx = dXy;
+  rect.rowDy = dYy;
+  return rect;
+}
+
+void GfxRenderer::writePanelRow(const int x, const int y, const uint8_t* bits, const int width) const {
+  if (y < 0 || y >= HalDisplay::DISPLAY_HEIGHT || x < 0 || width <= 0 || x + width > HalDisplay::DISPLAY_WIDTH) {
+    return;
+  }
+
+  uint8_t* row = frameBuffer + y * HalDisplay::DISPLAY_WIDTH_BYTES;
+  const int shift = x % 8;
+  for (int i = 0; i < width; i += 8) {
+    const int valid = std::min(8, width - i);
+    const auto mask = static_cast<uint8_t>(0xFF << (8 - valid));
+    const uint8_t value = bits[i / 8] & mask;
+    uint8_t* dst = row + (x + i) / 8;
+    dst[0] = (dst[0] & ~(mask >> shift)) | (value >> shift);
+    const auto spillMask = static_cast<uint8_t>(mask << (8 - shift));
+    if (shift != 0 && spillMask != 0) {
+      dst[1] = (dst[1] & ~spillMask) | static_cast<uint8_t>(value << (8 - shift));
+    }
+  }
+}
+
+void GfxRenderer::blitPacked1Bit(const uint8_t* src, const int x, const int y, const int width,
+                                 const int height) const {
+  const size_t rowBytes = (width + 7) / 8;
+  blitPacked(x, y, width, height, true, [&](const int row, const int k) { return src[row * rowBytes + k]; });
+}
+
+void GfxRenderer::blitPacked2Bit(const uint8_t* plane1, const uint8_t* plane2, const int x, const int y,
+                                 const int width, const int height, const uint8_t levelMask, const bool state) const {
+  const size_t columnBytes = (height + 7) / 8;
+  blitPacked(x, y, width, height, false, [&](const int column, const int k) -> uint8_t {
+    const size_t offset = (width - 1 - column) * columnBytes + k;
+    const uint8_t bit1 = plane1[offset];
+    const uint8_t bit2 = plane2[offset];
+    uint8_t selected = 0;
+    if (levelMask & 0x1) selected |= ~bit1 & ~bit2;
+    if (levelMask & 0x2) selected |= ~bit1 & bit2;
+    if (levelMask & 0x4) selected |= bit1 & ~bit2;
+    if (levelMask & 0x8) selected |= bit1 & bit2;
+    // Panel bits are set for white; state (as in drawPixel) is true for black
+    return state ? static_cast<uint8_t>(~selected) : selected;
+  });
+}
+
 void GfxRenderer::fillPolygon(const int* xPoints, const int* yPoints, int numPoints, bool state) const {
   if (numPoints < 3) return;
 
@@ -763,6 +933,20 @@ int GfxRenderer::getTextAdvanceX(const int fontId, const char* text, const EpdFo
   return width;
 }
 
+int GfxRenderer::getCodepointAdvanceX(const int fontId, const uint32_t cp, const EpdFontFamily::Style style) const {
+  const auto fontIt = fontMap.find(fontId);
+  if (fontIt == fontMap.end()) {
+    LOG_ERR("GFX", "Font %d not found", fontId);
+    return 0;
+  }
+
+  const EpdGlyph* glyph = fontIt->second.getGlyph(cp, style);
+  if (!glyph) {
+    glyph = fontIt->second.getGlyph(REPLACEMENT_GLYPH, style);
+  }
+  return glyph ? glyph->advanceX : 0;
+}
+
 int GfxRenderer::getFontAscenderSize(const int fontId) const {
   const auto fontIt = fontMap.find(fontId);
   if (fontIt == fontMap.end()) {
@@ -46,6 +46,8 @@ class GfxRenderer {
   void drawPixelDither(int x, int y) const;
   template <Color color>
   void fillArc(int maxRadius, int cx, int cy, int xDir, int yDir) const;
+  template <typename FetchByte>
+  void blitPacked(int x, int y, int width, int height, bool linesAreRows, FetchByte&& fetch) const;
 
  public:
   explicit GfxRenderer(HalDisplay& halDisplay)
@@ -104,6 +106,30 @@ class GfxRenderer {
   void drawBitmap1Bit(const Bitmap& bitmap, int x, int y, int maxWidth, int maxHeight) const;
   void fillPolygon(const int* xPoints, const int* yPoints, int numPoints, bool state = true) const;
 
+  // Packed page blits: whole bytes go straight into the frame buffer, with 8x8 bit transposes where the source
+  // layout runs across the panel rows. Pixels are written opaquely. Rectangles that are not 8-pixel aligned or not
+  // fully on screen fall back to per-pixel writes.
+  // 1 bit per pixel, row-major, MSB = leftmost pixel, set bit = white (XTG page layout)
+  void blitPacked1Bit(const uint8_t* src, int x, int y, int width, int height) const;
+  // 2 bits per pixel as two bit planes, column-major with columns stored right to left, MSB = topmost pixel (XTH
+  // page layout). Pixels whose value (bit1 << 1 | bit2) has its bit set in levelMask are drawn with `state`, all
+  // others with !state.
+  void blitPacked2Bit(const uint8_t* plane1, const uint8_t* plane2, int x, int y, int width, int height,
+                      uint8_t levelMask, bool state) const;
+
+  // Panel-space view of a logical rectangle, for caches stored in panel orientation. Panel pixel (x + c, y + r)
+  // shows the rectangle's pixel (originX + c * columnDx + r * rowDx, originY + c * columnDy + r * rowDy).
+  struct PanelRect {
+    int x, y, width, height;
+    int originX, originY;
+    int columnDx, columnDy;
+    int rowDx, rowDy;
+  };
+  PanelRect toPanelRect(int x, int y, int width, int height) const;
+  // Opaque write of `width` pixels (MSB first, set bit = white) to panel row y from panel column x; any bit alignment.
+  // Rows not fully on the panel are skipped.
+  void writePanelRow(int x, int y, const uint8_t* bits, int width) const;
+
   // Text
   int getTextWidth(int fontId, const char* text, EpdFontFamily::Style style = EpdFontFamily::REGULAR) const;
   void drawCenteredText(int fontId, int y, const char* text, bool black = true,
@@ -112,6 +138,8 @@ class GfxRenderer {
                 EpdFontFamily::Style style = EpdFontFamily::REGULAR) const;
   int getSpaceWidth(int fontId, EpdFontFamily::Style style = EpdFontFamily::REGULAR) const;
   int getTextAdvanceX(int fontId, const char* text, EpdFontFamily::Style style) const;
+  // Advance of one codepoint (replacement glyph if missing), for callers that measure text incrementally
+  int getCodepointAdvanceX(int fontId, uint32_t cp, EpdFontFamily::Style style = EpdFontFamily::REGULAR) const;
   int getFontAscenderSize(int fontId) const;
   int getLineHeight(int fontId) const;
   std::string truncatedText(int fontId, const char* text, int maxWidth,
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <cstdint>
+
+/**
+ * Peak heap use of an operation such as an image decode: how far the free heap dropped below its level at
+ * construction. The heap is only sampled on sample(), so call it after allocating and wherever usage peaks (e.g. once
+ * per decoded row).
+ */
+class HeapWatermark {
+ public:
+  HeapWatermark() : startFree(ESP.getFreeHeap()), lowestFree(startFree) {}
+
+  void sample() {
+    const uint32_t freeHeap = ESP.getFreeHeap();
+    if (freeHeap < lowestFree) lowestFree = freeHeap;
+  }
+  uint32_t peakBytes() const { return startFree - lowestFree; }
+
+ private:
+  uint32_t startFree;
+  uint32_t lowestFree;
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <HalStorage.h>
+
+#include <cstddef>
+
+/**
+ * Byte source an image decoder reads from: a file on the SD card, or an entry read straight out of a ZIP archive.
+ * Decoders read forward; seek() may go back only as far as the source can (any position for files, the look-back
+ * window for compressed streams).
+ */
+class ImageSource {
+ public:
+  virtual ~ImageSource() = default;
+
+  // Reads up to len bytes. Returns the count read, 0 at the end, negative on error.
+  virtual int read(void* buffer, size_t len) = 0;
+  // Skips len bytes forward
+  virtual bool skip(size_t len) = 0;
+  virtual bool seek(size_t position) = 0;
+  virtual size_t position() const = 0;
+};
+
+// Reads an open FsFile; the caller keeps ownership of the file
+class FileImageSource final : public ImageSource {
+ public:
+  explicit FileImageSource(FsFile& file) : file(file) {}
+
+  int read(void* buffer, const size_t len) override { return file.read(buffer, len); }
+  bool skip(const size_t len) override { return file.seekCur(len); }
+  bool seek(const size_t position) override { return file.seek(position); }
+  size_t position() const override { return file.position(); }
+
+ private:
+  FsFile& file;
+};
@@ -3,12 +3,15 @@
 class FsFile;
 class Print;
 class ZipFile;
+class ImageSource;
+struct BmpTarget;
 
 class JpegToBmpConverter {
   static unsigned char jpegReadCallback(unsigned char* pBuf, unsigned char buf_size,
                                         unsigned char* pBytes_actually_read, void* pCallback_data);
-  static bool jpegFileToBmpStreamInternal(class FsFile& jpegFile, Print& bmpOut, int targetWidth, int targetHeight,
-                                          bool oneBit, bool crop = true);
+  // picojpeg cannot read progressive files; these go through ProgressiveJpegDecoder, in gray only
+  static bool progressiveJpegToBmpStreams(ImageSource& jpeg, const BmpTarget* targets, int targetCount,
+                                          bool* written);
 
  public:
   static bool jpegFileToBmpStream(FsFile& jpegFile, Print& bmpOut, bool crop = true);
@@ -16,4 +19,7 @@ class JpegToBmpConverter {
   static bool jpegFileToBmpStreamWithSize(FsFile& jpegFile, Print& bmpOut, int targetMaxWidth, int targetMaxHeight);
   // Convert to 1-bit BMP (black and white only, no grays) for fast home screen rendering
   static bool jpegFileTo1BitBmpStreamWithSize(FsFile& jpegFile, Print& bmpOut, int targetMaxWidth, int targetMaxHeight);
+  // Decode once, from a file or straight from a ZIP entry, and write one BMP per target (e.g. cover and thumbnails).
+  // Returns true if every target was written; once the decode completes, written[i] (if given) tells each one apart.
+  static bool jpegToBmpStreams(ImageSource& jpeg, const BmpTarget* targets, int targetCount, bool* written = nullptr);
 };
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// PackBits run-length coding, as used by TIFF and Mac OS. A header byte n in [0, 127] is followed by n + 1 literal
+// bytes; n in [-127, -1] is followed by one byte to repeat 1 - n times; -128 is a no-op. Decoding needs no
+// dictionary or lookahead, which keeps it cheap enough to run while streaming from the SD card.
+
+// Worst-case encoded size of `length` bytes
+constexpr size_t packBitsMaxSize(const size_t length) { return length + (length + 127) / 128; }
+
+/**
+ * Encodes in[0, length) into out, which must hold packBitsMaxSize(length) bytes.
+ * Only runs of three or more become repeats, so the output never grows past that bound.
+ * @return Encoded size
+ */
+inline size_t packBitsEncode(const uint8_t* in, const size_t length, uint8_t* out) {
+  constexpr size_t MAX_RUN = 128;
+  size_t o = 0;
+  size_t i = 0;
+  while (i < length) {
+    size_t run = 1;
+    while (i + run < length && run < MAX_RUN && in[i + run] == in[i]) {
+      run++;
+    }
+    if (run >= 3) {
+      out[o++] = static_cast<uint8_t>(1 - static_cast<int>(run));
+      out[o++] = in[i];
+      i += run;
+      continue;
+    }
+
+    // Literal, up to the next run of three equal bytes
+    const size_t start = i++;
+    while (i < length && i - start < MAX_RUN && !(i + 2 < length && in[i] == in[i + 1] && in[i] == in[i + 2])) {
+      i++;
+    }
+    out[o++] = static_cast<uint8_t>(i - start - 1);
+    memcpy(out + o, in + start, i - start);
+    o += i - start;
+  }
+  return o;
+}
+
+/**
+ * Incremental PackBits decoder. Input and output may be split at any byte; runs left unfinished by one call carry
+ * over to the next.
+ */
+class PackBitsDecoder {
+ public:
+  // Decodes from in[0, inLen) into out[0, outLen). Returns bytes written; `consumed` receives input bytes used.
+  // A repeat run can still produce output after its input is used up, so call again with no input before refilling.
+  size_t decode(const uint8_t* in, const size_t inLen, size_t& consumed, uint8_t* out, const size_t outLen) {
+    size_t i = 0;
+    size_t o = 0;
+    while (o < outLen) {
+      if (remaining == 0) {
+        if (i >= inLen) {
+          break;
+        }
+        const auto header = static_cast<int8_t>(in[i++]);
+        if (header >= 0) {
+          remaining = header + 1;
+          repeating = false;
+        } else if (header != -128) {
+          remaining = 1 - header;
+          repeating = true;
+          haveValue = false;
+        }
+        continue;
+      }
+
+      size_t n;
+      if (repeating) {
+        if (!haveValue) {
+          if (i >= inLen) {
+            break;
+          }
+          value = in[i++];
+          haveValue = true;
+        }
+        n = std::min(remaining, outLen - o);
+        memset(out + o, value, n);
+      } else {
+        n = std::min({remaining, outLen - o, inLen - i});
+        if (n == 0) {
+          break;
+        }
+        memcpy(out + o, in + i, n);
+        i += n;
+      }
+      o += n;
+      remaining -= n;
+    }
+    consumed = i;
+    return o;
+  }
+
+ private:
+  size_t remaining = 0;  // Bytes left in the current literal or repeat run
+  bool repeating = false;
+  bool haveValue = false;  // Repeat value read (it may arrive in a later call than its header)
+  uint8_t value = 0;
+};
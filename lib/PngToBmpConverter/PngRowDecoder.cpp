@@ -0,0 +1,428 @@
+#include "PngRowDecoder.h"
+
+#include <ImageSource.h>
+#include <Logging.h>
+#include <miniz.h>
+
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+constexpr uint8_t PNG_SIGNATURE[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+constexpr size_t INPUT_BUFFER_BYTES = 2048;
+
+// PNG color types
+enum PngColorType : uint8_t {
+  PNG_COLOR_GRAYSCALE = 0,
+  PNG_COLOR_RGB = 2,
+  PNG_COLOR_PALETTE = 3,
+  PNG_COLOR_GRAYSCALE_ALPHA = 4,
+  PNG_COLOR_RGBA = 6,
+};
+
+// PNG filter types
+enum PngFilter : uint8_t {
+  PNG_FILTER_NONE = 0,
+  PNG_FILTER_SUB = 1,
+  PNG_FILTER_UP = 2,
+  PNG_FILTER_AVERAGE = 3,
+  PNG_FILTER_PAETH = 4,
+};
+
+inline uint32_t readBE32(const uint8_t* bytes) {
+  return (static_cast<uint32_t>(bytes[0]) << 24) | (static_cast<uint32_t>(bytes[1]) << 16) |
+         (static_cast<uint32_t>(bytes[2]) << 8) | bytes[3];
+}
+
+// Paeth predictor function per PNG spec
+inline uint8_t paethPredictor(uint8_t a, uint8_t b, uint8_t c) {
+  int p = static_cast<int>(a) + b - c;
+  int pa = p > a ? p - a : a - p;
+  int pb = p > b ? p - b : b - p;
+  int pc = p > c ? p - c : c - p;
+  if (pa <= pb && pa <= pc) return a;
+  if (pb <= pc) return b;
+  return c;
+}
+
+inline uint8_t rgbToGray(const uint8_t r, const uint8_t g, const uint8_t b) {
+  return (r * 77 + g * 150 + b * 29) >> 8;
+}
+
+// Blends onto a white background
+inline uint8_t blendOnWhite(const uint8_t gray, const uint8_t alpha) {
+  return (gray * alpha + 255 * (255 - alpha)) / 255;
+}
+
+}  // namespace
+
+PngRowDecoder::~PngRowDecoder() {
+  free(paletteGray);
+  free(currentRow);
+  free(previousRow);
+  free(input);
+  free(inflator);
+  free(window);
+}
+
+bool PngRowDecoder::readChunkHeader(uint32_t& length, uint8_t* type) {
+  uint8_t header[8];
+  if (source.read(header, sizeof(header)) != sizeof(header)) return false;
+  length = readBE32(header);
+  memcpy(type, header + 4, 4);
+  return true;
+}
+
+bool PngRowDecoder::begin() {
+  // Signature, then the IHDR chunk, which must come first
+  uint8_t header[33];
+  if (source.read(header, sizeof(header)) != sizeof(header) || memcmp(header, PNG_SIGNATURE, 8) != 0 ||
+      memcmp(header + 12, "IHDR", 4) != 0) {
+    LOG_ERR("PNG", "Invalid PNG signature or header");
+    return false;
+  }
+
+  const uint32_t imageWidth = readBE32(header + 16);
+  const uint32_t imageHeight = readBE32(header + 20);
+  bitDepth = header[24];
+  colorType = header[25];
+  const uint8_t compression = header[26];
+  const uint8_t filter = header[27];
+  const uint8_t interlace = header[28];
+  LOG_DBG("PNG", "Image: %ux%u, depth=%u, color=%u, interlace=%u", imageWidth, imageHeight, bitDepth, colorType,
+          interlace);
+
+  if (compression != 0 || filter != 0) {
+    LOG_ERR("PNG", "Unsupported compression/filter method");
+    return false;
+  }
+  if (interlace != 0) {
+    LOG_ERR("PNG", "Interlaced PNGs not supported");
+    return false;
+  }
+  if (imageWidth == 0 || imageHeight == 0 || imageWidth > INT16_MAX || imageHeight > INT16_MAX) {
+    LOG_ERR("PNG", "Unsupported PNG dimensions: %ux%u", imageWidth, imageHeight);
+    return false;
+  }
+  width = imageWidth;
+  height = imageHeight;
+
+  // Channels per pixel, for the depths each color type allows
+  int channels;
+  bool depthValid;
+  switch (colorType) {
+    case PNG_COLOR_GRAYSCALE:
+      channels = 1;
+      depthValid = bitDepth == 1 || bitDepth == 2 || bitDepth == 4 || bitDepth == 8 || bitDepth == 16;
+      break;
+    case PNG_COLOR_RGB:
+      channels = 3;
+      depthValid = bitDepth == 8 || bitDepth == 16;
+      break;
+    case PNG_COLOR_PALETTE:
+      channels = 1;
+      depthValid = bitDepth == 1 || bitDepth == 2 || bitDepth == 4 || bitDepth == 8;
+      break;
+    case PNG_COLOR_GRAYSCALE_ALPHA:
+      channels = 2;
+      depthValid = bitDepth == 8 || bitDepth == 16;
+      break;
+    case PNG_COLOR_RGBA:
+      channels = 4;
+      depthValid = bitDepth == 8 || bitDepth == 16;
+      break;
+    default:
+      channels = 0;
+      depthValid = false;
+      break;
+  }
+  if (!depthValid) {
+    LOG_ERR("PNG", "Unsupported color type %u at depth %u", colorType, bitDepth);
+    return false;
+  }
+  const size_t bitsPerPixel = channels * bitDepth;
+  bytesPerPixel = bitsPerPixel < 8 ? 1 : bitsPerPixel / 8;
+  rawRowBytes = (static_cast<size_t>(width) * bitsPerPixel + 7) / 8;
+
+  // Collect the palette and its transparency on the way to the first IDAT chunk
+  while (true) {
+    uint32_t chunkLength;
+    uint8_t chunkType[4];
+    if (!readChunkHeader(chunkLength, chunkType)) {
+      LOG_ERR("PNG", "No IDAT chunk found");
+      return false;
+    }
+
+    if (memcmp(chunkType, "IDAT", 4) == 0) {
+      chunkRemaining = chunkLength;
+      break;
+    }
+    if (memcmp(chunkType, "IEND", 4) == 0) {
+      LOG_ERR("PNG", "No IDAT chunk found");
+      return false;
+    }
+
+    size_t chunkRead = 0;
+    if (colorType == PNG_COLOR_PALETTE && memcmp(chunkType, "PLTE", 4) == 0 && !paletteGray) {
+      // Entries the palette does not define stay black
+      paletteGray = static_cast<uint8_t*>(calloc(256, 1));
+      if (!paletteGray) {
+        LOG_ERR("PNG", "Failed to allocate palette");
+        return false;
+      }
+      for (uint32_t i = 0; i < chunkLength / 3 && i < 256; i++) {
+        uint8_t rgb[3];
+        if (source.read(rgb, 3) != 3) return false;
+        paletteGray[i] = rgbToGray(rgb[0], rgb[1], rgb[2]);
+        chunkRead += 3;
+      }
+    } else if (paletteGray && memcmp(chunkType, "tRNS", 4) == 0) {
+      for (uint32_t i = 0; i < chunkLength && i < 256; i++) {
+        uint8_t alpha;
+        if (source.read(&alpha, 1) != 1) return false;
+        paletteGray[i] = blendOnWhite(paletteGray[i], alpha);
+        chunkRead++;
+      }
+    }
+    // Rest of the chunk and its CRC
+    if (!source.skip(chunkLength - chunkRead + 4)) return false;
+  }
+
+  if (colorType == PNG_COLOR_PALETTE && !paletteGray) {
+    LOG_ERR("PNG", "Palette image without a palette");
+    return false;
+  }
+
+  currentRow = static_cast<uint8_t*>(malloc(rawRowBytes));
+  previousRow = static_cast<uint8_t*>(calloc(rawRowBytes, 1));
+  input = static_cast<uint8_t*>(malloc(INPUT_BUFFER_BYTES));
+  if (!currentRow || !previousRow || !input) {
+    LOG_ERR("PNG", "Failed to allocate scanline buffers (%u bytes each)", static_cast<unsigned>(rawRowBytes));
+    return false;
+  }
+
+  // zlib header: the window the encoder used bounds how far back the data can refer
+  uint8_t cmf, flags;
+  if (!readCompressedByte(cmf) || !readCompressedByte(flags)) {
+    LOG_ERR("PNG", "Missing zlib header");
+    return false;
+  }
+  if ((cmf & 0x0F) != 8 || (cmf >> 4) > 7 || ((cmf << 8) | flags) % 31 != 0 || (flags & 0x20)) {
+    LOG_ERR("PNG", "Invalid zlib header");
+    return false;
+  }
+  windowSize = static_cast<size_t>(1) << ((cmf >> 4) + 8);
+
+  inflator = static_cast<tinfl_decompressor*>(malloc(sizeof(tinfl_decompressor)));
+  window = static_cast<uint8_t*>(malloc(windowSize));
+  if (!inflator || !window) {
+    LOG_ERR("PNG", "Failed to allocate inflater (%u byte window)", static_cast<unsigned>(windowSize));
+    return false;
+  }
+  tinfl_init(inflator);
+  LOG_DBG("PNG", "Decoding with %u byte rows and a %u byte window", static_cast<unsigned>(rawRowBytes),
+          static_cast<unsigned>(windowSize));
+  return true;
+}
+
+bool PngRowDecoder::feedInput() {
+  // IDAT chunks are consecutive: the first other chunk ends the image data
+  while (chunkRemaining == 0) {
+    uint32_t chunkLength;
+    uint8_t chunkType[4];
+    if (!source.skip(4) || !readChunkHeader(chunkLength, chunkType)) return false;
+    if (memcmp(chunkType, "IDAT", 4) != 0) {
+      idatFinished = true;
+      inputFilled = 0;
+      inputCursor = 0;
+      return true;
+    }
+    chunkRemaining = chunkLength;
+  }
+
+  const size_t toRead = chunkRemaining < INPUT_BUFFER_BYTES ? chunkRemaining : INPUT_BUFFER_BYTES;
+  const int bytesRead = source.read(input, toRead);
+  if (bytesRead <= 0) return false;
+  chunkRemaining -= bytesRead;
+  inputFilled = bytesRead;
+  inputCursor = 0;
+  return true;
+}
+
+bool PngRowDecoder::readCompressedByte(uint8_t& byte) {
+  while (inputCursor >= inputFilled) {
+    if (idatFinished || !feedInput()) return false;
+  }
+  byte = input[inputCursor++];
+  return true;
+}
+
+bool PngRowDecoder::inflateBytes(uint8_t* dest, size_t needed) {
+  while (needed > 0) {
+    // Copy what is already inflated
+    if (consumed < produced) {
+      const size_t windowPos = consumed & (windowSize - 1);
+      size_t chunk = produced - consumed;
+      if (chunk > windowSize - windowPos) chunk = windowSize - windowPos;
+      if (chunk > needed) chunk = needed;
+      memcpy(dest, window + windowPos, chunk);
+      dest += chunk;
+      consumed += chunk;
+      needed -= chunk;
+      continue;
+    }
+
+    if (inflateDone) {
+      LOG_ERR("PNG", "Image data ended early");
+      return false;
+    }
+    if (inputCursor >= inputFilled && !idatFinished && !feedInput()) {
+      LOG_ERR("PNG", "Failed to read image data");
+      return false;
+    }
+
+    size_t inBytes = inputFilled - inputCursor;
+    const size_t outputPos = produced & (windowSize - 1);
+    size_t outBytes = windowSize - outputPos;
+    const tinfl_status status = tinfl_decompress(inflator, input + inputCursor, &inBytes, window, window + outputPos,
+                                                 &outBytes, idatFinished ? 0 : TINFL_FLAG_HAS_MORE_INPUT);
+    inputCursor += inBytes;
+    produced += outBytes;
+    if (status < 0) {
+      LOG_ERR("PNG", "tinfl_decompress() failed with status %d", status);
+      return false;
+    }
+    if (status == TINFL_STATUS_DONE) {
+      inflateDone = true;
+    }
+  }
+  return true;
+}
+
+bool PngRowDecoder::unfilterRow(const uint8_t filterType) {
+  const size_t bpp = bytesPerPixel;
+  uint8_t* row = currentRow;
+  const uint8_t* prev = previousRow;
+
+  switch (filterType) {
+    case PNG_FILTER_NONE:
+      break;
+
+    case PNG_FILTER_SUB:
+      for (size_t i = bpp; i < rawRowBytes; i++) {
+        row[i] += row[i - bpp];
+      }
+      break;
+
+    case PNG_FILTER_UP:
+      for (size_t i = 0; i < rawRowBytes; i++) {
+        row[i] += prev[i];
+      }
+      break;
+
+    case PNG_FILTER_AVERAGE:
+      for (size_t i = 0; i < rawRowBytes; i++) {
+        const uint8_t a = i >= bpp ? row[i - bpp] : 0;
+        row[i] += (a + prev[i]) / 2;
+      }
+      break;
+
+    case PNG_FILTER_PAETH:
+      for (size_t i = 0; i < rawRowBytes; i++) {
+        const uint8_t a = i >= bpp ? row[i - bpp] : 0;
+        const uint8_t c = i >= bpp ? prev[i - bpp] : 0;
+        row[i] += paethPredictor(a, prev[i], c);
+      }
+      break;
+
+    default:
+      LOG_ERR("PNG", "Unknown filter type: %d", filterType);
+      return false;
+  }
+  return true;
+}
+
+// Batch-convert an entire scanline to grayscale.
+// Branches once on colorType/bitDepth, then runs a tight loop for the whole row. 16-bit samples use their high byte.
+void PngRowDecoder::convertRowToGray(uint8_t* gray) const {
+  const uint8_t* src = currentRow;
+  const int w = width;
+
+  switch (colorType) {
+    case PNG_COLOR_GRAYSCALE:
+      if (bitDepth == 8) {
+        memcpy(gray, src, w);
+      } else if (bitDepth == 16) {
+        for (int x = 0; x < w; x++) gray[x] = src[x * 2];
+      } else {
+        const int ppb = 8 / bitDepth;
+        const uint8_t mask = (1 << bitDepth) - 1;
+        for (int x = 0; x < w; x++) {
+          const int shift = (ppb - 1 - (x % ppb)) * bitDepth;
+          gray[x] = (src[x / ppb] >> shift & mask) * 255 / mask;
+        }
+      }
+      break;
+
+    case PNG_COLOR_RGB: {
+      // 8-bit is the most common EPUB cover format
+      const int step = bitDepth == 8 ? 1 : 2;
+      for (int x = 0; x < w; x++) {
+        const uint8_t* p = src + x * 3 * step;
+        gray[x] = rgbToGray(p[0], p[step], p[2 * step]);
+      }
+      break;
+    }
+
+    case PNG_COLOR_PALETTE:
+      if (bitDepth == 8) {
+        for (int x = 0; x < w; x++) gray[x] = paletteGray[src[x]];
+      } else {
+        const int ppb = 8 / bitDepth;
+        const uint8_t mask = (1 << bitDepth) - 1;
+        for (int x = 0; x < w; x++) {
+          const int shift = (ppb - 1 - (x % ppb)) * bitDepth;
+          gray[x] = paletteGray[(src[x / ppb] >> shift) & mask];
+        }
+      }
+      break;
+
+    case PNG_COLOR_GRAYSCALE_ALPHA: {
+      const int step = bitDepth == 8 ? 1 : 2;
+      for (int x = 0; x < w; x++) {
+        const uint8_t* p = src + x * 2 * step;
+        gray[x] = blendOnWhite(p[0], p[step]);
+      }
+      break;
+    }
+
+    case PNG_COLOR_RGBA: {
+      const int step = bitDepth == 8 ? 1 : 2;
+      for (int x = 0; x < w; x++) {
+        const uint8_t* p = src + x * 4 * step;
+        gray[x] = blendOnWhite(rgbToGray(p[0], p[step], p[2 * step]), p[3 * step]);
+      }
+      break;
+    }
+
+    default:
+      memset(gray, 128, w);
+      break;
+  }
+}
+
+bool PngRowDecoder::nextRow(uint8_t* gray) {
+  // Filter byte, then the raw row
+  uint8_t filterType;
+  if (!inflateBytes(&filterType, 1) || !inflateBytes(currentRow, rawRowBytes) || !unfilterRow(filterType)) {
+    return false;
+  }
+  convertRowToGray(gray);
+
+  // Swap current/previous row buffers
+  uint8_t* temp = previousRow;
+  previousRow = currentRow;
+  currentRow = temp;
+  return true;
+}
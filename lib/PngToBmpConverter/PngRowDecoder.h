@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+class ImageSource;
+struct tinfl_decompressor_tag;
+
+/**
+ * Streaming PNG decoder handing out one row of 8-bit gray at a time, with transparent pixels blended onto white.
+ *
+ * It holds two raw rows, the inflate state and a dictionary window only as large as the encoder declared (the zlib
+ * header's CINFO, at most 32KB), so its memory grows with the image width alone and any height streams through.
+ * Interlaced images are not supported.
+ */
+class PngRowDecoder {
+ public:
+  explicit PngRowDecoder(ImageSource& source) : source(source) {}
+  ~PngRowDecoder();
+
+  PngRowDecoder(const PngRowDecoder&) = delete;
+  PngRowDecoder& operator=(const PngRowDecoder&) = delete;
+
+  // Reads the header and the chunks up to the image data, from the source's current position
+  bool begin();
+  int getWidth() const { return width; }
+  int getHeight() const { return height; }
+  uint8_t getBitDepth() const { return bitDepth; }
+  uint8_t getColorType() const { return colorType; }
+
+  // Decodes the next row into getWidth() gray values
+  bool nextRow(uint8_t* gray);
+
+ private:
+  bool readChunkHeader(uint32_t& length, uint8_t* type);
+  // Refills the input buffer from the IDAT chunks. Sets idatFinished after the last one; false on a read error.
+  bool feedInput();
+  bool readCompressedByte(uint8_t& byte);
+  bool inflateBytes(uint8_t* dest, size_t needed);
+  bool unfilterRow(uint8_t filterType);
+  void convertRowToGray(uint8_t* gray) const;
+
+  ImageSource& source;
+
+  // Header
+  int width = 0;
+  int height = 0;
+  uint8_t bitDepth = 0;
+  uint8_t colorType = 0;
+  uint8_t bytesPerPixel = 0;  // Rounded up to 1 for sub-byte depths, the distance filters look back
+  size_t rawRowBytes = 0;
+  uint8_t* paletteGray = nullptr;  // Palette images: the gray of each entry, transparency already blended
+
+  // Defiltered rows
+  uint8_t* currentRow = nullptr;
+  uint8_t* previousRow = nullptr;
+
+  // Compressed input, read from the IDAT chunks
+  uint8_t* input = nullptr;
+  size_t inputFilled = 0;
+  size_t inputCursor = 0;
+  uint32_t chunkRemaining = 0;
+  bool idatFinished = false;
+
+  // Inflation into a circular window, rows are copied out of it
+  tinfl_decompressor_tag* inflator = nullptr;
+  uint8_t* window = nullptr;
+  size_t windowSize = 0;
+  size_t produced = 0;
+  size_t consumed = 0;
+  bool inflateDone = false;
+};
@@ -2,13 +2,15 @@
 
 class FsFile;
 class Print;
+class ImageSource;
+struct BmpTarget;
 
 class PngToBmpConverter {
-  static bool pngFileToBmpStreamInternal(FsFile& pngFile, Print& bmpOut, int targetWidth, int targetHeight, bool oneBit,
-                                         bool crop = true);
-
  public:
   static bool pngFileToBmpStream(FsFile& pngFile, Print& bmpOut, bool crop = true);
   static bool pngFileToBmpStreamWithSize(FsFile& pngFile, Print& bmpOut, int targetMaxWidth, int targetMaxHeight);
   static bool pngFileTo1BitBmpStreamWithSize(FsFile& pngFile, Print& bmpOut, int targetMaxWidth, int targetMaxHeight);
+  // Decode once, from a file or straight from a ZIP entry, and write one BMP per target (e.g. cover and thumbnails).
+  // Returns true if every target was written; once the decode completes, written[i] (if given) tells each one apart.
+  static bool pngToBmpStreams(ImageSource& png, const BmpTarget* targets, int targetCount, bool* written = nullptr);
 };
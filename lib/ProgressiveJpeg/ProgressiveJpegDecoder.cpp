@@ -0,0 +1,861 @@
+#include "ProgressiveJpegDecoder.h"
+
+#include <ImageSource.h>
+#include <Logging.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+enum JpegMarker : uint8_t {
+  M_SOF2 = 0xC2,
+  M_DHT = 0xC4,
+  M_RST0 = 0xD0,
+  M_RST7 = 0xD7,
+  M_SOI = 0xD8,
+  M_EOI = 0xD9,
+  M_SOS = 0xDA,
+  M_DQT = 0xDB,
+  M_DRI = 0xDD,
+  M_APP0 = 0xE0,
+  M_APP15 = 0xEF,
+  M_COM = 0xFE,
+};
+
+constexpr int FAST_BITS = 9;  // Codes up to this long are decoded with a single table lookup
+
+// Coefficients held in RAM up to this size, spilled to the SD card beyond it
+constexpr size_t MAX_IN_MEMORY_STORE_BYTES = 64 * 1024;
+// Size of the band of block rows kept in RAM while spilling
+constexpr size_t SPILL_BAND_BYTES = 16 * 1024;
+constexpr char SPILL_PATH[] = "/.crosspoint/progressive.tmp";
+
+constexpr uint8_t ZIGZAG_TO_NATURAL[64] = {0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+                                           12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+                                           35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+                                           58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+// Sign-extends a value received in the given number of bits
+inline int extend(const int value, const int bits) {
+  return value < (1 << (bits - 1)) ? value - (1 << bits) + 1 : value;
+}
+
+inline uint8_t clamp8(const int value) { return value < 0 ? 0 : (value > 255 ? 255 : value); }
+
+// Integer 8x8 inverse DCT (AAN-style separable, 12-bit fixed point constants), as in stb_image. Input in natural
+// order, already dequantized.
+#define F2F(x) static_cast<int>((x) * 4096 + 0.5f)
+#define IDCT_1D(s0, s1, s2, s3, s4, s5, s6, s7)           \
+  int t0, t1, t2, t3, p1, p2, p3, p4, p5, x0, x1, x2, x3; \
+  p2 = s2;                                                \
+  p3 = s6;                                                \
+  p1 = (p2 + p3) * F2F(0.5411961f);                       \
+  t2 = p1 + p3 * F2F(-1.847759065f);                      \
+  t3 = p1 + p2 * F2F(0.765366865f);                       \
+  p2 = s0;                                                \
+  p3 = s4;                                                \
+  t0 = (p2 + p3) * 4096;                                  \
+  t1 = (p2 - p3) * 4096;                                  \
+  x0 = t0 + t3;                                           \
+  x3 = t0 - t3;                                           \
+  x1 = t1 + t2;                                           \
+  x2 = t1 - t2;                                           \
+  t0 = s7;                                                \
+  t1 = s5;                                                \
+  t2 = s3;                                                \
+  t3 = s1;                                                \
+  p3 = t0 + t2;                                           \
+  p4 = t1 + t3;                                           \
+  p1 = t0 + t3;                                           \
+  p2 = t1 + t2;                                           \
+  p5 = (p3 + p4) * F2F(1.175875602f);                     \
+  t0 = t0 * F2F(0.298631336f);                            \
+  t1 = t1 * F2F(2.053119869f);                            \
+  t2 = t2 * F2F(3.072711026f);                            \
+  t3 = t3 * F2F(1.501321110f);                            \
+  p1 = p5 + p1 * F2F(-0.899976223f);                      \
+  p2 = p5 + p2 * F2F(-2.562915447f);                      \
+  p3 = p3 * F2F(-1.961570560f);                           \
+  p4 = p4 * F2F(-0.390180644f);                           \
+  t3 += p1 + p4;                                          \
+  t2 += p2 + p3;                                          \
+  t1 += p2 + p4;                                          \
+  t0 += p1 + p3;
+
+void idct8x8(const int* data, uint8_t* out) {
+  int values[64];
+
+  // Columns, keeping 2 extra bits of precision
+  for (int i = 0; i < 8; i++) {
+    const int* d = data + i;
+    int* v = values + i;
+    if (d[8] == 0 && d[16] == 0 && d[24] == 0 && d[32] == 0 && d[40] == 0 && d[48] == 0 && d[56] == 0) {
+      const int dc = d[0] * 4;
+      v[0] = v[8] = v[16] = v[24] = v[32] = v[40] = v[48] = v[56] = dc;
+      continue;
+    }
+    IDCT_1D(d[0], d[8], d[16], d[24], d[32], d[40], d[48], d[56])
+    x0 += 512;
+    x1 += 512;
+    x2 += 512;
+    x3 += 512;
+    v[0] = (x0 + t3) >> 10;
+    v[56] = (x0 - t3) >> 10;
+    v[8] = (x1 + t2) >> 10;
+    v[48] = (x1 - t2) >> 10;
+    v[16] = (x2 + t1) >> 10;
+    v[40] = (x2 - t1) >> 10;
+    v[24] = (x3 + t0) >> 10;
+    v[32] = (x3 - t0) >> 10;
+  }
+
+  // Rows: drop the 1 << 17 scale with rounding and level-shift to 0..255
+  for (int i = 0; i < 8; i++) {
+    const int* v = values + i * 8;
+    uint8_t* o = out + i * 8;
+    IDCT_1D(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7])
+    x0 += 65536 + (128 << 17);
+    x1 += 65536 + (128 << 17);
+    x2 += 65536 + (128 << 17);
+    x3 += 65536 + (128 << 17);
+    o[0] = clamp8((x0 + t3) >> 17);
+    o[7] = clamp8((x0 - t3) >> 17);
+    o[1] = clamp8((x1 + t2) >> 17);
+    o[6] = clamp8((x1 - t2) >> 17);
+    o[2] = clamp8((x2 + t1) >> 17);
+    o[5] = clamp8((x2 - t1) >> 17);
+    o[3] = clamp8((x3 + t0) >> 17);
+    o[4] = clamp8((x3 - t0) >> 17);
+  }
+}
+
+#undef IDCT_1D
+#undef F2F
+
+}  // namespace
+
+struct ProgressiveJpegDecoder::HuffmanTable {
+  uint8_t fast[1 << FAST_BITS];  // Symbol index per FAST_BITS-bit prefix, 255 when the code is longer
+  uint8_t values[256];
+  uint8_t sizes[257];    // Code length per symbol index
+  uint32_t maxCode[18];  // Per length, one past the largest code, left-aligned to 16 bits
+  int delta[17];         // Per length, symbol index minus code
+  bool defined;
+
+  // Builds the canonical codes from the count of codes of each length 1..16
+  bool build(const uint8_t* counts) {
+    int k = 0;
+    for (int length = 1; length <= 16; length++) {
+      for (int i = 0; i < counts[length - 1]; i++) sizes[k++] = length;
+    }
+    sizes[k] = 0;
+
+    uint16_t codes[256];
+    int code = 0;
+    k = 0;
+    for (int length = 1; length <= 16; length++) {
+      delta[length] = k - code;
+      while (sizes[k] == length) codes[k++] = code++;
+      if (code - 1 >= (1 << length)) return false;
+      maxCode[length] = static_cast<uint32_t>(code) << (16 - length);
+      code <<= 1;
+    }
+    maxCode[17] = 0xFFFFFFFF;
+
+    memset(fast, 255, sizeof(fast));
+    for (int i = 0; i < k; i++) {
+      const int size = sizes[i];
+      if (size > FAST_BITS) continue;
+      const int first = codes[i] << (FAST_BITS - size);
+      const int count = 1 << (FAST_BITS - size);
+      for (int j = 0; j < count; j++) fast[first + j] = i;
+    }
+    defined = true;
+    return true;
+  }
+};
+
+ProgressiveJpegDecoder::~ProgressiveJpegDecoder() { release(); }
+
+void ProgressiveJpegDecoder::release() {
+  free(huffmanTables);
+  free(band);
+  free(pixelRows);
+  huffmanTables = nullptr;
+  band = nullptr;
+  pixelRows = nullptr;
+  if (spilled) {
+    spillFile.close();
+    Storage.remove(SPILL_PATH);
+    spilled = false;
+  }
+}
+
+int ProgressiveJpegDecoder::readByte() {
+  if (readPos >= readFilled) {
+    const int bytesRead = source.read(readBuffer, sizeof(readBuffer));
+    if (bytesRead < 0) sourceFailed = true;
+    if (bytesRead <= 0) return -1;
+    readFilled = bytesRead;
+    readPos = 0;
+  }
+  return readBuffer[readPos++];
+}
+
+bool ProgressiveJpegDecoder::readBytes(uint8_t* out, const size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    const int byte = readByte();
+    if (byte < 0) return false;
+    out[i] = byte;
+  }
+  return true;
+}
+
+bool ProgressiveJpegDecoder::readWord(uint16_t& value) {
+  uint8_t bytes[2];
+  if (!readBytes(bytes, 2)) return false;
+  value = (bytes[0] << 8) | bytes[1];
+  return true;
+}
+
+bool ProgressiveJpegDecoder::skipSegment() {
+  uint16_t length;
+  if (!readWord(length) || length < 2) return false;
+  const size_t buffered = readFilled - readPos;
+  const size_t toSkip = length - 2;
+  if (toSkip <= buffered) {
+    readPos += toSkip;
+    return true;
+  }
+  readPos = readFilled;
+  return source.skip(toSkip - buffered);
+}
+
+int ProgressiveJpegDecoder::readMarker() {
+  while (true) {
+    int byte = readByte();
+    if (byte < 0) return -1;
+    if (byte != 0xFF) continue;
+    do {
+      byte = readByte();
+    } while (byte == 0xFF);
+    if (byte < 0) return -1;
+    if (byte != 0) return byte;  // 0xFF00 is a stuffed data byte
+  }
+}
+
+int ProgressiveJpegDecoder::findMarker() {
+  int marker;
+  do {
+    marker = readMarker();
+  } while (marker >= M_RST0 && marker <= M_RST7);
+  return marker;
+}
+
+bool ProgressiveJpegDecoder::begin() {
+  release();
+  if (readByte() != 0xFF || readByte() != M_SOI) {
+    LOG_ERR("JPG", "Not a JPEG file");
+    return false;
+  }
+
+  huffmanTables = static_cast<HuffmanTable*>(calloc(8, sizeof(HuffmanTable)));
+  if (!huffmanTables) {
+    LOG_ERR("JPG", "Failed to allocate Huffman tables");
+    return false;
+  }
+
+  bool frameRead = false;
+  while (true) {
+    const int marker = findMarker();
+    if (marker == M_SOS && frameRead) {
+      nextMarker = marker;
+      return true;
+    }
+    if (marker == M_SOF2) {
+      if (!readFrameHeader()) return false;
+      frameRead = true;
+      continue;
+    }
+    // Any other frame type, arithmetic coding, or image data before the frame header
+    if (marker < 0 || marker == M_EOI || marker == M_SOS || (marker >= 0xC0 && marker <= 0xCF && marker != M_DHT)) {
+      LOG_ERR("JPG", "Not a progressive Huffman-coded JPEG (marker 0x%02X)", marker);
+      return false;
+    }
+    if (!readSegment(marker)) return false;
+  }
+}
+
+bool ProgressiveJpegDecoder::readSegment(const int marker) {
+  switch (marker) {
+    case M_DQT:
+      return readQuantTables();
+    case M_DHT:
+      return readHuffmanTables();
+    case M_DRI:
+      return readRestartInterval();
+    default:
+      if ((marker >= M_APP0 && marker <= M_APP15) || marker == M_COM) {
+        return skipSegment();
+      }
+      LOG_ERR("JPG", "Unsupported JPEG marker 0x%02X", marker);
+      return false;
+  }
+}
+
+bool ProgressiveJpegDecoder::readFrameHeader() {
+  uint8_t header[17];
+  if (!readBytes(header, 8)) return false;
+  const int length = (header[0] << 8) | header[1];
+  const int precision = header[2];
+  height = (header[3] << 8) | header[4];
+  width = (header[5] << 8) | header[6];
+  componentCount = header[7];
+
+  if (precision != 8 || width == 0 || height == 0 || (componentCount != 1 && componentCount != 3) ||
+      length != 8 + 3 * componentCount || !readBytes(header + 8, 3 * componentCount)) {
+    LOG_ERR("JPG", "Unsupported progressive frame (%d-bit, %dx%d, %d components)", precision, width, height,
+            componentCount);
+    return false;
+  }
+
+  maxH = 1;
+  maxV = 1;
+  for (int i = 0; i < componentCount; i++) {
+    Component& component = components[i];
+    component.id = header[8 + i * 3];
+    component.h = header[9 + i * 3] >> 4;
+    component.v = header[9 + i * 3] & 0x0F;
+    component.quantTable = header[10 + i * 3];
+    if (component.h < 1 || component.h > 4 || component.v < 1 || component.v > 4 || component.quantTable > 3) {
+      LOG_ERR("JPG", "Bad sampling factors or quantization table");
+      return false;
+    }
+    maxH = std::max(maxH, component.h);
+    maxV = std::max(maxV, component.v);
+  }
+
+  if (componentCount == 1) {
+    // A single component is never interleaved, its MCU is one block whatever the sampling factors say
+    components[0].h = components[0].v = maxH = maxV = 1;
+  } else if (components[0].h != maxH || components[0].v != maxV) {
+    LOG_ERR("JPG", "Unsupported sampling: luma is subsampled");
+    return false;
+  }
+
+  // Luma blocks, padded to whole MCUs of interleaved scans
+  blocksWide = (width + 8 * maxH - 1) / (8 * maxH) * components[0].h;
+  blocksHigh = (height + 8 * maxV - 1) / (8 * maxV) * components[0].v;
+  LOG_DBG("JPG", "Progressive JPEG %dx%d, %d components, %dx%d luma blocks", width, height, componentCount,
+          blocksWide, blocksHigh);
+  return true;
+}
+
+bool ProgressiveJpegDecoder::readQuantTables() {
+  uint16_t length;
+  if (!readWord(length)) return false;
+  int remaining = length - 2;
+  while (remaining > 0) {
+    const int info = readByte();
+    const int precision = info >> 4;
+    const int id = info & 0x0F;
+    if (info < 0 || precision > 1 || id > 3) {
+      LOG_ERR("JPG", "Bad quantization table");
+      return false;
+    }
+    for (int i = 0; i < 64; i++) {
+      uint16_t value;
+      if (precision) {
+        if (!readWord(value)) return false;
+      } else {
+        const int byte = readByte();
+        if (byte < 0) return false;
+        value = byte;
+      }
+      quantTables[id][i] = value;
+    }
+    remaining -= 1 + 64 * (precision + 1);
+  }
+  return remaining == 0;
+}
+
+bool ProgressiveJpegDecoder::readHuffmanTables() {
+  uint16_t length;
+  if (!readWord(length)) return false;
+  int remaining = length - 2;
+  while (remaining > 0) {
+    const int info = readByte();
+    const int tableClass = info >> 4;
+    const int id = info & 0x0F;
+    uint8_t counts[16];
+    if (info < 0 || tableClass > 1 || id > 3 || !readBytes(counts, sizeof(counts))) {
+      LOG_ERR("JPG", "Bad Huffman table");
+      return false;
+    }
+
+    int total = 0;
+    for (const uint8_t count : counts) total += count;
+    HuffmanTable& table = huffmanTables[tableClass * 4 + id];
+    if (total > 256 || !readBytes(table.values, total) || !table.build(counts)) {
+      LOG_ERR("JPG", "Bad Huffman table");
+      return false;
+    }
+    remaining -= 17 + total;
+  }
+  return remaining == 0;
+}
+
+bool ProgressiveJpegDecoder::readRestartInterval() {
+  uint16_t length;
+  return readWord(length) && length == 4 && readWord(restartInterval);
+}
+
+void ProgressiveJpegDecoder::fillBits() {
+  while (bitCount <= 24) {
+    int byte = 0;
+    // Past a marker, the data is padded with zeros
+    if (pendingMarker < 0) {
+      byte = readByte();
+      if (byte == 0xFF) {
+        int next = readByte();
+        while (next == 0xFF) next = readByte();
+        if (next != 0) {
+          pendingMarker = next < 0 ? M_EOI : next;
+          byte = 0;
+        }
+      } else if (byte < 0) {
+        pendingMarker = M_EOI;
+        byte = 0;
+      }
+    }
+    bitBuffer |= static_cast<uint32_t>(byte) << (24 - bitCount);
+    bitCount += 8;
+  }
+}
+
+int ProgressiveJpegDecoder::getBits(const int count) {
+  if (count == 0) return 0;
+  if (bitCount < count) fillBits();
+  const int value = static_cast<int>(bitBuffer >> (32 - count));
+  bitBuffer <<= count;
+  bitCount -= count;
+  return value;
+}
+
+int ProgressiveJpegDecoder::decodeHuffman(const HuffmanTable& table) {
+  if (bitCount < 16) fillBits();
+
+  const int fastIndex = table.fast[bitBuffer >> (32 - FAST_BITS)];
+  if (fastIndex < 255) {
+    const int size = table.sizes[fastIndex];
+    bitBuffer <<= size;
+    bitCount -= size;
+    return table.values[fastIndex];
+  }
+
+  // Longer codes: find the length whose range holds the next 16 bits
+  const uint32_t top = bitBuffer >> 16;
+  int length = FAST_BITS + 1;
+  while (top >= table.maxCode[length]) length++;
+  if (length == 17) return -1;
+
+  const int index = static_cast<int>(bitBuffer >> (32 - length)) + table.delta[length];
+  if (index < 0 || index > 255) return -1;
+  bitBuffer <<= length;
+  bitCount -= length;
+  return table.values[index];
+}
+
+bool ProgressiveJpegDecoder::restart() {
+  const int marker = pendingMarker >= 0 ? pendingMarker : readMarker();
+  bitBuffer = 0;
+  bitCount = 0;
+  eobRun = 0;
+  memset(dcPredictors, 0, sizeof(dcPredictors));
+  if (marker >= M_RST0 && marker <= M_RST7) {
+    pendingMarker = -1;
+    return true;
+  }
+  // Damaged or truncated data: keep the marker, the rest of the scan then reads as zeros
+  pendingMarker = marker < 0 ? M_EOI : marker;
+  return true;
+}
+
+void ProgressiveJpegDecoder::setCoefficient(uint8_t* block, const int zigzagIndex, const int value) {
+  *reinterpret_cast<uint64_t*>(block) |= 1ULL << zigzagIndex;
+  const int index = storedIndex[zigzagIndex];
+  if (index >= 0) coefficientsOf(block)[index] = static_cast<int16_t>(value);
+}
+
+bool ProgressiveJpegDecoder::decodeDcFirst(uint8_t* block, const HuffmanTable& table, int& predictor) {
+  const int size = decodeHuffman(table);
+  if (size < 0 || size > 15) return false;
+  if (size) predictor += extend(getBits(size), size);
+  if (block) coefficientsOf(block)[0] = static_cast<int16_t>(predictor * (1 << approxLow));
+  return true;
+}
+
+bool ProgressiveJpegDecoder::decodeDcRefine(uint8_t* block) {
+  if (getBits(1) && block) coefficientsOf(block)[0] |= 1 << approxLow;
+  return true;
+}
+
+bool ProgressiveJpegDecoder::decodeAcFirst(uint8_t* block) {
+  if (eobRun > 0) {
+    eobRun--;
+    return true;
+  }
+
+  for (int k = spectralStart; k <= spectralEnd; k++) {
+    const int symbol = decodeHuffman(*acTable);
+    if (symbol < 0) return false;
+    const int run = symbol >> 4;
+    const int size = symbol & 0x0F;
+    if (size == 0) {
+      if (run < 15) {
+        // End of band, for this block and the next eobRun ones
+        eobRun = (1U << run) - 1;
+        if (run) eobRun += getBits(run);
+        break;
+      }
+      k += 15;  // Run of 16 zeros
+      continue;
+    }
+    k += run;
+    if (k > spectralEnd) return false;
+    setCoefficient(block, k, extend(getBits(size), size) * (1 << approxLow));
+  }
+  return true;
+}
+
+bool ProgressiveJpegDecoder::decodeAcRefine(uint8_t* block) {
+  const int plusOne = 1 << approxLow;
+  const uint64_t mask = *reinterpret_cast<const uint64_t*>(block);
+  int16_t* coefficients = coefficientsOf(block);
+
+  // Every coefficient already nonzero gets a correction bit wherever the zero runs pass it
+  const auto refine = [&](const int k) {
+    if (!getBits(1)) return;
+    const int index = storedIndex[k];
+    if (index < 0 || (coefficients[index] & plusOne)) return;
+    coefficients[index] += coefficients[index] >= 0 ? plusOne : -plusOne;
+  };
+
+  int k = spectralStart;
+  if (eobRun == 0) {
+    for (; k <= spectralEnd; k++) {
+      const int symbol = decodeHuffman(*acTable);
+      if (symbol < 0) return false;
+      int run = symbol >> 4;
+      const int size = symbol & 0x0F;
+      int value = 0;
+      if (size) {
+        value = getBits(1) ? plusOne : -plusOne;
+      } else if (run != 15) {
+        eobRun = 1U << run;
+        if (run) eobRun += getBits(run);
+        break;
+      }
+
+      // Skip run zero coefficients, refining the nonzero ones on the way, and stop on the next zero one
+      for (; k <= spectralEnd; k++) {
+        if (mask & (1ULL << k)) {
+          refine(k);
+        } else {
+          if (run == 0) break;
+          run--;
+        }
+      }
+      if (value && k <= spectralEnd) setCoefficient(block, k, value);
+    }
+  }
+
+  if (eobRun > 0) {
+    for (; k <= spectralEnd; k++) {
+      if (mask & (1ULL << k)) refine(k);
+    }
+    eobRun--;
+  }
+  return true;
+}
+
+bool ProgressiveJpegDecoder::decodeScan() {
+  uint8_t header[12];
+  if (!readBytes(header, 3)) return false;
+  const int length = (header[0] << 8) | header[1];
+  const int count = header[2];
+  if (count < 1 || count > componentCount || length != 6 + 2 * count || !readBytes(header + 3, 2 * count + 3)) {
+    LOG_ERR("JPG", "Bad scan header");
+    return false;
+  }
+
+  int scanComponents[3];
+  const HuffmanTable* dcTables[3] = {};
+  bool hasLuma = false;
+  for (int i = 0; i < count; i++) {
+    const uint8_t id = header[3 + i * 2];
+    const uint8_t tables = header[4 + i * 2];
+    scanComponents[i] = -1;
+    for (int c = 0; c < componentCount; c++) {
+      if (components[c].id == id) scanComponents[i] = c;
+    }
+    if (scanComponents[i] < 0 || (tables >> 4) > 3 || (tables & 0x0F) > 3) {
+      LOG_ERR("JPG", "Bad scan component");
+      return false;
+    }
+    dcTables[i] = &huffmanTables[tables >> 4];
+    if (scanComponents[i] == 0) {
+      hasLuma = true;
+      acTable = &huffmanTables[4 + (tables & 0x0F)];
+    }
+  }
+  spectralStart = header[3 + count * 2];
+  spectralEnd = header[4 + count * 2];
+  approxHigh = header[5 + count * 2] >> 4;
+  approxLow = header[5 + count * 2] & 0x0F;
+
+  const bool dcScan = spectralStart == 0;
+  if (spectralStart > spectralEnd || spectralEnd > 63 || (dcScan && spectralEnd != 0) || (!dcScan && count != 1) ||
+      approxLow > 13) {
+    LOG_ERR("JPG", "Bad progressive scan parameters");
+    return false;
+  }
+
+  // Chroma is not output and at 1/8 size only DC is: skip straight to the next marker
+  if (!hasLuma || (!dcScan && blockSize == 1)) {
+    nextMarker = findMarker();
+    return nextMarker >= 0;
+  }
+
+  const bool refining = approxHigh != 0;
+  for (int i = 0; i < count && !refining; i++) {
+    if (dcScan && !dcTables[i]->defined) {
+      LOG_ERR("JPG", "Scan uses an undefined Huffman table");
+      return false;
+    }
+  }
+  if (!dcScan && !acTable->defined) {
+    LOG_ERR("JPG", "Scan uses an undefined Huffman table");
+    return false;
+  }
+
+  bitBuffer = 0;
+  bitCount = 0;
+  pendingMarker = -1;
+  eobRun = 0;
+  memset(dcPredictors, 0, sizeof(dcPredictors));
+  int restartsLeft = restartInterval;
+  const auto nextMcu = [&]() {
+    if (restartInterval == 0) return true;
+    if (restartsLeft == 0) {
+      if (!restart()) return false;
+      restartsLeft = restartInterval;
+    }
+    restartsLeft--;
+    return true;
+  };
+  const auto decodeBlock = [&](uint8_t* block, const int scanIndex) {
+    if (dcScan) {
+      return refining ? decodeDcRefine(block) : decodeDcFirst(block, *dcTables[scanIndex], dcPredictors[scanIndex]);
+    }
+    return refining ? decodeAcRefine(block) : decodeAcFirst(block);
+  };
+
+  bool success = true;
+  if (count == 1) {
+    // Non-interleaved: the luma blocks that hold image pixels, one per MCU
+    const int wide = (width + 7) / 8;
+    const int high = (height + 7) / 8;
+    for (int blockY = 0; blockY < high && success; blockY++) {
+      // Past the end of the data a scan is padded with zeros, but a failed source stops it at once
+      success = !sourceFailed && ensureRows(blockY, 1);
+      bandDirty = true;
+      for (int blockX = 0; blockX < wide && success; blockX++) {
+        success = nextMcu() && decodeBlock(blockAt(blockX, blockY), 0);
+      }
+    }
+  } else {
+    // Interleaved DC scan: chroma DC is decoded to stay in step, then dropped
+    const Component& luma = components[0];
+    const int mcusWide = blocksWide / luma.h;
+    const int mcusHigh = blocksHigh / luma.v;
+    for (int mcuY = 0; mcuY < mcusHigh && success; mcuY++) {
+      success = !sourceFailed && ensureRows(mcuY * luma.v, luma.v);
+      bandDirty = true;
+      for (int mcuX = 0; mcuX < mcusWide && success; mcuX++) {
+        success = nextMcu();
+        for (int i = 0; i < count && success; i++) {
+          const Component& component = components[scanComponents[i]];
+          for (int v = 0; v < component.v && success; v++) {
+            for (int h = 0; h < component.h && success; h++) {
+              uint8_t* block =
+                  scanComponents[i] == 0 ? blockAt(mcuX * component.h + h, mcuY * component.v + v) : nullptr;
+              success = decodeBlock(block, i);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  if (!success) {
+    LOG_ERR("JPG", "Failed to decode progressive scan");
+    return false;
+  }
+
+  nextMarker = pendingMarker >= 0 && (pendingMarker < M_RST0 || pendingMarker > M_RST7) ? pendingMarker : findMarker();
+  pendingMarker = -1;
+  return nextMarker >= 0;
+}
+
+bool ProgressiveJpegDecoder::decodeScans(const uint8_t scale) {
+  if (!huffmanTables || nextMarker != M_SOS || scale > 3) {
+    return false;
+  }
+
+  blockSize = 8 >> scale;
+  for (int z = 0; z < 64; z++) {
+    const int row = ZIGZAG_TO_NATURAL[z] / 8;
+    const int column = ZIGZAG_TO_NATURAL[z] % 8;
+    storedIndex[z] = row < blockSize && column < blockSize ? row * blockSize + column : -1;
+  }
+  // 1/8 size keeps DC alone, larger ones the nonzero mask refinement scans need, then the coefficients
+  blockBytes = blockSize == 1 ? sizeof(int16_t) : sizeof(uint64_t) + blockSize * blockSize * sizeof(int16_t);
+  rowBytes = blocksWide * blockBytes;
+
+  const size_t storeBytes = rowBytes * blocksHigh;
+  if (storeBytes <= MAX_IN_MEMORY_STORE_BYTES) {
+    band = static_cast<uint8_t*>(calloc(storeBytes, 1));
+  }
+  if (band) {
+    bandRows = blocksHigh;
+    bandFirstRow = 0;
+  } else {
+    // Bands hold whole MCU rows
+    bandRows = std::max<int>(SPILL_BAND_BYTES / rowBytes / maxV, 1) * maxV;
+    bandRows = std::min(bandRows, blocksHigh);
+    band = static_cast<uint8_t*>(malloc(bandRows * rowBytes));
+    Storage.mkdir("/.crosspoint");
+    spillFile = Storage.open(SPILL_PATH, O_RDWR | O_CREAT | O_TRUNC);
+    spilled = static_cast<bool>(spillFile);
+    if (!band || !spilled) {
+      LOG_ERR("JPG", "Failed to set up the coefficient store (%u bytes)", static_cast<unsigned>(storeBytes));
+      return false;
+    }
+    storedRows = 0;
+    LOG_DBG("JPG", "Spilling %u bytes of coefficients to the SD card, %d block rows at a time",
+            static_cast<unsigned>(storeBytes), bandRows);
+  }
+
+  while (nextMarker != M_EOI) {
+    if (nextMarker == M_SOS) {
+      if (!decodeScan()) return false;
+      continue;
+    }
+    if (nextMarker < 0) {
+      LOG_ERR("JPG", "Unexpected end of progressive JPEG");
+      return false;
+    }
+    if (!readSegment(nextMarker)) return false;
+    nextMarker = findMarker();
+  }
+
+  free(huffmanTables);
+  huffmanTables = nullptr;
+
+  const int round = (1 << scale) - 1;
+  outWidth = (width + round) >> scale;
+  outHeight = (height + round) >> scale;
+  nextBlockRow = 0;
+  pixelRows = static_cast<uint8_t*>(malloc(outWidth * blockSize));
+  if (!pixelRows) {
+    LOG_ERR("JPG", "Failed to allocate output rows (%d bytes)", outWidth * blockSize);
+    return false;
+  }
+  return true;
+}
+
+uint8_t* ProgressiveJpegDecoder::blockAt(const int blockX, const int blockY) const {
+  return band + (blockY - bandFirstRow) * rowBytes + blockX * blockBytes;
+}
+
+bool ProgressiveJpegDecoder::flushBand() {
+  if (!spilled || bandFirstRow < 0 || !bandDirty) return true;
+  const int rows = std::min(bandRows, blocksHigh - bandFirstRow);
+  if (!spillFile.seek(bandFirstRow * rowBytes) || spillFile.write(band, rows * rowBytes) != rows * rowBytes) {
+    LOG_ERR("JPG", "Failed to write coefficients to the SD card");
+    return false;
+  }
+  storedRows = std::max(storedRows, bandFirstRow + rows);
+  bandDirty = false;
+  return true;
+}
+
+bool ProgressiveJpegDecoder::ensureRows(const int firstRow, const int rowCount) {
+  if (bandFirstRow >= 0 && firstRow >= bandFirstRow && firstRow + rowCount <= bandFirstRow + bandRows) {
+    return true;
+  }
+  if (!flushBand()) return false;
+
+  // Rows never written yet start out as zero
+  const int rows = std::min(bandRows, blocksHigh - firstRow);
+  const int storedCount = std::max(0, std::min(rows, storedRows - firstRow));
+  if (storedCount > 0) {
+    const size_t bytes = storedCount * rowBytes;
+    if (!spillFile.seek(firstRow * rowBytes) || spillFile.read(band, bytes) != static_cast<int>(bytes)) {
+      LOG_ERR("JPG", "Failed to read coefficients from the SD card");
+      bandFirstRow = -1;
+      return false;
+    }
+  }
+  memset(band + storedCount * rowBytes, 0, (rows - storedCount) * rowBytes);
+  bandFirstRow = firstRow;
+  return true;
+}
+
+void ProgressiveJpegDecoder::renderBlock(const uint8_t* block, uint8_t* out, const int stride,
+                                         const int columns) const {
+  const int16_t* coefficients = coefficientsOf(block);
+  const uint16_t* quant = quantTables[components[0].quantTable];
+  if (blockSize == 1) {
+    *out = clamp8(128 + ((coefficients[0] * quant[0] + 4) >> 3));
+    return;
+  }
+
+  int data[64] = {};
+  for (int z = 0; z < 64; z++) {
+    if (storedIndex[z] >= 0) data[ZIGZAG_TO_NATURAL[z]] = coefficients[storedIndex[z]] * quant[z];
+  }
+  uint8_t pixels[64];
+  idct8x8(data, pixels);
+
+  // Average down to KxK
+  const int factor = 8 / blockSize;
+  const int area = factor * factor;
+  for (int y = 0; y < blockSize; y++) {
+    for (int x = 0; x < columns; x++) {
+      int sum = 0;
+      for (int sy = 0; sy < factor; sy++) {
+        const uint8_t* p = pixels + (y * factor + sy) * 8 + x * factor;
+        for (int sx = 0; sx < factor; sx++) sum += p[sx];
+      }
+      out[y * stride + x] = (sum + area / 2) / area;
+    }
+  }
+}
+
+const uint8_t* ProgressiveJpegDecoder::nextRows(int& rowCount) {
+  const int firstPixelRow = nextBlockRow * blockSize;
+  if (!pixelRows || firstPixelRow >= outHeight || !ensureRows(nextBlockRow, 1)) {
+    return nullptr;
+  }
+
+  for (int x = 0, blockX = 0; x < outWidth; x += blockSize, blockX++) {
+    renderBlock(blockAt(blockX, nextBlockRow), pixelRows + x, outWidth, std::min<int>(blockSize, outWidth - x));
+  }
+  rowCount = std::min<int>(blockSize, outHeight - firstPixelRow);
+  nextBlockRow++;
+  return pixelRows;
+}
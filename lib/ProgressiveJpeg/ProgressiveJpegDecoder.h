@@ -0,0 +1,143 @@
+#pragma once
+
+#include <HalStorage.h>
+
+#include <cstddef>
+#include <cstdint>
+
+class ImageSource;
+
+/**
+ * Grayscale decoder for progressive JPEGs, which picojpeg cannot read, in bounded memory.
+ *
+ * A progressive file sends the image several times over, each scan refining some of the DCT coefficients, so no pixel
+ * is final before the last scan and the coefficients have to be kept between scans. Only the luma coefficients an
+ * output at 1/1 to 1/8 size needs are kept: the top-left KxK of each 8x8 block (K = 8 >> scale), plus a bit per
+ * coefficient saying whether it is nonzero, which refinement scans depend on. Chroma scans, and at 1/8 all AC scans,
+ * are skipped unread. The store lives in RAM when it is small enough; otherwise it is spilled to a temporary file on
+ * the SD card and each scan updates it a band of block rows at a time.
+ */
+class ProgressiveJpegDecoder {
+ public:
+  explicit ProgressiveJpegDecoder(ImageSource& source) : source(source) {}
+  ~ProgressiveJpegDecoder();
+
+  ProgressiveJpegDecoder(const ProgressiveJpegDecoder&) = delete;
+  ProgressiveJpegDecoder& operator=(const ProgressiveJpegDecoder&) = delete;
+
+  // Reads the headers up to the first scan, from the source's current position. Fails on anything but an 8-bit
+  // progressive Huffman-coded JPEG.
+  bool begin();
+  int getWidth() const { return width; }
+  int getHeight() const { return height; }
+
+  // Decodes every scan for an output at 1/(1 << scale) size, scale being one of the PJPG_SCALE_ values
+  bool decodeScans(uint8_t scale);
+  int getOutputWidth() const { return outWidth; }
+  int getOutputHeight() const { return outHeight; }
+
+  // Returns the next rows of getOutputWidth() gray pixels, at most 8 of them, or nullptr once every row is out. The
+  // rows stay valid until the next call.
+  const uint8_t* nextRows(int& rowCount);
+
+ private:
+  struct HuffmanTable;
+  struct Component {
+    uint8_t id;
+    uint8_t h;
+    uint8_t v;
+    uint8_t quantTable;
+  };
+
+  // Byte reading
+  int readByte();
+  bool readBytes(uint8_t* out, size_t count);
+  bool readWord(uint16_t& value);
+  bool skipSegment();
+  // Returns the next marker after the current position, skipping any data before it, or -1 at the end
+  int readMarker();
+  // Same, also skipping restart markers
+  int findMarker();
+
+  // Marker segments
+  bool readSegment(int marker);
+  bool readQuantTables();
+  bool readHuffmanTables();
+  bool readFrameHeader();
+  bool readRestartInterval();
+  bool decodeScan();
+
+  // Entropy-coded data
+  void fillBits();
+  int getBits(int count);
+  int decodeHuffman(const HuffmanTable& table);
+  bool restart();
+  bool decodeDcFirst(uint8_t* block, const HuffmanTable& table, int& predictor);
+  bool decodeDcRefine(uint8_t* block);
+  bool decodeAcFirst(uint8_t* block);
+  bool decodeAcRefine(uint8_t* block);
+  void setCoefficient(uint8_t* block, int zigzagIndex, int value);
+  int16_t* coefficientsOf(uint8_t* block) const { return reinterpret_cast<int16_t*>(block + maskBytes()); }
+  const int16_t* coefficientsOf(const uint8_t* block) const {
+    return reinterpret_cast<const int16_t*>(block + maskBytes());
+  }
+  size_t maskBytes() const { return blockSize > 1 ? sizeof(uint64_t) : 0; }
+
+  // Coefficient store
+  bool ensureRows(int firstRow, int rowCount);
+  bool flushBand();
+  uint8_t* blockAt(int blockX, int blockY) const;
+  void renderBlock(const uint8_t* block, uint8_t* out, int stride, int columns) const;
+  void release();
+
+  ImageSource& source;
+  uint8_t readBuffer[512] = {};
+  size_t readPos = 0;
+  size_t readFilled = 0;
+  bool sourceFailed = false;  // The source reported an error (e.g. cancelled), rather than running out of data
+
+  // Frame
+  int width = 0;
+  int height = 0;
+  uint8_t componentCount = 0;
+  Component components[3] = {};
+  uint8_t maxH = 1;
+  uint8_t maxV = 1;
+  uint16_t restartInterval = 0;
+  uint16_t quantTables[4][64] = {};       // Zigzag order
+  HuffmanTable* huffmanTables = nullptr;  // 4 DC tables, then 4 AC tables
+
+  // Current scan
+  uint8_t spectralStart = 0;
+  uint8_t spectralEnd = 0;
+  uint8_t approxHigh = 0;
+  uint8_t approxLow = 0;
+  const HuffmanTable* acTable = nullptr;
+  uint32_t bitBuffer = 0;
+  int bitCount = 0;
+  int pendingMarker = -1;  // Marker met inside entropy-coded data, or -1
+  uint32_t eobRun = 0;
+  int dcPredictors[3] = {};
+  int nextMarker = -1;  // Marker after the last segment or scan read
+
+  // Coefficient store: blocksWide x blocksHigh blocks of blockBytes, the nonzero mask then KxK coefficients
+  uint8_t blockSize = 8;        // K
+  int8_t storedIndex[64] = {};  // Zigzag index -> index in the KxK coefficients, or -1 when not kept
+  int blocksWide = 0;
+  int blocksHigh = 0;
+  size_t blockBytes = 0;
+  size_t rowBytes = 0;
+  uint8_t* band = nullptr;
+  int bandRows = 0;
+  int bandFirstRow = -1;
+  bool bandDirty = false;
+  bool spilled = false;
+  int storedRows = 0;  // Block rows written to the spill file so far
+  FsFile spillFile;
+
+  // Output
+  int outWidth = 0;
+  int outHeight = 0;
+  int nextBlockRow = 0;
+  uint8_t* pixelRows = nullptr;
+};
@@ -30,7 +30,8 @@ static void writeString(std::ostream& os, const std::string& s) {
   os.write(s.data(), len);
 }
 
-static void writeString(FsFile& file, const std::string& s) {
+template <typename Alloc>
+static void writeString(FsFile& file, const std::basic_string<char, std::char_traits<char>, Alloc>& s) {
   const uint32_t len = s.size();
   writePod(file, len);
   file.write(reinterpret_cast<const uint8_t*>(s.data()), len);
@@ -43,7 +44,8 @@ static void readString(std::istream& is, std::string& s) {
   is.read(&s[0], len);
 }
 
-static void readString(FsFile& file, std::string& s) {
+template <typename Alloc>
+static void readString(FsFile& file, std::basic_string<char, std::char_traits<char>, Alloc>& s) {
   uint32_t len;
   readPod(file, len);
   s.resize(len);
@@ -4,6 +4,8 @@
 #include <JpegToBmpConverter.h>
 #include <Logging.h>
 
+#include <algorithm>
+
 Txt::Txt(std::string path, std::string cacheBasePath)
     : filepath(std::move(path)), cacheBasePath(std::move(cacheBasePath)) {
   // Generate cache path from file path hash
@@ -170,6 +172,33 @@ bool Txt::generateCoverBmp() const {
   return false;
 }
 
+void Txt::setEncoding(const TxtEncoding value) {
+  encoding = value;
+  encodingKnown = true;
+}
+
+TxtEncoding Txt::detectEncoding() {
+  constexpr size_t SAMPLE_SIZE = 4096;
+  const size_t length = std::min(SAMPLE_SIZE, fileSize);
+  if (length == 0) {
+    setEncoding(TxtEncoding::Utf8);
+    return encoding;
+  }
+
+  auto* sample = static_cast<uint8_t*>(malloc(length));
+  if (!sample) {
+    LOG_ERR("TXT", "Failed to allocate %zu bytes", length);
+    return encoding;
+  }
+
+  if (readContent(sample, 0, length)) {
+    setEncoding(detectTxtEncoding(sample, length));
+    LOG_DBG("TXT", "Detected encoding: %s", txtEncodingName(encoding));
+  }
+  free(sample);
+  return encoding;
+}
+
 bool Txt::readContent(uint8_t* buffer, size_t offset, size_t length) const {
   if (!loaded) {
     return false;
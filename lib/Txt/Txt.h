@@ -5,12 +5,16 @@
 #include <memory>
 #include <string>
 
+#include "TxtEncoding.h"
+
 class Txt {
   std::string filepath;
   std::string cacheBasePath;
   std::string cachePath;
   bool loaded = false;
   size_t fileSize = 0;
+  TxtEncoding encoding = TxtEncoding::Utf8;
+  bool encodingKnown = false;
 
  public:
   explicit Txt(std::string path, std::string cacheBasePath);
@@ -28,6 +32,12 @@ class Txt {
   [[nodiscard]] bool generateCoverBmp() const;
   [[nodiscard]] std::string findCoverImage() const;
 
-  // Read content from file
+  // Source encoding. Detected once per book and persisted by the reader's page index cache.
+  [[nodiscard]] TxtEncoding getEncoding() const { return encoding; }
+  [[nodiscard]] bool hasEncoding() const { return encodingKnown; }
+  void setEncoding(TxtEncoding value);
+  TxtEncoding detectEncoding();
+
+  // Read raw (source encoding) content from file
   [[nodiscard]] bool readContent(uint8_t* buffer, size_t offset, size_t length) const;
 };
@@ -0,0 +1,276 @@
+#include "TxtEncoding.h"
+
+#include "generated/TxtCodepages.h"
+
+namespace {
+constexpr uint32_t REPLACEMENT_CODEPOINT = 0xFFFD;
+constexpr uint32_t BYTE_ORDER_MARK = 0xFEFF;
+constexpr size_t GBK_TRAIL_COUNT = GBK_TRAIL_LAST - GBK_TRAIL_FIRST + 1;
+
+bool isGbkLead(const uint8_t b) { return b >= GBK_LEAD_FIRST && b <= GBK_LEAD_LAST; }
+bool isGbkTrail(const uint8_t b) { return b >= GBK_TRAIL_FIRST && b <= GBK_TRAIL_LAST && b != 0x7F; }
+
+uint16_t utf16Unit(const TxtEncoding encoding, const uint8_t* p) {
+  return encoding == TxtEncoding::Utf16Le ? static_cast<uint16_t>(p[0] | (p[1] << 8))
+                                          : static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+size_t utf8EncodedLength(const uint32_t cp) {
+  if (cp < 0x80) return 1;
+  if (cp < 0x800) return 2;
+  if (cp < 0x10000) return 3;
+  return 4;
+}
+
+void appendUtf8(std::string& out, const uint32_t cp) {
+  if (cp < 0x80) {
+    out += static_cast<char>(cp);
+  } else if (cp < 0x800) {
+    out += static_cast<char>(0xC0 | (cp >> 6));
+    out += static_cast<char>(0x80 | (cp & 0x3F));
+  } else if (cp < 0x10000) {
+    out += static_cast<char>(0xE0 | (cp >> 12));
+    out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (cp & 0x3F));
+  } else {
+    out += static_cast<char>(0xF0 | (cp >> 18));
+    out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+    out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (cp & 0x3F));
+  }
+}
+
+// Decodes the character at src[pos] of a non-UTF-8 encoding and advances pos.
+// Returns false, leaving pos, when the character is cut off by length and more input may follow.
+bool decodeChar(const TxtEncoding encoding, const uint8_t* src, const size_t length, const bool final, size_t& pos,
+                uint32_t& cp) {
+  const uint8_t b = src[pos];
+  switch (encoding) {
+    case TxtEncoding::Utf16Le:
+    case TxtEncoding::Utf16Be: {
+      if (pos + 2 > length) {
+        if (!final) return false;
+        cp = REPLACEMENT_CODEPOINT;
+        pos = length;
+        return true;
+      }
+      const uint16_t unit = utf16Unit(encoding, src + pos);
+      if (unit >= 0xD800 && unit <= 0xDBFF) {
+        if (pos + 4 > length && !final) return false;
+        const uint16_t low = pos + 4 <= length ? utf16Unit(encoding, src + pos + 2) : 0;
+        if (low >= 0xDC00 && low <= 0xDFFF) {
+          cp = 0x10000 + ((static_cast<uint32_t>(unit - 0xD800) << 10) | (low - 0xDC00));
+          pos += 4;
+          return true;
+        }
+      }
+      cp = unit >= 0xD800 && unit <= 0xDFFF ? REPLACEMENT_CODEPOINT : unit;
+      pos += 2;
+      return true;
+    }
+    case TxtEncoding::Cp1251:
+      cp = b < 0x80 ? b : cp1251_high[b - 0x80];
+      pos++;
+      return true;
+    case TxtEncoding::Cp1252:
+      cp = b < 0x80 ? b : cp1252_high[b - 0x80];
+      pos++;
+      return true;
+    case TxtEncoding::Gbk:
+      if (b < 0x80) {
+        cp = b;
+      } else if (b == 0x80) {
+        cp = 0x20AC;  // Euro sign, single byte in code page 936
+      } else if (isGbkLead(b)) {
+        if (pos + 1 >= length && !final) return false;
+        if (pos + 1 < length && isGbkTrail(src[pos + 1])) {
+          cp = gbk_double_byte[(b - GBK_LEAD_FIRST) * GBK_TRAIL_COUNT + (src[pos + 1] - GBK_TRAIL_FIRST)];
+          pos += 2;
+          return true;
+        }
+        // Stray lead byte: replace it alone and resynchronize on the next byte
+        cp = REPLACEMENT_CODEPOINT;
+      } else {
+        cp = REPLACEMENT_CODEPOINT;
+      }
+      pos++;
+      return true;
+    case TxtEncoding::Utf8:
+    default:
+      cp = b;
+      pos++;
+      return true;
+  }
+}
+
+// Well-formed UTF-8, allowing a sequence cut off at the end of the sample
+bool isValidUtf8(const uint8_t* data, const size_t length) {
+  size_t i = 0;
+  while (i < length) {
+    const uint8_t b = data[i];
+    size_t continuation;
+    if (b < 0x80) {
+      i++;
+      continue;
+    } else if (b >= 0xC2 && b <= 0xDF) {
+      continuation = 1;
+    } else if (b >= 0xE0 && b <= 0xEF) {
+      continuation = 2;
+    } else if (b >= 0xF0 && b <= 0xF4) {
+      continuation = 3;
+    } else {
+      return false;
+    }
+    for (size_t j = 1; j <= continuation && i + j < length; j++) {
+      if ((data[i + j] & 0xC0) != 0x80) {
+        return false;
+      }
+    }
+    i += continuation + 1;
+  }
+  return true;
+}
+
+}  // anonymous namespace
+
+const char* txtEncodingName(const TxtEncoding encoding) {
+  switch (encoding) {
+    case TxtEncoding::Utf8:
+      return "UTF-8";
+    case TxtEncoding::Utf16Le:
+      return "UTF-16LE";
+    case TxtEncoding::Utf16Be:
+      return "UTF-16BE";
+    case TxtEncoding::Cp1251:
+      return "CP1251";
+    case TxtEncoding::Cp1252:
+      return "CP1252";
+    case TxtEncoding::Gbk:
+      return "GBK";
+  }
+  return "?";
+}
+
+TxtEncoding detectTxtEncoding(const uint8_t* data, const size_t length) {
+  if (length >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF) {
+    return TxtEncoding::Utf8;
+  }
+  if (length >= 2 && data[0] == 0xFF && data[1] == 0xFE) {
+    return TxtEncoding::Utf16Le;
+  }
+  if (length >= 2 && data[0] == 0xFE && data[1] == 0xFF) {
+    return TxtEncoding::Utf16Be;
+  }
+
+  // Without a BOM, UTF-16 still gives itself away: for Latin, Greek, Cyrillic, Hebrew and Arabic text one byte of
+  // each code unit is NUL or a small block number, which UTF-8 and the legacy code pages never produce
+  auto isLowByte = [](const uint8_t b) { return b < 0x09; };
+  const size_t units = length / 2;
+  size_t evenLow = 0;
+  size_t oddLow = 0;
+  for (size_t i = 0; i + 1 < length; i += 2) {
+    if (isLowByte(data[i])) evenLow++;
+    if (isLowByte(data[i + 1])) oddLow++;
+  }
+  if (units >= 2) {
+    if (oddLow * 10 > units * 3 && evenLow * 2 < oddLow) {
+      return TxtEncoding::Utf16Le;
+    }
+    if (evenLow * 10 > units * 3 && oddLow * 2 < evenLow) {
+      return TxtEncoding::Utf16Be;
+    }
+  }
+
+  if (isValidUtf8(data, length)) {
+    return TxtEncoding::Utf8;
+  }
+
+  // GBK pairs a lead byte with a trail byte, and Chinese text keeps both in the high half; Cyrillic words are runs
+  // of high bytes of any length (so some end on a lead byte followed by a space), and Western text has isolated
+  // high bytes between ASCII letters.
+  size_t gbkPairs = 0;
+  size_t gbkHighTrails = 0;
+  size_t gbkErrors = 0;
+  for (size_t i = 0; i < length;) {
+    const uint8_t b = data[i];
+    if (b < 0x80) {
+      i++;
+    } else if (isGbkLead(b) && i + 1 < length && isGbkTrail(data[i + 1])) {
+      gbkPairs++;
+      if (data[i + 1] >= 0x80) gbkHighTrails++;
+      i += 2;
+    } else {
+      if (i + 1 < length) gbkErrors++;
+      i++;
+    }
+  }
+  if (gbkPairs > 0 && gbkErrors * 50 <= gbkPairs && gbkHighTrails * 2 > gbkPairs) {
+    return TxtEncoding::Gbk;
+  }
+
+  size_t highBytes = 0;
+  size_t highInRuns = 0;
+  for (size_t i = 0; i < length; i++) {
+    if (data[i] < 0x80) continue;
+    highBytes++;
+    if ((i > 0 && data[i - 1] >= 0x80) || (i + 1 < length && data[i + 1] >= 0x80)) {
+      highInRuns++;
+    }
+  }
+  return highInRuns * 2 > highBytes ? TxtEncoding::Cp1251 : TxtEncoding::Cp1252;
+}
+
+size_t transcodeTxtToUtf8(const TxtEncoding encoding, const uint8_t* src, const size_t length, const bool final,
+                          std::string& out) {
+  if (encoding == TxtEncoding::Utf8) {
+    out.append(reinterpret_cast<const char*>(src), length);
+    return length;
+  }
+
+  size_t pos = 0;
+  uint32_t cp;
+  while (pos < length && decodeChar(encoding, src, length, final, pos, cp)) {
+    if (cp != BYTE_ORDER_MARK) {
+      appendUtf8(out, cp);
+    }
+  }
+  return pos;
+}
+
+size_t txtSourceOffset(const TxtEncoding encoding, const uint8_t* src, const size_t length, const size_t utf8Length) {
+  if (encoding == TxtEncoding::Utf8) {
+    return utf8Length;
+  }
+
+  size_t pos = 0;
+  size_t produced = 0;
+  uint32_t cp;
+  while (produced < utf8Length && pos < length && decodeChar(encoding, src, length, true, pos, cp)) {
+    if (cp != BYTE_ORDER_MARK) {
+      produced += utf8EncodedLength(cp);
+    }
+  }
+  return pos;
+}
+
+size_t txtNextBreakStart(const TxtEncoding encoding, const uint8_t* data, const size_t length) {
+  const size_t unitSize = txtCodeUnitSize(encoding);
+  auto unitAt = [&](const size_t i) -> uint16_t { return unitSize == 2 ? utf16Unit(encoding, data + i) : data[i]; };
+
+  for (const uint16_t separator : {uint16_t{'\n'}, uint16_t{' '}}) {
+    for (size_t i = 0; i + unitSize < length; i += unitSize) {
+      if (unitAt(i) == separator) {
+        return i + unitSize;
+      }
+    }
+  }
+
+  size_t i = 0;
+  if (encoding == TxtEncoding::Utf8) {
+    while (i < length && (data[i] & 0xC0) == 0x80) i++;
+  } else if (unitSize == 2 && length >= 4) {
+    const uint16_t unit = unitAt(0);
+    if (unit >= 0xDC00 && unit <= 0xDFFF) i = 2;
+  }
+  return i < length ? i : 0;
+}
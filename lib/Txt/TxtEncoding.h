@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Source encodings the TXT reader can transcode to UTF-8. Values are persisted in the TXT page index cache.
+enum class TxtEncoding : uint8_t { Utf8 = 0, Utf16Le = 1, Utf16Be = 2, Cp1251 = 3, Cp1252 = 4, Gbk = 5 };
+constexpr uint8_t TXT_ENCODING_COUNT = 6;
+
+const char* txtEncodingName(TxtEncoding encoding);
+
+/**
+ * Guess the encoding of a text file from its first bytes.
+ * A byte order mark wins; otherwise NUL byte parity picks UTF-16, valid UTF-8 stays UTF-8, and the shape of
+ * high-byte runs decides between GBK, CP1251 and CP1252.
+ */
+TxtEncoding detectTxtEncoding(const uint8_t* data, size_t length);
+
+// Offsets into UTF-16 files must stay on 2-byte code unit boundaries
+inline size_t txtCodeUnitSize(const TxtEncoding encoding) {
+  return encoding == TxtEncoding::Utf16Le || encoding == TxtEncoding::Utf16Be ? 2 : 1;
+}
+
+/**
+ * Transcode whole characters of src to UTF-8, appending to out. Byte order marks are dropped.
+ * @param final True if src ends at end of file; otherwise a character cut off at the end is left for the next read
+ * @return Source bytes consumed
+ */
+size_t transcodeTxtToUtf8(TxtEncoding encoding, const uint8_t* src, size_t length, bool final, std::string& out);
+
+// Source bytes behind the first utf8Length bytes that transcodeTxtToUtf8() produced from src
+size_t txtSourceOffset(TxtEncoding encoding, const uint8_t* src, size_t length, size_t utf8Length);
+
+/**
+ * Where to start a page near an arbitrary offset: after the first newline in data, else after the first space,
+ * else at the first character boundary. data must start on a code unit boundary.
+ * @return Offset into data, always < length (0 if nothing better was found)
+ */
+size_t txtNextBreakStart(TxtEncoding encoding, const uint8_t* data, size_t length);
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Decodes the UTF-8 codepoint at text[pos] and advances pos past it. Sequences cut off by `length` (a chunk
+// boundary) are consumed up to the end so callers always make progress.
+inline uint32_t txtNextCodepoint(const char* text, const size_t length, size_t& pos) {
+  const auto lead = static_cast<uint8_t>(text[pos++]);
+  if (lead < 0x80) {
+    return lead;
+  }
+  size_t continuation;
+  uint32_t cp;
+  if ((lead >> 5) == 0x6) {
+    continuation = 1;
+    cp = lead & 0x1F;
+  } else if ((lead >> 4) == 0xE) {
+    continuation = 2;
+    cp = lead & 0x0F;
+  } else if ((lead >> 3) == 0x1E) {
+    continuation = 3;
+    cp = lead & 0x07;
+  } else {
+    return lead;
+  }
+  for (; continuation > 0 && pos < length; --continuation) {
+    cp = (cp << 6) | (static_cast<uint8_t>(text[pos++]) & 0x3F);
+  }
+  return cp;
+}
+
+/**
+ * Greedy word wrap of one source line (no CR/LF) in a single pass.
+ *
+ * Advances are accumulated per codepoint while the last space whose preceding text still fits is remembered, so
+ * every byte is measured once. Lines break at that space (which is dropped), or before the codepoint that
+ * overflows when a word is wider than the line; a lone glyph wider than the line gets a line of its own.
+ *
+ * @param advanceOf int(uint32_t codepoint): horizontal advance of one codepoint
+ * @param emit bool(size_t start, size_t length, int width): receives each wrapped line; return false to stop
+ * @return Bytes of text consumed, including the space skipped after the last emitted line. Equals `length` once
+ *         the whole line was emitted.
+ */
+template <typename AdvanceFn, typename EmitFn>
+size_t wrapTxtLine(const char* text, const size_t length, const int maxWidth, AdvanceFn&& advanceOf, EmitFn&& emit) {
+  constexpr size_t NO_BREAK = SIZE_MAX;
+
+  size_t lineStart = 0;
+  int width = 0;  // Advance of text[lineStart, pos)
+  size_t breakAt = NO_BREAK;
+  int widthBeforeBreak = 0;
+  int widthThroughBreak = 0;
+
+  size_t pos = 0;
+  while (pos < length) {
+    const size_t cpStart = pos;
+    const uint32_t cp = txtNextCodepoint(text, length, pos);
+    const int advance = advanceOf(cp);
+
+    // width never exceeds maxWidth here, so the text before this space always fits
+    const bool isBreak = cp == ' ' && cpStart > lineStart;
+    if (isBreak) {
+      breakAt = cpStart;
+      widthBeforeBreak = width;
+    }
+    width += advance;
+    if (isBreak) {
+      widthThroughBreak = width;
+    }
+
+    while (width > maxWidth) {
+      if (breakAt != NO_BREAK) {
+        if (!emit(lineStart, breakAt - lineStart, widthBeforeBreak)) {
+          return breakAt + 1;
+        }
+        lineStart = breakAt + 1;
+        width -= widthThroughBreak;
+        breakAt = NO_BREAK;
+      } else if (cpStart > lineStart) {
+        if (!emit(lineStart, cpStart - lineStart, width - advance)) {
+          return cpStart;
+        }
+        lineStart = cpStart;
+        width = advance;
+      } else {
+        if (!emit(lineStart, pos - lineStart, width)) {
+          return pos;
+        }
+        lineStart = pos;
+        width = 0;
+      }
+    }
+  }
+
+  if (lineStart < length) {
+    emit(lineStart, length - lineStart, width);
+  }
+  return length;
+}
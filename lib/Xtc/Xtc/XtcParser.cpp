@@ -10,13 +10,16 @@
 #include <FsHelpers.h>
 #include <HalStorage.h>
 #include <Logging.h>
+#include <PackBits.h>
 
+#include <algorithm>
 #include <cstring>
 
 namespace xtc {
 
 XtcParser::XtcParser()
     : m_isOpen(false),
+      m_pageTableBlockStart(NO_BLOCK),
       m_defaultWidth(DISPLAY_WIDTH),
       m_defaultHeight(DISPLAY_HEIGHT),
       m_bitDepth(1),
@@ -89,7 +92,7 @@ void XtcParser::close() {
     m_file.close();
     m_isOpen = false;
   }
-  m_pageTable.clear();
+  m_pageTableBlockStart = NO_BLOCK;
   m_chapters.clear();
   m_title.clear();
   m_hasChapters = false;
@@ -169,38 +172,49 @@ XtcError XtcParser::readPageTable() {
     return XtcError::CORRUPTED_HEADER;
   }
 
-  // Seek to page table
-  if (!m_file.seek(m_header.pageTableOffset)) {
-    LOG_DBG("XTC", "Failed to seek to page table at %llu", m_header.pageTableOffset);
+  // Entries are read on demand; only check that the whole table is in the file
+  const uint64_t tableEnd =
+      m_header.pageTableOffset + static_cast<uint64_t>(m_header.pageCount) * sizeof(PageTableEntry);
+  if (tableEnd > m_file.size()) {
+    LOG_DBG("XTC", "Page table ends at %llu, past end of file", tableEnd);
+    return XtcError::CORRUPTED_HEADER;
+  }
+
+  // Default dimensions from first page
+  m_pageTableBlockStart = NO_BLOCK;
+  PageTableEntry first;
+  if (!readPageTableEntry(0, first)) {
     return XtcError::READ_ERROR;
   }
+  m_defaultWidth = first.width;
+  m_defaultHeight = first.height;
 
-  m_pageTable.resize(m_header.pageCount);
+  LOG_DBG("XTC", "Page table at %llu (%u entries)", m_header.pageTableOffset, m_header.pageCount);
+  return XtcError::OK;
+}
 
-  // Read page table entries
-  for (uint16_t i = 0; i < m_header.pageCount; i++) {
-    PageTableEntry entry;
-    size_t bytesRead = m_file.read(reinterpret_cast<uint8_t*>(&entry), sizeof(PageTableEntry));
-    if (bytesRead != sizeof(PageTableEntry)) {
-      LOG_DBG("XTC", "Failed to read page table entry %u", i);
-      return XtcError::READ_ERROR;
-    }
+bool XtcParser::readPageTableEntry(const uint32_t pageIndex, PageTableEntry& entry) {
+  if (pageIndex >= m_header.pageCount) {
+    return false;
+  }
 
-    m_pageTable[i].offset = static_cast<uint32_t>(entry.dataOffset);
-    m_pageTable[i].size = entry.dataSize;
-    m_pageTable[i].width = entry.width;
-    m_pageTable[i].height = entry.height;
-    m_pageTable[i].bitDepth = m_bitDepth;
+  if (m_pageTableBlockStart == NO_BLOCK || pageIndex < m_pageTableBlockStart ||
+      pageIndex >= m_pageTableBlockStart + PAGE_TABLE_BLOCK_ENTRIES) {
+    const uint32_t blockStart = pageIndex - pageIndex % PAGE_TABLE_BLOCK_ENTRIES;
+    const uint32_t count = std::min<uint32_t>(PAGE_TABLE_BLOCK_ENTRIES, m_header.pageCount - blockStart);
+    const size_t blockBytes = count * sizeof(PageTableEntry);
 
-    // Update default dimensions from first page
-    if (i == 0) {
-      m_defaultWidth = entry.width;
-      m_defaultHeight = entry.height;
+    m_pageTableBlockStart = NO_BLOCK;
+    if (!m_file.seek(m_header.pageTableOffset + static_cast<uint64_t>(blockStart) * sizeof(PageTableEntry)) ||
+        m_file.read(reinterpret_cast<uint8_t*>(m_pageTableBlock), blockBytes) != static_cast<int>(blockBytes)) {
+      LOG_DBG("XTC", "Failed to read page table block at entry %u", blockStart);
+      return false;
     }
+    m_pageTableBlockStart = blockStart;
   }
 
-  LOG_DBG("XTC", "Read %u page table entries", m_header.pageCount);
-  return XtcError::OK;
+  entry = m_pageTableBlock[pageIndex - m_pageTableBlockStart];
+  return true;
 }
 
 XtcError XtcParser::readChapters() {
@@ -309,41 +323,53 @@ XtcError XtcParser::readChapters() {
   return XtcError::OK;
 }
 
-bool XtcParser::getPageInfo(uint32_t pageIndex, PageInfo& info) const {
-  if (pageIndex >= m_pageTable.size()) {
+bool XtcParser::getPageInfo(uint32_t pageIndex, PageInfo& info) {
+  PageTableEntry entry;
+  if (!readPageTableEntry(pageIndex, entry)) {
     return false;
   }
-  info = m_pageTable[pageIndex];
+
+  info.offset = static_cast<uint32_t>(entry.dataOffset);
+  info.size = entry.dataSize;
+  info.width = entry.width;
+  info.height = entry.height;
+  info.bitDepth = m_bitDepth;
+  info.compression = XTG_COMPRESSION_NONE;
+
+  XtgPageHeader pageHeader;
+  if (m_file.seek(info.offset) &&
+      m_file.read(reinterpret_cast<uint8_t*>(&pageHeader), sizeof(pageHeader)) == sizeof(pageHeader)) {
+    info.compression = pageHeader.compression;
+  }
   return true;
 }
 
-size_t XtcParser::loadPage(uint32_t pageIndex, uint8_t* buffer, size_t bufferSize) {
+XtcError XtcParser::beginPage(const uint32_t pageIndex, XtgPageHeader& pageHeader, size_t& bitmapSize) {
   if (!m_isOpen) {
-    m_lastError = XtcError::FILE_NOT_FOUND;
-    return 0;
+    return XtcError::FILE_NOT_FOUND;
   }
 
   if (pageIndex >= m_header.pageCount) {
-    m_lastError = XtcError::PAGE_OUT_OF_RANGE;
-    return 0;
+    return XtcError::PAGE_OUT_OF_RANGE;
   }
 
-  const PageInfo& page = m_pageTable[pageIndex];
+  PageTableEntry entry;
+  if (!readPageTableEntry(pageIndex, entry)) {
+    return XtcError::READ_ERROR;
+  }
 
   // Seek to page data
-  if (!m_file.seek(page.offset)) {
-    LOG_DBG("XTC", "Failed to seek to page %u at offset %lu", pageIndex, page.offset);
-    m_lastError = XtcError::READ_ERROR;
-    return 0;
+  const auto pageOffset = static_cast<uint32_t>(entry.dataOffset);
+  if (!m_file.seek(pageOffset)) {
+    LOG_DBG("XTC", "Failed to seek to page %u at offset %lu", pageIndex, pageOffset);
+    return XtcError::READ_ERROR;
   }
 
   // Read page header (XTG for 1-bit, XTH for 2-bit - same structure)
-  XtgPageHeader pageHeader;
   size_t headerRead = m_file.read(reinterpret_cast<uint8_t*>(&pageHeader), sizeof(XtgPageHeader));
   if (headerRead != sizeof(XtgPageHeader)) {
     LOG_DBG("XTC", "Failed to read page header for page %u", pageIndex);
-    m_lastError = XtcError::READ_ERROR;
-    return 0;
+    return XtcError::READ_ERROR;
   }
 
   // Verify page magic (XTG for 1-bit, XTH for 2-bit)
@@ -351,20 +377,76 @@ size_t XtcParser::loadPage(uint32_t pageIndex, uint8_t* buffer, size_t bufferSiz
   if (pageHeader.magic != expectedMagic) {
     LOG_DBG("XTC", "Invalid page magic for page %u: 0x%08X (expected 0x%08X)", pageIndex, pageHeader.magic,
             expectedMagic);
-    m_lastError = XtcError::INVALID_MAGIC;
-    return 0;
+    return XtcError::INVALID_MAGIC;
+  }
+
+  if (pageHeader.compression != XTG_COMPRESSION_NONE && pageHeader.compression != XTG_COMPRESSION_PACKBITS) {
+    LOG_DBG("XTC", "Unsupported compression %u for page %u", pageHeader.compression, pageIndex);
+    return XtcError::DECOMPRESSION_ERROR;
   }
 
   // Calculate bitmap size based on bit depth
   // XTG (1-bit): Row-major, ((width+7)/8) * height bytes
   // XTH (2-bit): Two bit planes, column-major, ((width * height + 7) / 8) * 2 bytes
-  size_t bitmapSize;
   if (m_bitDepth == 2) {
     // XTH: two bit planes, each containing (width * height) bits rounded up to bytes
     bitmapSize = ((static_cast<size_t>(pageHeader.width) * pageHeader.height + 7) / 8) * 2;
   } else {
     bitmapSize = ((pageHeader.width + 7) / 8) * pageHeader.height;
   }
+  return XtcError::OK;
+}
+
+XtcError XtcParser::readPackBits(size_t compressedSize, const size_t bitmapSize, uint8_t* window,
+                                 const size_t windowSize,
+                                 const std::function<void(const uint8_t* data, size_t size, size_t offset)>& callback) {
+  PackBitsDecoder decoder;
+  uint8_t input[256];
+  size_t inputPos = 0;
+  size_t inputLen = 0;
+
+  size_t decoded = 0;
+  while (decoded < bitmapSize) {
+    const size_t want = std::min(windowSize, bitmapSize - decoded);
+    size_t filled = 0;
+    while (filled < want) {
+      // A repeat run can still have output pending after its input is used up, so only refill once nothing comes out
+      size_t consumed = 0;
+      const size_t written =
+          decoder.decode(input + inputPos, inputLen - inputPos, consumed, window + filled, want - filled);
+      inputPos += consumed;
+      filled += written;
+      if (written > 0 || inputPos < inputLen) {
+        continue;
+      }
+
+      if (compressedSize == 0) {
+        LOG_DBG("XTC", "PackBits data ended after %u of %u bytes", decoded + filled, bitmapSize);
+        return XtcError::DECOMPRESSION_ERROR;
+      }
+      inputLen = m_file.read(input, std::min(sizeof(input), compressedSize));
+      if (inputLen == 0) {
+        return XtcError::READ_ERROR;
+      }
+      compressedSize -= inputLen;
+      inputPos = 0;
+    }
+
+    if (callback) {
+      callback(window, want, decoded);
+    }
+    decoded += want;
+  }
+  return XtcError::OK;
+}
+
+size_t XtcParser::loadPage(uint32_t pageIndex, uint8_t* buffer, size_t bufferSize) {
+  XtgPageHeader pageHeader;
+  size_t bitmapSize = 0;
+  m_lastError = beginPage(pageIndex, pageHeader, bitmapSize);
+  if (m_lastError != XtcError::OK) {
+    return 0;
+  }
 
   // Check buffer size
   if (bufferSize < bitmapSize) {
@@ -373,6 +455,12 @@ size_t XtcParser::loadPage(uint32_t pageIndex, uint8_t* buffer, size_t bufferSiz
     return 0;
   }
 
+  // Compressed pages are decoded straight into the caller's buffer
+  if (pageHeader.compression == XTG_COMPRESSION_PACKBITS) {
+    m_lastError = readPackBits(pageHeader.dataSize, bitmapSize, buffer, bitmapSize, nullptr);
+    return m_lastError == XtcError::OK ? bitmapSize : 0;
+  }
+
   // Read bitmap data
   size_t bytesRead = m_file.read(buffer, bitmapSize);
   if (bytesRead != bitmapSize) {
@@ -388,41 +476,21 @@ size_t XtcParser::loadPage(uint32_t pageIndex, uint8_t* buffer, size_t bufferSiz
 XtcError XtcParser::loadPageStreaming(uint32_t pageIndex,
                                       std::function<void(const uint8_t* data, size_t size, size_t offset)> callback,
                                       size_t chunkSize) {
-  if (!m_isOpen) {
-    return XtcError::FILE_NOT_FOUND;
-  }
-
-  if (pageIndex >= m_header.pageCount) {
-    return XtcError::PAGE_OUT_OF_RANGE;
-  }
-
-  const PageInfo& page = m_pageTable[pageIndex];
-
-  // Seek to page data
-  if (!m_file.seek(page.offset)) {
-    return XtcError::READ_ERROR;
-  }
-
-  // Read and skip page header (XTG for 1-bit, XTH for 2-bit)
   XtgPageHeader pageHeader;
-  size_t headerRead = m_file.read(reinterpret_cast<uint8_t*>(&pageHeader), sizeof(XtgPageHeader));
-  const uint32_t expectedMagic = (m_bitDepth == 2) ? XTH_MAGIC : XTG_MAGIC;
-  if (headerRead != sizeof(XtgPageHeader) || pageHeader.magic != expectedMagic) {
-    return XtcError::READ_ERROR;
-  }
-
-  // Calculate bitmap size based on bit depth
-  // XTG (1-bit): Row-major, ((width+7)/8) * height bytes
-  // XTH (2-bit): Two bit planes, ((width * height + 7) / 8) * 2 bytes
-  size_t bitmapSize;
-  if (m_bitDepth == 2) {
-    bitmapSize = ((static_cast<size_t>(pageHeader.width) * pageHeader.height + 7) / 8) * 2;
-  } else {
-    bitmapSize = ((pageHeader.width + 7) / 8) * pageHeader.height;
+  size_t bitmapSize = 0;
+  const XtcError err = beginPage(pageIndex, pageHeader, bitmapSize);
+  if (err != XtcError::OK) {
+    return err;
   }
 
   // Read in chunks
   std::vector<uint8_t> chunk(chunkSize);
+
+  // Compressed pages are handed out decoded, in the same chunks
+  if (pageHeader.compression == XTG_COMPRESSION_PACKBITS) {
+    return readPackBits(pageHeader.dataSize, bitmapSize, chunk.data(), chunkSize, callback);
+  }
+
   size_t totalRead = 0;
 
   while (totalRead < bitmapSize) {
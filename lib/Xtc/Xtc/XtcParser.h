@@ -41,8 +41,8 @@ class XtcParser {
   uint16_t getHeight() const { return m_defaultHeight; }
   uint8_t getBitDepth() const { return m_bitDepth; }  // 1 = XTC/XTG, 2 = XTCH/XTH
 
-  // Page information
-  bool getPageInfo(uint32_t pageIndex, PageInfo& info) const;
+  // Page information (page table entry plus the compression byte of the page header)
+  bool getPageInfo(uint32_t pageIndex, PageInfo& info);
 
   /**
    * Load page bitmap (raw 1-bit data, skipping XTG header)
@@ -84,7 +84,11 @@ class XtcParser {
   FsFile m_file;
   bool m_isOpen;
   XtcHeader m_header;
-  std::vector<PageInfo> m_pageTable;
+  // The page table stays on the card; entries are read a block at a time so RAM does not grow with page count
+  static constexpr uint32_t PAGE_TABLE_BLOCK_ENTRIES = 64;
+  static constexpr uint32_t NO_BLOCK = UINT32_MAX;
+  PageTableEntry m_pageTableBlock[PAGE_TABLE_BLOCK_ENTRIES];
+  uint32_t m_pageTableBlockStart;  // Page index of m_pageTableBlock[0], NO_BLOCK if nothing is cached
   std::vector<ChapterInfo> m_chapters;
   std::string m_title;
   std::string m_author;
@@ -100,6 +104,13 @@ class XtcParser {
   XtcError readTitle();
   XtcError readAuthor();
   XtcError readChapters();
+  bool readPageTableEntry(uint32_t pageIndex, PageTableEntry& entry);
+
+  // Seek to a page, validate its header and compute the decoded bitmap size; the file is left at the page data
+  XtcError beginPage(uint32_t pageIndex, XtgPageHeader& pageHeader, size_t& bitmapSize);
+  // Decode bitmapSize bytes of PackBits page data through `window`, calling `callback` (if set) each time it fills
+  XtcError readPackBits(size_t compressedSize, size_t bitmapSize, uint8_t* window, size_t windowSize,
+                        const std::function<void(const uint8_t* data, size_t size, size_t offset)>& callback);
 };
 
 }  // namespace xtc
@@ -70,7 +70,7 @@ struct XtgPageHeader {
   uint16_t width;       // 0x04: Image width (pixels)
   uint16_t height;      // 0x06: Image height (pixels)
   uint8_t colorMode;    // 0x08: Color mode (0=monochrome)
-  uint8_t compression;  // 0x09: Compression (0=uncompressed)
+  uint8_t compression;  // 0x09: Compression (XTG_COMPRESSION_*)
   uint32_t dataSize;    // 0x0A: Image data size (bytes)
   uint64_t md5;         // 0x0E: MD5 checksum (first 8 bytes, optional)
   // Followed by bitmap data at offset 0x16 (22)
@@ -83,17 +83,24 @@ struct XtgPageHeader {
   //   First plane: Bit1 for all pixels
   //   Second plane: Bit2 for all pixels
   //   pixelValue = (bit1 << 1) | bit2
+  //
+  // With XTG_COMPRESSION_PACKBITS, dataSize is the compressed size and each row (XTG) or column of each plane (XTH)
+  // is PackBits-encoded on its own
 };
 #pragma pack(pop)
 
+// XTG/XTH page compression
+constexpr uint8_t XTG_COMPRESSION_NONE = 0;
+constexpr uint8_t XTG_COMPRESSION_PACKBITS = 1;
+
 // Page information (internal use, optimized for memory)
 struct PageInfo {
   uint32_t offset;   // File offset to page data (max 4GB file size)
   uint32_t size;     // Data size (bytes)
   uint16_t width;    // Page width
   uint16_t height;   // Page height
-  uint8_t bitDepth;  // 1 = XTG (1-bit), 2 = XTH (2-bit grayscale)
-  uint8_t padding;   // Alignment padding
+  uint8_t bitDepth;     // 1 = XTG (1-bit), 2 = XTH (2-bit grayscale)
+  uint8_t compression;  // XTG_COMPRESSION_*, from the page header
 };  // 16 bytes total
 
 struct ChapterInfo {
@@ -0,0 +1,106 @@
+/**
+ * XtcPageCache.cpp
+ *
+ * Read-ahead cache of XTC page bitmaps
+ */
+
+#include "XtcPageCache.h"
+
+#include <Arduino.h>
+#include <Logging.h>
+
+#include <cstdlib>
+
+#include "Xtc.h"
+
+void XtcPageCache::allocate(const size_t pageSize) {
+  release();
+  slotSize = pageSize;
+  while (slotsUsed < MAX_SLOTS && ESP.getMaxAllocHeap() >= pageSize + HEAP_RESERVE) {
+    auto* buffer = static_cast<uint8_t*>(malloc(pageSize));
+    if (!buffer) {
+      break;
+    }
+    slots[slotsUsed++].buffer = buffer;
+  }
+  LOG_DBG("XPC", "Allocated %zu page slots of %zu bytes", slotsUsed, pageSize);
+}
+
+void XtcPageCache::release() {
+  for (auto& slot : slots) {
+    free(slot.buffer);
+    slot = Slot();
+  }
+  slotsUsed = 0;
+}
+
+XtcPageCache::Slot* XtcPageCache::find(const uint32_t page) {
+  for (size_t i = 0; i < slotsUsed; i++) {
+    if (slots[i].page == page) {
+      return &slots[i];
+    }
+  }
+  return nullptr;
+}
+
+XtcPageCache::Slot* XtcPageCache::victim(const uint32_t page) {
+  Slot* best = nullptr;
+  uint32_t bestDistance = 0;
+  for (size_t i = 0; i < slotsUsed; i++) {
+    Slot& slot = slots[i];
+    if (slot.page == NO_PAGE) {
+      return &slot;
+    }
+    if (slot.page == page) {
+      continue;
+    }
+    const uint32_t distance = slot.page > page ? slot.page - page : page - slot.page;
+    if (!best || distance > bestDistance) {
+      best = &slot;
+      bestDistance = distance;
+    }
+  }
+  return best;
+}
+
+bool XtcPageCache::load(Slot& slot, const uint32_t page) {
+  slot.page = NO_PAGE;
+  if (xtc.loadPage(page, slot.buffer, slotSize) == 0) {
+    LOG_ERR("XPC", "Failed to load page %lu", page);
+    return false;
+  }
+  slot.page = page;
+  return true;
+}
+
+const uint8_t* XtcPageCache::get(const uint32_t page) {
+  if (Slot* slot = find(page)) {
+    hitCount++;
+    return slot->buffer;
+  }
+
+  missCount++;
+  Slot* slot = victim(page);
+  if (!slot || !load(*slot, page)) {
+    return nullptr;
+  }
+  return slot->buffer;
+}
+
+bool XtcPageCache::prefetch(const uint32_t page) {
+  const uint32_t pageCount = xtc.getPageCount();
+  const uint32_t candidates[] = {page + 1, page > 0 ? page - 1 : NO_PAGE};
+  for (const uint32_t candidate : candidates) {
+    if (candidate >= pageCount || find(candidate)) {
+      continue;
+    }
+    Slot* slot = victim(page);
+    // Never evict a neighbour for the other one, except the previous page to make room for the next
+    const bool neighbour = slot && slot->page != NO_PAGE && (slot->page == page + 1 || slot->page + 1 == page);
+    if (!slot || (neighbour && !(candidate == page + 1 && slot->page + 1 == page))) {
+      return false;
+    }
+    return load(*slot, candidate);
+  }
+  return false;
+}
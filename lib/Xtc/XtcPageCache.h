@@ -0,0 +1,67 @@
+/**
+ * XtcPageCache.h
+ *
+ * Read-ahead cache of XTC page bitmaps
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+class Xtc;
+
+/**
+ * Small ring of page bitmaps: the page on screen plus its neighbours, which the reader fills while idle so a page
+ * turn only has to blit. Slots are sized against free heap when allocated; with no slots at all the reader streams
+ * pages instead.
+ */
+class XtcPageCache {
+ public:
+  static constexpr size_t MAX_SLOTS = 3;             // Current, next and previous page
+  static constexpr size_t HEAP_RESERVE = 64 * 1024;  // Heap left free for the rest of the reader
+  static constexpr uint32_t NO_PAGE = UINT32_MAX;
+
+  explicit XtcPageCache(const Xtc& xtc) : xtc(xtc) {}
+  ~XtcPageCache() { release(); }
+  XtcPageCache(const XtcPageCache&) = delete;
+  XtcPageCache& operator=(const XtcPageCache&) = delete;
+
+  // Allocate as many slots of pageSize bytes as free heap allows, keeping HEAP_RESERVE
+  void allocate(size_t pageSize);
+  void release();
+
+  /**
+   * Bitmap of a page, read into the slot of the page furthest away on a miss
+   * @return nullptr if there are no slots or the read failed
+   */
+  const uint8_t* get(uint32_t page);
+
+  /**
+   * Read one uncached neighbour of `page` (next first, then previous) without evicting `page`
+   * @return true if a page was read, false if there was nothing to do
+   */
+  bool prefetch(uint32_t page);
+
+  [[nodiscard]] size_t slotCount() const { return slotsUsed; }
+  [[nodiscard]] uint32_t hits() const { return hitCount; }
+  [[nodiscard]] uint32_t misses() const { return missCount; }
+
+ private:
+  struct Slot {
+    uint8_t* buffer = nullptr;
+    uint32_t page = NO_PAGE;
+  };
+
+  const Xtc& xtc;
+  Slot slots[MAX_SLOTS];
+  size_t slotsUsed = 0;
+  size_t slotSize = 0;
+  uint32_t hitCount = 0;
+  uint32_t missCount = 0;
+
+  Slot* find(uint32_t page);
+  // Empty slot, else the one holding the page furthest from `page`; never the slot holding `page` itself
+  Slot* victim(uint32_t page);
+  bool load(Slot& slot, uint32_t page);
+};
@@ -0,0 +1,200 @@
+#include "ZipEntryStream.h"
+
+#include <Logging.h>
+#include <miniz.h>
+
+#include <cstdlib>
+#include <cstring>
+
+bool ZipEntryStream::open(const char* filename, const size_t chunkSize) {
+  close();
+
+  if (!zip.open()) {
+    return false;
+  }
+
+  if (!zip.loadFileStatSlim(filename, &fileStat)) {
+    LOG_ERR("ZIP", "Entry not found: %s", filename);
+    close();
+    return false;
+  }
+
+  dataOffset = zip.getDataOffset(fileStat);
+  if (dataOffset < 0) {
+    close();
+    return false;
+  }
+
+  if (fileStat.method != MZ_NO_COMPRESSION && fileStat.method != MZ_DEFLATED) {
+    LOG_ERR("ZIP", "Unsupported compression method");
+    close();
+    return false;
+  }
+
+  inputBuffer = static_cast<uint8_t*>(malloc(chunkSize));
+  if (!inputBuffer) {
+    LOG_ERR("ZIP", "Failed to allocate memory for zip file read buffer");
+    close();
+    return false;
+  }
+  inputSize = chunkSize;
+
+  if (fileStat.method == MZ_NO_COMPRESSION) {
+    opened = true;
+    return seek(0);
+  }
+
+  inflator = static_cast<tinfl_decompressor*>(malloc(sizeof(tinfl_decompressor)));
+  window = static_cast<uint8_t*>(malloc(TINFL_LZ_DICT_SIZE));
+  if (!inflator || !window) {
+    LOG_ERR("ZIP", "Failed to allocate memory for inflator");
+    close();
+    return false;
+  }
+
+  opened = true;
+  return restart();
+}
+
+void ZipEntryStream::close() {
+  free(inflator);
+  free(window);
+  free(inputBuffer);
+  inflator = nullptr;
+  window = nullptr;
+  inputBuffer = nullptr;
+  zip.close();
+  opened = false;
+  readPos = 0;
+}
+
+bool ZipEntryStream::restart() {
+  memset(inflator, 0, sizeof(tinfl_decompressor));
+  tinfl_init(inflator);
+  if (!zip.file.seek(dataOffset)) {
+    return false;
+  }
+  inputFilled = 0;
+  inputCursor = 0;
+  compressedRemaining = fileStat.compressedSize;
+  produced = 0;
+  finished = false;
+  readPos = 0;
+  return true;
+}
+
+bool ZipEntryStream::inflateMore() {
+  if (finished) {
+    return false;
+  }
+
+  // Load more compressed bytes when needed
+  if (inputCursor >= inputFilled && compressedRemaining > 0) {
+    const int bytesRead = zip.file.read(inputBuffer, compressedRemaining < inputSize ? compressedRemaining : inputSize);
+    if (bytesRead <= 0) {
+      LOG_ERR("ZIP", "Could not read more bytes");
+      return false;
+    }
+    inputFilled = bytesRead;
+    inputCursor = 0;
+    compressedRemaining -= bytesRead;
+  }
+
+  size_t inBytes = inputFilled - inputCursor;
+  const size_t outputCursor = produced & (TINFL_LZ_DICT_SIZE - 1);
+  size_t outBytes = TINFL_LZ_DICT_SIZE - outputCursor;
+  const tinfl_status status =
+      tinfl_decompress(inflator, inputBuffer + inputCursor, &inBytes, window, window + outputCursor, &outBytes,
+                       compressedRemaining > 0 ? TINFL_FLAG_HAS_MORE_INPUT : 0);
+  inputCursor += inBytes;
+  produced += outBytes;
+
+  if (status < 0) {
+    LOG_ERR("ZIP", "tinfl_decompress() failed with status %d", status);
+    return false;
+  }
+  if (status == TINFL_STATUS_DONE) {
+    finished = true;
+  } else if (outBytes == 0 && inBytes == 0 && compressedRemaining == 0) {
+    LOG_ERR("ZIP", "Unexpected EOF");
+    return false;
+  }
+  return true;
+}
+
+size_t ZipEntryStream::windowSpan() const {
+  const size_t windowPos = readPos & (TINFL_LZ_DICT_SIZE - 1);
+  const size_t available = produced - readPos;
+  return available < TINFL_LZ_DICT_SIZE - windowPos ? available : TINFL_LZ_DICT_SIZE - windowPos;
+}
+
+int ZipEntryStream::read(void* buffer, const size_t len) {
+  if (!opened) {
+    return -1;
+  }
+
+  const size_t remaining = size() - readPos;
+  const size_t toRead = len < remaining ? len : remaining;
+
+  if (fileStat.method == MZ_NO_COMPRESSION) {
+    const int bytesRead = zip.file.read(buffer, toRead);
+    if (bytesRead > 0) {
+      readPos += bytesRead;
+    }
+    return bytesRead;
+  }
+
+  auto* out = static_cast<uint8_t*>(buffer);
+  size_t copied = 0;
+  while (copied < toRead) {
+    if (readPos == produced) {
+      if (!inflateMore()) {
+        break;
+      }
+      continue;
+    }
+
+    // Copy what is already inflated
+    size_t chunk = windowSpan();
+    if (chunk > toRead - copied) chunk = toRead - copied;
+    memcpy(out + copied, window + (readPos & (TINFL_LZ_DICT_SIZE - 1)), chunk);
+    copied += chunk;
+    readPos += chunk;
+  }
+
+  if (copied == 0 && toRead > 0) {
+    return -1;
+  }
+  return static_cast<int>(copied);
+}
+
+bool ZipEntryStream::seek(const size_t position) {
+  if (!opened || position > size()) {
+    return false;
+  }
+
+  if (fileStat.method == MZ_NO_COMPRESSION) {
+    if (!zip.file.seek(dataOffset + position)) {
+      return false;
+    }
+    readPos = position;
+    return true;
+  }
+
+  // Behind the look-back window: inflate again from the start
+  if (position < produced && produced - position > TINFL_LZ_DICT_SIZE) {
+    LOG_DBG("ZIP", "Seek to %u is outside the look-back window, restarting", static_cast<unsigned>(position));
+    if (!restart()) {
+      return false;
+    }
+  }
+
+  // Inflate up to the position; the window then still holds it
+  while (produced < position) {
+    if (!inflateMore()) {
+      return false;
+    }
+  }
+  readPos = position;
+  return true;
+}
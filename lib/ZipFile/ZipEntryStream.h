@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "ZipFile.h"
+
+struct tinfl_decompressor_tag;
+
+/**
+ * Reads one entry of a ZIP archive (stored or deflated) as a stream, without extracting it to the SD card first.
+ *
+ * Deflated entries are inflated on demand into the 32KB dictionary window, which doubles as a look-back buffer: seek()
+ * can return to any of the last 32KB inflated, e.g. to the start of an image after parsing its header. Seeking further
+ * back restarts the inflation from the start of the entry. Stored entries seek freely.
+ */
+class ZipEntryStream {
+ public:
+  // zipPath is referenced, not copied, and must outlive the stream
+  explicit ZipEntryStream(const std::string& zipPath) : zip(zipPath) {}
+  ~ZipEntryStream() { close(); }
+
+  ZipEntryStream(const ZipEntryStream&) = delete;
+  ZipEntryStream& operator=(const ZipEntryStream&) = delete;
+
+  bool open(const char* filename, size_t chunkSize = 1024);
+  void close();
+  bool isOpen() const { return opened; }
+
+  // Reads up to len bytes. Returns the count read, 0 at the end of the entry, negative on error.
+  int read(void* buffer, size_t len);
+  bool skip(size_t len) { return seek(readPos + len); }
+  bool seek(size_t position);
+  size_t position() const { return readPos; }
+  size_t size() const { return fileStat.uncompressedSize; }
+
+ private:
+  // Inflates the next piece of the entry into the window. Returns false at the end or on error.
+  bool inflateMore();
+  bool restart();
+  // Inflated bytes from readPos on that are contiguous in the window
+  size_t windowSpan() const;
+
+  ZipFile zip;
+  ZipFile::FileStatSlim fileStat = {};
+  long dataOffset = 0;
+  bool opened = false;
+  size_t readPos = 0;
+
+  uint8_t* inputBuffer = nullptr;
+  size_t inputSize = 0;
+
+  // Deflated entries only
+  tinfl_decompressor_tag* inflator = nullptr;
+  uint8_t* window = nullptr;  // Circular dictionary holding the last inflated bytes
+  size_t inputFilled = 0;
+  size_t inputCursor = 0;
+  size_t compressedRemaining = 0;
+  size_t produced = 0;  // Bytes inflated so far
+  bool finished = false;
+};
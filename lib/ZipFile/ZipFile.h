@@ -38,6 +38,8 @@ class ZipFile {
   }
 
  private:
+  friend class ZipEntryStream;
+
   const std::string& filePath;
   FsFile file;
   ZipDetails zipDetails = {0, 0, false};
@@ -178,6 +178,11 @@ static uint8 gHuffVal2[256];
 static HuffTable gHuffTab3;
 static uint8 gHuffVal3[256];
 
+// AC - 1024: symbols whose code is at most 8 bits, looked up from the next 8 bits of the stream. The high byte is the
+// code length (0 for longer codes, which go through the table above) and the low byte the symbol.
+static uint16 gHuffLook2[256];
+static uint16 gHuffLook3[256];
+
 static uint8 gValidHuffTables;
 static uint8 gValidQuantTables;
 
@@ -222,7 +227,8 @@ static uint8 gMCUOrg[6];
 static pjpeg_need_bytes_callback_t g_pNeedBytesCallback;
 static void* g_pCallback_data;
 static uint8 gCallbackStatus;
-static uint8 gReduce;
+static uint8 gScale;
+static uint8 gScaleMask;  // Coefficient index bits that must be clear for the coefficient to be kept
 //------------------------------------------------------------------------------
 static void fillInBuf(void) {
   unsigned char status;
@@ -434,6 +440,19 @@ static PJPG_INLINE uint8 huffDecode(const HuffTable* pHuffTable, const uint8* pH
   return pHuffVal[j];
 }
 //------------------------------------------------------------------------------
+// AC symbols come every few bits, so short codes are resolved in one step. The top byte of gBitBuf always holds the
+// next 8 bits, and consuming them through getBits2() reads the same octets the bit-by-bit walk would.
+static PJPG_INLINE uint8 huffDecodeAC(uint8 compACTab) {
+  uint16 entry = (compACTab ? gHuffLook3 : gHuffLook2)[gBitBuf >> 8];
+
+  if (entry) {
+    getBits2((uint8)(entry >> 8));
+    return (uint8)entry;
+  }
+
+  return compACTab ? huffDecode(&gHuffTab3, gHuffVal3) : huffDecode(&gHuffTab2, gHuffVal2);
+}
+//------------------------------------------------------------------------------
 static void huffCreate(const uint8* pBits, HuffTable* pHuffTable) {
   uint8 i = 0;
   uint8 j = 0;
@@ -464,6 +483,26 @@ static void huffCreate(const uint8* pBits, HuffTable* pHuffTable) {
   }
 }
 //------------------------------------------------------------------------------
+static void huffCreateLookup(const uint8* pBits, const uint8* pHuffVal, uint16* pLook) {
+  uint16 i, code = 0;
+  uint8 len, j = 0;
+
+  for (i = 0; i < 256; i++) pLook[i] = 0;
+
+  for (len = 1; len <= 8; len++) {
+    uint8 num = pBits[len - 1];
+
+    for (; num; num--, code++, j++) {
+      // Malformed tables run out of codes; the rest is left to the bit-by-bit walk
+      if (code >= (1U << len)) return;
+
+      for (i = 0; i < (1U << (8 - len)); i++) pLook[(code << (8 - len)) + i] = (uint16)((len << 8) | pHuffVal[j]);
+    }
+
+    code <<= 1;
+  }
+}
+//------------------------------------------------------------------------------
 static HuffTable* getHuffTable(uint8 index) {
   // 0-1 = DC
   // 2-3 = AC
@@ -543,6 +582,7 @@ static uint8 readDHTMarker(void) {
     left = (uint16)(left - totalRead);
 
     huffCreate(bits, pHuffTable);
+    if (tableIndex >= 2) huffCreateLookup(bits, pHuffVal, tableIndex == 3 ? gHuffLook3 : gHuffLook2);
   }
 
   return 0;
@@ -1907,6 +1947,119 @@ static void transformBlockReduce(uint8 mcuBlock) {
   }
 }
 //------------------------------------------------------------------------------
+// Reduced-size IDCT for the 1/2 and 1/4 scales: the low-frequency n*n coefficients go through an n-point IDCT, which
+// samples the full 8-point reconstruction at the centre of each 2x2 or 4x4 pixel group. The weights are
+// cos((2x+1)u*pi/2n) / cos(u*pi/16) in 8.8 fixed point; the divisor undoes the Winograd scaling of the coefficients.
+static PJPG_INLINE int16 imulScaled(int16 w, int16 c) {
+  long x = ((long)c * w) + 128L;
+  return (int16)(PJPG_ARITH_SHIFT_RIGHT_8_L(x));
+}
+
+static void idctScaled4(int16* p, uint8 stride) {
+  int16 s0 = p[0];
+  int16 e2 = imulScaled(196, p[2 * stride]);
+  int16 s1 = p[1 * stride];
+  int16 s3 = p[3 * stride];
+  int16 o0 = imulScaled(241, s1) + imulScaled(118, s3);
+  int16 o1 = imulScaled(100, s1) - imulScaled(284, s3);
+
+  p[0] = s0 + e2 + o0;
+  p[1 * stride] = s0 - e2 + o1;
+  p[2 * stride] = s0 - e2 - o1;
+  p[3 * stride] = s0 + e2 - o0;
+}
+
+static void idctScaled2(int16* p, uint8 stride) {
+  int16 s0 = p[0];
+  int16 o0 = imulScaled(185, p[stride]);
+
+  p[0] = s0 + o0;
+  p[stride] = s0 - o0;
+}
+
+static void idctScaled(uint8 n) {
+  uint8 i, j;
+
+  for (i = 0; i < n; i++) {
+    if (n == 4)
+      idctScaled4(gCoeffBuf + i * 8, 1);
+    else
+      idctScaled2(gCoeffBuf + i * 8, 1);
+  }
+
+  for (i = 0; i < n; i++) {
+    if (n == 4)
+      idctScaled4(gCoeffBuf + i, 8);
+    else
+      idctScaled2(gCoeffBuf + i, 8);
+
+    // descale, convert to unsigned and clamp to 8-bit
+    for (j = 0; j < n; j++) gCoeffBuf[i + j * 8] = clamp(PJPG_DESCALE(gCoeffBuf[i + j * 8]) + 128);
+  }
+}
+
+// Colour conversion for the 1/2 and 1/4 scales. Each block holds n*n pixels; chroma blocks are upsampled by the
+// component sampling factors across the luma blocks of the MCU (blocks at offsets 64 to the right, 128 below).
+static void transformBlockScaled(uint8 mcuBlock) {
+  uint8 n = (uint8)(8 >> gScale);
+  uint8 componentID = gMCUOrg[mcuBlock];
+  uint8 hSamp = gCompHSamp[0];
+  uint8 vSamp = gCompVSamp[0];
+  uint8 x, y, dx, dy;
+
+  idctScaled(n);
+
+  if (componentID == 0) {
+    // Luma block index within the MCU, in raster order
+    uint8 lumaOfs = 0;
+    if (gScanType == PJPG_YH1V2)
+      lumaOfs = mcuBlock * 128;
+    else if (gScanType != PJPG_GRAYSCALE)
+      lumaOfs = mcuBlock * 64;
+
+    for (y = 0; y < n; y++) {
+      for (x = 0; x < n; x++) {
+        uint8 c = (uint8)gCoeffBuf[y * 8 + x];
+        uint8 ofs = lumaOfs + y * 8 + x;
+        gMCUBufR[ofs] = c;
+        gMCUBufG[ofs] = c;
+        gMCUBufB[ofs] = c;
+      }
+    }
+    return;
+  }
+
+  for (y = 0; y < n; y++) {
+    for (x = 0; x < n; x++) {
+      uint8 c = (uint8)gCoeffBuf[y * 8 + x];
+      int16 deltaA, deltaG;
+
+      if (componentID == 1) {
+        deltaG = ((c * 88U) >> 8U) - 44U;
+        deltaA = (c + ((c * 198U) >> 8U)) - 227U;
+      } else {
+        deltaG = ((c * 183U) >> 8U) - 91;
+        deltaA = (c + ((c * 103U) >> 8U)) - 179;
+      }
+
+      for (dy = 0; dy < vSamp; dy++) {
+        for (dx = 0; dx < hSamp; dx++) {
+          uint8 lx = x * hSamp + dx;
+          uint8 ly = y * vSamp + dy;
+          uint8 ofs = (ly / n) * 128 + (lx / n) * 64 + (ly % n) * 8 + (lx % n);
+
+          gMCUBufG[ofs] = subAndClamp(gMCUBufG[ofs], deltaG);
+          // Cb adds to blue, Cr to red
+          if (componentID == 1)
+            gMCUBufB[ofs] = addAndClamp(gMCUBufB[ofs], deltaA);
+          else
+            gMCUBufR[ofs] = addAndClamp(gMCUBufR[ofs], deltaA);
+        }
+      }
+    }
+  }
+}
+//------------------------------------------------------------------------------
 static uint8 decodeNextMCU(void) {
   uint8 status;
   uint8 mcuBlock;
@@ -1941,10 +2094,10 @@ static uint8 decodeNextMCU(void) {
 
     compACTab = gCompACTab[componentID];
 
-    if (gReduce) {
-      // Decode, but throw out the AC coefficients in reduce mode.
+    if (gScale == PJPG_SCALE_1_8) {
+      // DC only: the AC codes are read past to stay in step, never dequantized or transformed
       for (k = 1; k < 64; k++) {
-        s = huffDecode(compACTab ? &gHuffTab3 : &gHuffTab2, compACTab ? gHuffVal3 : gHuffVal2);
+        s = huffDecodeAC(compACTab);
 
         numExtraBits = s & 0xF;
         if (numExtraBits) getBits2(numExtraBits);
@@ -1969,12 +2122,52 @@ static uint8 decodeNextMCU(void) {
       }
 
       transformBlockReduce(mcuBlock);
+    } else if (gScale) {
+      // Decode all AC coefficients but only dequantize the low-frequency ones the reduced IDCT uses
+      uint8 n = (uint8)(8 >> gScale);
+      uint8 i;
+      for (i = 1; i < n * 8; i++) gCoeffBuf[i] = 0;
+
+      for (k = 1; k < 64; k++) {
+        uint16 extraBits;
+
+        s = huffDecodeAC(compACTab);
+
+        extraBits = 0;
+        numExtraBits = s & 0xF;
+        if (numExtraBits) extraBits = getBits2(numExtraBits);
+
+        r = s >> 4;
+        s &= 15;
+
+        if (s) {
+          uint8 z;
+
+          if (r) {
+            if ((k + r) > 63) return PJPG_DECODE_ERROR;
+
+            k = (uint8)(k + r);
+          }
+
+          z = ZAG[k];
+          if ((z & gScaleMask) == 0) gCoeffBuf[z] = huffExtend(extraBits, s) * pQ[k];
+        } else {
+          if (r == 15) {
+            if ((k + 16) > 64) return PJPG_DECODE_ERROR;
+
+            k += (16 - 1);  // - 1 because the loop counter is k
+          } else
+            break;
+        }
+      }
+
+      transformBlockScaled(mcuBlock);
     } else {
       // Decode and dequantize AC coefficients
       for (k = 1; k < 64; k++) {
         uint16 extraBits;
 
-        s = huffDecode(compACTab ? &gHuffTab3 : &gHuffTab2, compACTab ? gHuffVal3 : gHuffVal2);
+        s = huffDecodeAC(compACTab);
 
         extraBits = 0;
         numExtraBits = s & 0xF;
@@ -2039,7 +2232,7 @@ unsigned char pjpeg_decode_mcu(void) {
 }
 //------------------------------------------------------------------------------
 unsigned char pjpeg_decode_init(pjpeg_image_info_t* pInfo, pjpeg_need_bytes_callback_t pNeed_bytes_callback,
-                                void* pCallback_data, unsigned char reduce) {
+                                void* pCallback_data, unsigned char scale) {
   uint8 status;
 
   pInfo->m_width = 0;
@@ -2057,7 +2250,7 @@ unsigned char pjpeg_decode_init(pjpeg_image_info_t* pInfo, pjpeg_need_bytes_call
   g_pNeedBytesCallback = pNeed_bytes_callback;
   g_pCallback_data = pCallback_data;
   gCallbackStatus = 0;
-  gReduce = reduce;
+  pjpeg_set_scale(scale);
 
   status = init();
   if ((status) || (gCallbackStatus)) return gCallbackStatus ? gCallbackStatus : status;
@@ -2085,3 +2278,23 @@ unsigned char pjpeg_decode_init(pjpeg_image_info_t* pInfo, pjpeg_need_bytes_call
 
   return 0;
 }
+//------------------------------------------------------------------------------
+void pjpeg_set_scale(unsigned char scale) {
+  // Index bits of column and row values of n and above, for n = 8 >> scale
+  static const uint8 masks[] = {0x00, 0x24, 0x36, 0x3F};
+
+  if (scale > PJPG_SCALE_1_8) scale = PJPG_SCALE_1_8;
+  gScale = scale;
+  gScaleMask = masks[scale];
+}
+//------------------------------------------------------------------------------
+unsigned char pjpeg_choose_scale(int width, int height, int minWidth, int minHeight) {
+  unsigned char scale = PJPG_SCALE_1_8;
+
+  for (; scale > PJPG_SCALE_1_1; scale--) {
+    int round = (1 << scale) - 1;
+    if (((width + round) >> scale) >= minWidth && ((height + round) >> scale) >= minHeight) break;
+  }
+
+  return scale;
+}
@@ -105,12 +105,25 @@ typedef struct {
 typedef unsigned char (*pjpeg_need_bytes_callback_t)(unsigned char* pBuf, unsigned char buf_size,
                                                      unsigned char* pBytes_actually_read, void* pCallback_data);
 
+// Output scales. Reduced scales decode every 8x8 block straight to its top-left (8 >> scale)x(8 >> scale) pixels, still
+// laid out with a row stride of 8 at the usual block offsets, so an MCU covers (m_MCUWidth >> scale)x(m_MCUHeight >>
+// scale) pixels. 1/2 and 1/4 run a 4- or 2-point IDCT on the low-frequency coefficients only, 1/8 uses the DC alone.
+// All of them skip the dequantization of the discarded coefficients and most of the IDCT and chroma upsampling work.
+enum { PJPG_SCALE_1_1 = 0, PJPG_SCALE_1_2, PJPG_SCALE_1_4, PJPG_SCALE_1_8 };
+
 // Initializes the decompressor. Returns 0 on success, or one of the above error codes on failure.
 // pNeed_bytes_callback will be called to fill the decompressor's internal input buffer.
-// If reduce is 1, only the first pixel of each block will be decoded. This mode is much faster because it skips the AC
-// dequantization, IDCT and chroma upsampling of every image pixel. Not thread safe.
+// scale is one of the PJPG_SCALE_ values. Not thread safe.
 unsigned char pjpeg_decode_init(pjpeg_image_info_t* pInfo, pjpeg_need_bytes_callback_t pNeed_bytes_callback,
-                                void* pCallback_data, unsigned char reduce);
+                                void* pCallback_data, unsigned char scale);
+
+// Changes the output scale once the image size is known. Only valid between pjpeg_decode_init() and the first
+// pjpeg_decode_mcu(). Not thread safe.
+void pjpeg_set_scale(unsigned char scale);
+
+// Returns the strongest PJPG_SCALE_ reduction whose output still covers minWidth x minHeight, so a caller that
+// resamples to that size afterwards never has to upsample. A scaled dimension is (size + (1 << scale) - 1) >> scale.
+unsigned char pjpeg_choose_scale(int width, int height, int minWidth, int minHeight);
 
 // Decompresses the file's next MCU. Returns 0 on success, PJPG_NO_MORE_BLOCKS if no more blocks are available, or an
 // error code. Must be called a total of m_MCUSPerRow*m_MCUSPerCol times to completely decompress the image. Not thread
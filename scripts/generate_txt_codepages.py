@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+"""Generate the legacy code page tables used to transcode TXT files to UTF-8."""
+
+from __future__ import annotations
+
+import argparse
+import pathlib
+
+REPLACEMENT = 0xFFFD
+GBK_LEAD_FIRST, GBK_LEAD_LAST = 0x81, 0xFE
+GBK_TRAIL_FIRST, GBK_TRAIL_LAST = 0x40, 0xFE
+
+
+def _decode(raw: bytes, codec: str) -> int:
+    # Unmapped byte sequences become U+FFFD so the reader shows a replacement glyph instead of dropping text.
+    try:
+        text = raw.decode(codec)
+    except UnicodeDecodeError:
+        return REPLACEMENT
+    if len(text) != 1 or ord(text) > 0xFFFF:
+        return REPLACEMENT
+    return ord(text)
+
+
+def _format_table(values: list[int], per_line: int = 12) -> str:
+    lines = []
+    for i in range(0, len(values), per_line):
+        lines.append('    ' + ', '.join(f"0x{v:04X}" for v in values[i : i + per_line]) + ',')
+    return '\n'.join(lines)
+
+
+def _high_half(codec: str) -> list[int]:
+    return [_decode(bytes([b]), codec) for b in range(0x80, 0x100)]
+
+
+def _gbk() -> list[int]:
+    values = []
+    for lead in range(GBK_LEAD_FIRST, GBK_LEAD_LAST + 1):
+        for trail in range(GBK_TRAIL_FIRST, GBK_TRAIL_LAST + 1):
+            values.append(REPLACEMENT if trail == 0x7F else _decode(bytes([lead, trail]), 'gbk'))
+    return values
+
+
+def write_header(path: pathlib.Path) -> None:
+    path.parent.mkdir(parents=True, exist_ok=True)
+    content = f"""#pragma once
+
+#include <cstdint>
+
+// Auto-generated by generate_txt_codepages.py. Do not edit manually.
+
+// Unicode of bytes 0x80-0xFF
+constexpr uint16_t cp1251_high[128] = {{
+{_format_table(_high_half('cp1251'))}
+}};
+
+constexpr uint16_t cp1252_high[128] = {{
+{_format_table(_high_half('cp1252'))}
+}};
+
+// Unicode of GBK double-byte characters, indexed by (lead - 0x{GBK_LEAD_FIRST:02X}) * {GBK_TRAIL_LAST - GBK_TRAIL_FIRST + 1} + (trail - 0x{GBK_TRAIL_FIRST:02X})
+constexpr uint8_t GBK_LEAD_FIRST = 0x{GBK_LEAD_FIRST:02X};
+constexpr uint8_t GBK_LEAD_LAST = 0x{GBK_LEAD_LAST:02X};
+constexpr uint8_t GBK_TRAIL_FIRST = 0x{GBK_TRAIL_FIRST:02X};
+constexpr uint8_t GBK_TRAIL_LAST = 0x{GBK_TRAIL_LAST:02X};
+constexpr uint16_t gbk_double_byte[] = {{
+{_format_table(_gbk())}
+}};
+"""
+    path.write_text(content)
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--output', default='lib/Txt/generated/TxtCodepages.h',
+                        help='Destination header path')
+    args = parser.parse_args()
+    write_header(pathlib.Path(args.output))
+    print(f'wrote {args.output}')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,153 @@
+#!/usr/bin/env python3
+"""
+Rewrite an XTC/XTCH file with PackBits-compressed pages.
+
+Each XTG row, or each XTH column of each plane, is encoded on its own and the page header compression byte is set to
+1. Pages that would not get smaller are kept raw. Everything outside the page data (header, metadata, chapters, page
+table, thumbnails) is copied unchanged apart from the offsets that move.
+
+Expects the usual layout where the page table precedes the page data.
+
+Usage:
+    python xtc_compress.py input.xtc output.xtc
+"""
+
+from __future__ import annotations
+
+import argparse
+import pathlib
+import struct
+import sys
+
+HEADER = struct.Struct('<IBBHBBBBIQQQQII')
+PAGE_TABLE_ENTRY = struct.Struct('<QIHH')
+PAGE_HEADER = struct.Struct('<IHHBBIQ')
+
+XTCH_MAGIC = 0x48435458
+THUMB_OFFSET_FIELD = 0x28
+
+COMPRESSION_NONE = 0
+COMPRESSION_PACKBITS = 1
+
+MAX_RUN = 128
+
+
+def packbits(data: bytes) -> bytes:
+    out = bytearray()
+    i = 0
+    n = len(data)
+    while i < n:
+        j = i + 1
+        while j < n and j - i < MAX_RUN and data[j] == data[i]:
+            j += 1
+        if j - i >= 2:
+            out.append((1 - (j - i)) & 0xFF)
+            out.append(data[i])
+            i = j
+            continue
+
+        # Literal run, up to the next run of three equal bytes
+        start = i
+        i += 1
+        while i < n and i - start < MAX_RUN:
+            if i + 2 < n and data[i] == data[i + 1] == data[i + 2]:
+                break
+            i += 1
+        out.append(i - start - 1)
+        out += data[start:i]
+    return bytes(out)
+
+
+def unpackbits(data: bytes) -> bytes:
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        header = data[i] - 256 if data[i] >= 128 else data[i]
+        i += 1
+        if header >= 0:
+            out += data[i : i + header + 1]
+            i += header + 1
+        elif header != -128:
+            out += bytes([data[i]]) * (1 - header)
+            i += 1
+    return bytes(out)
+
+
+def line_length(width: int, height: int, two_bit: bool) -> int:
+    if not two_bit:
+        return (width + 7) // 8
+    # XTH columns are height bits; planes whose columns do not end on a byte are encoded as one line
+    return height // 8 if height % 8 == 0 else (width * height + 7) // 8
+
+
+def compress_bitmap(bitmap: bytes, line: int) -> bytes:
+    return b''.join(packbits(bitmap[i : i + line]) for i in range(0, len(bitmap), line))
+
+
+def compress(data: bytes) -> tuple[bytes, int, int]:
+    header = list(HEADER.unpack_from(data, 0))
+    magic, page_count, page_table_offset = header[0], header[3], header[10]
+    thumb_offset = header[12]
+    two_bit = magic == XTCH_MAGIC
+
+    entries = [PAGE_TABLE_ENTRY.unpack_from(data, page_table_offset + i * PAGE_TABLE_ENTRY.size)
+               for i in range(page_count)]
+    first_page = min(e[0] for e in entries)
+    pages_end = max(e[0] + e[1] for e in entries)
+    if page_table_offset + page_count * PAGE_TABLE_ENTRY.size > first_page:
+        raise ValueError('page table must precede the page data')
+    if first_page <= thumb_offset < pages_end:
+        raise ValueError('thumbnails inside the page data are not supported')
+
+    out = bytearray(data[:first_page])
+    raw_total = 0
+    packed_total = 0
+    new_entries = []
+    for offset, _, width, height in entries:
+        page = list(PAGE_HEADER.unpack_from(data, offset))
+        _, page_width, page_height, _, compression, size, _ = page
+        if compression != COMPRESSION_NONE:
+            raise ValueError(f'page at {offset} is already compressed')
+        bitmap = data[offset + PAGE_HEADER.size : offset + PAGE_HEADER.size + size]
+        packed = compress_bitmap(bitmap, line_length(page_width, page_height, two_bit))
+        if unpackbits(packed) != bitmap:
+            raise AssertionError(f'PackBits round trip failed for page at {offset}')
+
+        raw_total += len(bitmap)
+        if len(packed) < len(bitmap):
+            page[4] = COMPRESSION_PACKBITS
+            page[5] = len(packed)
+            body = packed
+        else:
+            body = bitmap
+        packed_total += len(body)
+
+        new_entries.append((len(out), PAGE_HEADER.size + len(body), width, height))
+        out += PAGE_HEADER.pack(*page) + body
+
+    shift = len(out) - pages_end
+    out += data[pages_end:]
+    for i, entry in enumerate(new_entries):
+        PAGE_TABLE_ENTRY.pack_into(out, page_table_offset + i * PAGE_TABLE_ENTRY.size, *entry)
+    if thumb_offset >= pages_end:
+        struct.pack_into('<Q', out, THUMB_OFFSET_FIELD, thumb_offset + shift)
+    return bytes(out), raw_total, packed_total
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description='Compress XTC/XTCH pages with PackBits')
+    parser.add_argument('input', type=pathlib.Path)
+    parser.add_argument('output', type=pathlib.Path)
+    args = parser.parse_args()
+
+    try:
+        data, raw_total, packed_total = compress(args.input.read_bytes())
+    except ValueError as e:
+        sys.exit(f'{args.input}: {e}')
+    args.output.write_bytes(data)
+    ratio = raw_total / packed_total if packed_total else 0
+    print(f'{args.output}: page data {raw_total} -> {packed_total} bytes ({ratio:.1f}x)')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,299 @@
+#include "CoverJobQueue.h"
+
+#include <Epub.h>
+#include <HalPowerManager.h>
+#include <HalStorage.h>
+#include <Logging.h>
+#include <Serialization.h>
+#include <Txt.h>
+#include <Xtc.h>
+
+#include <algorithm>
+#include <cassert>
+
+#include "CrossPointSettings.h"
+#include "RecentBooksStore.h"
+#include "components/UITheme.h"
+#include "util/StringUtils.h"
+
+namespace {
+constexpr uint8_t COVER_JOBS_FILE_VERSION = 1;
+constexpr char COVER_JOBS_FILE[] = "/.crosspoint/cover_jobs.bin";
+constexpr size_t MAX_PENDING_BOOKS = 16;
+constexpr uint32_t PAUSE_BETWEEN_JOBS_MS = 100;  // Longer than a UI loop iteration, so its try-locks get through
+
+bool isXtc(const std::string& path) {
+  return StringUtils::checkFileExtension(path, ".xtc") || StringUtils::checkFileExtension(path, ".xtch");
+}
+
+bool isTxt(const std::string& path) { return StringUtils::checkFileExtension(path, ".txt"); }
+
+bool isEpub(const std::string& path) { return StringUtils::checkFileExtension(path, ".epub"); }
+
+bool sleepCoverNeeded() {
+  return SETTINGS.sleepScreen == CrossPointSettings::SLEEP_SCREEN_MODE::COVER ||
+         SETTINGS.sleepScreen == CrossPointSettings::SLEEP_SCREEN_MODE::COVER_CUSTOM;
+}
+
+bool sleepCoverCropped() {
+  return SETTINGS.sleepScreenCoverMode == CrossPointSettings::SLEEP_SCREEN_COVER_MODE::CROP;
+}
+
+int homeThumbHeight() { return UITheme::getInstance().getMetrics().homeCoverHeight; }
+
+// Home thumbnails that fail once are not retried: the recent books entry forgets its cover
+void forgetThumb(const std::string& path) {
+  for (const RecentBook& book : RECENT_BOOKS.getBooks()) {
+    if (book.path == path) {
+      RECENT_BOOKS.updateBook(book.path, book.title, book.author, "");
+      return;
+    }
+  }
+}
+}  // namespace
+
+CoverJobQueue CoverJobQueue::instance;
+
+void CoverJobQueue::begin() {
+  jobMutex = xSemaphoreCreateMutex();
+  assert(jobMutex != nullptr && "Failed to create cover job mutex");
+  loadFromFile();
+
+  xTaskCreate(&workerTaskTrampoline, "CoverJobs",
+              8192,              // Stack size
+              this,              // Parameters
+              0,                 // Priority, below the UI tasks
+              &workerTaskHandle  // Task handle
+  );
+  assert(workerTaskHandle != nullptr && "Failed to create cover job task");
+}
+
+void CoverJobQueue::workerTaskTrampoline(void* param) {
+  auto* self = static_cast<CoverJobQueue*>(param);
+  self->workerTaskLoop();
+}
+
+void CoverJobQueue::workerTaskLoop() {
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    while (true) {
+      xSemaphoreTake(jobMutex, portMAX_DELAY);
+      if (!running || pendingBooks.empty()) {
+        xSemaphoreGive(jobMutex);
+        break;
+      }
+
+      const std::string path = pendingBooks.front();
+      bool success;
+      {
+        HalPowerManager::Lock powerLock;  // Full speed while decoding
+        success = generateCovers(path, &stopRequested);
+      }
+      if (stopRequested.load()) {
+        // Suspended mid-job: the book stays queued and is retried from scratch on the next resume
+        LOG_DBG("CJQ", "Abandoned covers for %s, retried on resume", path.c_str());
+        xSemaphoreGive(jobMutex);
+        break;
+      }
+      if (!success) {
+        LOG_ERR("CJQ", "Failed to generate covers for %s", path.c_str());
+      }
+      removePending(path);
+      completedJobs++;
+      xSemaphoreGive(jobMutex);
+      vTaskDelay(pdMS_TO_TICKS(PAUSE_BETWEEN_JOBS_MS));
+    }
+  }
+}
+
+bool CoverJobQueue::hasCovers(const std::string& path) {
+  if (isEpub(path)) {
+    const Epub epub(path, "/.crosspoint");
+    return Storage.exists(epub.getThumbBmpPath(homeThumbHeight()).c_str()) &&
+           (!sleepCoverNeeded() || Storage.exists(epub.getCoverBmpPath(sleepCoverCropped()).c_str()));
+  }
+  if (isXtc(path)) {
+    const Xtc xtc(path, "/.crosspoint");
+    return Storage.exists(xtc.getThumbBmpPath(homeThumbHeight()).c_str()) &&
+           (!sleepCoverNeeded() || Storage.exists(xtc.getCoverBmpPath().c_str()));
+  }
+  if (isTxt(path)) {
+    const Txt txt(path, "/.crosspoint");
+    return !sleepCoverNeeded() || Storage.exists(txt.getCoverBmpPath().c_str());
+  }
+  return true;
+}
+
+bool CoverJobQueue::generateCovers(const std::string& path, const std::atomic<bool>* cancel) {
+  const bool sleepCover = sleepCoverNeeded();
+  const auto cancelled = [cancel]() { return cancel && cancel->load(); };
+
+  if (isEpub(path)) {
+    Epub epub(path, "/.crosspoint");
+    // Skip loading css since we only need metadata here
+    if (!epub.load(true, true)) {
+      LOG_ERR("CJQ", "Failed to load epub: %s", path.c_str());
+      return false;
+    }
+    // The sleep cover and the thumbnails of every theme come from one decode of the cover image, so switching
+    // themes later finds its thumbnail ready
+    const bool cropped = sleepCoverCropped();
+    const std::vector<int> thumbHeights = UITheme::getCoverThumbHeights();
+    const auto result = epub.generateCoverBmps(sleepCover && !cropped, sleepCover && cropped, thumbHeights, cancel);
+    if (cancelled()) {
+      return false;
+    }
+    if (!result.fitCover || !result.croppedCover) {
+      LOG_ERR("CJQ", "Failed to generate EPUB cover bmp: %s", path.c_str());
+    }
+    // Only the thumbnail of the current theme decides whether the home screen keeps showing a cover
+    const auto homeThumb = std::find(thumbHeights.begin(), thumbHeights.end(), homeThumbHeight());
+    if (homeThumb != thumbHeights.end() && !result.thumbs[homeThumb - thumbHeights.begin()]) {
+      forgetThumb(path);
+      return false;
+    }
+    return true;
+  }
+
+  if (isXtc(path)) {
+    Xtc xtc(path, "/.crosspoint");
+    if (!xtc.load()) {
+      LOG_ERR("CJQ", "Failed to load XTC: %s", path.c_str());
+      return false;
+    }
+    if (sleepCover && !xtc.generateCoverBmp()) {
+      LOG_ERR("CJQ", "Failed to generate XTC cover bmp: %s", path.c_str());
+    }
+    // XTC and TXT covers are not decoded through a cancellable source, so a stop is only seen between the steps
+    if (cancelled()) {
+      return false;
+    }
+    if (!xtc.generateThumbBmp(homeThumbHeight())) {
+      if (!cancelled()) {
+        forgetThumb(path);
+      }
+      return false;
+    }
+    return true;
+  }
+
+  if (isTxt(path)) {
+    // TXT files have no home thumbnail, only a sleep cover from an image in the same folder
+    Txt txt(path, "/.crosspoint");
+    return !sleepCover || (txt.load() && txt.generateCoverBmp());
+  }
+
+  return true;
+}
+
+void CoverJobQueue::enqueue(const std::string& path) {
+  xSemaphoreTake(jobMutex, portMAX_DELAY);
+  if (std::find(pendingBooks.begin(), pendingBooks.end(), path) == pendingBooks.end() && !hasCovers(path)) {
+    pendingBooks.push_back(path);
+    if (pendingBooks.size() > MAX_PENDING_BOOKS) {
+      pendingBooks.erase(pendingBooks.begin());
+    }
+    saveToFile();
+    LOG_DBG("CJQ", "Queued covers for %s (%d pending)", path.c_str(), pendingBooks.size());
+  }
+  const bool wake = running && !pendingBooks.empty();
+  xSemaphoreGive(jobMutex);
+
+  if (wake) {
+    xTaskNotifyGive(workerTaskHandle);
+  }
+}
+
+void CoverJobQueue::resume() {
+  xSemaphoreTake(jobMutex, portMAX_DELAY);
+  running = true;
+  xSemaphoreGive(jobMutex);
+  xTaskNotifyGive(workerTaskHandle);
+}
+
+void CoverJobQueue::suspend() {
+  // The job in progress, if any, gives up at its next read of the cover image; taking the mutex only waits for that,
+  // as the SD card must be free before the caller uses it again
+  stopRequested = true;
+  xSemaphoreTake(jobMutex, portMAX_DELAY);
+  running = false;
+  stopRequested = false;
+  xSemaphoreGive(jobMutex);
+}
+
+bool CoverJobQueue::runNow(const std::string& path) {
+  xSemaphoreTake(jobMutex, portMAX_DELAY);
+  const bool success = generateCovers(path);
+  removePending(path);
+  xSemaphoreGive(jobMutex);
+  return success;
+}
+
+void CoverJobQueue::removePending(const std::string& path) {
+  auto it = std::find(pendingBooks.begin(), pendingBooks.end(), path);
+  if (it != pendingBooks.end()) {
+    pendingBooks.erase(it);
+    saveToFile();
+  }
+}
+
+bool CoverJobQueue::saveToFile() const {
+  // Make sure the directory exists
+  Storage.mkdir("/.crosspoint");
+
+  FsFile outputFile;
+  if (!Storage.openFileForWrite("CJQ", COVER_JOBS_FILE, outputFile)) {
+    return false;
+  }
+
+  serialization::writePod(outputFile, COVER_JOBS_FILE_VERSION);
+  const uint8_t count = static_cast<uint8_t>(pendingBooks.size());
+  serialization::writePod(outputFile, count);
+  for (const auto& path : pendingBooks) {
+    serialization::writeString(outputFile, path);
+  }
+
+  outputFile.close();
+  return true;
+}
+
+bool CoverJobQueue::loadFromFile() {
+  FsFile inputFile;
+  if (!Storage.openFileForRead("CJQ", COVER_JOBS_FILE, inputFile)) {
+    return false;
+  }
+
+  uint8_t version;
+  serialization::readPod(inputFile, version);
+  if (version != COVER_JOBS_FILE_VERSION) {
+    LOG_ERR("CJQ", "Deserialization failed: Unknown version %u", version);
+    inputFile.close();
+    return false;
+  }
+
+  uint8_t count;
+  serialization::readPod(inputFile, count);
+  pendingBooks.clear();
+  pendingBooks.reserve(count);
+  for (uint8_t i = 0; i < count; i++) {
+    std::string path;
+    serialization::readString(inputFile, path);
+    pendingBooks.push_back(path);
+  }
+
+  inputFile.close();
+  LOG_DBG("CJQ", "Cover job queue loaded from file (%d pending)", pendingBooks.size());
+  return true;
+}
+
+// Lock
+
+CoverJobQueue::Lock::Lock(const bool engaged, const TickType_t timeout)
+    : engaged(engaged && xSemaphoreTake(instance.jobMutex, timeout) == pdTRUE) {}
+
+CoverJobQueue::Lock::~Lock() {
+  if (engaged) {
+    xSemaphoreGive(instance.jobMutex);
+  }
+}
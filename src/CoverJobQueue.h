@@ -0,0 +1,84 @@
+#pragma once
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+/**
+ * Persistent queue of books whose cover and thumbnail BMPs still have to be generated.
+ *
+ * Books are queued when opened (or when the home screen finds a thumbnail missing) and a low-priority task works
+ * through them, generating the sleep screen cover for the configured crop mode and the home thumbnail for the current
+ * theme (for EPUBs, the thumbnails of every theme, from the same decode). The queue is saved to the SD card so that
+ * unfinished work survives a reboot.
+ *
+ * The SD card driver is not thread safe, so the worker only runs between resume() and suspend(), which the home screen
+ * calls on enter and exit, and holds the queue mutex while a job runs. suspend() cuts the running job short: its
+ * decode fails at the next read of the cover image and the book stays queued for the next resume(). Code that reads
+ * covers from the SD card while the worker may be running takes a Lock first. The worker pauses between jobs so that
+ * such a Lock gets its turn.
+ */
+class CoverJobQueue {
+  // Static instance
+  static CoverJobQueue instance;
+
+  std::vector<std::string> pendingBooks;  // Oldest first
+  SemaphoreHandle_t jobMutex = nullptr;   // Guards pendingBooks and running, held for the whole of a job
+  TaskHandle_t workerTaskHandle = nullptr;
+  bool running = false;
+  std::atomic<bool> stopRequested{false};  // Set by suspend() to abandon the running job
+  std::atomic<uint32_t> completedJobs{0};
+
+  [[noreturn]] static void workerTaskTrampoline(void* param);
+  [[noreturn]] void workerTaskLoop();
+  // Generates every missing cover BMP of a book. Returns false if its home thumbnail could not be generated or the
+  // job was cancelled.
+  static bool generateCovers(const std::string& path, const std::atomic<bool>* cancel = nullptr);
+  void removePending(const std::string& path);
+  bool saveToFile() const;
+  bool loadFromFile();
+
+ public:
+  ~CoverJobQueue() = default;
+
+  // Get singleton instance
+  static CoverJobQueue& getInstance() { return instance; }
+
+  // Loads the saved queue and starts the (suspended) worker task
+  void begin();
+
+  // Queues a book unless all of its covers already exist or it is queued already
+  void enqueue(const std::string& path);
+
+  // Lets the worker process the queue / stops the worker, abandoning the running job at its next read
+  void resume();
+  void suspend();
+
+  // Generates a book's covers on the calling task, dropping it from the queue
+  bool runNow(const std::string& path);
+
+  // Whether every cover BMP the current settings and theme need for a book exists
+  static bool hasCovers(const std::string& path);
+
+  // Incremented after every job; poll to find out when new covers are ready
+  uint32_t getCompletedJobs() const { return completedJobs.load(); }
+
+  // RAII helper to keep the worker off the SD card while covers are read. With a timeout the lock may not be taken,
+  // e.g. a UI task passing 0 to try again later instead of waiting for a whole job; check held().
+  class Lock {
+    bool engaged;
+
+   public:
+    explicit Lock(bool engaged = true, TickType_t timeout = portMAX_DELAY);
+    Lock(const Lock&) = delete;
+    Lock& operator=(const Lock&) = delete;
+    ~Lock();
+    bool held() const { return engaged; }
+  };
+};
+
+// Helper macro to access the cover job queue
+#define COVER_JOBS CoverJobQueue::getInstance()
@@ -4,9 +4,12 @@
 #include <GfxRenderer.h>
 #include <HalStorage.h>
 #include <I18n.h>
+#include <Logging.h>
+#include <Serialization.h>
 #include <Txt.h>
 #include <Xtc.h>
 
+#include "CoverJobQueue.h"
 #include "CrossPointSettings.h"
 #include "CrossPointState.h"
 #include "components/UITheme.h"
@@ -14,6 +17,72 @@
 #include "images/Logo120.h"
 #include "util/StringUtils.h"
 
+// What a cached sleep frame was rendered from. Files written on the device all carry the same date, so a few spread
+// out samples of the contents catch an image replaced by another of the same size. The firmware version is part of
+// the key because a new build may draw the same image differently.
+struct SleepFrameKey {
+  uint32_t firmwareHash;
+  uint32_t pathHash;
+  uint32_t sourceSize;
+  uint16_t sourceDate;
+  uint16_t sourceTime;
+  uint32_t sourceSample;
+  uint8_t orientation;
+  uint8_t coverMode;
+  uint8_t coverFilter;
+
+  bool operator==(const SleepFrameKey& other) const {
+    return firmwareHash == other.firmwareHash && pathHash == other.pathHash && sourceSize == other.sourceSize &&
+           sourceDate == other.sourceDate && sourceTime == other.sourceTime && sourceSample == other.sourceSample &&
+           orientation == other.orientation && coverMode == other.coverMode && coverFilter == other.coverFilter;
+  }
+};
+
+namespace {
+// The last sleep frame as it went to the panel: the BW frame buffer, then for images with grays the LSB and MSB
+// planes, each GfxRenderer::getBufferSize() bytes in panel orientation
+constexpr uint8_t SLEEP_FRAME_FILE_VERSION = 2;
+constexpr char SLEEP_FRAME_FILE[] = "/.crosspoint/sleep.frame";
+constexpr int SLEEP_FRAME_SAMPLES = 8;
+constexpr size_t SLEEP_FRAME_SAMPLE_BYTES = 32;
+constexpr size_t SLEEP_FRAME_HEADER_SIZE = sizeof(uint8_t) + sizeof(SleepFrameKey) + sizeof(uint8_t);
+
+SleepFrameKey makeSleepFrameKey(const std::string& path, FsFile& file, const GfxRenderer& renderer) {
+  SleepFrameKey key = {};
+  key.firmwareHash = static_cast<uint32_t>(std::hash<std::string>{}(CROSSPOINT_VERSION));
+  key.pathHash = static_cast<uint32_t>(std::hash<std::string>{}(path));
+  key.sourceSize = static_cast<uint32_t>(file.size());
+  file.getModifyDateTime(&key.sourceDate, &key.sourceTime);
+
+  // FNV-1a over evenly spaced chunks
+  uint32_t hash = 2166136261u;
+  uint8_t sample[SLEEP_FRAME_SAMPLE_BYTES];
+  for (int i = 0; i < SLEEP_FRAME_SAMPLES; i++) {
+    if (!file.seek(static_cast<uint64_t>(key.sourceSize) * i / SLEEP_FRAME_SAMPLES)) break;
+    const int bytesRead = file.read(sample, sizeof(sample));
+    for (int j = 0; j < bytesRead; j++) {
+      hash = (hash ^ sample[j]) * 16777619u;
+    }
+  }
+  key.sourceSample = hash;
+
+  key.orientation = renderer.getOrientation();
+  key.coverMode = SETTINGS.sleepScreenCoverMode;
+  key.coverFilter = SETTINGS.sleepScreenCoverFilter;
+  return key;
+}
+
+bool writeFramePlane(FsFile& file, const GfxRenderer& renderer) {
+  const size_t bufferSize = GfxRenderer::getBufferSize();
+  return file.write(renderer.getFrameBuffer(), bufferSize) == bufferSize;
+}
+
+bool readFramePlane(FsFile& file, const GfxRenderer& renderer) {
+  const size_t bufferSize = GfxRenderer::getBufferSize();
+  return file.read(renderer.getFrameBuffer(), bufferSize) == static_cast<int>(bufferSize);
+}
+}  // namespace
+
 void SleepActivity::onEnter() {
   Activity::onEnter();
   GUI.drawPopup(renderer, tr(STR_ENTERING_SLEEP));
@@ -79,9 +148,8 @@ void SleepActivity::renderCustomSleepScreen() const {
       if (Storage.openFileForRead("SLP", filename, file)) {
         LOG_DBG("SLP", "Randomly loading: /sleep/%s", files[randomFileIndex].c_str());
         delay(100);
-        Bitmap bitmap(file, true);
-        if (bitmap.parseHeaders() == BmpReaderError::Ok) {
-          renderBitmapSleepScreen(bitmap);
+        // A different image is picked every time, so caching one would only cost an SD write
+        if (renderSleepImage(filename, file, true, numFiles == 1)) {
           dir.close();
           return;
         }
@@ -94,10 +162,8 @@ void SleepActivity::renderCustomSleepScreen() const {
   // render a custom sleep screen instead of the default.
   FsFile file;
   if (Storage.openFileForRead("SLP", "/sleep.bmp", file)) {
-    Bitmap bitmap(file, true);
-    if (bitmap.parseHeaders() == BmpReaderError::Ok) {
-      LOG_DBG("SLP", "Loading: /sleep.bmp");
-      renderBitmapSleepScreen(bitmap);
+    LOG_DBG("SLP", "Loading: /sleep.bmp");
+    if (renderSleepImage("/sleep.bmp", file, true, true)) {
       return;
     }
   }
@@ -122,7 +188,73 @@ void SleepActivity::renderDefaultSleepScreen() const {
   renderer.displayBuffer(HalDisplay::HALF_REFRESH);
 }
 
-void SleepActivity::renderBitmapSleepScreen(const Bitmap& bitmap) const {
+bool SleepActivity::renderSleepImage(const std::string& path, FsFile& file, const bool dithering,
+                                     const bool cacheable) const {
+  SleepFrameKey key = {};
+  if (cacheable) {
+    key = makeSleepFrameKey(path, file, renderer);
+    if (renderCachedSleepScreen(key)) {
+      return true;
+    }
+  }
+
+  Bitmap bitmap(file, dithering);
+  if (bitmap.parseHeaders() != BmpReaderError::Ok) {
+    LOG_DBG("SLP", "Invalid BMP file: %s", path.c_str());
+    return false;
+  }
+  renderBitmapSleepScreen(bitmap, cacheable ? &key : nullptr);
+  return true;
+}
+
+bool SleepActivity::renderCachedSleepScreen(const SleepFrameKey& key) const {
+  FsFile file;
+  if (!Storage.exists(SLEEP_FRAME_FILE) || !Storage.openFileForRead("SLP", SLEEP_FRAME_FILE, file)) {
+    return false;
+  }
+
+  uint8_t version = 0;
+  SleepFrameKey cachedKey = {};
+  uint8_t planeCount = 0;
+  serialization::readPod(file, version);
+  serialization::readPod(file, cachedKey);
+  serialization::readPod(file, planeCount);
+  if (version != SLEEP_FRAME_FILE_VERSION || !(cachedKey == key) || (planeCount != 1 && planeCount != 3) ||
+      file.size() != SLEEP_FRAME_HEADER_SIZE + planeCount * GfxRenderer::getBufferSize()) {
+    LOG_DBG("SLP", "Cached sleep frame is stale");
+    file.close();
+    return false;
+  }
+
+  if (!readFramePlane(file, renderer)) {
+    LOG_ERR("SLP", "Failed to read cached sleep frame");
+    file.close();
+    return false;
+  }
+  LOG_DBG("SLP", "Showing cached sleep frame");
+  renderer.displayBuffer(HalDisplay::HALF_REFRESH);
+
+  if (planeCount == 3) {
+    bool grays = readFramePlane(file, renderer);
+    if (grays) {
+      renderer.copyGrayscaleLsbBuffers();
+      grays = readFramePlane(file, renderer);
+    }
+    if (!grays) {
+      // The panel only has the black and white frame; the caller draws the image in full instead
+      LOG_ERR("SLP", "Failed to read cached sleep frame grays");
+      file.close();
+      Storage.remove(SLEEP_FRAME_FILE);
+      return false;
+    }
+    renderer.copyGrayscaleMsbBuffers();
+    renderer.displayGrayBuffer();
+  }
+  file.close();
+  return true;
+}
+
+void SleepActivity::renderBitmapSleepScreen(const Bitmap& bitmap, const SleepFrameKey* key) const {
   int x, y;
   const auto pageWidth = renderer.getScreenWidth();
   const auto pageHeight = renderer.getScreenHeight();
@@ -174,24 +306,46 @@ void SleepActivity::renderBitmapSleepScreen(const Bitmap& bitmap) const {
     renderer.invertScreen();
   }
 
+  // Each plane is saved from the frame buffer as soon as it is drawn, before it goes to the panel, so the image is
+  // decoded only once per plane
+  FsFile cache;
+  bool caching = key && Storage.openFileForWrite("SLP", SLEEP_FRAME_FILE, cache);
+  if (caching) {
+    serialization::writePod(cache, SLEEP_FRAME_FILE_VERSION);
+    serialization::writePod(cache, *key);
+    serialization::writePod(cache, static_cast<uint8_t>(hasGreyscale ? 3 : 1));
+  }
+  const auto capturePlane = [&] {
+    if (caching && !writeFramePlane(cache, renderer)) {
+      LOG_ERR("SLP", "Failed to write sleep frame cache");
+      caching = false;
+      cache.close();
+      Storage.remove(SLEEP_FRAME_FILE);
+    }
+  };
+
+  capturePlane();
   renderer.displayBuffer(HalDisplay::HALF_REFRESH);
 
   if (hasGreyscale) {
-    bitmap.rewindToData();
-    renderer.clearScreen(0x00);
-    renderer.setRenderMode(GfxRenderer::GRAYSCALE_LSB);
-    renderer.drawBitmap(bitmap, x, y, pageWidth, pageHeight, cropX, cropY);
+    const auto drawPlane = [&](const GfxRenderer::RenderMode mode) {
+      bitmap.rewindToData();
+      renderer.clearScreen(0x00);
+      renderer.setRenderMode(mode);
+      renderer.drawBitmap(bitmap, x, y, pageWidth, pageHeight, cropX, cropY);
+    };
+    drawPlane(GfxRenderer::GRAYSCALE_LSB);
+    capturePlane();
     renderer.copyGrayscaleLsbBuffers();
-
-    bitmap.rewindToData();
-    renderer.clearScreen(0x00);
-    renderer.setRenderMode(GfxRenderer::GRAYSCALE_MSB);
-    renderer.drawBitmap(bitmap, x, y, pageWidth, pageHeight, cropX, cropY);
+    drawPlane(GfxRenderer::GRAYSCALE_MSB);
+    capturePlane();
     renderer.copyGrayscaleMsbBuffers();
-
     renderer.displayGrayBuffer();
     renderer.setRenderMode(GfxRenderer::BW);
   }
+  if (caching) {
+    cache.close();
+  }
 }
 
 void SleepActivity::renderCoverSleepScreen() const {
@@ -215,58 +369,26 @@ void SleepActivity::renderCoverSleepScreen() const {
   // Check if the current book is XTC, TXT, or EPUB
   if (StringUtils::checkFileExtension(APP_STATE.openEpubPath, ".xtc") ||
       StringUtils::checkFileExtension(APP_STATE.openEpubPath, ".xtch")) {
-    // Handle XTC file
-    Xtc lastXtc(APP_STATE.openEpubPath, "/.crosspoint");
-    if (!lastXtc.load()) {
-      LOG_ERR("SLP", "Failed to load last XTC");
-      return (this->*renderNoCoverSleepScreen)();
-    }
-
-    if (!lastXtc.generateCoverBmp()) {
-      LOG_ERR("SLP", "Failed to generate XTC cover bmp");
-      return (this->*renderNoCoverSleepScreen)();
-    }
-
-    coverBmpPath = lastXtc.getCoverBmpPath();
+    coverBmpPath = Xtc(APP_STATE.openEpubPath, "/.crosspoint").getCoverBmpPath();
   } else if (StringUtils::checkFileExtension(APP_STATE.openEpubPath, ".txt")) {
-    // Handle TXT file - looks for cover image in the same folder
-    Txt lastTxt(APP_STATE.openEpubPath, "/.crosspoint");
-    if (!lastTxt.load()) {
-      LOG_ERR("SLP", "Failed to load last TXT");
-      return (this->*renderNoCoverSleepScreen)();
-    }
-
-    if (!lastTxt.generateCoverBmp()) {
-      LOG_ERR("SLP", "No cover image found for TXT file");
-      return (this->*renderNoCoverSleepScreen)();
-    }
-
-    coverBmpPath = lastTxt.getCoverBmpPath();
+    // TXT covers come from an image in the same folder
+    coverBmpPath = Txt(APP_STATE.openEpubPath, "/.crosspoint").getCoverBmpPath();
   } else if (StringUtils::checkFileExtension(APP_STATE.openEpubPath, ".epub")) {
-    // Handle EPUB file
-    Epub lastEpub(APP_STATE.openEpubPath, "/.crosspoint");
-    // Skip loading css since we only need metadata here
-    if (!lastEpub.load(true, true)) {
-      LOG_ERR("SLP", "Failed to load last epub");
-      return (this->*renderNoCoverSleepScreen)();
-    }
-
-    if (!lastEpub.generateCoverBmp(cropped)) {
-      LOG_ERR("SLP", "Failed to generate cover bmp");
-      return (this->*renderNoCoverSleepScreen)();
-    }
-
-    coverBmpPath = lastEpub.getCoverBmpPath(cropped);
+    coverBmpPath = Epub(APP_STATE.openEpubPath, "/.crosspoint").getCoverBmpPath(cropped);
   } else {
     return (this->*renderNoCoverSleepScreen)();
   }
 
+  // Covers are normally ready by now. If the queue has not reached this book yet, nothing else is left to keep
+  // responsive, so generate them here.
+  if (!Storage.exists(coverBmpPath.c_str())) {
+    COVER_JOBS.runNow(APP_STATE.openEpubPath);
+  }
+
   FsFile file;
   if (Storage.openFileForRead("SLP", coverBmpPath, file)) {
-    Bitmap bitmap(file);
-    if (bitmap.parseHeaders() == BmpReaderError::Ok) {
-      LOG_DBG("SLP", "Rendering sleep cover: %s", coverBmpPath.c_str());
-      renderBitmapSleepScreen(bitmap);
+    LOG_DBG("SLP", "Rendering sleep cover: %s", coverBmpPath.c_str());
+    if (renderSleepImage(coverBmpPath, file, false, true)) {
       return;
     }
   }
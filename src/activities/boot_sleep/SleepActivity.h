@@ -1,7 +1,11 @@
 #pragma once
 #include "../Activity.h"
 
+#include <string>
+
 class Bitmap;
+class FsFile;
+struct SleepFrameKey;
 
 class SleepActivity final : public Activity {
  public:
@@ -13,6 +17,11 @@ class SleepActivity final : public Activity {
   void renderDefaultSleepScreen() const;
   void renderCustomSleepScreen() const;
   void renderCoverSleepScreen() const;
-  void renderBitmapSleepScreen(const Bitmap& bitmap) const;
+  // Shows a BMP sleep image. A cacheable image is shown from the cached frame when one was rendered from the same file
+  // and settings, and otherwise becomes the cached frame.
+  bool renderSleepImage(const std::string& path, FsFile& file, bool dithering, bool cacheable) const;
+  bool renderCachedSleepScreen(const SleepFrameKey& key) const;
+  // Caches the rendered frame under key unless it is nullptr
+  void renderBitmapSleepScreen(const Bitmap& bitmap, const SleepFrameKey* key) const;
   void renderBlankSleepScreen() const;
 };
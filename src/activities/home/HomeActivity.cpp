@@ -1,25 +1,24 @@
 #include "HomeActivity.h"
 
 #include <Bitmap.h>
-#include <Epub.h>
 #include <GfxRenderer.h>
 #include <HalStorage.h>
 #include <I18n.h>
 #include <Utf8.h>
-#include <Xtc.h>
 
+#include <algorithm>
 #include <cstring>
 #include <ctime>
 #include <vector>
 
 #include "Battery.h"
+#include "CoverJobQueue.h"
 #include "CrossPointSettings.h"
 #include "CrossPointState.h"
 #include "MappedInputManager.h"
 #include "RecentBooksStore.h"
 #include "components/UITheme.h"
 #include "fontIds.h"
-#include "util/StringUtils.h"
 
 namespace {
 constexpr const char* HOME_HEADER_BRANDING = "github.com/chase-hunter";
@@ -56,62 +55,30 @@ void HomeActivity::loadRecentBooks(int maxBooks) {
   }
 }
 
-void HomeActivity::loadRecentCovers(int coverHeight) {
-  recentsLoading = true;
-  bool showingLoading = false;
-  Rect popupRect;
+void HomeActivity::queueMissingCovers(const int coverHeight) {
+  // Thumbnails are generated in the background; until then the theme draws a placeholder
+  for (RecentBook& book : recentBooks) {
+    if (!book.coverBmpPath.empty() &&
+        !Storage.exists(UITheme::getCoverThumbPath(book.coverBmpPath, coverHeight).c_str())) {
+      COVER_JOBS.enqueue(book.path);
+      book.coverBmpPath.clear();
+    }
+  }
+}
 
-  int progress = 0;
+void HomeActivity::loadReadyCovers(const int coverHeight) {
+  const auto& books = RECENT_BOOKS.getBooks();
   for (RecentBook& book : recentBooks) {
     if (!book.coverBmpPath.empty()) {
-      std::string coverPath = UITheme::getCoverThumbPath(book.coverBmpPath, coverHeight);
-      if (!Storage.exists(coverPath.c_str())) {
-        // If epub, try to load the metadata for title/author and cover
-        if (StringUtils::checkFileExtension(book.path, ".epub")) {
-          Epub epub(book.path, "/.crosspoint");
-          // Skip loading css since we only need metadata here
-          epub.load(false, true);
-
-          // Try to generate thumbnail image for Continue Reading card
-          if (!showingLoading) {
-            showingLoading = true;
-            popupRect = GUI.drawPopup(renderer, tr(STR_LOADING_POPUP));
-          }
-          GUI.fillPopupProgress(renderer, popupRect, 10 + progress * (90 / recentBooks.size()));
-          bool success = epub.generateThumbBmp(coverHeight);
-          if (!success) {
-            RECENT_BOOKS.updateBook(book.path, book.title, book.author, "");
-            book.coverBmpPath = "";
-          }
-          coverRendered = false;
-          requestUpdate();
-        } else if (StringUtils::checkFileExtension(book.path, ".xtch") ||
-                   StringUtils::checkFileExtension(book.path, ".xtc")) {
-          // Handle XTC file
-          Xtc xtc(book.path, "/.crosspoint");
-          if (xtc.load()) {
-            // Try to generate thumbnail image for Continue Reading card
-            if (!showingLoading) {
-              showingLoading = true;
-              popupRect = GUI.drawPopup(renderer, tr(STR_LOADING_POPUP));
-            }
-            GUI.fillPopupProgress(renderer, popupRect, 10 + progress * (90 / recentBooks.size()));
-            bool success = xtc.generateThumbBmp(coverHeight);
-            if (!success) {
-              RECENT_BOOKS.updateBook(book.path, book.title, book.author, "");
-              book.coverBmpPath = "";
-            }
-            coverRendered = false;
-            requestUpdate();
-          }
-        }
-      }
+      continue;
+    }
+    // Failed thumbnails have their cover path cleared in the store
+    const auto it = std::find(books.begin(), books.end(), book);
+    if (it != books.end() && !it->coverBmpPath.empty() &&
+        Storage.exists(UITheme::getCoverThumbPath(it->coverBmpPath, coverHeight).c_str())) {
+      book.coverBmpPath = it->coverBmpPath;
     }
-    progress++;
   }
-
-  recentsLoaded = true;
-  recentsLoading = false;
 }
 
 void HomeActivity::onEnter() {
@@ -124,6 +91,9 @@ void HomeActivity::onEnter() {
 
   auto metrics = UITheme::getInstance().getMetrics();
   loadRecentBooks(metrics.homeRecentBooksCount);
+  queueMissingCovers(metrics.homeCoverHeight);
+  seenCoverJobs = COVER_JOBS.getCompletedJobs();
+  COVER_JOBS.resume();
 
   // Trigger first update
   requestUpdate();
@@ -131,6 +101,7 @@ void HomeActivity::onEnter() {
 
 void HomeActivity::onExit() {
   Activity::onExit();
+  COVER_JOBS.suspend();
 
   // Free the stored cover buffer if any
   freeCoverBuffer();
@@ -181,6 +152,23 @@ void HomeActivity::freeCoverBuffer() {
 void HomeActivity::loop() {
   const int menuCount = getMenuItemCount();
 
+  // Redraw the cover card whenever the background queue finishes a book. Never wait for the job in progress: if the
+  // worker holds the SD card, try again on the next loop.
+  const uint32_t completedCoverJobs = COVER_JOBS.getCompletedJobs();
+  if (completedCoverJobs != seenCoverJobs || coversDeferred) {
+    CoverJobQueue::Lock coverLock(true, 0);
+    if (coverLock.held()) {
+      seenCoverJobs = completedCoverJobs;
+      coversDeferred = false;
+      {
+        RenderLock lock(*this);
+        loadReadyCovers(UITheme::getInstance().getMetrics().homeCoverHeight);
+        coverRendered = false;
+      }
+      requestUpdate();
+    }
+  }
+
   buttonNavigator.onNext([this, menuCount] {
     selectorIndex = ButtonNavigator::nextIndex(selectorIndex, menuCount);
     requestUpdate();
@@ -271,9 +259,29 @@ void HomeActivity::render(Activity::RenderLock&&) {
   renderer.drawRect(sectionX, contentTop - metrics.verticalSpacing / 2, sectionWidth,
                     metrics.homeCoverTileHeight + metrics.verticalSpacing);
 
-  GUI.drawRecentBookCover(renderer, Rect{0, contentTop, pageWidth, metrics.homeCoverTileHeight},
-                          recentBooks, selectorIndex, coverRendered, coverBufferStored, bufferRestored,
-                          std::bind(&HomeActivity::storeCoverBuffer, this));
+  {
+    // Keep the cover job worker off the SD card while thumbnails are read from it. If a job is running, draw
+    // placeholders now and let the next loop bring the covers in once the worker pauses.
+    const bool readsCovers =
+        !coverRendered && std::any_of(recentBooks.begin(), recentBooks.end(),
+                                      [](const RecentBook& book) { return !book.coverBmpPath.empty(); });
+    CoverJobQueue::Lock coverLock(readsCovers, 0);
+    const Rect coverRect{0, contentTop, pageWidth, metrics.homeCoverTileHeight};
+    if (readsCovers && !coverLock.held()) {
+      std::vector<RecentBook> placeholders = recentBooks;
+      for (RecentBook& book : placeholders) {
+        book.coverBmpPath.clear();
+      }
+      GUI.drawRecentBookCover(renderer, coverRect, placeholders, selectorIndex, coverRendered, coverBufferStored,
+                              bufferRestored, std::bind(&HomeActivity::storeCoverBuffer, this));
+      coverRendered = false;
+      coverBufferStored = false;
+      coversDeferred = true;
+    } else {
+      GUI.drawRecentBookCover(renderer, coverRect, recentBooks, selectorIndex, coverRendered, coverBufferStored,
+                              bufferRestored, std::bind(&HomeActivity::storeCoverBuffer, this));
+    }
+  }
 
   // Build menu items dynamically
   std::vector<const char*> menuItems = {tr(STR_BROWSE_FILES), tr(STR_MENU_RECENT_BOOKS), tr(STR_FILE_TRANSFER),
@@ -304,12 +312,4 @@ void HomeActivity::render(Activity::RenderLock&&) {
   GUI.drawButtonHints(renderer, labels.btn1, labels.btn2, labels.btn3, labels.btn4);
 
   renderer.displayBuffer();
-
-  if (!firstRenderDone) {
-    firstRenderDone = true;
-    requestUpdate();
-  } else if (!recentsLoaded && !recentsLoading) {
-    recentsLoading = true;
-    loadRecentCovers(metrics.homeCoverHeight);
-  }
 }
@@ -12,10 +12,9 @@ struct Rect;
 class HomeActivity final : public Activity {
   ButtonNavigator buttonNavigator;
   int selectorIndex = 0;
-  bool recentsLoading = false;
-  bool recentsLoaded = false;
-  bool firstRenderDone = false;
   bool hasOpdsUrl = false;
+  uint32_t seenCoverJobs = 0;      // Cover job count when cover paths were last refreshed
+  bool coversDeferred = false;     // Covers were left out of the last render because the cover worker was busy
   bool coverRendered = false;      // Track if cover has been rendered once
   bool coverBufferStored = false;  // Track if cover buffer is stored
   uint8_t* coverBuffer = nullptr;  // HomeActivity's own buffer for cover image
@@ -32,7 +31,8 @@ class HomeActivity final : public Activity {
   bool restoreCoverBuffer();  // Restore frame buffer from stored cover
   void freeCoverBuffer();     // Free the stored cover buffer
   void loadRecentBooks(int maxBooks);
-  void loadRecentCovers(int coverHeight);
+  void queueMissingCovers(int coverHeight);  // Queue missing thumbnails and hide them until ready
+  void loadReadyCovers(int coverHeight);     // Show thumbnails the queue has generated since
 
  public:
   explicit HomeActivity(GfxRenderer& renderer, MappedInputManager& mappedInput,
@@ -7,6 +7,7 @@
 #include <I18n.h>
 #include <Logging.h>
 
+#include "CoverJobQueue.h"
 #include "CrossPointSettings.h"
 #include "CrossPointState.h"
 #include "EpubReaderChapterSelectionActivity.h"
@@ -96,10 +97,11 @@ void EpubReaderActivity::onEnter() {
     }
   }
 
-  // Save current epub as last opened epub and add to recent books
+  // Save current epub as last opened epub, add to recent books and queue its covers
   APP_STATE.openEpubPath = epub->getPath();
   APP_STATE.saveToFile();
   RECENT_BOOKS.addBook(epub->getPath(), epub->getTitle(), epub->getAuthor(), epub->getThumbBmpPath());
+  COVER_JOBS.enqueue(epub->getPath());
 
   // Trigger first update
   requestUpdate();
@@ -543,9 +545,11 @@ void EpubReaderActivity::render(Activity::RenderLock&& lock) {
 
       const auto popupFn = [this]() { GUI.drawPopup(renderer, tr(STR_INDEXING)); };
 
+      // Images are decoded into their pixel caches while indexing, so pages with images render from the cache
       if (!section->createSectionFile(SETTINGS.getReaderFontId(), SETTINGS.getReaderLineCompression(),
                                       SETTINGS.extraParagraphSpacing, SETTINGS.paragraphAlignment, viewportWidth,
-                                      viewportHeight, SETTINGS.hyphenationEnabled, SETTINGS.embeddedStyle, popupFn)) {
+                                      viewportHeight, SETTINGS.hyphenationEnabled, SETTINGS.embeddedStyle, popupFn,
+                                      /*preDecodeImages=*/true)) {
         LOG_ERR("ERS", "Failed to persist page data to SD");
         section.reset();
         return;
@@ -4,8 +4,11 @@
 #include <HalStorage.h>
 #include <I18n.h>
 #include <Serialization.h>
-#include <Utf8.h>
+#include <TxtWordWrap.h>
 
+#include <algorithm>
+
+#include "CoverJobQueue.h"
 #include "CrossPointSettings.h"
 #include "CrossPointState.h"
 #include "MappedInputManager.h"
@@ -19,9 +22,15 @@ constexpr int statusBarMargin = 25;
 constexpr int progressBarMarginTop = 1;
 constexpr size_t CHUNK_SIZE = 8 * 1024;  // 8KB chunk for reading
 
+// Incremental indexing: time spent per loop() slice, and how many new pages trigger an index.bin checkpoint
+constexpr unsigned long INDEX_SLICE_MS = 40;
+constexpr size_t INDEX_CHECKPOINT_PAGES = 256;
+// How far past an estimated offset we look for a line start to begin the page at
+constexpr size_t ALIGN_SCAN_BYTES = 512;
+
 // Cache file magic and version
 constexpr uint32_t CACHE_MAGIC = 0x54585449;  // "TXTI"
-constexpr uint8_t CACHE_VERSION = 2;          // Increment when cache format changes
+constexpr uint8_t CACHE_VERSION = 5;          // Increment when cache format changes
 }  // namespace
 
 void TxtReaderActivity::onEnter() {
@@ -51,12 +60,13 @@ void TxtReaderActivity::onEnter() {
 
   txt->setupCacheDir();
 
-  // Save current txt as last opened file and add to recent books
+  // Save current txt as last opened file, add to recent books and queue its cover
   auto filePath = txt->getPath();
   auto fileName = filePath.substr(filePath.rfind('/') + 1);
   APP_STATE.openEpubPath = filePath;
   APP_STATE.saveToFile();
   RECENT_BOOKS.addBook(filePath, fileName, "", "");
+  COVER_JOBS.enqueue(filePath);
 
   // Trigger first update
   requestUpdate();
@@ -65,6 +75,11 @@ void TxtReaderActivity::onEnter() {
 void TxtReaderActivity::onExit() {
   ActivityWithSubactivity::onExit();
 
+  // Keep the partial index so the next open resumes where indexing stopped
+  if (initialized && pagesSinceCheckpoint > 0) {
+    savePageIndexCache();
+  }
+
   // Reset orientation back to portrait for the rest of the UI
   renderer.setOrientation(GfxRenderer::Orientation::Portrait);
 
@@ -108,6 +123,11 @@ void TxtReaderActivity::loop() {
                                     mappedInput.wasReleased(MappedInputManager::Button::Right));
 
   if (!prevTriggered && !nextTriggered) {
+    // Idle: extend the page index a slice at a time while the user reads
+    if (initialized && !indexComplete) {
+      RenderLock lock(*this);
+      indexPages(INDEX_SLICE_MS);
+    }
     return;
   }
 
@@ -158,15 +178,25 @@ void TxtReaderActivity::initializeReader() {
   linesPerPage = viewportHeight / lineHeight;
   if (linesPerPage < 1) linesPerPage = 1;
 
+  for (uint32_t cp = 0; cp < 128; cp++) {
+    asciiAdvance[cp] = static_cast<int16_t>(renderer.getCodepointAdvanceX(cachedFontId, cp));
+  }
+
   LOG_DBG("TRS", "Viewport: %dx%d, lines per page: %d", viewportWidth, viewportHeight, linesPerPage);
 
-  // Try to load cached page index first
+  // Resume from the cached (possibly partial) page index, and index the first pages right away; the rest is
+  // indexed from loop() while the user reads
   if (!loadPageIndexCache()) {
-    // Cache not found, build page index
-    buildPageIndex();
-    // Save to cache for next time
-    savePageIndexCache();
+    pageOffsets.clear();
+    pageOffsets.push_back(0);  // First page starts at offset 0
+    indexResumeOffset = 0;
+    indexComplete = txt->getFileSize() == 0;
+    LOG_DBG("TRS", "Indexing %zu bytes incrementally", txt->getFileSize());
+  }
+  if (!txt->hasEncoding()) {
+    txt->detectEncoding();
   }
+  indexPages(INDEX_SLICE_MS);
 
   // Load saved progress
   loadProgress();
@@ -174,43 +204,120 @@ void TxtReaderActivity::initializeReader() {
   initialized = true;
 }
 
-void TxtReaderActivity::buildPageIndex() {
-  pageOffsets.clear();
-  pageOffsets.push_back(0);  // First page starts at offset 0
-
-  size_t offset = 0;
+void TxtReaderActivity::indexPages(const unsigned long budgetMs) {
   const size_t fileSize = txt->getFileSize();
+  const unsigned long start = millis();
+  const size_t startOffset = indexResumeOffset;
+  const bool wasComplete = indexComplete;
 
-  LOG_DBG("TRS", "Building page index for %zu bytes...", fileSize);
-
-  GUI.drawPopup(renderer, tr(STR_INDEXING));
-
-  while (offset < fileSize) {
+  // Always measure at least one page so every slice makes progress
+  while (!indexComplete) {
     std::vector<std::string> tempLines;
-    size_t nextOffset = offset;
+    size_t nextOffset = indexResumeOffset;
 
-    if (!loadPageAtOffset(offset, tempLines, nextOffset)) {
+    if (!loadPageAtOffset(indexResumeOffset, tempLines, nextOffset) || nextOffset <= indexResumeOffset) {
+      // Read failure or no progress made, stop rather than loop forever
+      indexComplete = true;
       break;
     }
 
-    if (nextOffset <= offset) {
-      // No progress made, avoid infinite loop
-      break;
+    indexResumeOffset = nextOffset;
+    if (indexResumeOffset < fileSize) {
+      pageOffsets.push_back(indexResumeOffset);
+      pagesSinceCheckpoint++;
+    } else {
+      indexComplete = true;
     }
 
-    offset = nextOffset;
-    if (offset < fileSize) {
-      pageOffsets.push_back(offset);
+    if (millis() - start >= budgetMs) {
+      break;
     }
+  }
 
-    // Yield to other tasks periodically
-    if (pageOffsets.size() % 20 == 0) {
-      vTaskDelay(1);
-    }
+  updateTotalPages();
+
+  // The page on screen was placed by estimate; once indexed, renumber it to the exact page containing it
+  if (displayedPageApproximate && (indexComplete || displayedPageStart < indexResumeOffset)) {
+    const auto it = std::upper_bound(pageOffsets.begin(), pageOffsets.end(), displayedPageStart);
+    currentPage = displayedPage = static_cast<int>(std::distance(pageOffsets.begin(), it)) - 1;
+    displayedPageApproximate = false;
   }
 
-  totalPages = pageOffsets.size();
-  LOG_DBG("TRS", "Built page index: %d pages", totalPages);
+  // A complete index loaded from index.bin is left as it is; only a slice that got further is written back
+  if (indexComplete == wasComplete && indexResumeOffset == startOffset) {
+    return;
+  }
+  if (indexComplete) {
+    LOG_DBG("TRS", "Built page index: %d pages", totalPages);
+    savePageIndexCache();
+  } else if (pagesSinceCheckpoint >= INDEX_CHECKPOINT_PAGES) {
+    savePageIndexCache();
+  }
+}
+
+void TxtReaderActivity::updateTotalPages() {
+  if (indexComplete) {
+    totalPages = pageOffsets.size();
+    return;
+  }
+
+  // The last offset starts a page that has not been measured yet
+  const size_t measuredPages = pageOffsets.size() - 1;
+  if (measuredPages == 0 || indexResumeOffset == 0) {
+    totalPages = pageOffsets.size();
+    return;
+  }
+  const size_t remainingBytes = txt->getFileSize() - indexResumeOffset;
+  const size_t estimatedRemaining = (remainingBytes * measuredPages + indexResumeOffset - 1) / indexResumeOffset;
+  totalPages = static_cast<int>(measuredPages + std::max<size_t>(estimatedRemaining, 1));
+  // Never estimate the page on screen out of the book
+  if (displayedPageApproximate) {
+    totalPages = std::max(totalPages, displayedPage + 1);
+  }
+}
+
+size_t TxtReaderActivity::pageStartOffset(const int page) {
+  if (page < static_cast<int>(pageOffsets.size())) {
+    return pageOffsets[page];
+  }
+
+  // Past the indexed region. Stay continuous with the page on screen where possible...
+  if (page == displayedPage) {
+    return displayedPageStart;
+  }
+  if (page == displayedPage + 1 && displayedPageEnd > displayedPageStart && displayedPageEnd < txt->getFileSize()) {
+    return displayedPageEnd;
+  }
+
+  // ...otherwise jump to an estimate based on the average length of the indexed pages
+  const size_t measuredPages = std::max<size_t>(pageOffsets.size() - 1, 1);
+  const size_t averagePageBytes = std::max<size_t>(indexResumeOffset / measuredPages, 1);
+  const size_t pagesPastIndex = page - (pageOffsets.size() - 1);
+  const size_t estimate =
+      std::min(indexResumeOffset + pagesPastIndex * averagePageBytes, txt->getFileSize() - 1);
+  return alignToLineStart(estimate);
+}
+
+size_t TxtReaderActivity::alignToLineStart(size_t offset) const {
+  const size_t fileSize = txt->getFileSize();
+  const TxtEncoding encoding = txt->getEncoding();
+  offset += offset % txtCodeUnitSize(encoding);
+  if (offset == 0 || offset >= fileSize) {
+    return std::min(offset, fileSize);
+  }
+
+  uint8_t buffer[ALIGN_SCAN_BYTES];
+  const size_t length = std::min(ALIGN_SCAN_BYTES, fileSize - offset);
+  if (!txt->readContent(buffer, offset, length)) {
+    return offset;
+  }
+
+  // Prefer the next line start, then the next word, then at least a character boundary
+  return offset + txtNextBreakStart(encoding, buffer, length);
+}
+
+int TxtReaderActivity::advanceOf(const uint32_t cp) const {
+  return cp < 128 ? asciiAdvance[cp] : renderer.getCodepointAdvanceX(cachedFontId, cp);
 }
 
 bool TxtReaderActivity::loadPageAtOffset(size_t offset, std::vector<std::string>& outLines, size_t& nextOffset) {
@@ -235,18 +342,36 @@ bool TxtReaderActivity::loadPageAtOffset(size_t offset, std::vector<std::string>
   }
   buffer[chunkSize] = '\0';
 
-  // Parse lines from buffer
+  // Lines are parsed and wrapped as UTF-8. Other encodings are transcoded a chunk at a time and the position reached
+  // is mapped back to source bytes at the end, so page offsets stay valid whatever the encoding.
+  const TxtEncoding encoding = txt->getEncoding();
+  const bool chunkReachesEnd = offset + chunkSize >= fileSize;
+  const char* text = reinterpret_cast<const char*>(buffer);
+  size_t textSize = chunkSize;
+  std::string transcoded;
+  if (encoding != TxtEncoding::Utf8) {
+    transcoded.reserve(chunkSize + chunkSize / 2);
+    transcodeTxtToUtf8(encoding, buffer, chunkSize, chunkReachesEnd, transcoded);
+    text = transcoded.data();
+    textSize = transcoded.size();
+  }
+
+  // Parse lines from buffer, skipping a UTF-8 byte order mark
   size_t pos = 0;
+  if (offset == 0 && encoding == TxtEncoding::Utf8 && textSize >= 3 && buffer[0] == 0xEF && buffer[1] == 0xBB &&
+      buffer[2] == 0xBF) {
+    pos = 3;
+  }
 
-  while (pos < chunkSize && static_cast<int>(outLines.size()) < linesPerPage) {
+  while (pos < textSize && static_cast<int>(outLines.size()) < linesPerPage) {
     // Find end of line
     size_t lineEnd = pos;
-    while (lineEnd < chunkSize && buffer[lineEnd] != '\n') {
+    while (lineEnd < textSize && text[lineEnd] != '\n') {
       lineEnd++;
     }
 
     // Check if we have a complete line
-    bool lineComplete = (lineEnd < chunkSize) || (offset + lineEnd >= fileSize);
+    bool lineComplete = (lineEnd < textSize) || chunkReachesEnd;
 
     if (!lineComplete && static_cast<int>(outLines.size()) > 0) {
       // Incomplete line and we already have some lines, stop here
@@ -257,66 +382,26 @@ bool TxtReaderActivity::loadPageAtOffset(size_t offset, std::vector<std::string>
     size_t lineContentLen = lineEnd - pos;
 
     // Check for carriage return
-    bool hasCR = (lineContentLen > 0 && buffer[pos + lineContentLen - 1] == '\r');
+    bool hasCR = (lineContentLen > 0 && text[pos + lineContentLen - 1] == '\r');
     size_t displayLen = hasCR ? lineContentLen - 1 : lineContentLen;
 
-    // Extract line content for display (without CR/LF)
-    std::string line(reinterpret_cast<char*>(buffer + pos), displayLen);
-
-    // Track position within this source line (in bytes from pos)
-    size_t lineBytePos = 0;
-
-    // Word wrap if needed
-    while (!line.empty() && static_cast<int>(outLines.size()) < linesPerPage) {
-      int lineWidth = renderer.getTextWidth(cachedFontId, line.c_str());
-
-      if (lineWidth <= viewportWidth) {
-        outLines.push_back(line);
-        lineBytePos = displayLen;  // Consumed entire display content
-        line.clear();
-        break;
-      }
-
-      // Find break point
-      size_t breakPos = line.length();
-      while (breakPos > 0 && renderer.getTextWidth(cachedFontId, line.substr(0, breakPos).c_str()) > viewportWidth) {
-        // Try to break at space
-        size_t spacePos = line.rfind(' ', breakPos - 1);
-        if (spacePos != std::string::npos && spacePos > 0) {
-          breakPos = spacePos;
-        } else {
-          // Break at character boundary for UTF-8
-          breakPos--;
-          // Make sure we don't break in the middle of a UTF-8 sequence
-          while (breakPos > 0 && (line[breakPos] & 0xC0) == 0x80) {
-            breakPos--;
-          }
-        }
-      }
-
-      if (breakPos == 0) {
-        breakPos = 1;
-      }
-
-      outLines.push_back(line.substr(0, breakPos));
-
-      // Skip space at break point
-      size_t skipChars = breakPos;
-      if (breakPos < line.length() && line[breakPos] == ' ') {
-        skipChars++;
-      }
-      lineBytePos += skipChars;
-      line = line.substr(skipChars);
-    }
+    // Word wrap in one pass; stops as soon as the page is full
+    const char* line = text + pos;
+    const size_t consumed = wrapTxtLine(
+        line, displayLen, viewportWidth, [this](const uint32_t cp) { return advanceOf(cp); },
+        [&](const size_t start, const size_t length, int) {
+          outLines.emplace_back(line + start, length);
+          return static_cast<int>(outLines.size()) < linesPerPage;
+        });
 
     // Determine how much of the source buffer we consumed
-    if (line.empty()) {
+    if (consumed >= displayLen) {
       // Fully consumed this source line, move past the newline
       pos = lineEnd + 1;
     } else {
       // Partially consumed - page is full mid-line
       // Move pos to where we stopped in the line (NOT past the line)
-      pos = pos + lineBytePos;
+      pos = pos + consumed;
       break;
     }
   }
@@ -327,7 +412,7 @@ bool TxtReaderActivity::loadPageAtOffset(size_t offset, std::vector<std::string>
     pos = 1;
   }
 
-  nextOffset = offset + pos;
+  nextOffset = offset + txtSourceOffset(encoding, buffer, chunkSize, pos);
 
   // Make sure we don't go past the file
   if (nextOffset > fileSize) {
@@ -361,10 +446,14 @@ void TxtReaderActivity::render(Activity::RenderLock&&) {
   if (currentPage >= totalPages) currentPage = totalPages - 1;
 
   // Load current page content
-  size_t offset = pageOffsets[currentPage];
-  size_t nextOffset;
+  const size_t offset = pageStartOffset(currentPage);
+  size_t nextOffset = offset;
   currentPageLines.clear();
   loadPageAtOffset(offset, currentPageLines, nextOffset);
+  displayedPageApproximate = currentPage >= static_cast<int>(pageOffsets.size());
+  displayedPage = currentPage;
+  displayedPageStart = offset;
+  displayedPageEnd = nextOffset;
 
   renderer.clearScreen();
   renderPage();
@@ -531,14 +620,21 @@ void TxtReaderActivity::renderStatusBar(const int orientedMarginRight, const int
 }
 
 void TxtReaderActivity::saveProgress() const {
+  // The page number, then the byte offset of the page on screen: page numbers past the indexed region are estimates,
+  // so the offset is what puts the reader back on the same text
   FsFile f;
   if (Storage.openFileForWrite("TRS", txt->getCachePath() + "/progress.bin", f)) {
-    uint8_t data[4];
+    const uint32_t offset = static_cast<uint32_t>(displayedPageStart);
+    uint8_t data[8];
     data[0] = currentPage & 0xFF;
     data[1] = (currentPage >> 8) & 0xFF;
     data[2] = 0;
     data[3] = 0;
-    f.write(data, 4);
+    data[4] = offset & 0xFF;
+    data[5] = (offset >> 8) & 0xFF;
+    data[6] = (offset >> 16) & 0xFF;
+    data[7] = (offset >> 24) & 0xFF;
+    f.write(data, 8);
     f.close();
   }
 }
@@ -546,8 +642,14 @@ void TxtReaderActivity::saveProgress() const {
 void TxtReaderActivity::loadProgress() {
   FsFile f;
   if (Storage.openFileForRead("TRS", txt->getCachePath() + "/progress.bin", f)) {
-    uint8_t data[4];
-    if (f.read(data, 4) == 4) {
+    uint8_t data[8];
+    const int bytesRead = f.read(data, 8);
+    if (bytesRead == 8) {
+      const size_t offset = data[4] | (data[5] << 8) | (data[6] << 16) | (static_cast<uint32_t>(data[7]) << 24);
+      restorePageAtOffset(std::min(offset, txt->getFileSize()));
+      LOG_DBG("TRS", "Loaded progress: offset %zu, page %d/%d", offset, currentPage, totalPages);
+    } else if (bytesRead == 4) {
+      // Saved before offsets were kept
       currentPage = data[0] + (data[1] << 8);
       if (currentPage >= totalPages) {
         currentPage = totalPages - 1;
@@ -561,17 +663,41 @@ void TxtReaderActivity::loadProgress() {
   }
 }
 
+void TxtReaderActivity::restorePageAtOffset(const size_t offset) {
+  if (indexComplete || offset <= indexResumeOffset) {
+    // Indexed: the exact page containing the offset
+    const auto it = std::upper_bound(pageOffsets.begin(), pageOffsets.end(), offset);
+    currentPage = std::max(static_cast<int>(std::distance(pageOffsets.begin(), it)) - 1, 0);
+    return;
+  }
+
+  // Past the index: number the page by estimate, but show it from the saved offset. indexPages() renumbers it once
+  // indexing gets there.
+  const size_t measuredPages = std::max<size_t>(pageOffsets.size() - 1, 1);
+  const size_t averagePageBytes = std::max<size_t>(indexResumeOffset / measuredPages, 1);
+  const size_t pagesPastIndex = std::max<size_t>((offset - indexResumeOffset) / averagePageBytes, 1);
+  currentPage = static_cast<int>(pageOffsets.size() - 1 + pagesPastIndex);
+  totalPages = std::max(totalPages, currentPage + 1);
+  displayedPage = currentPage;
+  displayedPageStart = offset;
+  displayedPageEnd = offset;
+  displayedPageApproximate = true;
+}
+
 bool TxtReaderActivity::loadPageIndexCache() {
   // Cache file format (using serialization module):
   // - uint32_t: magic "TXTI"
   // - uint8_t: cache version
   // - uint32_t: file size (to validate cache)
+  // - uint8_t: source encoding (TxtEncoding)
   // - int32_t: viewport width
   // - int32_t: lines per page
   // - int32_t: font ID (to invalidate cache on font change)
   // - int32_t: screen margin (to invalidate cache on margin change)
   // - uint8_t: paragraph alignment (to invalidate cache on alignment change)
-  // - uint32_t: total pages count
+  // - uint8_t: index complete flag (0 = checkpoint of a partial index)
+  // - uint32_t: resume offset (start of the first page not yet measured)
+  // - uint32_t: indexed pages count
   // - N * uint32_t: page offsets
 
   std::string cachePath = txt->getCachePath() + "/index.bin";
@@ -606,6 +732,13 @@ bool TxtReaderActivity::loadPageIndexCache() {
     return false;
   }
 
+  // The encoding only depends on the file, so it stays valid even if the layout below does not
+  uint8_t encoding;
+  serialization::readPod(f, encoding);
+  if (encoding < TXT_ENCODING_COUNT) {
+    txt->setEncoding(static_cast<TxtEncoding>(encoding));
+  }
+
   int32_t cachedWidth;
   serialization::readPod(f, cachedWidth);
   if (cachedWidth != viewportWidth) {
@@ -646,8 +779,18 @@ bool TxtReaderActivity::loadPageIndexCache() {
     return false;
   }
 
+  uint8_t complete;
+  serialization::readPod(f, complete);
+  uint32_t resumeOffset;
+  serialization::readPod(f, resumeOffset);
+
   uint32_t numPages;
   serialization::readPod(f, numPages);
+  if (numPages == 0 || resumeOffset > fileSize) {
+    LOG_DBG("TRS", "Cache page index invalid, rebuilding");
+    f.close();
+    return false;
+  }
 
   // Read page offsets
   pageOffsets.clear();
@@ -660,12 +803,15 @@ bool TxtReaderActivity::loadPageIndexCache() {
   }
 
   f.close();
-  totalPages = pageOffsets.size();
-  LOG_DBG("TRS", "Loaded page index cache: %d pages", totalPages);
+  indexComplete = complete != 0;
+  indexResumeOffset = resumeOffset;
+  pagesSinceCheckpoint = 0;
+  updateTotalPages();
+  LOG_DBG("TRS", "Loaded page index cache: %zu pages%s", pageOffsets.size(), indexComplete ? "" : " (partial)");
   return true;
 }
 
-void TxtReaderActivity::savePageIndexCache() const {
+void TxtReaderActivity::savePageIndexCache() {
   std::string cachePath = txt->getCachePath() + "/index.bin";
   FsFile f;
   if (!Storage.openFileForWrite("TRS", cachePath, f)) {
@@ -677,11 +823,14 @@ void TxtReaderActivity::savePageIndexCache() const {
   serialization::writePod(f, CACHE_MAGIC);
   serialization::writePod(f, CACHE_VERSION);
   serialization::writePod(f, static_cast<uint32_t>(txt->getFileSize()));
+  serialization::writePod(f, static_cast<uint8_t>(txt->getEncoding()));
   serialization::writePod(f, static_cast<int32_t>(viewportWidth));
   serialization::writePod(f, static_cast<int32_t>(linesPerPage));
   serialization::writePod(f, static_cast<int32_t>(cachedFontId));
   serialization::writePod(f, static_cast<int32_t>(cachedScreenMargin));
   serialization::writePod(f, cachedParagraphAlignment);
+  serialization::writePod(f, static_cast<uint8_t>(indexComplete ? 1 : 0));
+  serialization::writePod(f, static_cast<uint32_t>(indexResumeOffset));
   serialization::writePod(f, static_cast<uint32_t>(pageOffsets.size()));
 
   // Write page offsets
@@ -690,5 +839,6 @@ void TxtReaderActivity::savePageIndexCache() const {
   }
 
   f.close();
-  LOG_DBG("TRS", "Saved page index cache: %d pages", totalPages);
+  pagesSinceCheckpoint = 0;
+  LOG_DBG("TRS", "Saved page index cache: %zu pages%s", pageOffsets.size(), indexComplete ? "" : " (partial)");
 }
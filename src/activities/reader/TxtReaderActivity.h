@@ -18,8 +18,18 @@ class TxtReaderActivity final : public ActivityWithSubactivity {
   const std::function<void()> onGoHome;
 
   // Streaming text reader - stores file offsets for each page
-  std::vector<size_t> pageOffsets;  // File offset for start of each page
+  // The index is built incrementally: pages below pageOffsets.size() have exact offsets, later pages are estimated
+  // from the average page length until indexing reaches them.
+  std::vector<size_t> pageOffsets;  // File offset for start of each indexed page
+  size_t indexResumeOffset = 0;     // Start of the first page not yet measured
+  bool indexComplete = false;
+  size_t pagesSinceCheckpoint = 0;
   std::vector<std::string> currentPageLines;
+  // Page on screen, so page turns from an estimated position continue where the text left off
+  int displayedPage = -1;
+  size_t displayedPageStart = 0;
+  size_t displayedPageEnd = 0;
+  bool displayedPageApproximate = false;
   int linesPerPage = 0;
   int viewportWidth = 0;
   bool initialized = false;
@@ -28,17 +38,24 @@ class TxtReaderActivity final : public ActivityWithSubactivity {
   int cachedFontId = 0;
   int cachedScreenMargin = 0;
   uint8_t cachedParagraphAlignment = CrossPointSettings::LEFT_ALIGN;
+  // ASCII advances of cachedFontId for the word wrapper; other codepoints are looked up per glyph
+  int16_t asciiAdvance[128] = {};
 
   void renderPage();
   void renderStatusBar(int orientedMarginRight, int orientedMarginBottom, int orientedMarginLeft) const;
 
   void initializeReader();
+  int advanceOf(uint32_t cp) const;
   bool loadPageAtOffset(size_t offset, std::vector<std::string>& outLines, size_t& nextOffset);
-  void buildPageIndex();
+  void indexPages(unsigned long budgetMs);
+  void updateTotalPages();
+  size_t pageStartOffset(int page);
+  size_t alignToLineStart(size_t offset) const;
   bool loadPageIndexCache();
-  void savePageIndexCache() const;
+  void savePageIndexCache();
   void saveProgress() const;
   void loadProgress();
+  void restorePageAtOffset(size_t offset);  // Makes the page starting at or containing offset the current page
 
  public:
   explicit TxtReaderActivity(GfxRenderer& renderer, MappedInputManager& mappedInput, std::unique_ptr<Txt> txt,
@@ -51,4 +68,7 @@ class TxtReaderActivity final : public ActivityWithSubactivity {
   void onExit() override;
   void loop() override;
   void render(Activity::RenderLock&&) override;
+  // Index flat out only while the page on screen lies past the index, to number it; the rest of the index is built a
+  // slice per loop between the normal loop delays
+  bool skipLoopDelay() override { return initialized && !indexComplete && displayedPageApproximate; }
 };
@@ -12,6 +12,7 @@
 #include <HalStorage.h>
 #include <I18n.h>
 
+#include "CoverJobQueue.h"
 #include "CrossPointSettings.h"
 #include "CrossPointState.h"
 #include "MappedInputManager.h"
@@ -23,6 +24,11 @@
 namespace {
 constexpr unsigned long skipPageMs = 700;
 constexpr unsigned long goHomeMs = 1000;
+
+// XTH pixel value sets for GfxRenderer::blitPacked2Bit (bit v = value v)
+constexpr uint8_t XTH_NON_WHITE = 0b1110;  // Dark grey, light grey, black
+constexpr uint8_t XTH_DARK_GREY = 0b0010;
+constexpr uint8_t XTH_GREYS = 0b0110;  // Dark and light grey
 }  // namespace
 
 void XtcReaderActivity::onEnter() {
@@ -34,13 +40,22 @@ void XtcReaderActivity::onEnter() {
 
   xtc->setupCacheDir();
 
+  // Page bitmaps for read-ahead: byte-padded rows for XTG, both column-major planes for XTH
+  const size_t pageWidth = xtc->getPageWidth();
+  const size_t pageHeight = xtc->getPageHeight();
+  const size_t pageBytes =
+      xtc->getBitDepth() == 2 ? ((pageWidth * pageHeight + 7) / 8) * 2 : ((pageWidth + 7) / 8) * pageHeight;
+  pageCache = std::make_unique<XtcPageCache>(*xtc);
+  pageCache->allocate(pageBytes);
+
   // Load saved progress
   loadProgress();
 
-  // Save current XTC as last opened book and add to recent books
+  // Save current XTC as last opened book, add to recent books and queue its covers
   APP_STATE.openEpubPath = xtc->getPath();
   APP_STATE.saveToFile();
   RECENT_BOOKS.addBook(xtc->getPath(), xtc->getTitle(), xtc->getAuthor(), xtc->getThumbBmpPath());
+  COVER_JOBS.enqueue(xtc->getPath());
 
   // Trigger first update
   requestUpdate();
@@ -51,6 +66,7 @@ void XtcReaderActivity::onExit() {
 
   APP_STATE.readerActivityLoadCount = 0;
   APP_STATE.saveToFile();
+  pageCache.reset();
   xtc.reset();
 }
 
@@ -106,6 +122,11 @@ void XtcReaderActivity::loop() {
                                     mappedInput.wasReleased(MappedInputManager::Button::Right));
 
   if (!prevTriggered && !nextTriggered) {
+    // Idle: read the neighbouring pages ahead, one per loop so input stays responsive
+    if (pageCache && currentPage < xtc->getPageCount()) {
+      RenderLock lock(*this);
+      pageCache->prefetch(currentPage);
+    }
     return;
   }
 
@@ -153,49 +174,94 @@ void XtcReaderActivity::render(Activity::RenderLock&&) {
   saveProgress();
 }
 
-void XtcReaderActivity::renderPage() {
+bool XtcReaderActivity::drawPagePass(const uint8_t* bitmap, uint8_t* streamPlane1, const uint8_t levelMask,
+                                     const bool state) {
   const uint16_t pageWidth = xtc->getPageWidth();
   const uint16_t pageHeight = xtc->getPageHeight();
-  const uint8_t bitDepth = xtc->getBitDepth();
+  const bool twoBit = xtc->getBitDepth() == 2;
+  const size_t planeSize = (static_cast<size_t>(pageWidth) * pageHeight + 7) / 8;
 
-  // Calculate buffer size for one page
-  // XTG (1-bit): Row-major, ((width+7)/8) * height bytes
-  // XTH (2-bit): Two bit planes, column-major, ((width * height + 7) / 8) * 2 bytes
-  size_t pageBufferSize;
-  if (bitDepth == 2) {
-    pageBufferSize = ((static_cast<size_t>(pageWidth) * pageHeight + 7) / 8) * 2;
-  } else {
-    pageBufferSize = ((pageWidth + 7) / 8) * pageHeight;
+  if (bitmap) {
+    if (twoBit) {
+      renderer.blitPacked2Bit(bitmap, bitmap + planeSize, 0, 0, pageWidth, pageHeight, levelMask, state);
+    } else {
+      renderer.blitPacked1Bit(bitmap, 0, 0, pageWidth, pageHeight);
+    }
+    return true;
   }
 
-  // Allocate page buffer
-  uint8_t* pageBuffer = static_cast<uint8_t*>(malloc(pageBufferSize));
-  if (!pageBuffer) {
-    LOG_ERR("XTR", "Failed to allocate page buffer (%lu bytes)", pageBufferSize);
-    renderer.clearScreen();
-    renderer.drawCenteredText(UI_12_FONT_ID, 300, tr(STR_MEMORY_ERROR), true, EpdFontFamily::BOLD);
-    renderer.displayBuffer();
-    return;
+  // Streaming: blit each chunk as it arrives. 1-bit chunks are 8 rows; 2-bit chunks are 8 columns of the second
+  // plane, combined with the first plane kept in streamPlane1.
+  if (!twoBit) {
+    const size_t rowBytes = (pageWidth + 7) / 8;
+    return xtc->loadPageStreaming(
+               currentPage,
+               [&](const uint8_t* data, const size_t size, const size_t offset) {
+                 renderer.blitPacked1Bit(data, 0, offset / rowBytes, pageWidth, size / rowBytes);
+               },
+               rowBytes * 8) == xtc::XtcError::OK;
   }
 
-  // Load page data
-  size_t bytesRead = xtc->loadPage(currentPage, pageBuffer, pageBufferSize);
-  if (bytesRead == 0) {
+  const size_t columnBytes = pageHeight / 8;
+  return xtc->loadPageStreaming(
+             currentPage,
+             [&](const uint8_t* data, const size_t size, const size_t offset) {
+               if (offset < planeSize) {
+                 memcpy(streamPlane1 + offset, data, size);
+                 return;
+               }
+               // Columns are stored right to left
+               const size_t firstColumn = (offset - planeSize) / columnBytes;
+               const size_t columns = size / columnBytes;
+               renderer.blitPacked2Bit(streamPlane1 + firstColumn * columnBytes, data,
+                                       pageWidth - firstColumn - columns, 0, columns, pageHeight, levelMask, state);
+             },
+             columnBytes * 8) == xtc::XtcError::OK;
+}
+
+void XtcReaderActivity::renderPage() {
+  const uint16_t pageWidth = xtc->getPageWidth();
+  const uint16_t pageHeight = xtc->getPageHeight();
+  const uint8_t bitDepth = xtc->getBitDepth();
+
+  // Cached (or prefetched) bitmap; without cache slots the page is streamed from the card for each pass
+  const uint8_t* pageBuffer = pageCache ? pageCache->get(currentPage) : nullptr;
+  const bool streaming = !pageCache || pageCache->slotCount() == 0;
+  if (!pageBuffer && !streaming) {
     LOG_ERR("XTR", "Failed to load page %lu", currentPage);
-    free(pageBuffer);
     renderer.clearScreen();
     renderer.drawCenteredText(UI_12_FONT_ID, 300, tr(STR_PAGE_LOAD_ERROR), true, EpdFontFamily::BOLD);
     renderer.displayBuffer();
     return;
   }
+  if (pageCache) {
+    LOG_DBG("XTR", "Page cache: %lu hits, %lu misses", pageCache->hits(), pageCache->misses());
+  }
+
+  // Streamed 2-bit pages still need the first plane in memory to combine with the second, and chunks must cover
+  // whole columns or rows
+  const size_t planeSize = (static_cast<size_t>(pageWidth) * pageHeight + 7) / 8;
+  uint8_t* streamPlane1 = nullptr;
+  if (streaming) {
+    const bool aligned = pageWidth % 8 == 0 && pageHeight % 8 == 0;
+    if (aligned && bitDepth == 2) {
+      streamPlane1 = static_cast<uint8_t*>(malloc(planeSize));
+    }
+    if (!aligned || (bitDepth == 2 && !streamPlane1)) {
+      LOG_ERR("XTR", "Not enough memory to stream page %lu", currentPage);
+      renderer.clearScreen();
+      renderer.drawCenteredText(UI_12_FONT_ID, 300, tr(STR_MEMORY_ERROR), true, EpdFontFamily::BOLD);
+      renderer.displayBuffer();
+      return;
+    }
+    LOG_DBG("XTR", "No page cache slots, streaming page %lu", currentPage);
+  }
 
   // Clear screen first
   renderer.clearScreen();
 
-  // Copy page bitmap using GfxRenderer's drawPixel
+  // Blit the page bitmap straight into the frame buffer
   // XTC/XTCH pages are pre-rendered with status bar included, so render full page
-  const uint16_t maxSrcY = pageHeight;
-
   if (bitDepth == 2) {
     // XTH 2-bit mode: Two bit planes, column-major order
     // - Columns scanned right to left (x = width-1 down to 0)
@@ -204,43 +270,26 @@ void XtcReaderActivity::renderPage() {
     // - Pixel value = (bit1 << 1) | bit2
     // - Grayscale: 0=White, 1=Dark Grey, 2=Light Grey, 3=Black
 
-    const size_t planeSize = (static_cast<size_t>(pageWidth) * pageHeight + 7) / 8;
-    const uint8_t* plane1 = pageBuffer;              // Bit1 plane
-    const uint8_t* plane2 = pageBuffer + planeSize;  // Bit2 plane
-    const size_t colBytes = (pageHeight + 7) / 8;    // Bytes per column (100 for 800 height)
-
-    // Lambda to get pixel value at (x, y)
-    auto getPixelValue = [&](uint16_t x, uint16_t y) -> uint8_t {
-      const size_t colIndex = pageWidth - 1 - x;
-      const size_t byteInCol = y / 8;
-      const size_t bitInByte = 7 - (y % 8);
-      const size_t byteOffset = colIndex * colBytes + byteInCol;
-      const uint8_t bit1 = (plane1[byteOffset] >> bitInByte) & 1;
-      const uint8_t bit2 = (plane2[byteOffset] >> bitInByte) & 1;
-      return (bit1 << 1) | bit2;
-    };
-
     // Optimized grayscale rendering without storeBwBuffer (saves 48KB peak memory)
     // Flow: BW display → LSB/MSB passes → grayscale display → re-render BW for next frame
 
     // Count pixel distribution for debugging
-    uint32_t pixelCounts[4] = {0, 0, 0, 0};
-    for (uint16_t y = 0; y < pageHeight; y++) {
-      for (uint16_t x = 0; x < pageWidth; x++) {
-        pixelCounts[getPixelValue(x, y)]++;
+    if (pageBuffer) {
+      const uint8_t* plane1 = pageBuffer;              // Bit1 plane
+      const uint8_t* plane2 = pageBuffer + planeSize;  // Bit2 plane
+      uint32_t pixelCounts[4] = {0, 0, 0, 0};
+      for (size_t i = 0; i < planeSize; i++) {
+        pixelCounts[0] += __builtin_popcount(static_cast<uint8_t>(~plane1[i] & ~plane2[i]));
+        pixelCounts[1] += __builtin_popcount(static_cast<uint8_t>(~plane1[i] & plane2[i]));
+        pixelCounts[2] += __builtin_popcount(static_cast<uint8_t>(plane1[i] & ~plane2[i]));
+        pixelCounts[3] += __builtin_popcount(static_cast<uint8_t>(plane1[i] & plane2[i]));
       }
+      LOG_DBG("XTR", "Pixel distribution: White=%lu, DarkGrey=%lu, LightGrey=%lu, Black=%lu", pixelCounts[0],
+              pixelCounts[1], pixelCounts[2], pixelCounts[3]);
     }
-    LOG_DBG("XTR", "Pixel distribution: White=%lu, DarkGrey=%lu, LightGrey=%lu, Black=%lu", pixelCounts[0],
-            pixelCounts[1], pixelCounts[2], pixelCounts[3]);
 
     // Pass 1: BW buffer - draw all non-white pixels as black
-    for (uint16_t y = 0; y < pageHeight; y++) {
-      for (uint16_t x = 0; x < pageWidth; x++) {
-        if (getPixelValue(x, y) >= 1) {
-          renderer.drawPixel(x, y, true);
-        }
-      }
-    }
+    drawPagePass(pageBuffer, streamPlane1, XTH_NON_WHITE, true);
 
     // Display BW with conditional refresh based on pagesUntilFullRefresh
     if (pagesUntilFullRefresh <= 1) {
@@ -254,26 +303,13 @@ void XtcReaderActivity::renderPage() {
     // Pass 2: LSB buffer - mark DARK gray only (XTH value 1)
     // In LUT: 0 bit = apply gray effect, 1 bit = untouched
     renderer.clearScreen(0x00);
-    for (uint16_t y = 0; y < pageHeight; y++) {
-      for (uint16_t x = 0; x < pageWidth; x++) {
-        if (getPixelValue(x, y) == 1) {  // Dark grey only
-          renderer.drawPixel(x, y, false);
-        }
-      }
-    }
+    drawPagePass(pageBuffer, streamPlane1, XTH_DARK_GREY, false);
     renderer.copyGrayscaleLsbBuffers();
 
     // Pass 3: MSB buffer - mark LIGHT AND DARK gray (XTH value 1 or 2)
     // In LUT: 0 bit = apply gray effect, 1 bit = untouched
     renderer.clearScreen(0x00);
-    for (uint16_t y = 0; y < pageHeight; y++) {
-      for (uint16_t x = 0; x < pageWidth; x++) {
-        const uint8_t pv = getPixelValue(x, y);
-        if (pv == 1 || pv == 2) {  // Dark grey or Light grey
-          renderer.drawPixel(x, y, false);
-        }
-      }
-    }
+    drawPagePass(pageBuffer, streamPlane1, XTH_GREYS, false);
     renderer.copyGrayscaleMsbBuffers();
 
     // Display grayscale overlay
@@ -281,44 +317,23 @@ void XtcReaderActivity::renderPage() {
 
     // Pass 4: Re-render BW to framebuffer (restore for next frame, instead of restoreBwBuffer)
     renderer.clearScreen();
-    for (uint16_t y = 0; y < pageHeight; y++) {
-      for (uint16_t x = 0; x < pageWidth; x++) {
-        if (getPixelValue(x, y) >= 1) {
-          renderer.drawPixel(x, y, true);
-        }
-      }
-    }
+    drawPagePass(pageBuffer, streamPlane1, XTH_NON_WHITE, true);
 
     // Cleanup grayscale buffers with current frame buffer
     renderer.cleanupGrayscaleWithFrameBuffer();
 
-    free(pageBuffer);
+    free(streamPlane1);
 
     LOG_DBG("XTR", "Rendered page %lu/%lu (2-bit grayscale)", currentPage + 1, xtc->getPageCount());
     return;
-  } else {
-    // 1-bit mode: 8 pixels per byte, MSB first
-    const size_t srcRowBytes = (pageWidth + 7) / 8;  // 60 bytes for 480 width
-
-    for (uint16_t srcY = 0; srcY < maxSrcY; srcY++) {
-      const size_t srcRowStart = srcY * srcRowBytes;
-
-      for (uint16_t srcX = 0; srcX < pageWidth; srcX++) {
-        // Read source pixel (MSB first, bit 7 = leftmost pixel)
-        const size_t srcByte = srcRowStart + srcX / 8;
-        const size_t srcBit = 7 - (srcX % 8);
-        const bool isBlack = !((pageBuffer[srcByte] >> srcBit) & 1);  // XTC: 0 = black, 1 = white
+  }
 
-        if (isBlack) {
-          renderer.drawPixel(srcX, srcY, true);
-        }
-      }
-    }
+  // 1-bit mode: 8 pixels per byte, MSB first, 0 = black, 1 = white
+  if (!drawPagePass(pageBuffer, nullptr, 0, true)) {
+    LOG_ERR("XTR", "Failed to stream page %lu", currentPage);
   }
   // White pixels are already cleared by clearScreen()
 
-  free(pageBuffer);
-
   // XTC pages already have status bar pre-rendered, no need to add our own
 
   // Display with appropriate refresh
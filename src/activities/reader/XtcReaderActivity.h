@@ -8,11 +8,13 @@
 #pragma once
 
 #include <Xtc.h>
+#include <XtcPageCache.h>
 
 #include "activities/ActivityWithSubactivity.h"
 
 class XtcReaderActivity final : public ActivityWithSubactivity {
   std::shared_ptr<Xtc> xtc;
+  std::unique_ptr<XtcPageCache> pageCache;
 
   uint32_t currentPage = 0;
   int pagesUntilFullRefresh = 0;
@@ -21,6 +23,8 @@ class XtcReaderActivity final : public ActivityWithSubactivity {
   const std::function<void()> onGoHome;
 
   void renderPage();
+  // One blit of the current page, from `bitmap` or streamed from the card when it is null
+  bool drawPagePass(const uint8_t* bitmap, uint8_t* streamPlane1, uint8_t levelMask, bool state);
   void saveProgress() const;
   void loadProgress();
 
@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "lib/GfxRenderer/BitmapHelpers.h"
+
+// Checks the word-at-a-time row kernels and ditherRow() of BitmapHelpers against the per-pixel functions they
+// replace, packing the per-pixel results the same way, on random and gradient images of many widths. Any differing
+// byte is a failure: the kernels are meant to be exact. Then times both on a full-screen (480x800) image.
+
+namespace {
+
+constexpr int ROUNDS = 20;
+constexpr int BENCH_WIDTH = 480;
+constexpr int BENCH_HEIGHT = 800;
+
+struct Image {
+  int width = 0;
+  int height = 0;
+  std::vector<uint8_t> pixels;
+  const uint8_t* row(const int y) const { return pixels.data() + static_cast<size_t>(y) * width; }
+};
+
+Image randomImage(const int width, const int height, uint32_t seed) {
+  Image image{width, height, std::vector<uint8_t>(static_cast<size_t>(width) * height)};
+  for (auto& p : image.pixels) {
+    seed = seed * 1664525u + 1013904223u;
+    p = static_cast<uint8_t>(seed >> 24);
+  }
+  return image;
+}
+
+// Smooth ramps are where error diffusion state matters most
+Image gradientImage(const int width, const int height) {
+  Image image{width, height, std::vector<uint8_t>(static_cast<size_t>(width) * height)};
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      image.pixels[static_cast<size_t>(y) * width + x] = static_cast<uint8_t>((x * 255 / std::max(1, width - 1) +
+                                                                              y * 3) % 256);
+    }
+  }
+  return image;
+}
+
+// Packs levelOf(x) for a row, bitsPerPixel wide and MSB first, with the unused low bits cleared
+template <typename LevelFn>
+void packPixels(uint8_t* out, const int width, const int bitsPerPixel, LevelFn&& levelOf) {
+  const int perByte = 8 / bitsPerPixel;
+  memset(out, 0, (width + perByte - 1) / perByte);
+  for (int x = 0; x < width; x++) {
+    out[x / perByte] |= levelOf(x) << (8 - bitsPerPixel * (x % perByte + 1));
+  }
+}
+
+struct Kernel {
+  const char* name;
+  int bitsPerPixel;
+  // Reference and row kernel for a whole image, one packed row per call
+  void (*reference)(const Image& image, std::vector<uint8_t>& out);
+  void (*fast)(const Image& image, std::vector<uint8_t>& out);
+};
+
+int packedBytes(const int width, const int bitsPerPixel) { return (width * bitsPerPixel + 7) / 8; }
+
+void referenceQuantize(const Image& image, std::vector<uint8_t>& out) {
+  const int stride = packedBytes(image.width, 2);
+  out.assign(static_cast<size_t>(stride) * image.height, 0);
+  for (int y = 0; y < image.height; y++) {
+    packPixels(out.data() + y * stride, image.width, 2,
+               [&](const int x) { return quantize(adjustPixel(image.row(y)[x]), x, y); });
+  }
+}
+
+void fastQuantize(const Image& image, std::vector<uint8_t>& out) {
+  const int stride = packedBytes(image.width, 2);
+  out.assign(static_cast<size_t>(stride) * image.height, 0);
+  for (int y = 0; y < image.height; y++) {
+    quantizeRow(image.row(y), out.data() + y * stride, image.width, y);
+  }
+}
+
+void referenceNative(const Image& image, std::vector<uint8_t>& out) {
+  const int stride = packedBytes(image.width, 2);
+  out.assign(static_cast<size_t>(stride) * image.height, 0);
+  for (int y = 0; y < image.height; y++) {
+    packPixels(out.data() + y * stride, image.width, 2, [&](const int x) { return adjustPixel(image.row(y)[x]) >> 6; });
+  }
+}
+
+void fastNative(const Image& image, std::vector<uint8_t>& out) {
+  const int stride = packedBytes(image.width, 2);
+  out.assign(static_cast<size_t>(stride) * image.height, 0);
+  for (int y = 0; y < image.height; y++) {
+    quantizeRowNative(image.row(y), out.data() + y * stride, image.width);
+  }
+}
+
+// Odd horizontal offset so the Bayer phase does not start at lane 0
+constexpr int BAYER_X = 3;
+
+void referenceBayer(const Image& image, std::vector<uint8_t>& out) {
+  const int stride = packedBytes(image.width, 2);
+  out.assign(static_cast<size_t>(stride) * image.height, 0);
+  for (int y = 0; y < image.height; y++) {
+    packPixels(out.data() + y * stride, image.width, 2,
+               [&](const int x) { return applyBayerDither4Level(image.row(y)[x], BAYER_X + x, y); });
+  }
+}
+
+void fastBayer(const Image& image, std::vector<uint8_t>& out) {
+  const int stride = packedBytes(image.width, 2);
+  out.assign(static_cast<size_t>(stride) * image.height, 0);
+  for (int y = 0; y < image.height; y++) {
+    ditherRowBayer(image.row(y), out.data() + y * stride, image.width, BAYER_X, y);
+  }
+}
+
+template <typename Ditherer, int Bits, bool AdjustFirst>
+void referenceDiffusion(const Image& image, std::vector<uint8_t>& out) {
+  const int stride = packedBytes(image.width, Bits);
+  out.assign(static_cast<size_t>(stride) * image.height, 0);
+  Ditherer ditherer(image.width);
+  for (int y = 0; y < image.height; y++) {
+    packPixels(out.data() + y * stride, image.width, Bits, [&](const int x) {
+      const int gray = image.row(y)[x];
+      return ditherer.processPixel(AdjustFirst ? adjustPixel(gray) : gray, x);
+    });
+    ditherer.nextRow();
+  }
+}
+
+template <typename Ditherer, int Bits>
+void fastDiffusion(const Image& image, std::vector<uint8_t>& out) {
+  const int stride = packedBytes(image.width, Bits);
+  out.assign(static_cast<size_t>(stride) * image.height, 0);
+  Ditherer ditherer(image.width);
+  for (int y = 0; y < image.height; y++) {
+    ditherer.ditherRow(image.row(y), out.data() + y * stride);
+  }
+}
+
+const Kernel KERNELS[] = {
+    {"quantizeRow", 2, referenceQuantize, fastQuantize},
+    {"quantizeRowNative", 2, referenceNative, fastNative},
+    {"ditherRowBayer", 2, referenceBayer, fastBayer},
+    {"AtkinsonDitherer", 2, referenceDiffusion<AtkinsonDitherer, 2, true>, fastDiffusion<AtkinsonDitherer, 2>},
+    {"Atkinson1BitDitherer", 1, referenceDiffusion<Atkinson1BitDitherer, 1, false>,
+     fastDiffusion<Atkinson1BitDitherer, 1>},
+    {"FloydSteinbergDitherer", 2, referenceDiffusion<FloydSteinbergDitherer, 2, true>,
+     fastDiffusion<FloydSteinbergDitherer, 2>},
+};
+
+// Best of ROUNDS, in milliseconds
+double timeRun(void (*run)(const Image&, std::vector<uint8_t>&), const Image& image, std::vector<uint8_t>& out) {
+  using Clock = std::chrono::steady_clock;
+  double best = 0.0;
+  for (int round = 0; round < ROUNDS; round++) {
+    const auto start = Clock::now();
+    run(image, out);
+    const double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    best = round == 0 ? ms : std::min(best, ms);
+  }
+  return best;
+}
+
+}  // namespace
+
+int main() {
+  std::vector<Image> images;
+  for (int width = 1; width <= 40; width++) {
+    images.push_back(randomImage(width, 7, width * 7919u));
+    images.push_back(gradientImage(width, 5));
+  }
+  images.push_back(randomImage(BENCH_WIDTH, 64, 42));
+  images.push_back(gradientImage(BENCH_WIDTH, 64));
+
+  bool ok = true;
+  std::vector<uint8_t> expected;
+  std::vector<uint8_t> actual;
+  for (const Kernel& kernel : KERNELS) {
+    size_t bytes = 0;
+    size_t mismatches = 0;
+    for (const Image& image : images) {
+      kernel.reference(image, expected);
+      kernel.fast(image, actual);
+      bytes += expected.size();
+      for (size_t i = 0; i < expected.size(); i++) {
+        if (expected[i] != actual[i]) mismatches++;
+      }
+    }
+    std::cout << kernel.name << ": " << mismatches << " of " << bytes << " packed bytes differ" << std::endl;
+    if (mismatches > 0) ok = false;
+  }
+
+  const Image bench = gradientImage(BENCH_WIDTH, BENCH_HEIGHT);
+  std::cout << std::endl << "Timing on " << BENCH_WIDTH << "x" << BENCH_HEIGHT << ", best of " << ROUNDS << std::endl;
+  for (const Kernel& kernel : KERNELS) {
+    const double referenceMs = timeRun(kernel.reference, bench, expected);
+    const double fastMs = timeRun(kernel.fast, bench, actual);
+    std::cout << "  " << kernel.name << ": per pixel " << referenceMs << " ms, row kernel " << fastMs << " ms ("
+              << referenceMs / fastMs << "x)" << std::endl;
+  }
+
+  std::cout << (ok ? "All kernels match" : "MISMATCH") << std::endl;
+  return ok ? 0 : 1;
+}
@@ -2,15 +2,19 @@
 
 #include <algorithm>
 #include <cctype>
+#include <chrono>
 #include <cmath>
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <random>
 #include <sstream>
 #include <string>
 #include <vector>
 
+#include "lib/Epub/Epub/hyphenation/HyphenationCache.h"
 #include "lib/Epub/Epub/hyphenation/HyphenationCommon.h"
+#include "lib/Epub/Epub/hyphenation/Hyphenator.h"
 #include "lib/Epub/Epub/hyphenation/LanguageHyphenator.h"
 #include "lib/Epub/Epub/hyphenation/LanguageRegistry.h"
 
@@ -135,6 +139,95 @@ std::vector<size_t> hyphenateWordWithHyphenator(const std::string& word, const L
   return hyphenator.breakIndexes(cps);
 }
 
+// Measures breakIndexes() alone: codepoints are collected up front and the corpus is replayed for several
+// timed rounds. The best round is reported, as it is the one least disturbed by the rest of the system.
+double measureWordsPerSecond(const std::vector<TestCase>& testCases, const LanguageHyphenator& hyphenator) {
+  std::vector<std::vector<CodepointInfo>> words;
+  words.reserve(testCases.size());
+  for (const auto& testCase : testCases) {
+    auto cps = collectCodepoints(testCase.word);
+    trimSurroundingPunctuationAndFootnote(cps);
+    words.push_back(std::move(cps));
+  }
+
+  using Clock = std::chrono::steady_clock;
+  constexpr int kRounds = 7;
+  constexpr std::chrono::milliseconds kMinRoundDuration(100);
+  // Volatile sink so the calls cannot be optimized away
+  volatile size_t breaksFound = 0;
+  double best = 0.0;
+  for (int round = 0; round < kRounds; ++round) {
+    size_t wordsProcessed = 0;
+    const auto start = Clock::now();
+    auto elapsed = Clock::duration::zero();
+    do {
+      for (const auto& cps : words) {
+        breaksFound = breaksFound + hyphenator.breakIndexes(cps).size();
+      }
+      wordsProcessed += words.size();
+      elapsed = Clock::now() - start;
+    } while (elapsed < kMinRoundDuration);
+    best = std::max(best, wordsProcessed / std::chrono::duration<double>(elapsed).count());
+  }
+  return best;
+}
+
+struct IndexingSpeed {
+  double unhyphenatedWordsPerSecond = 0.0;
+  double hyphenatedWordsPerSecond = 0.0;
+  double cacheHitRate = 0.0;
+};
+
+// Approximates the per-word cost of indexing a chapter with and without hyphenation. The corpus is replayed as
+// running text (each word repeated by its frequency, in a fixed shuffled order); the unhyphenated pass only
+// decodes each word, the hyphenated pass also asks Hyphenator::breakOffsets() through a HyphenationCache, the
+// way a section build does.
+IndexingSpeed measureIndexingSpeed(const std::vector<TestCase>& testCases, const char* primaryTag) {
+  std::vector<const char*> text;
+  for (const auto& testCase : testCases) {
+    text.insert(text.end(), std::max(testCase.frequency, 1), testCase.word.c_str());
+  }
+  std::shuffle(text.begin(), text.end(), std::mt19937(42));
+
+  using Clock = std::chrono::steady_clock;
+  constexpr int kRounds = 5;
+  // Volatile sink so the work cannot be optimized away
+  volatile size_t sink = 0;
+  const auto bestWordsPerSecond = [&](const std::function<size_t(const char*)>& perWord) {
+    double best = 0.0;
+    for (int round = 0; round < kRounds; ++round) {
+      const auto start = Clock::now();
+      for (const char* word : text) {
+        sink = sink + perWord(word);
+      }
+      const auto elapsed = Clock::now() - start;
+      best = std::max(best, text.size() / std::chrono::duration<double>(elapsed).count());
+    }
+    return best;
+  };
+  const auto decode = [](const char* word) {
+    const auto* ptr = reinterpret_cast<const unsigned char*>(word);
+    size_t codepoints = 0;
+    while (*ptr != 0) {
+      utf8NextCodepoint(&ptr);
+      ++codepoints;
+    }
+    return codepoints;
+  };
+
+  IndexingSpeed speed;
+  speed.unhyphenatedWordsPerSecond = bestWordsPerSecond(decode);
+
+  Hyphenator::setPreferredLanguage(primaryTag);
+  HyphenationCache cache;
+  Hyphenator::setBreakCache(&cache);
+  speed.hyphenatedWordsPerSecond = bestWordsPerSecond(
+      [&decode](const char* word) { return decode(word) + Hyphenator::breakOffsets(word, false).size(); });
+  Hyphenator::setBreakCache(nullptr);
+  speed.cacheHitRate = cache.lookups() == 0 ? 0.0 : static_cast<double>(cache.hits()) / cache.lookups();
+  return speed;
+}
+
 std::vector<LanguageConfig> resolveLanguages(const std::string& selection) {
   if (selection == "all") {
     return kSupportedLanguages;
@@ -304,6 +397,8 @@ void printResults(const std::string& language, const std::vector<TestCase>& test
 
 int main(int argc, char* argv[]) {
   const bool summaryMode = argc <= 1;
+  // `<language|all> --benchmark` only reports hyphenation throughput
+  const bool benchmarkMode = argc > 2 && std::string(argv[2]) == "--benchmark";
   const std::string languageSelection = summaryMode ? "all" : argv[1];
 
   std::vector<LanguageConfig> languages = resolveLanguages(languageSelection);
@@ -322,7 +417,7 @@ int main(int argc, char* argv[]) {
       return hyphenateWordWithHyphenator(word, *hyphenator);
     };
 
-    if (!summaryMode) {
+    if (!summaryMode && !benchmarkMode) {
       std::cout << "Loading test data from: " << lang.testDataFile << std::endl;
     }
     std::vector<TestCase> testCases = loadTestData(lang.testDataFile);
@@ -332,6 +427,17 @@ int main(int argc, char* argv[]) {
       continue;
     }
 
+    if (benchmarkMode) {
+      std::cout << lang.cliName << ": " << static_cast<long>(measureWordsPerSecond(testCases, *hyphenator))
+                << " words/s" << std::endl;
+      const IndexingSpeed indexing = measureIndexingSpeed(testCases, lang.primaryTag);
+      std::cout << lang.cliName << " indexing: " << static_cast<long>(indexing.unhyphenatedWordsPerSecond)
+                << " words/s unhyphenated, " << static_cast<long>(indexing.hyphenatedWordsPerSecond)
+                << " words/s hyphenated (" << static_cast<int>(indexing.cacheHitRate * 100) << "% cache hits)"
+                << std::endl;
+      continue;
+    }
+
     if (!summaryMode) {
       std::cout << "Loaded " << testCases.size() << " test cases for " << lang.cliName << std::endl;
       std::cout << std::endl;
@@ -384,6 +490,11 @@ int main(int argc, char* argv[]) {
 
     printResults(lang.cliName, testCases, worstCases, perfectMatches, partialMatches, completeMisses, totalPrecision,
                  totalRecall, totalF1, totalWeighted, totalTP, totalFP, totalFN, hyphenateFunc);
+
+    std::cout << "--- Throughput ---" << std::endl;
+    std::cout << "Words per second:        " << static_cast<long>(measureWordsPerSecond(testCases, *hyphenator))
+              << std::endl;
+    std::cout << std::endl;
   }
 
   return 0;
@@ -0,0 +1,219 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "lib/picojpeg/picojpeg.h"
+
+// Decodes JPEG files with picojpeg at 1/1, 1/2, 1/4 and 1/8 scale and compares each reduced decode, and the
+// full decode point-sampled to the same size the way the converters used to shrink images, against a box-filtered
+// full decode. Reports decode times and PSNR, and writes every result as a PGM next to the given output prefix.
+//
+// Usage: JpegScaleBenchmark <output-prefix> <file.jpg>...
+
+namespace {
+
+constexpr int ROUNDS = 5;
+
+struct MemoryReader {
+  const std::vector<uint8_t>* data;
+  size_t pos;
+};
+
+unsigned char readCallback(unsigned char* pBuf, const unsigned char bufSize, unsigned char* pBytesRead,
+                           void* pCallbackData) {
+  auto* reader = static_cast<MemoryReader*>(pCallbackData);
+  const size_t left = reader->data->size() - reader->pos;
+  const size_t count = left < bufSize ? left : bufSize;
+  memcpy(pBuf, reader->data->data() + reader->pos, count);
+  reader->pos += count;
+  *pBytesRead = static_cast<unsigned char>(count);
+  return 0;
+}
+
+struct GrayImage {
+  int width = 0;
+  int height = 0;
+  std::vector<uint8_t> pixels;
+};
+
+// Decodes to 8-bit luma with the same block addressing and luma weights as JpegToFramebufferConverter
+bool decode(const std::vector<uint8_t>& jpeg, const unsigned char scale, GrayImage& out) {
+  MemoryReader reader = {&jpeg, 0};
+  pjpeg_image_info_t info;
+  if (pjpeg_decode_init(&info, readCallback, &reader, scale) != 0) {
+    return false;
+  }
+
+  const int round = (1 << scale) - 1;
+  out.width = (info.m_width + round) >> scale;
+  out.height = (info.m_height + round) >> scale;
+  out.pixels.assign(static_cast<size_t>(out.width) * out.height, 0);
+
+  const int blockSize = 8 >> scale;
+  const int mcuWidth = info.m_MCUWidth >> scale;
+  const int mcuHeight = info.m_MCUHeight >> scale;
+  for (int mcuY = 0; mcuY < info.m_MCUSPerCol; mcuY++) {
+    for (int mcuX = 0; mcuX < info.m_MCUSPerRow; mcuX++) {
+      if (pjpeg_decode_mcu() != 0) {
+        return false;
+      }
+      for (int row = 0; row < mcuHeight; row++) {
+        const int y = mcuY * mcuHeight + row;
+        if (y >= out.height) break;
+        for (int col = 0; col < mcuWidth; col++) {
+          const int x = mcuX * mcuWidth + col;
+          if (x >= out.width) break;
+          const int offset = (row / blockSize) * 128 + (col / blockSize) * 64 + (row % blockSize) * 8 + col % blockSize;
+          uint8_t gray;
+          if (info.m_scanType == PJPG_GRAYSCALE) {
+            gray = info.m_pMCUBufR[offset];
+          } else {
+            gray = static_cast<uint8_t>(
+                (info.m_pMCUBufR[offset] * 77 + info.m_pMCUBufG[offset] * 150 + info.m_pMCUBufB[offset] * 29) >> 8);
+          }
+          out.pixels[static_cast<size_t>(y) * out.width + x] = gray;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+GrayImage boxFilter(const GrayImage& full, const unsigned char scale) {
+  const int factor = 1 << scale;
+  GrayImage out;
+  out.width = (full.width + factor - 1) / factor;
+  out.height = (full.height + factor - 1) / factor;
+  out.pixels.resize(static_cast<size_t>(out.width) * out.height);
+  for (int y = 0; y < out.height; y++) {
+    for (int x = 0; x < out.width; x++) {
+      int sum = 0;
+      int count = 0;
+      for (int sy = y * factor; sy < (y + 1) * factor && sy < full.height; sy++) {
+        for (int sx = x * factor; sx < (x + 1) * factor && sx < full.width; sx++) {
+          sum += full.pixels[static_cast<size_t>(sy) * full.width + sx];
+          count++;
+        }
+      }
+      out.pixels[static_cast<size_t>(y) * out.width + x] = static_cast<uint8_t>((sum + count / 2) / count);
+    }
+  }
+  return out;
+}
+
+GrayImage pointSample(const GrayImage& full, const unsigned char scale) {
+  const int factor = 1 << scale;
+  GrayImage out;
+  out.width = (full.width + factor - 1) / factor;
+  out.height = (full.height + factor - 1) / factor;
+  out.pixels.resize(static_cast<size_t>(out.width) * out.height);
+  for (int y = 0; y < out.height; y++) {
+    for (int x = 0; x < out.width; x++) {
+      out.pixels[static_cast<size_t>(y) * out.width + x] =
+          full.pixels[static_cast<size_t>(y * factor) * full.width + x * factor];
+    }
+  }
+  return out;
+}
+
+double psnr(const GrayImage& a, const GrayImage& b) {
+  double sum = 0.0;
+  for (size_t i = 0; i < a.pixels.size(); i++) {
+    const double diff = static_cast<double>(a.pixels[i]) - b.pixels[i];
+    sum += diff * diff;
+  }
+  if (sum == 0.0) return INFINITY;
+  return 10.0 * std::log10(255.0 * 255.0 / (sum / a.pixels.size()));
+}
+
+void writePgm(const std::string& path, const GrayImage& image) {
+  std::ofstream file(path, std::ios::binary);
+  file << "P5\n" << image.width << " " << image.height << "\n255\n";
+  file.write(reinterpret_cast<const char*>(image.pixels.data()), static_cast<std::streamsize>(image.pixels.size()));
+}
+
+std::string baseName(const std::string& path) {
+  const size_t slash = path.find_last_of('/');
+  std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+  const size_t dot = name.find_last_of('.');
+  return dot == std::string::npos ? name : name.substr(0, dot);
+}
+
+// Best of ROUNDS decodes, in milliseconds
+double timeDecode(const std::vector<uint8_t>& jpeg, const unsigned char scale, GrayImage& out) {
+  using Clock = std::chrono::steady_clock;
+  double best = 0.0;
+  for (int round = 0; round < ROUNDS; round++) {
+    const auto start = Clock::now();
+    if (!decode(jpeg, scale, out)) {
+      return -1.0;
+    }
+    const double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    best = round == 0 ? ms : std::min(best, ms);
+  }
+  return best;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0] << " <output-prefix> <file.jpg>..." << std::endl;
+    return 1;
+  }
+  const std::string prefix = argv[1];
+  static const char* const kScaleNames[] = {"1_1", "1_2", "1_4", "1_8"};
+
+  bool ok = true;
+  for (int arg = 2; arg < argc; arg++) {
+    std::ifstream file(argv[arg], std::ios::binary);
+    if (!file) {
+      std::cerr << "Cannot open " << argv[arg] << std::endl;
+      return 1;
+    }
+    const std::vector<uint8_t> jpeg((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    const std::string name = baseName(argv[arg]);
+
+    GrayImage full;
+    const double fullMs = timeDecode(jpeg, PJPG_SCALE_1_1, full);
+    if (fullMs < 0) {
+      std::cerr << argv[arg] << ": decode failed" << std::endl;
+      ok = false;
+      continue;
+    }
+    std::cout << name << " " << full.width << "x" << full.height << std::endl;
+    std::cout << "  1/1  " << fullMs << " ms" << std::endl;
+    writePgm(prefix + name + "_" + kScaleNames[0] + ".pgm", full);
+
+    for (unsigned char scale = PJPG_SCALE_1_2; scale <= PJPG_SCALE_1_8; scale++) {
+      GrayImage reduced;
+      const double ms = timeDecode(jpeg, scale, reduced);
+      if (ms < 0) {
+        std::cerr << argv[arg] << ": decode at scale " << kScaleNames[scale] << " failed" << std::endl;
+        ok = false;
+        continue;
+      }
+      const GrayImage reference = boxFilter(full, scale);
+      const GrayImage sampled = pointSample(full, scale);
+      if (reduced.width != reference.width || reduced.height != reference.height) {
+        std::cerr << argv[arg] << ": unexpected size at scale " << kScaleNames[scale] << std::endl;
+        ok = false;
+        continue;
+      }
+      std::cout << "  1/" << (1 << scale) << "  " << ms << " ms (" << fullMs / ms << "x), PSNR vs box filter "
+                << psnr(reduced, reference) << " dB, point-sampled full decode " << psnr(sampled, reference) << " dB"
+                << std::endl;
+      writePgm(prefix + name + "_" + kScaleNames[scale] + ".pgm", reduced);
+      writePgm(prefix + name + "_" + kScaleNames[scale] + "_box.pgm", reference);
+      writePgm(prefix + name + "_" + kScaleNames[scale] + "_sampled.pgm", sampled);
+    }
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,36 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+BUILD_DIR="$ROOT_DIR/build/jpeg_scale_bench"
+BINARY="$BUILD_DIR/JpegScaleBenchmark"
+OUTPUT_DIR="$BUILD_DIR/images"
+
+mkdir -p "$BUILD_DIR" "$OUTPUT_DIR"
+
+CFLAGS=(
+  -O2
+  -Wall
+)
+
+CXXFLAGS=(
+  -std=c++20
+  -O2
+  -Wall
+  -Wextra
+  -pedantic
+  -I"$ROOT_DIR"
+  -I"$ROOT_DIR/lib"
+)
+
+cc "${CFLAGS[@]}" -c "$ROOT_DIR/lib/picojpeg/picojpeg.c" -o "$BUILD_DIR/picojpeg.o"
+c++ "${CXXFLAGS[@]}" "$ROOT_DIR/test/jpeg_scale_bench/JpegScaleBenchmark.cpp" "$BUILD_DIR/picojpeg.o" -o "$BINARY"
+
+# Without arguments, use the images of the JPEG test book
+if [ "$#" -eq 0 ]; then
+  unzip -o -q -j "$ROOT_DIR/test/epubs/test_jpeg_images.epub" '*.jpg' -d "$BUILD_DIR/input"
+  set -- "$BUILD_DIR"/input/*.jpg
+fi
+
+"$BINARY" "$OUTPUT_DIR/" "$@"
+echo "Comparison images written to $OUTPUT_DIR"
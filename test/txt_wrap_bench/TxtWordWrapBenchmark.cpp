@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "lib/Txt/TxtWordWrap.h"
+
+// Paginates a plain-text file the way TxtReaderActivity::loadPageAtOffset does (8 KB chunks, whole lines per page)
+// with the single-pass wrapper and with the previous shrink-and-remeasure loop, checks that both produce the same
+// page offsets and reports their throughput. Without a file argument a 10 MB synthetic book is generated.
+
+namespace {
+
+constexpr size_t CHUNK_SIZE = 8 * 1024;
+constexpr int VIEWPORT_WIDTH = 454;  // Portrait screen minus default margins
+constexpr int LINES_PER_PAGE = 27;
+constexpr size_t SYNTHETIC_SIZE = 10 * 1024 * 1024;
+
+// Proportional stand-in for a reader font
+int advanceOf(const uint32_t cp) {
+  if (cp == ' ') return 6;
+  if (cp == 'i' || cp == 'l' || cp == 'j' || cp == '.' || cp == ',') return 5;
+  if (cp == 'm' || cp == 'w' || cp == 'M' || cp == 'W') return 16;
+  if (cp < 0x80) return 10;
+  return 11;
+}
+
+int advanceWidth(const std::string& text) {
+  int width = 0;
+  size_t pos = 0;
+  while (pos < text.size()) {
+    width += advanceOf(txtNextCodepoint(text.data(), text.size(), pos));
+  }
+  return width;
+}
+
+std::string syntheticBook() {
+  static const char* const kWords[] = {
+      "the",   "of",    "and",    "reader", "paper", "ink", "page", "light", "quiet",    "i",
+      "will",  "margin", "window", "whom",  "a",     "—",   "über", "façade", "naïve",   "mountain",
+      "книга", "свет",  "страница", "extraordinarily"};
+  constexpr size_t kWordCount = sizeof(kWords) / sizeof(kWords[0]);
+
+  std::string text;
+  text.reserve(SYNTHETIC_SIZE + 4096);
+  uint32_t state = 12345;
+  auto next = [&state]() {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+  };
+  while (text.size() < SYNTHETIC_SIZE) {
+    // Paragraphs of a few words to a few thousand bytes, some with an unbreakable run
+    const size_t paragraphWords = 1 + next() % 400;
+    for (size_t w = 0; w < paragraphWords; ++w) {
+      if (w > 0) text += ' ';
+      if (next() % 500 == 0) {
+        text.append(80 + next() % 120, 'x');
+      } else {
+        text += kWords[next() % kWordCount];
+      }
+    }
+    text += next() % 4 == 0 ? "\r\n\r\n" : "\n";
+  }
+  return text;
+}
+
+// Wrap loop replaced by wrapTxtLine(), with getTextWidth() stood in for by the summed advances
+size_t legacyWrapLine(const char* text, const size_t length, const size_t linesLeft, size_t& linesOut) {
+  std::string line(text, length);
+  size_t lineBytePos = 0;
+  size_t emitted = 0;
+  while (!line.empty() && emitted < linesLeft) {
+    if (advanceWidth(line) <= VIEWPORT_WIDTH) {
+      emitted++;
+      lineBytePos = length;
+      line.clear();
+      break;
+    }
+    size_t breakPos = line.length();
+    while (breakPos > 0 && advanceWidth(line.substr(0, breakPos)) > VIEWPORT_WIDTH) {
+      const size_t spacePos = line.rfind(' ', breakPos - 1);
+      if (spacePos != std::string::npos && spacePos > 0) {
+        breakPos = spacePos;
+      } else {
+        breakPos--;
+        while (breakPos > 0 && (line[breakPos] & 0xC0) == 0x80) {
+          breakPos--;
+        }
+      }
+    }
+    if (breakPos == 0) {
+      breakPos = 1;
+    }
+    emitted++;
+    size_t skipChars = breakPos;
+    if (breakPos < line.length() && line[breakPos] == ' ') {
+      skipChars++;
+    }
+    lineBytePos += skipChars;
+    line = line.substr(skipChars);
+  }
+  linesOut += emitted;
+  return line.empty() ? length : lineBytePos;
+}
+
+size_t singlePassWrapLine(const char* text, const size_t length, const size_t linesLeft, size_t& linesOut) {
+  size_t emitted = 0;
+  const size_t consumed =
+      wrapTxtLine(text, length, VIEWPORT_WIDTH, advanceOf, [&](size_t, size_t, int) { return ++emitted < linesLeft; });
+  linesOut += emitted;
+  return consumed;
+}
+
+template <typename WrapFn>
+std::vector<size_t> paginate(const std::string& book, WrapFn&& wrapLine) {
+  std::vector<size_t> pages = {0};
+  size_t offset = 0;
+  while (offset < book.size()) {
+    const size_t chunkSize = std::min(CHUNK_SIZE, book.size() - offset);
+    const char* chunk = book.data() + offset;
+    size_t lines = 0;
+    size_t pos = 0;
+    while (pos < chunkSize && lines < LINES_PER_PAGE) {
+      size_t lineEnd = pos;
+      while (lineEnd < chunkSize && chunk[lineEnd] != '\n') lineEnd++;
+      const bool lineComplete = lineEnd < chunkSize || offset + lineEnd >= book.size();
+      if (!lineComplete && lines > 0) break;
+      size_t displayLen = lineEnd - pos;
+      if (displayLen > 0 && chunk[pos + displayLen - 1] == '\r') displayLen--;
+
+      const size_t consumed = wrapLine(chunk + pos, displayLen, LINES_PER_PAGE - lines, lines);
+      if (consumed >= displayLen) {
+        pos = lineEnd + 1;
+      } else {
+        pos += consumed;
+        break;
+      }
+    }
+    if (pos == 0) pos = 1;
+    offset = std::min(offset + pos, book.size());
+    if (offset < book.size()) pages.push_back(offset);
+  }
+  return pages;
+}
+
+// Best of `rounds` full paginations, in seconds
+template <typename WrapFn>
+double timePagination(const std::string& book, WrapFn&& wrapLine, const int rounds, std::vector<size_t>& pages) {
+  using Clock = std::chrono::steady_clock;
+  double best = 0.0;
+  for (int round = 0; round < rounds; ++round) {
+    const auto start = Clock::now();
+    pages = paginate(book, wrapLine);
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    best = round == 0 ? seconds : std::min(best, seconds);
+  }
+  return best;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::string book;
+  if (argc > 1) {
+    std::ifstream file(argv[1], std::ios::binary);
+    if (!file) {
+      std::cerr << "Cannot open " << argv[1] << std::endl;
+      return 1;
+    }
+    book.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  } else {
+    book = syntheticBook();
+  }
+  const double megabytes = book.size() / (1024.0 * 1024.0);
+  std::cout << "Text: " << book.size() << " bytes" << std::endl;
+
+  std::vector<size_t> singlePassPages;
+  const double singlePass = timePagination(book, singlePassWrapLine, 5, singlePassPages);
+  // The old loop takes minutes on a 10 MB file, so it only runs once
+  std::vector<size_t> legacyPages;
+  const double legacy = timePagination(book, legacyWrapLine, 1, legacyPages);
+
+  std::cout << "Pages: " << singlePassPages.size() << std::endl;
+  std::cout << "Single pass: " << singlePass << " s (" << megabytes / singlePass << " MB/s)" << std::endl;
+  std::cout << "Shrink loop: " << legacy << " s (" << megabytes / legacy << " MB/s)" << std::endl;
+
+  if (singlePassPages != legacyPages) {
+    const auto mismatch = std::mismatch(singlePassPages.begin(), singlePassPages.end(), legacyPages.begin(),
+                                        legacyPages.end());
+    std::cerr << "Page offsets differ from page " << (mismatch.first - singlePassPages.begin()) << std::endl;
+    return 1;
+  }
+  std::cout << "Page offsets match" << std::endl;
+  return 0;
+}